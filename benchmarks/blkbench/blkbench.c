@@ -0,0 +1,164 @@
+/* blkbench - measure random read performance of a block device
+ *
+ * For every queue depth given on the command line, this benchmark forks as
+ * many readers, each of which reads blocks of a fixed size from random,
+ * aligned positions on the device until the time is up. The total number of
+ * reads is shown as operations and megabytes per second. With more readers,
+ * more requests can be outstanding at the driver at once, as far as the file
+ * system serving the device passes them on concurrently. The device is only
+ * read from.
+ */
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/ioc_disk.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <minix/partition.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEFAULT_SIZE	4096
+#define DEFAULT_SECONDS	10
+
+static void reader(const char *dev, size_t size, u64_t blocks, int seconds,
+	int out)
+{
+	struct timeval start, now;
+	unsigned long ops = 0;
+	char *buf;
+	off_t pos;
+	int fd;
+
+	if ((buf = malloc(size)) == NULL) {
+		perror("malloc");
+		_exit(1);
+	}
+	if ((fd = open(dev, O_RDONLY)) == -1) {
+		perror(dev);
+		_exit(1);
+	}
+	srandom(getpid());
+
+	gettimeofday(&start, NULL);
+	do {
+		pos = (off_t) (((u64_t) random() << 16 ^ random()) % blocks) *
+			size;
+		if (pread(fd, buf, size, pos) != (ssize_t) size) {
+			perror("pread");
+			_exit(1);
+		}
+		ops++;
+		gettimeofday(&now, NULL);
+	} while (now.tv_sec - start.tv_sec < seconds);
+
+	if (write(out, &ops, sizeof(ops)) != sizeof(ops))
+		_exit(1);
+	_exit(0);
+}
+
+static int run(const char *dev, size_t size, u64_t blocks, int seconds,
+	int depth)
+{
+	struct timeval start, end;
+	unsigned long ops, total = 0;
+	double secs;
+	int i, fds[2], status, failed = 0;
+
+	if (pipe(fds) == -1) {
+		perror("pipe");
+		return -1;
+	}
+
+	fflush(stdout);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < depth; i++) {
+		switch (fork()) {
+		case -1:
+			perror("fork");
+			failed = 1;
+			break;
+		case 0:
+			close(fds[0]);
+			reader(dev, size, blocks, seconds, fds[1]);
+		}
+	}
+	close(fds[1]);
+
+	while (read(fds[0], &ops, sizeof(ops)) == sizeof(ops))
+		total += ops;
+	close(fds[0]);
+
+	while (wait(&status) != -1)
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			failed = 1;
+	gettimeofday(&end, NULL);
+
+	if (failed)
+		return -1;
+
+	secs = (end.tv_sec - start.tv_sec) +
+		(end.tv_usec - start.tv_usec) / 1000000.0;
+	printf("%8zu %6d %12.0f %12.1f\n", size, depth, total / secs,
+		(double) total * size / (1024 * 1024) / secs);
+	fflush(stdout);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct partition part;
+	size_t size;
+	int c, i, fd, depth, seconds;
+
+	size = DEFAULT_SIZE;
+	seconds = DEFAULT_SECONDS;
+	while ((c = getopt(argc, argv, "s:t:")) != -1) {
+		switch (c) {
+		case 's':
+			size = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind >= argc || size == 0 || size % 512 != 0 || seconds <= 0)
+		goto usage;
+
+	if ((fd = open(argv[optind], O_RDONLY)) == -1) {
+		perror(argv[optind]);
+		return 1;
+	}
+	if (ioctl(fd, DIOCGETP, &part) == -1) {
+		perror("DIOCGETP");
+		return 1;
+	}
+	close(fd);
+
+	if (part.size < size) {
+		fprintf(stderr, "%s: device is too small\n", argv[optind]);
+		return 1;
+	}
+
+	printf("%8s %6s %12s %12s\n", "size", "depth", "reads/s", "MB/s");
+	for (i = optind + 1; i < argc; i++) {
+		if ((depth = atoi(argv[i])) <= 0)
+			continue;
+		if (run(argv[optind], size, part.size / size, seconds,
+				depth) != 0)
+			return 1;
+	}
+
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-s size] [-t seconds] device depth ...\n",
+		argv[0]);
+	return 1;
+}
@@ -0,0 +1,5 @@
+#!/bin/sh
+# Reads the given device (default /dev/c0d0) at random; nothing is written.
+dev=${1:-/dev/c0d0}
+./blkbench -s 4096 $dev 1 2 4 8 16
+./blkbench -s 65536 $dev 1 4 16
@@ -0,0 +1,175 @@
+/* Multi-core IPC ping-pong benchmark.
+ *
+ * The same service plays both ends of a pair. A pong instance answers every
+ * request it receives. A ping instance first has itself and its pong put on
+ * one cpu, then does SENDREC round trips with the pong for a number of
+ * seconds and prints the rate, and the cycles a round trip takes. The
+ * requests are null messages, so a single pair measures the bare cost of a
+ * SENDREC to a waiting server and its reply. Pairs on different cpus do not
+ * share any process, so their combined rate shows how well IPC scales across
+ * cores.
+ *
+ * Arguments, given with 'service up -args':
+ *   role=ping|pong	which end of the pair to play
+ *   peer=<label>	label of the pong instance (ping only)
+ *   cpu=<n>		cpu to run the pair on (ping only)
+ *   secs=<n>		seconds to run for (ping only, default 5)
+ */
+#include <minix/drivers.h>
+#include <minix/ds.h>
+#include <minix/com.h>
+#include <minix/minlib.h>
+#include <minix/u64.h>
+
+#define IPCBENCH_PIN	1	/* put the sender on cpu m1_i1 */
+#define IPCBENCH_PING	2	/* one round trip */
+
+#define BATCH		1024	/* round trips between clock readings */
+
+static char role[8];
+static char peer_label[DS_MAX_KEYLEN];
+static long cpu, secs = 5;
+
+/*===========================================================================*
+ *				pin					     *
+ *===========================================================================*/
+static int pin(endpoint_t ep, int on_cpu)
+{
+	/* Let the kernel schedule 'ep' on a fixed cpu, keeping its priority
+	 * and quantum.
+	 */
+	return sys_schedctl(SCHEDCTL_FLAG_KERNEL, ep, -1, -1, on_cpu);
+}
+
+/*===========================================================================*
+ *				do_pong					     *
+ *===========================================================================*/
+static void do_pong(void)
+{
+	message m;
+	int r;
+
+	for (;;) {
+		if ((r = sef_receive(ANY, &m)) != OK)
+			panic("sef_receive failed: %d", r);
+
+		if (m.m_type == IPCBENCH_PIN)
+			m.m_type = pin(m.m_source, m.m1_i1);
+
+		if ((r = send(m.m_source, &m)) != OK)
+			panic("send failed: %d", r);
+	}
+}
+
+/*===========================================================================*
+ *				do_ping					     *
+ *===========================================================================*/
+static void do_ping(void)
+{
+	endpoint_t peer;
+	message m;
+	clock_t start, now, end;
+	u64_t tsc0, tsc1;
+	unsigned long trips;
+	int i, r;
+
+	if ((r = ds_retrieve_label_endpt(peer_label, &peer)) != OK)
+		panic("unable to find peer '%s': %d", peer_label, r);
+
+	/* The pong moves us while we wait for its reply, then we move the
+	 * pong while it waits for our next request.
+	 */
+	m.m_type = IPCBENCH_PIN;
+	m.m1_i1 = cpu;
+	if ((r = sendrec(peer, &m)) != OK || (r = m.m_type) != OK)
+		panic("unable to move to cpu %ld: %d", cpu, r);
+	if ((r = pin(peer, cpu)) != OK)
+		panic("unable to move peer to cpu %ld: %d", cpu, r);
+
+	if ((r = getuptime(&start)) != OK)
+		panic("getuptime failed: %d", r);
+	end = start + secs * sys_hz();
+
+	read_tsc_64(&tsc0);
+	trips = 0;
+	do {
+		for (i = 0; i < BATCH; i++) {
+			m.m_type = IPCBENCH_PING;
+			if ((r = sendrec(peer, &m)) != OK)
+				panic("sendrec failed: %d", r);
+		}
+		trips += BATCH;
+		if ((r = getuptime(&now)) != OK)
+			panic("getuptime failed: %d", r);
+	} while (now < end);
+	read_tsc_64(&tsc1);
+
+	printf("ipcbench: cpu %ld: %lu round trips in %lu ticks, %lu/s, "
+		"%lu cycles each\n",
+		cpu, trips, (unsigned long) (now - start),
+		(unsigned long) (trips * sys_hz() / (now - start)),
+		(unsigned long) div64u(sub64(tsc1, tsc0), trips));
+
+	/* Stay around until we are taken down. */
+	for (;;) {
+		if ((r = sef_receive(ANY, &m)) != OK)
+			panic("sef_receive failed: %d", r);
+	}
+}
+
+/*===========================================================================*
+ *				sef_cb_init_fresh			     *
+ *===========================================================================*/
+static int sef_cb_init_fresh(int UNUSED(type), sef_init_info_t *UNUSED(info))
+{
+	if (env_get_param("role", role, sizeof(role)) != OK)
+		strcpy(role, "pong");
+
+	if (!strcmp(role, "ping")) {
+		if (env_get_param("peer", peer_label,
+				sizeof(peer_label)) != OK)
+			return EINVAL;
+		env_parse("cpu", "d", 0, &cpu, 0, 255);
+		env_parse("secs", "d", 0, &secs, 1, 3600);
+	} else if (strcmp(role, "pong"))
+		return EINVAL;
+
+	return OK;
+}
+
+/*===========================================================================*
+ *				sef_cb_signal_handler			     *
+ *===========================================================================*/
+static void sef_cb_signal_handler(int sig)
+{
+	if (sig == SIGTERM)
+		exit(0);
+}
+
+/*===========================================================================*
+ *				sef_local_startup			     *
+ *===========================================================================*/
+static void sef_local_startup(void)
+{
+	sef_setcb_init_fresh(sef_cb_init_fresh);
+	sef_setcb_signal_handler(sef_cb_signal_handler);
+
+	sef_startup();
+}
+
+/*===========================================================================*
+ *				main					     *
+ *===========================================================================*/
+int main(int argc, char **argv)
+{
+	env_setargs(argc, argv);
+
+	sef_local_startup();
+
+	if (!strcmp(role, "ping"))
+		do_ping();
+	else
+		do_pong();
+
+	return 0;
+}
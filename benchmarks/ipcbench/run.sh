@@ -0,0 +1,39 @@
+#!/bin/sh
+# Runs 1, 2, 4, ... independent ping-pong pairs, each on its own cpu, for a
+# few seconds. Every pair prints its round trip rate and the cycles a null
+# SENDREC round trip takes on the console; when IPC scales, the rate per pair
+# stays the same as pairs are added.
+
+make >/dev/null
+
+ncpus=`grep -c '^processor' /proc/cpuinfo`
+secs=5
+
+n=1
+while [ $n -le $ncpus ]
+do
+	echo "$n pair(s) for $secs seconds"
+	c=0
+	while [ $c -lt $n ]
+	do
+		service up `pwd`/ipcbench -config system.conf \
+			-label ipcpong$c -args "role=pong" \
+			-script /etc/rs.single
+		service up `pwd`/ipcbench -config system.conf \
+			-label ipcping$c \
+			-args "role=ping peer=ipcpong$c cpu=$c secs=$secs" \
+			-script /etc/rs.single
+		c=`expr $c + 1`
+	done
+
+	sleep `expr $secs + 2`
+
+	c=0
+	while [ $c -lt $n ]
+	do
+		service down ipcping$c
+		service down ipcpong$c
+		c=`expr $c + 1`
+	done
+	n=`expr $n \* 2`
+done
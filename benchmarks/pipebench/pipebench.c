@@ -0,0 +1,141 @@
+/* pipebench - measure the throughput of pipes and UNIX domain socketpairs
+ *
+ * For every transfer size given on the command line, this benchmark forks a
+ * child that reads from a pipe, and then from a stream socketpair, until the
+ * writing parent closes its end. The parent writes a fixed amount of data in
+ * transfers of the given size, and the time until the child has read all of
+ * it is shown as a throughput. Small transfers mostly measure the cost of the
+ * calls through VFS and PFS, large ones the cost of copying the data.
+ */
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEFAULT_MBYTES	32
+
+static void drain(int fd, size_t size)
+{
+	char *buf;
+	ssize_t r;
+
+	if ((buf = malloc(size)) == NULL) {
+		perror("malloc");
+		_exit(1);
+	}
+	while ((r = read(fd, buf, size)) > 0)
+		;
+	if (r < 0) {
+		perror("read");
+		_exit(1);
+	}
+	_exit(0);
+}
+
+static double run(int fds[2], size_t size, size_t total)
+{
+	struct timeval start, end;
+	char *buf;
+	size_t done;
+	ssize_t r;
+	pid_t pid;
+	int status;
+
+	if ((buf = malloc(size)) == NULL) {
+		perror("malloc");
+		return -1;
+	}
+	memset(buf, 'x', size);
+
+	fflush(stdout);
+	if ((pid = fork()) == -1) {
+		perror("fork");
+		free(buf);
+		return -1;
+	}
+	if (pid == 0) {
+		close(fds[1]);
+		drain(fds[0], size);
+	}
+	close(fds[0]);
+
+	gettimeofday(&start, NULL);
+	for (done = 0; done < total; done += r) {
+		if ((r = write(fds[1], buf, size)) <= 0) {
+			perror("write");
+			break;
+		}
+	}
+	close(fds[1]);
+	waitpid(pid, &status, 0);
+	gettimeofday(&end, NULL);
+	free(buf);
+
+	if (done < total || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		return -1;
+
+	return (double) total / (1024 * 1024) /
+		((end.tv_sec - start.tv_sec) +
+		(end.tv_usec - start.tv_usec) / 1000000.0);
+}
+
+static void result(double mbs)
+{
+	if (mbs < 0)
+		printf(" %12s", "-");
+	else
+		printf(" %12.1f", mbs);
+}
+
+int main(int argc, char **argv)
+{
+	size_t size, total;
+	int c, i, fds[2];
+
+	total = DEFAULT_MBYTES;
+	while ((c = getopt(argc, argv, "m:")) != -1) {
+		switch (c) {
+		case 'm':
+			total = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-m mbytes] size ...\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	total *= 1024 * 1024;
+
+	printf("%8s %12s %12s\n", "size", "pipe MB/s", "socket MB/s");
+	for (i = optind; i < argc; i++) {
+		if ((size = atoi(argv[i])) == 0)
+			continue;
+		printf("%8zu", size);
+
+		if (pipe(fds) == -1) {
+			perror("pipe");
+			return 1;
+		}
+		result(run(fds, size, total));
+
+		/* UNIX domain sockets take at most PIPE_BUF bytes a write. */
+		if (size > PIPE_BUF) {
+			result(-1);
+		} else {
+			if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+				perror("socketpair");
+				return 1;
+			}
+			result(run(fds, size, total));
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+
+	return 0;
+}
@@ -0,0 +1,3 @@
+#!/bin/sh
+# Transfer sizes above PIPE_BUF are only measured for pipes.
+./pipebench 64 512 4096 16384 65536
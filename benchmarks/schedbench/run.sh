@@ -0,0 +1,3 @@
+#!/bin/sh
+# The lottery policy must be active; switch to it with Shift-F7.
+./schedbench 8 16 32 64 128 192
@@ -0,0 +1,134 @@
+/* schedbench - measure the cost of a lottery draw in SCHED
+ *
+ * For every process count given on the command line, this benchmark forks
+ * that many CPU-bound children, gives each of them a different number of
+ * lottery tickets through nice(), and lets them compete for a while. The
+ * number of draws SCHED held in that period and the TSC cycles it spent on
+ * them are taken from /proc/sched, so that the cost of a single draw can be
+ * shown as a function of the number of processes in the lottery.
+ */
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <minix/sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PROC_SCHED	"/proc/sched"
+#define MAX_TICKETS	20	/* PRIO_MAX, the highest nice value */
+#define DEFAULT_SECS	5
+
+struct sample {
+	int policy;
+	unsigned procs;
+	unsigned long draws;
+	unsigned long long cycles;
+};
+
+static int get_sample(struct sample *sp)
+{
+	FILE *fp;
+	unsigned tickets;
+	unsigned long hi, lo;
+	int r;
+
+	if ((fp = fopen(PROC_SCHED, "r")) == NULL) {
+		perror(PROC_SCHED);
+		return -1;
+	}
+	r = fscanf(fp, "%d %u %u %lu %lu %lu", &sp->policy, &sp->procs,
+		&tickets, &sp->draws, &hi, &lo);
+	fclose(fp);
+	if (r != 6) {
+		fprintf(stderr, "schedbench: unexpected format of %s\n",
+			PROC_SCHED);
+		return -1;
+	}
+	sp->cycles = ((unsigned long long) hi << 32) | lo;
+	return 0;
+}
+
+static void spin(int tickets)
+{
+	volatile unsigned long n = 0;
+
+	nice(tickets);
+	for (;;)
+		n++;
+}
+
+static int run(int nprocs, int secs)
+{
+	struct sample before, after;
+	pid_t *pids;
+	unsigned long draws;
+	int i;
+
+	if ((pids = calloc(nprocs, sizeof(*pids))) == NULL) {
+		perror("calloc");
+		return -1;
+	}
+
+	for (i = 0; i < nprocs; i++) {
+		if ((pids[i] = fork()) == -1) {
+			perror("fork");
+			nprocs = i;
+			break;
+		}
+		if (pids[i] == 0)
+			spin(1 + i % MAX_TICKETS);
+	}
+
+	/* Let the children settle into the lottery queue first. */
+	sleep(1);
+	if (get_sample(&before) == 0) {
+		sleep(secs);
+		if (get_sample(&after) == 0) {
+			draws = after.draws - before.draws;
+			printf("%8d %9u %10lu %12llu\n", nprocs, after.procs,
+				draws, draws ? (after.cycles - before.cycles) /
+				draws : 0ULL);
+		}
+	}
+
+	for (i = 0; i < nprocs; i++)
+		kill(pids[i], SIGKILL);
+	for (i = 0; i < nprocs; i++)
+		waitpid(pids[i], NULL, 0);
+	free(pids);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct sample s;
+	int c, i, secs = DEFAULT_SECS;
+
+	while ((c = getopt(argc, argv, "t:")) != -1) {
+		switch (c) {
+		case 't':
+			secs = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-t secs] nprocs ...\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	if (get_sample(&s) != 0)
+		return 1;
+	if (s.policy != SCHEDULE_LOTTERY)
+		fprintf(stderr, "schedbench: warning: lottery policy is not "
+			"active, no draws will be held\n");
+
+	printf("%8s %9s %10s %12s\n", "nprocs", "inlottery", "draws",
+		"cycles/draw");
+	for (i = optind; i < argc; i++)
+		if (run(atoi(argv[i]), secs) != 0)
+			return 1;
+
+	return 0;
+}
@@ -0,0 +1,4 @@
+#!/bin/sh
+# The smallest buffer fits in the TLB with small pages; the larger ones only
+# do with big pages.
+./tlbbench 64 4096 16384 65536
@@ -0,0 +1,107 @@
+/* tlbbench - measure the cost of TLB misses on big anonymous buffers
+ *
+ * For every buffer size (in KB) given on the command line, this benchmark
+ * maps an anonymous buffer, writes to every page of it, and then reads one
+ * word from page after page, striding through the buffer such that no two
+ * reads in a row are near each other. Nearly every read of a buffer larger
+ * than the TLB covers then misses in the TLB, unless VM has mapped the buffer
+ * with big pages. Both the time to fault the buffer in and the time per read
+ * are shown; the smallest buffer is a baseline that always fits.
+ */
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEFAULT_MREADS	16
+#define PAGE		4096
+#define STRIDE		257	/* pages between reads; odd, to get to all */
+
+static double elapsed(struct timeval *start, struct timeval *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+		(end->tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static int run(size_t kbytes, unsigned long reads)
+{
+	struct timeval start, end;
+	volatile unsigned long sum;
+	unsigned long n, page, pages, stride;
+	size_t size;
+	double touch;
+	char *buf;
+
+	size = kbytes * 1024;
+	pages = size / PAGE;
+	if (pages == 0)
+		return 0;
+
+	buf = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE,
+		-1, 0);
+	if (buf == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+
+	gettimeofday(&start, NULL);
+	for (page = 0; page < pages; page++)
+		buf[page * PAGE] = (char) page;
+	gettimeofday(&end, NULL);
+	touch = elapsed(&start, &end);
+
+	/* Spread the reads over cache sets as well as over pages. */
+	if ((stride = STRIDE % pages) == 0)
+		stride = 1;
+	sum = 0;
+	page = 0;
+	gettimeofday(&start, NULL);
+	for (n = 0; n < reads; n++) {
+		sum += *(unsigned long *) (buf + page * PAGE + (page % 64) * 64);
+		if ((page += stride) >= pages)
+			page -= pages;
+	}
+	gettimeofday(&end, NULL);
+
+	printf("%10zu %12.1f %12.2f\n", kbytes,
+		touch > 0 ? (double) size / (1024 * 1024) / touch : 0.0,
+		elapsed(&start, &end) * 1000000000.0 / reads);
+	fflush(stdout);
+
+	munmap(buf, size);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long reads;
+	size_t kbytes;
+	int c, i;
+
+	reads = DEFAULT_MREADS;
+	while ((c = getopt(argc, argv, "n:")) != -1) {
+		switch (c) {
+		case 'n':
+			reads = atol(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n mreads] kbytes ...\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	reads *= 1000000;
+
+	printf("%10s %12s %12s\n", "KB", "fault MB/s", "ns/read");
+	for (i = optind; i < argc; i++) {
+		if ((kbytes = atol(argv[i])) == 0)
+			continue;
+		if (run(kbytes, reads) != 0)
+			return 1;
+	}
+
+	return 0;
+}
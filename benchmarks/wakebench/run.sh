@@ -0,0 +1,4 @@
+#!/bin/sh
+# Boot with tickless=1 to measure the tickless clock, with tickless=0 for
+# the periodic one.
+./wakebench 0 1
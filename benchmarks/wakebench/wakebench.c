@@ -0,0 +1,127 @@
+/* wakebench - measure how often idle cpus wake up
+ *
+ * For every number of busy processes given on the command line, this
+ * benchmark forks that many CPU-bound children, and counts how many times
+ * each cpu wakes up from idle in a fixed period. The counts are taken from
+ * the "wakeups" lines of /proc/cpuinfo, and shown per second. On an idle
+ * system with the periodic tick this is about the clock frequency; with the
+ * tickless clock (boot parameter tickless=1) it comes down to the rate at
+ * which timers expire.
+ */
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PROC_CPUINFO	"/proc/cpuinfo"
+#define MAX_CPUS	32
+#define DEFAULT_SECS	10
+
+static int get_wakeups(unsigned long *wakeups)
+{
+	FILE *fp;
+	char line[128];
+	unsigned long n;
+	int cpus;
+
+	if ((fp = fopen(PROC_CPUINFO, "r")) == NULL) {
+		perror(PROC_CPUINFO);
+		return -1;
+	}
+	cpus = 0;
+	while (fgets(line, sizeof(line), fp) != NULL && cpus < MAX_CPUS) {
+		if (strncmp(line, "wakeups", 7) == 0 &&
+		    sscanf(strchr(line, ':') + 1, "%lu", &n) == 1)
+			wakeups[cpus++] = n;
+	}
+	fclose(fp);
+	if (cpus == 0) {
+		fprintf(stderr, "wakebench: no wakeup counts in %s\n",
+			PROC_CPUINFO);
+		return -1;
+	}
+	return cpus;
+}
+
+static void spin(void)
+{
+	volatile unsigned long n = 0;
+
+	for (;;)
+		n++;
+}
+
+static int run(int nprocs, int secs)
+{
+	unsigned long before[MAX_CPUS], after[MAX_CPUS];
+	pid_t *pids;
+	int i, cpus;
+
+	if ((pids = calloc(nprocs + 1, sizeof(*pids))) == NULL) {
+		perror("calloc");
+		return -1;
+	}
+
+	for (i = 0; i < nprocs; i++) {
+		if ((pids[i] = fork()) == -1) {
+			perror("fork");
+			nprocs = i;
+			break;
+		}
+		if (pids[i] == 0)
+			spin();
+	}
+
+	if ((cpus = get_wakeups(before)) > 0) {
+		sleep(secs);
+		if (get_wakeups(after) != cpus)
+			cpus = -1;
+	}
+
+	for (i = 0; i < nprocs; i++)
+		kill(pids[i], SIGKILL);
+	for (i = 0; i < nprocs; i++)
+		waitpid(pids[i], NULL, 0);
+	free(pids);
+
+	if (cpus < 0)
+		return -1;
+
+	printf("%8d", nprocs);
+	for (i = 0; i < cpus; i++)
+		printf(" %10.1f", (double) (after[i] - before[i]) / secs);
+	printf("\n");
+	fflush(stdout);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int c, i, secs;
+
+	secs = DEFAULT_SECS;
+	while ((c = getopt(argc, argv, "t:")) != -1) {
+		switch (c) {
+		case 't':
+			secs = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-t seconds] busy ...\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (secs <= 0)
+		secs = DEFAULT_SECS;
+
+	printf("%8s %s\n", "busy", "wakeups/s per cpu");
+	for (i = optind; i < argc; i++) {
+		if (run(atoi(argv[i]), secs) != 0)
+			return 1;
+	}
+
+	return 0;
+}
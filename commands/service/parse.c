@@ -732,6 +732,7 @@ struct
 	{ "RS_UPDATE",		VM_RS_UPDATE },
 	{ "RS_MEMCTL",		VM_RS_MEMCTL },
 	{ "PROCCTL",		VM_PROCCTL },
+	{ "WATCH_MEM",		VM_WATCH_MEM },
 	{ NULL,			0 },
 };
 
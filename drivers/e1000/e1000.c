@@ -33,6 +33,7 @@ static void e1000_init_buf(e1000_t *e);
 static void e1000_reset_hw(e1000_t *e);
 static void e1000_writev_s(message *mp, int from_int);
 static void e1000_readv_s(message *mp, int from_int);
+static void e1000_readv_m(e1000_t *e, iovec_s_t *iovec, int tail);
 static void e1000_getstat_s(message *mp);
 static void e1000_interrupt(message *mp);
 static int e1000_link_changed(e1000_t *e);
@@ -91,8 +92,10 @@ int main(int argc, char *argv[])
 	}
 	switch (m.m_type)
 	{
-	    case DL_WRITEV_S:   e1000_writev_s(&m, FALSE);	break;
-	    case DL_READV_S:    e1000_readv_s(&m, FALSE);	break;
+	    case DL_WRITEV_S:
+	    case DL_WRITEV_M:   e1000_writev_s(&m, FALSE);	break;
+	    case DL_READV_S:
+	    case DL_READV_M:    e1000_readv_s(&m, FALSE);	break;
 	    case DL_CONF:	e1000_init(&m);			break;
 	    case DL_GETSTAT_S:  e1000_getstat_s(&m);		break;
 	    default:
@@ -197,6 +200,14 @@ static void e1000_init(message *mp)
     reply_mess.m_type  = DL_CONF_REPLY;
     reply_mess.DL_STAT = OK;
     *(ether_addr_t *) reply_mess.DL_HWADDR = e->address;
+
+    /* Take several packets per request, if the client can send them. */
+    if (mp->DL_MODE & DL_BATCH_REQ)
+    {
+	reply_mess.m_type   = DL_CONF_REPLY_M;
+	reply_mess.DL_BATCH = E1000_IOVEC_NR - 1;
+	reply_mess.DL_RING  = NULL;	/* no shared ring */
+    }
     mess_reply(mp, &reply_mess);
 }
 
@@ -590,7 +601,7 @@ int from_int;
     e1000_t *e = &e1000_state;
     e1000_tx_desc_t *desc;
     iovec_s_t iovec[E1000_IOVEC_NR];
-    int r, head, tail, i, bytes = 0, size;
+    int r, head, tail, i, bytes = 0, size, batch;
 
     E1000_DEBUG(3, ("e1000: writev_s(%p,%d)\n", mp, from_int));
 
@@ -627,9 +638,14 @@ int from_int;
 	E1000_DEBUG(4, ("%s: head=%d, tail=%d\n",
 	                 e->name, head, tail));
 
+	/* In a batch, every vector element is a packet of its own. */
+	batch = (e->tx_message.m_type == DL_WRITEV_M);
+
 	/* Loop vector elements. */
 	for (i = 0; i < e->tx_message.DL_COUNT; i++)
 	{
+	    if (batch)
+		bytes = 0;
 	    size = iovec[i].iov_size < (E1000_IOBUF_SIZE - bytes) ?
 		   iovec[i].iov_size : (E1000_IOBUF_SIZE - bytes);
 
@@ -649,13 +665,18 @@ int from_int;
 	    desc->command = 0;
 	    desc->length  = size;
 
-	    /* Marks End-of-Packet. */
+	    /* Marks End-of-Packet. Report status for the last one only. */
 	    if (i == e->tx_message.DL_COUNT - 1)
 	    {
 		desc->command = E1000_TX_CMD_EOP |
 			        E1000_TX_CMD_FCS |
 				E1000_TX_CMD_RS;
 	    }
+	    else if (batch)
+	    {
+		desc->command = E1000_TX_CMD_EOP |
+			        E1000_TX_CMD_FCS;
+	    }
 	    /* Move to next descriptor. */
 	    tail   = (tail + 1) % e->tx_desc_count;
 	    bytes +=  size;
@@ -715,6 +736,16 @@ int from_int;
 	tail = e1000_reg_read(e, E1000_REG_RDT);
 	cur  = (tail + 1) % e->rx_desc_count;
 	desc = &e->rx_desc[cur];
+
+	/*
+	 * A batch takes as many packets as have arrived.
+	 */
+	if (e->rx_message.m_type == DL_READV_M)
+	{
+	    e1000_readv_m(e, iovec, tail);
+	    reply(e);
+	    return;
+	}
 	
 	/*
 	 * Only handle one packet at a time.
@@ -762,6 +793,68 @@ int from_int;
     reply(e);
 }
 
+/*===========================================================================*
+ *				e1000_readv_m				     *
+ *===========================================================================*/
+static void e1000_readv_m(e, iovec, tail)
+e1000_t *e;
+iovec_s_t *iovec;
+int tail;
+{
+    e1000_rx_desc_t *desc;
+    int i, r, cur, size;
+
+    /*
+     * Copy one received packet to each vector element.
+     */
+    for (i = 0; i < e->rx_message.DL_COUNT; i++)
+    {
+	cur  = (tail + 1) % e->rx_desc_count;
+	desc = &e->rx_desc[cur];
+
+	if (!(desc->status & E1000_RX_STATUS_EOP))
+	    break;
+
+	size = iovec[i].iov_size < desc->length ?
+	       iovec[i].iov_size : desc->length;
+
+	if ((r = sys_safecopyto(e->rx_message.m_source, iovec[i].iov_grant,
+			       0, (vir_bytes) e->rx_buffer +
+			       (cur * E1000_IOBUF_SIZE), size)) != OK)
+	{
+	    panic("sys_safecopyto() failed: %d", r);
+	}
+	desc->status = 0;
+	tail = cur;
+
+	/* Report the size like a single read would. */
+	iovec[i].iov_size = size >= ETH_MIN_PACK_SIZE ?
+			    size : ETH_MIN_PACK_SIZE;
+    }
+    if (i == 0)
+	return;
+
+    /*
+     * Tell the client the size of each packet.
+     */
+    if ((r = sys_safecopyto(e->rx_message.m_source,
+			   e->rx_message.DL_GRANT, 0, (vir_bytes) iovec,
+			   i * sizeof(iovec_s_t))) != OK)
+    {
+	panic("sys_safecopyto() failed: %d", r);
+    }
+
+    /*
+     * Update state.
+     */
+    e->rx_size   = i;
+    e->status   |= E1000_RECEIVED;
+    E1000_DEBUG(2, ("e1000: got %d packets\n", i));
+
+    /* Increment tail. */
+    e1000_reg_write(e, E1000_REG_RDT, tail);
+}
+
 /*===========================================================================*
  *				e1000_getstat_s				     *
  *===========================================================================*/
@@ -1166,8 +1259,11 @@ e1000_t *e;
 	e->status & E1000_RECEIVED)
     {
 	msg.DL_FLAGS |= DL_PACK_RECV;
-	msg.DL_COUNT = e->rx_size >= ETH_MIN_PACK_SIZE ?
-		       e->rx_size  : ETH_MIN_PACK_SIZE;
+	if (e->rx_message.m_type == DL_READV_M)
+	    msg.DL_COUNT = e->rx_size;
+	else
+	    msg.DL_COUNT = e->rx_size >= ETH_MIN_PACK_SIZE ?
+			   e->rx_size  : ETH_MIN_PACK_SIZE;
 
         /* Clear flags. */
 	e->status &= ~(E1000_READING | E1000_RECEIVED);
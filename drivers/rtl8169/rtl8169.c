@@ -105,6 +105,7 @@ typedef struct re {
 
 	/* Tx */
 	int re_tx_head;
+	int re_tx_done;		/* packets of a DL_WRITEV_M already queued */
 	struct {
 		int ret_busy;
 		phys_bytes ret_buf;
@@ -213,6 +214,8 @@ static void rl_confaddr(re_t *rep);
 static void rl_rec_mode(re_t *rep);
 static void rl_readv_s(const message *mp, int from_int);
 static void rl_writev_s(const message *mp, int from_int);
+static void rl_readv_m(const message *mp, int from_int);
+static void rl_writev_m(const message *mp, int from_int);
 static void rl_check_ints(re_t *rep);
 static void rl_report_link(re_t *rep);
 static void rl_do_reset(re_t *rep);
@@ -289,6 +292,8 @@ int main(int argc, char *argv[])
 		switch (m.m_type) {
 		case DL_WRITEV_S:	rl_writev_s(&m, FALSE);	 break;
 		case DL_READV_S:	rl_readv_s(&m, FALSE);	 break;
+		case DL_WRITEV_M:	rl_writev_m(&m, FALSE);	 break;
+		case DL_READV_M:	rl_readv_m(&m, FALSE);	 break;
 		case DL_CONF:		rl_init(&m);		 break;
 		case DL_GETSTAT_S:	rl_getstat_s(&m);	 break;
 		default:
@@ -583,6 +588,13 @@ message *mp;
 	reply_mess.DL_STAT = OK;
 	*(ether_addr_t *) reply_mess.DL_HWADDR = rep->re_address;
 
+	/* Take several packets per request, if the client can send them */
+	if (mp->DL_MODE & DL_BATCH_REQ) {
+		reply_mess.m_type = DL_CONF_REPLY_M;
+		reply_mess.DL_BATCH = IOVEC_NR;
+		reply_mess.DL_RING = NULL;	/* no shared ring */
+	}
+
 	mess_reply(mp, &reply_mess);
 }
 
@@ -680,6 +692,7 @@ re_t *rep;
 	rep->re_rx_head = 0;
 	rep->re_read_s = 0;
 	rep->re_tx_head = 0;
+	rep->re_tx_done = 0;
 	rep->re_stat = empty_stat;
 	rep->dtcc_counter = 0;
 }
@@ -1420,6 +1433,233 @@ suspend:
 	reply(rep);
 }
 
+/*===========================================================================*
+ *				rl_readv_m				     *
+ *===========================================================================*/
+static void rl_readv_m(const message *mp, int from_int)
+{
+/* Receive the packets that have arrived, up to one per vector element, and
+ * report the size of each packet in its element.
+ */
+	int i, count, index;
+	port_t port;
+	unsigned totlen, packlen;
+	re_desc *desc;
+	u32_t rxstat;
+	re_t *rep;
+	iovec_s_t *iovp;
+	int cps;
+
+	rep = &re_state;
+
+	rep->re_client = mp->m_source;
+	count = mp->DL_COUNT;
+	assert(count > 0 && count <= IOVEC_NR);
+
+	assert(rep->re_mode == REM_ENABLED);
+	assert(rep->re_flags & REF_ENABLED);
+
+	port = rep->re_base_port;
+
+	if (!from_int && (rl_inb(port, RL_CR) & RL_CR_BUFE))
+		goto suspend;		/* Receive buffer is empty, suspend */
+
+	cps = sys_safecopyfrom(mp->m_source, mp->DL_GRANT, 0,
+		(vir_bytes) rep->re_iovec_s, count * sizeof(rep->re_iovec_s[0]));
+	if (cps != OK)
+		panic("rl_readv_m: sys_safecopyfrom failed: %d", cps);
+
+	index = rep->re_rx_head;
+	desc = rep->re_rx_desc;
+	desc += index;
+	for (i = 0, iovp = rep->re_iovec_s; i < count; ) {
+		rxstat = desc->status;
+
+		if (rxstat & DESC_OWN)
+			break;
+
+		if (rxstat & DESC_RX_CRC)
+			rep->re_stat.ets_CRCerr++;
+
+		/* Fragmented packets are dropped, see rl_readv_s() */
+		if ((rxstat & (DESC_FS | DESC_LS)) == (DESC_FS | DESC_LS)) {
+			totlen = rxstat & DESC_RX_LENMASK;
+			if (totlen < 8 || totlen > 2 * ETH_MAX_PACK_SIZE) {
+				/* Someting went wrong */
+				printf("rl_readv_m: bad length (%u) in status "
+					"0x%08x\n", totlen, rxstat);
+				panic(NULL);
+			}
+
+			/* Should subtract the CRC */
+			packlen = totlen - ETH_CRC_SIZE;
+			if (packlen > iovp->iov_size)
+				packlen = iovp->iov_size;
+
+			cps = sys_safecopyto(mp->m_source, iovp->iov_grant, 0,
+				(vir_bytes) rep->re_rx[index].v_ret_buf,
+				packlen);
+			if (cps != OK)
+				panic("rl_readv_m: sys_safecopyto failed: %d",
+					cps);
+
+			iovp->iov_size = packlen;
+			rep->re_stat.ets_packetR++;
+			i++;
+			iovp++;
+		}
+
+		/* Give the descriptor back to the card */
+		if (index == N_RX_DESC - 1) {
+			desc->status =  DESC_EOR | DESC_OWN | (RX_BUFSIZE & DESC_RX_LENMASK);
+			index = 0;
+			desc = rep->re_rx_desc;
+		} else {
+			desc->status =  DESC_OWN | (RX_BUFSIZE & DESC_RX_LENMASK);
+			index++;
+			desc++;
+		}
+	}
+	rep->re_rx_head = index;
+	assert(rep->re_rx_head < N_RX_DESC);
+
+	if (i == 0)
+		goto suspend;
+
+	cps = sys_safecopyto(mp->m_source, mp->DL_GRANT, 0,
+		(vir_bytes) rep->re_iovec_s, i * sizeof(rep->re_iovec_s[0]));
+	if (cps != OK)
+		panic("rl_readv_m: sys_safecopyto failed: %d", cps);
+
+	rep->re_read_s = i;
+	rep->re_flags = (rep->re_flags & ~REF_READING) | REF_PACK_RECV;
+
+	if (!from_int)
+		reply(rep);
+
+	return;
+
+suspend:
+	if (from_int) {
+		assert(rep->re_flags & REF_READING);
+
+		/* No need to store any state */
+		return;
+	}
+
+	rep->re_rx_mess = *mp;
+	assert(!(rep->re_flags & REF_READING));
+	rep->re_flags |= REF_READING;
+
+	reply(rep);
+}
+
+/*===========================================================================*
+ *				rl_writev_m				     *
+ *===========================================================================*/
+static void rl_writev_m(const message *mp, int from_int)
+{
+/* Send the packets of a batch, one per vector element. When the card runs
+ * out of transmit descriptors, re_tx_done remembers how far we got, and the
+ * rest is sent from the interrupt handler once descriptors are free.
+ */
+	int s, count, queued;
+	int tx_head;
+	re_t *rep;
+	iovec_s_t *iovp;
+	re_desc *desc;
+	int cps;
+
+	rep = &re_state;
+
+	rep->re_client = mp->m_source;
+	count = mp->DL_COUNT;
+	assert(count > 0 && count <= IOVEC_NR);
+	assert(rep->setup);
+
+	assert(rep->re_mode == REM_ENABLED);
+	assert(rep->re_flags & REF_ENABLED);
+
+	if (from_int) {
+		assert(rep->re_flags & REF_SEND_AVAIL);
+		rep->re_flags &= ~REF_SEND_AVAIL;
+		rep->re_send_int = FALSE;
+		rep->re_tx_alive = TRUE;
+	}
+
+	assert(!(rep->re_flags & REF_PACK_SENT));
+
+	cps = sys_safecopyfrom(mp->m_source, mp->DL_GRANT, 0,
+		(vir_bytes) rep->re_iovec_s, count * sizeof(rep->re_iovec_s[0]));
+	if (cps != OK)
+		panic("rl_writev_m: sys_safecopyfrom failed: %d", cps);
+
+	tx_head = rep->re_tx_head;
+	queued = 0;
+	while (rep->re_tx_done < count) {
+		if (rep->re_tx[tx_head].ret_busy) {
+			assert(!(rep->re_flags & REF_SEND_AVAIL));
+			rep->re_flags |= REF_SEND_AVAIL;
+			if (rep->re_tx[tx_head].ret_busy)
+				break;
+
+			/* Race with the interrupt handler, see rl_writev_s() */
+			rep->re_flags &= ~REF_SEND_AVAIL;
+			rep->re_send_int = FALSE;
+		}
+
+		iovp = &rep->re_iovec_s[rep->re_tx_done];
+		s = iovp->iov_size;
+		if (s < ETH_MIN_PACK_SIZE || s > ETH_MAX_PACK_SIZE_TAGGED)
+			panic("invalid packet size: %d", s);
+
+		cps = sys_safecopyfrom(mp->m_source, iovp->iov_grant, 0,
+			(vir_bytes) rep->re_tx[tx_head].v_ret_buf, s);
+		if (cps != OK)
+			panic("rl_writev_m: sys_safecopyfrom failed: %d", cps);
+
+		rep->re_tx[tx_head].ret_busy = TRUE;
+
+		desc = rep->re_tx_desc;
+		desc += tx_head;
+		if (tx_head == N_TX_DESC - 1) {
+			desc->status =  DESC_EOR | DESC_OWN | DESC_FS | DESC_LS | s;
+			tx_head = 0;
+		} else {
+			desc->status =  DESC_OWN | DESC_FS | DESC_LS | s;
+			tx_head++;
+		}
+
+		rep->re_tx_done++;
+		queued++;
+	}
+
+	assert(tx_head < N_TX_DESC);
+	rep->re_tx_head = tx_head;
+
+	/* One poll starts the transmission of all queued packets */
+	if (queued > 0)
+		rl_outl(rep->re_base_port, RL_TPPOLL, RL_TPPOLL_NPQ);
+
+	if (rep->re_tx_done < count) {
+		rep->re_tx_mess = *mp;
+		if (!from_int)
+			reply(rep);
+		return;
+	}
+
+	rep->re_tx_done = 0;
+	rep->re_flags |= REF_PACK_SENT;
+
+	/*
+	 * If the interrupt handler called, don't send a reply. The reply
+	 * will be sent after all interrupts are handled.
+	 */
+	if (from_int)
+		return;
+	reply(rep);
+}
+
 /*===========================================================================*
  *				rl_check_ints				     *
  *===========================================================================*/
@@ -1433,16 +1673,24 @@ re_t *rep;
 	if ((re_flags & REF_READING) &&
 		!(rl_inb(rep->re_base_port, RL_CR) & RL_CR_BUFE))
 	{
-		assert(rep->re_rx_mess.m_type == DL_READV_S);
-		rl_readv_s(&rep->re_rx_mess, TRUE /* from int */);
+		if (rep->re_rx_mess.m_type == DL_READV_M) {
+			rl_readv_m(&rep->re_rx_mess, TRUE /* from int */);
+		} else {
+			assert(rep->re_rx_mess.m_type == DL_READV_S);
+			rl_readv_s(&rep->re_rx_mess, TRUE /* from int */);
+		}
 	}
 
 	if (rep->re_need_reset)
 		rl_do_reset(rep);
 
 	if (rep->re_send_int) {
-		assert(rep->re_tx_mess.m_type == DL_WRITEV_S);
-		rl_writev_s(&rep->re_tx_mess, TRUE /* from int */);
+		if (rep->re_tx_mess.m_type == DL_WRITEV_M) {
+			rl_writev_m(&rep->re_tx_mess, TRUE /* from int */);
+		} else {
+			assert(rep->re_tx_mess.m_type == DL_WRITEV_S);
+			rl_writev_s(&rep->re_tx_mess, TRUE /* from int */);
+		}
 	}
 
 	if (rep->re_report_link) {
@@ -20,8 +20,6 @@
 
 #include "virtio_blk.h"
 
-#define mystatus(tid)  (status_vir[(tid)] & 0xFF)
-
 #define dprintf(s) do {						\
 	printf("%s: ", name);					\
 	printf s;						\
@@ -29,7 +27,18 @@
 } while (0)
 
 /* Number of threads to use */
-#define VIRTIO_BLK_NUM_THREADS		4
+#define VIRTIO_BLK_NUM_THREADS		16
+
+/* Most virtqueues to use, if the host offers several */
+#define VIRTIO_BLK_MAX_QUEUES		4
+
+/* Most requests in flight per virtqueue, the others wait and may be merged */
+#define VIRTIO_BLK_QUEUE_DEPTH		8
+
+/* Most data segments in a request, merged ones included. An indirect
+ * descriptor table of libvirtio also holds the header and the status.
+ */
+#define VIRTIO_BLK_MAX_SEGS		(MAPVEC_NR + MAPVEC_NR / 2 - 2)
 
 /* virtio-blk blocksize is always 512 bytes */
 #define VIRTIO_BLK_BLOCK_SIZE		512
@@ -51,7 +60,8 @@ struct virtio_feature blkf[] = {
 	{ "scsi",	VIRTIO_BLK_F_SCSI,	0,	0	},
 	{ "flush",	VIRTIO_BLK_F_FLUSH,	0,	0	},
 	{ "topology",	VIRTIO_BLK_F_TOPOLOGY,	0,	0	},
-	{ "idbytes",	VIRTIO_BLK_ID_BYTES,	0,	0	}
+	{ "idbytes",	VIRTIO_BLK_ID_BYTES,	0,	0	},
+	{ "multiqueue",	VIRTIO_BLK_F_MQ,	0,	1	}
 };
 
 /* State information */
@@ -77,6 +87,34 @@ static phys_bytes hdrs_phys;
 static u16_t *status_vir;
 static phys_bytes status_phys;
 
+/* A transfer or flush of a worker thread.
+ *
+ * Requests wait in a list until a queue has room for them. A transfer that
+ * directly follows or precedes a waiting one of the same kind is merged into
+ * it: the first of both then heads a chain of requests, which go to the host
+ * as one, with the header and status of the head.
+ */
+struct blk_req {
+	thread_id_t tid;
+	u32_t type;			/* VIRTIO_BLK_T_* */
+	u64_t sector;			/* first sector of the chain */
+	u64_t end;			/* sector after the chain */
+	int nsegs;			/* segments of the chain */
+	int pcnt;			/* segments of this request */
+	struct vumap_phys phys[MAPVEC_NR];
+	u8_t status;
+	struct blk_req *next;		/* next waiting request */
+	struct blk_req *merged;		/* next request in the chain */
+	struct blk_req *last;		/* last request in the chain */
+};
+
+static struct blk_req reqs[VIRTIO_BLK_NUM_THREADS];
+static struct blk_req *pending;
+
+static int num_queues = 1;
+static int inflight[VIRTIO_BLK_MAX_QUEUES];
+static int seg_limit = VIRTIO_BLK_MAX_SEGS;
+
 /* Prototypes */
 static int virtio_blk_open(dev_t minor, int access);
 static int virtio_blk_close(dev_t minor);
@@ -92,6 +130,9 @@ static void virtio_blk_spurious_intr(void);
 static void virtio_blk_intr(unsigned int irqs);
 static int virtio_blk_device(dev_t minor, device_id_t *id);
 
+static void virtio_blk_submit(struct blk_req *req);
+static void virtio_blk_dispatch(void);
+
 static int virtio_blk_flush(void);
 static void virtio_blk_terminate(void);
 static void virtio_blk_cleanup(void);
@@ -176,9 +217,16 @@ virtio_blk_close(dev_t minor)
 }
 
 static int
-prepare_bufs(struct vumap_vir *vir, struct vumap_phys *phys, int cnt, int w)
+prepare_bufs(struct vumap_phys *phys, int *pcnt, int w, vir_bytes *size)
 {
-	for (int i = 0; i < cnt ; i++) {
+	/* A buffer may map to several physical segments, and the segments
+	 * may run out before the buffers do. Then only what was mapped is
+	 * transferred, in whole sectors.
+	 */
+	vir_bytes total = 0, excess;
+	int i;
+
+	for (i = 0; i < *pcnt ; i++) {
 
 		/* So you gave us a byte aligned buffer? Good job! */
 		if (phys[i].vp_addr & 1) {
@@ -186,16 +234,33 @@ prepare_bufs(struct vumap_vir *vir, struct vumap_phys *phys, int cnt, int w)
 			return EINVAL;
 		}
 
-		/* Check if the buffer is good */
-		if (phys[i].vp_size != vir[i].vv_size) {
-			dprintf(("Non-contig buf %08lx", phys[i].vp_addr));
-			return EINVAL;
-		}
+		total += phys[i].vp_size;
 
 		/* If write, the buffers only need to be read */
 		phys[i].vp_addr |= !w;
 	}
 
+	excess = total % VIRTIO_BLK_BLOCK_SIZE;
+
+	while (excess > 0) {
+		if (phys[i - 1].vp_size > excess) {
+			phys[i - 1].vp_size -= excess;
+			break;
+		}
+
+		excess -= phys[i - 1].vp_size;
+		i--;
+	}
+
+	total -= total % VIRTIO_BLK_BLOCK_SIZE;
+
+	if (total == 0) {
+		dprintf(("buffers map to less than a sector"));
+		return EINVAL;
+	}
+
+	*pcnt = i;
+	*size = total;
 	return OK;
 }
 
@@ -244,18 +309,16 @@ virtio_blk_transfer(dev_t minor, int write, u64_t position, endpoint_t endpt,
 	/* Need to translate vir to phys */
 	struct vumap_vir vir[NR_IOREQS];
 
-	/* Physical addresses of buffers, including header and trailer */
-	struct vumap_phys phys[NR_IOREQS + 2];
-
 	/* Which thread is doing the transfer? */
 	thread_id_t tid = blockdriver_mt_get_tid();
+	struct blk_req *req = &reqs[tid];
 
 	vir_bytes size = 0;
 	vir_bytes size_tmp = 0;
 	struct device *dv;
 	u64_t sector;
 	u64_t end_part;
-	int r, pcnt = sizeof(phys) / sizeof(phys[0]);
+	int r, pcnt = MIN(seg_limit, MAPVEC_NR);
 
 	iovec_s_t *iv = (iovec_s_t *)iovec;
 	int access = write ? VUA_READ : VUA_WRITE;
@@ -326,54 +389,163 @@ virtio_blk_transfer(dev_t minor, int write, u64_t position, endpoint_t endpt,
 
 	/* Map vir to phys */
 	if ((r = sys_vumap(endpt, vir, cnt, 0, access,
-			   &phys[1], &pcnt)) != OK) {
+			   req->phys, &pcnt)) != OK) {
 
 		dprintf(("Unable to map memory from %d (%d)", endpt, r));
 		return r;
 	}
 
-	/* Prepare the header */
-	memset(&hdrs_vir[tid], 0, sizeof(hdrs_vir[0]));
-
-	if (write)
-		hdrs_vir[tid].type = VIRTIO_BLK_T_OUT;
-	else
-		hdrs_vir[tid].type = VIRTIO_BLK_T_IN;
-
-	hdrs_vir[tid].ioprio = 0;
-	hdrs_vir[tid].sector = sector;
-
-	/* First the header */
-	phys[0].vp_addr = hdrs_phys + tid * sizeof(hdrs_vir[0]);
-	phys[0].vp_size = sizeof(hdrs_vir[0]);
-
-	/* Put the physical buffers into phys */
-	if ((r = prepare_bufs(vir, &phys[1], pcnt, write)) != OK)
+	/* Check the physical buffers, this may shorten the transfer */
+	if ((r = prepare_bufs(req->phys, &pcnt, write, &size)) != OK)
 		return r;
 
-	/* Put the status at the end */
-	phys[pcnt + 1].vp_addr = status_phys + tid * sizeof(status_vir[0]);
-	phys[pcnt + 1].vp_size = sizeof(u8_t);
-
-	/* Status always needs write access */
-	phys[1 + pcnt].vp_addr |= 1;
+	req->tid = tid;
+	req->type = write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+	req->sector = sector;
+	req->end = sector + size / VIRTIO_BLK_BLOCK_SIZE;
+	req->pcnt = req->nsegs = pcnt;
 
-	/* Send addresses to queue */
-	virtio_to_queue(blk_dev, 0, phys, 2 + pcnt, &tid);
+	/* Send to the host, possibly along with others */
+	virtio_blk_submit(req);
 
 	/* Wait for completion */
 	blockdriver_mt_sleep();
 
 	/* All was good */
-	if (mystatus(tid) == VIRTIO_BLK_S_OK)
+	if (req->status == VIRTIO_BLK_S_OK)
 		return size;
 
 	/* Error path */
 	dprintf(("ERROR status=%02x sector=%llu len=%lx cnt=%d op=%s t=%d",
-		 mystatus(tid), sector, size, pcnt,
+		 req->status, sector, size, pcnt,
 		 write ? "write" : "read", tid));
 
-	return virtio_blk_status2error(mystatus(tid));
+	return virtio_blk_status2error(req->status);
+}
+
+static void
+virtio_blk_submit(struct blk_req *req)
+{
+	/* Add a request to the waiting ones, merged into an adjacent one if
+	 * possible, and give the host what it can take.
+	 */
+	struct blk_req *p = NULL, **pp, **start;
+
+	assert(req->tid < VIRTIO_BLK_NUM_THREADS);
+
+	req->next = NULL;
+	req->merged = NULL;
+	req->last = req;
+
+	/* Nothing may get ahead of a waiting flush, so only requests behind
+	 * the last one can take this one in.
+	 */
+	start = &pending;
+	for (pp = &pending; *pp != NULL; pp = &(*pp)->next)
+		if ((*pp)->type == VIRTIO_BLK_T_FLUSH)
+			start = &(*pp)->next;
+
+	for (pp = start; req->type != VIRTIO_BLK_T_FLUSH &&
+			    (p = *pp) != NULL; pp = &p->next) {
+
+		if (p->type != req->type || p->nsegs + req->nsegs > seg_limit)
+			continue;
+
+		/* req follows the chain of p */
+		if (p->end == req->sector) {
+			p->last->merged = req;
+			p->last = req;
+			p->end = req->end;
+			p->nsegs += req->nsegs;
+			break;
+		}
+
+		/* req precedes the chain of p, and takes over its place */
+		if (req->end == p->sector) {
+			req->merged = p;
+			req->last = p->last;
+			req->end = p->end;
+			req->nsegs += p->nsegs;
+			req->next = p->next;
+			*pp = req;
+			break;
+		}
+	}
+
+	/* Not merged, wait at the end */
+	if (p == NULL) {
+		for (pp = &pending; *pp != NULL; pp = &(*pp)->next)
+			;
+		*pp = req;
+	}
+
+	virtio_blk_dispatch();
+}
+
+static void
+virtio_blk_dispatch(void)
+{
+	/* Hand waiting requests to the least busy queue, as long as the
+	 * queues take them.
+	 */
+	struct vumap_phys phys[VIRTIO_BLK_MAX_SEGS + 2];
+	struct blk_req *req, *m;
+	int i, n, q;
+
+	while ((req = pending) != NULL) {
+
+		for (q = 0, i = 1; i < num_queues; i++)
+			if (inflight[i] < inflight[q])
+				q = i;
+
+		if (inflight[q] >= VIRTIO_BLK_QUEUE_DEPTH)
+			break;
+
+		/* Prepare the header */
+		memset(&hdrs_vir[req->tid], 0, sizeof(hdrs_vir[0]));
+		hdrs_vir[req->tid].type = req->type;
+
+		/* Let a flush be a barrier if the host supports it. Only the
+		 * header gets the bit, so that merging still sees a flush.
+		 */
+		if (req->type == VIRTIO_BLK_T_FLUSH &&
+		    virtio_host_supports(blk_dev, VIRTIO_BLK_F_BARRIER))
+			hdrs_vir[req->tid].type |= VIRTIO_BLK_T_BARRIER;
+
+		hdrs_vir[req->tid].ioprio = 0;
+		hdrs_vir[req->tid].sector = req->sector;
+
+		/* First the header */
+		phys[0].vp_addr = hdrs_phys + req->tid * sizeof(hdrs_vir[0]);
+		phys[0].vp_size = sizeof(hdrs_vir[0]);
+		n = 1;
+
+		/* Then the buffers of all requests in the chain */
+		for (m = req; m != NULL; m = m->merged)
+			for (i = 0; i < m->pcnt; i++)
+				phys[n++] = m->phys[i];
+
+		/* Put the status at the end */
+		phys[n].vp_addr = status_phys +
+				  req->tid * sizeof(status_vir[0]);
+		phys[n].vp_size = sizeof(u8_t);
+
+		/* Status always needs write access */
+		phys[n++].vp_addr |= 1;
+
+		/* Send addresses to queue, or wait for the host to free some
+		 * descriptors first.
+		 */
+		if (virtio_to_queue(blk_dev, q, phys, n, req) != OK) {
+			if (inflight[q] == 0)
+				panic("%s: request does not fit queue %d",
+								name, q);
+			break;
+		}
+
+		pending = req->next;
+		inflight[q]++;
+	}
 }
 
 static int
@@ -440,11 +612,25 @@ virtio_blk_geometry(dev_t minor, struct partition *entry)
 static void
 virtio_blk_device_intr(void)
 {
-	thread_id_t *tid;
+	struct blk_req *req, *m;
+	int q;
 
-	/* Multiple requests might have finished */
-	while (!virtio_from_queue(blk_dev, 0, (void**)&tid))
-		blockdriver_mt_wakeup(*tid);
+	/* Multiple requests might have finished, on every queue. All
+	 * requests in a chain share the status of its head.
+	 */
+	for (q = 0; q < num_queues; q++) {
+		while (!virtio_from_queue(blk_dev, q, (void**)&req, NULL)) {
+			inflight[q]--;
+
+			for (m = req; m != NULL; m = m->merged) {
+				m->status = status_vir[req->tid] & 0xFF;
+				blockdriver_mt_wakeup(m->tid);
+			}
+		}
+	}
+
+	/* The queues have room for waiting requests now */
+	virtio_blk_dispatch();
 }
 
 static void
@@ -486,46 +672,33 @@ virtio_blk_device(dev_t minor, device_id_t *id)
 static int
 virtio_blk_flush(void)
 {
-	struct vumap_phys phys[2];
-	size_t phys_cnt = sizeof(phys) / sizeof(phys[0]);
-
 	/* Which thread is doing this request? */
 	thread_id_t tid = blockdriver_mt_get_tid();
+	struct blk_req *req = &reqs[tid];
 
 	/* Host may not support flushing */
 	if (!virtio_host_supports(blk_dev, VIRTIO_BLK_F_FLUSH))
 		return EOPNOTSUPP;
 
-	/* Prepare the header */
-	memset(&hdrs_vir[tid], 0, sizeof(hdrs_vir[0]));
-	hdrs_vir[tid].type = VIRTIO_BLK_T_FLUSH;
-
-	/* Let this be a barrier if the host supports it */
-	if (virtio_host_supports(blk_dev, VIRTIO_BLK_F_BARRIER))
-		hdrs_vir[tid].type |= VIRTIO_BLK_T_BARRIER;
-
-	/* Header and status for the queue */
-	phys[0].vp_addr = hdrs_phys + tid * sizeof(hdrs_vir[0]);
-	phys[0].vp_size = sizeof(hdrs_vir[0]);
-	phys[1].vp_addr = status_phys + tid * sizeof(status_vir[0]);
-	phys[1].vp_size = 1;
-
-	/* Status always needs write access */
-	phys[1].vp_addr |= 1;
+	/* A flush has no buffers, only the header and status */
+	req->tid = tid;
+	req->type = VIRTIO_BLK_T_FLUSH;
+	req->sector = req->end = 0;
+	req->pcnt = req->nsegs = 0;
 
 	/* Send flush request to queue */
-	virtio_to_queue(blk_dev, 0, phys, phys_cnt, &tid);
+	virtio_blk_submit(req);
 
 	blockdriver_mt_sleep();
 
 	/* All was good */
-	if (mystatus(tid) == VIRTIO_BLK_S_OK)
+	if (req->status == VIRTIO_BLK_S_OK)
 		return OK;
 
 	/* Error path */
-	dprintf(("ERROR status=%02x op=flush t=%d", mystatus(tid), tid));
+	dprintf(("ERROR status=%02x op=flush t=%d", req->status, tid));
 
-	return virtio_blk_status2error(mystatus(tid));
+	return virtio_blk_status2error(req->status);
 }
 
 static void
@@ -605,6 +778,10 @@ virtio_blk_feature_setup(void)
 	if (virtio_host_supports(blk_dev, VIRTIO_BLK_F_SEG_MAX)) {
 		blk_config.seg_max = virtio_sread32(blk_dev, 12);
 		dprintf(("Seg Max: %d", blk_config.seg_max));
+
+		/* Do not merge beyond what the host takes */
+		if (blk_config.seg_max > 0 && blk_config.seg_max < seg_limit)
+			seg_limit = blk_config.seg_max;
 	}
 
 	if (virtio_host_supports(blk_dev, VIRTIO_BLK_F_GEOMETRY)) {
@@ -632,6 +809,14 @@ virtio_blk_feature_setup(void)
 	if (virtio_host_supports(blk_dev, VIRTIO_BLK_F_BARRIER))
 		dprintf(("Supports barrier"));
 
+	if (virtio_host_supports(blk_dev, VIRTIO_BLK_F_MQ)) {
+		blk_config.num_queues = virtio_sread16(blk_dev, 34);
+		dprintf(("Queues: %d", blk_config.num_queues));
+
+		num_queues = MIN(MAX(blk_config.num_queues, 1),
+				 VIRTIO_BLK_MAX_QUEUES);
+	}
+
 	return 0;
 }
 
@@ -657,7 +842,7 @@ virtio_blk_config(void)
 static int
 virtio_blk_probe(int skip)
 {
-	int r;
+	int r, i;
 
 	/* sub device id for virtio-blk is 0x0002 */
 	blk_dev = virtio_setup_device(0x0002, name, blkf,
@@ -666,12 +851,28 @@ virtio_blk_probe(int skip)
 	if (!blk_dev)
 		return ENXIO;
 
-	/* virtio-blk has one queue only */
-	if ((r = virtio_alloc_queues(blk_dev, 1)) != OK) {
+	/* This tells how many queues the host offers */
+	virtio_blk_config();
+
+	if ((r = virtio_alloc_queues(blk_dev, num_queues)) != OK) {
 		virtio_free_device(blk_dev);
 		return r;
 	}
 
+	/* Without indirect tables a request, header and status included,
+	 * has to fit into the ring of a queue.
+	 */
+	for (i = 0; i < num_queues; i++)
+		seg_limit = MIN(seg_limit,
+				virtio_queue_max_chain(blk_dev, i) - 2);
+
+	if (seg_limit < 1) {
+		printf("%s: queues too small\n", name);
+		virtio_free_queues(blk_dev);
+		virtio_free_device(blk_dev);
+		return ENXIO;
+	}
+
 	/* Allocate memory for headers and status */
 	if ((r = virtio_blk_alloc_requests() != OK)) {
 		virtio_free_queues(blk_dev);
@@ -679,8 +880,6 @@ virtio_blk_probe(int skip)
 		return r;
 	}
 
-	virtio_blk_config();
-
 	/* Let the host now that we are ready */
 	virtio_device_ready(blk_dev);
 
@@ -41,6 +41,7 @@
 #define VIRTIO_BLK_F_SCSI	7	/* Supports scsi command passthru */
 #define VIRTIO_BLK_F_FLUSH	9	/* Cache flush command support */
 #define VIRTIO_BLK_F_TOPOLOGY	10	/* Topology information is available */
+#define VIRTIO_BLK_F_MQ		12	/* Support more than one vq */
 
 #define VIRTIO_BLK_ID_BYTES	20	/* ID string length */
 
@@ -71,6 +72,13 @@ struct virtio_blk_config {
 	/* optimal sustained I/O size in logical blocks. */
 	u32_t opt_io_size;
 
+	/* writeback mode (if VIRTIO_BLK_F_CONFIG_WCE) */
+	u8_t wce;
+	u8_t unused;
+
+	/* number of vqs, only available when VIRTIO_BLK_F_MQ is set */
+	u16_t num_queues;
+
 } __attribute__((packed));
 
 /*
@@ -9,12 +9,14 @@
 
 #include <assert.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 
 #include <net/gen/ether.h>
 #include <net/gen/eth_io.h>
 
 #include <minix/drivers.h>
 #include <minix/netdriver.h>
+#include <minix/netring.h>
 #include <minix/sysutil.h>
 #include <minix/virtio.h>
 
@@ -41,6 +43,8 @@ enum queue {RX_Q, TX_Q, CTRL_Q};
 #define BUF_PACKETS		64
 /* Maximum size of a packet */
 #define MAX_PACK_SIZE		ETH_MAX_PACK_SIZE
+/* Most packets taken in one DL_WRITEV_M or DL_READV_M request */
+#define BATCH_PACKETS		(BUF_PACKETS / 4)
 /* Buffer size needed for the payload of BUF_PACKETS */
 #define PACKET_BUF_SZ		(BUF_PACKETS * MAX_PACK_SIZE)
 
@@ -73,6 +77,26 @@ static int rx_pending;
 static message pending_rx_msg;
 static int tx_pending;
 static message pending_tx_msg;
+static int tx_done;		/* packets of a DL_WRITEV_M already queued */
+
+/* State of the ring shared with the client, see <minix/netring.h>. The
+ * slots of the ring are given to the host directly: ring_pkts holds the TX
+ * slots followed by the RX slots, each with a private virtio header.
+ */
+static struct netring *ring;
+static phys_bytes ring_phys;
+static endpoint_t ring_client = NONE;
+static struct netring *ring_user;	/* address of the ring in ring_client */
+static struct virtio_net_hdr *ring_hdrs;
+static phys_bytes ring_hdrs_phys;
+static struct packet ring_pkts[2 * NETRING_SLOTS];
+static int ring_done[2 * NETRING_SLOTS];	/* slot given back by host */
+static u32_t ring_tx_next;		/* next TX slot to give to the host */
+static u32_t ring_rx_next;		/* next RX slot to give to the host */
+
+#define RING_HDRS_SZ		(2 * NETRING_SLOTS * sizeof(ring_hdrs[0]))
+#define is_ring_pkt(p)		((p) >= &ring_pkts[0] && \
+				 (p) < &ring_pkts[2 * NETRING_SLOTS])
 
 /* Various state data */
 static u8_t virtio_net_mac[6];
@@ -90,9 +114,15 @@ static void virtio_net_refill_rx_queue(void);
 static void virtio_net_check_queues(void);
 static void virtio_net_check_pending(void);
 
+static int virtio_net_ring_setup(endpoint_t ep);
+static void virtio_net_ring_refill(void);
+static void virtio_net_ring_advance(void);
+
 static void virtio_net_fetch_iovec(iovec_s_t *iov, message *m);
 static int virtio_net_cpy_to_user(message *m);
 static int virtio_net_cpy_from_user(message *m);
+static int virtio_net_cpy_pkts_to_user(message *m);
+static int virtio_net_cpy_pkts_from_user(message *m);
 
 static void virtio_net_intr(message *m);
 static void virtio_net_write(message *m);
@@ -265,23 +295,198 @@ static void
 virtio_net_check_queues(void)
 {
 	struct packet *p;
+	size_t len;
 
 	/* Put the received packets into the recv list */
-	while (virtio_from_queue(net_dev, RX_Q, (void **)&p) == 0) {
-		STAILQ_INSERT_TAIL(&recv_list, p, next);
-		in_rx--;
+	while (virtio_from_queue(net_dev, RX_Q, (void **)&p, &len) == 0) {
 		virtio_net_stats.ets_packetR++;
+
+		if (is_ring_pkt(p)) {
+			ring->nr_rx.nq_len[p->idx % NETRING_SLOTS] =
+				len - sizeof(struct virtio_net_hdr);
+			ring_done[p->idx] = TRUE;
+			continue;
+		}
+
+		in_rx--;
+
+		/* With a ring, our own buffers are no longer read from */
+		if (ring != NULL) {
+			virtio_net_stats.ets_missedP++;
+			STAILQ_INSERT_HEAD(&free_list, p, next);
+			continue;
+		}
+
+		STAILQ_INSERT_TAIL(&recv_list, p, next);
 	}
 
 	/* Packets from the TX queue just indicated they are free to
 	 * be reused now. inet already knows about them as being sent.
 	 */
-	while (virtio_from_queue(net_dev, TX_Q, (void **)&p) == 0) {
+	while (virtio_from_queue(net_dev, TX_Q, (void **)&p, NULL) == 0) {
+		if (is_ring_pkt(p)) {
+			ring_done[p->idx] = TRUE;
+			virtio_net_stats.ets_packetT++;
+			continue;
+		}
+
 		memset(p->vhdr, 0, sizeof(*p->vhdr));
 		memset(p->vdata, 0, MAX_PACK_SIZE);
 		STAILQ_INSERT_HEAD(&free_list, p, next);
 		virtio_net_stats.ets_packetT++;
 	}
+
+	if (ring != NULL)
+		virtio_net_ring_advance();
+}
+
+static int
+virtio_net_ring_setup(endpoint_t ep)
+{
+	/* Share a ring with ep. The ring outlives its client: if the client
+	 * is restarted, the new instance gets the same ring, with the
+	 * indices where the old one left them.
+	 */
+	struct packet *p;
+	void *addr;
+	int i;
+
+	if (ring_client == ep)
+		return OK;
+
+	if (ring == NULL) {
+		ring = alloc_contig(NETRING_SIZE, 0, &ring_phys);
+
+		if (ring == NULL)
+			return ENOMEM;
+
+		ring_hdrs = alloc_contig(RING_HDRS_SZ, 0, &ring_hdrs_phys);
+
+		if (ring_hdrs == NULL) {
+			free_contig(ring, NETRING_SIZE);
+			ring = NULL;
+			return ENOMEM;
+		}
+
+		memset(ring, 0, NETRING_HDR_SIZE);
+		memset(ring_hdrs, 0, RING_HDRS_SZ);
+
+		for (i = 0; i < 2 * NETRING_SLOTS; i++) {
+			p = &ring_pkts[i];
+			p->idx = i;
+			p->vhdr = &ring_hdrs[i];
+			p->phdr = ring_hdrs_phys + i * sizeof(ring_hdrs[0]);
+			p->vdata = NETRING_TX_SLOT(ring, i);
+			p->pdata = ring_phys + NETRING_TX_OFF(i);
+			if (i >= NETRING_SLOTS) {
+				p->vdata += NETRING_SLOTS * NETRING_SLOT_SIZE;
+				p->pdata += NETRING_SLOTS * NETRING_SLOT_SIZE;
+			}
+		}
+	}
+
+	addr = vm_remap(ep, getprocnr(), NULL, ring, NETRING_SIZE);
+
+	if (addr == MAP_FAILED) {
+		dput(("mapping ring into %d failed", ep));
+		return ENOMEM;
+	}
+
+	ring_user = addr;
+	ring_client = ep;
+
+	virtio_net_ring_refill();
+
+	return OK;
+}
+
+static void
+virtio_net_ring_refill(void)
+{
+	/* Give the host the TX slots the client filled, and every RX slot
+	 * the client is not holding on to.
+	 */
+	struct vumap_phys phys[2];
+	struct packet *p;
+	u32_t prod, cons;
+
+	prod = ring->nr_tx.nq_prod;
+	netring_barrier();
+
+	while (ring_tx_next != prod) {
+		p = &ring_pkts[ring_tx_next % NETRING_SLOTS];
+
+		phys[0].vp_addr = p->phdr;
+		assert(!(phys[0].vp_addr & 1));
+		phys[0].vp_size = sizeof(struct virtio_net_hdr);
+		phys[1].vp_addr = p->pdata;
+		assert(!(phys[1].vp_addr & 1));
+		phys[1].vp_size = MIN(ring->nr_tx.nq_len[p->idx],
+				      NETRING_SLOT_SIZE);
+
+		virtio_to_queue(net_dev, TX_Q, phys, 2, p);
+		ring_tx_next++;
+	}
+
+	cons = ring->nr_rx.nq_cons;
+
+	while (ring_rx_next - cons < NETRING_SLOTS) {
+		p = &ring_pkts[NETRING_SLOTS + ring_rx_next % NETRING_SLOTS];
+
+		/* RX queue needs write */
+		phys[0].vp_addr = p->phdr | 1;
+		phys[0].vp_size = sizeof(struct virtio_net_hdr);
+		phys[1].vp_addr = p->pdata | 1;
+		phys[1].vp_size = NETRING_SLOT_SIZE;
+
+		virtio_to_queue(net_dev, RX_Q, phys, 2, p);
+		ring_rx_next++;
+	}
+}
+
+static void
+virtio_net_ring_advance(void)
+{
+	/* Hand the slots the host is done with to the client, in order, and
+	 * ring the doorbell if the client may be waiting for them.
+	 */
+	struct netring_queue *q;
+	u32_t old, idx;
+	int wake = FALSE;
+
+	/* Sent packets make room in the TX queue */
+	q = &ring->nr_tx;
+	old = idx = q->nq_cons;
+	while (idx != ring_tx_next && ring_done[idx % NETRING_SLOTS]) {
+		ring_done[idx % NETRING_SLOTS] = FALSE;
+		idx++;
+	}
+	if (idx != old) {
+		q->nq_cons = idx;
+		netring_barrier();
+		if (q->nq_prod - old == NETRING_SLOTS)
+			wake = TRUE;
+	}
+
+	/* Received packets fill the RX queue */
+	q = &ring->nr_rx;
+	old = idx = q->nq_prod;
+	while (idx != ring_rx_next &&
+	    ring_done[NETRING_SLOTS + idx % NETRING_SLOTS]) {
+		ring_done[NETRING_SLOTS + idx % NETRING_SLOTS] = FALSE;
+		idx++;
+	}
+	if (idx != old) {
+		/* The sizes must be visible before the index */
+		netring_barrier();
+		q->nq_prod = idx;
+		netring_barrier();
+		if (q->nq_cons == old)
+			wake = TRUE;
+	}
+
+	if (wake && ring_client != NONE)
+		notify(ring_client);
 }
 
 static void
@@ -298,16 +503,29 @@ virtio_net_check_pending(void)
 	/* Pending read and something in recv_list? */
 	if (!STAILQ_EMPTY(&recv_list) && rx_pending) {
 		dst = pending_rx_msg.m_source;
-		reply.DL_COUNT = virtio_net_cpy_to_user(&pending_rx_msg);
+		if (pending_rx_msg.m_type == DL_READV_M)
+			reply.DL_COUNT =
+				virtio_net_cpy_pkts_to_user(&pending_rx_msg);
+		else
+			reply.DL_COUNT = virtio_net_cpy_to_user(&pending_rx_msg);
 		reply.DL_FLAGS |= DL_PACK_RECV;
 		rx_pending = 0;
 	}
 
 	if (!STAILQ_EMPTY(&free_list) && tx_pending) {
-		dst = pending_tx_msg.m_source;
-		virtio_net_cpy_from_user(&pending_tx_msg);
-		reply.DL_FLAGS |= DL_PACK_SEND;
-		tx_pending = 0;
+		/* A batch may need more free packets than there are */
+		if (pending_tx_msg.m_type == DL_WRITEV_M) {
+			if (virtio_net_cpy_pkts_from_user(&pending_tx_msg)) {
+				dst = pending_tx_msg.m_source;
+				reply.DL_FLAGS |= DL_PACK_SEND;
+				tx_pending = 0;
+			}
+		} else {
+			dst = pending_tx_msg.m_source;
+			virtio_net_cpy_from_user(&pending_tx_msg);
+			reply.DL_FLAGS |= DL_PACK_SEND;
+			tx_pending = 0;
+		}
 	}
 
 	/* Only reply if a pending request was handled */
@@ -448,6 +666,99 @@ virtio_net_cpy_from_user(message *m)
 	return bytes;
 }
 
+static int
+virtio_net_cpy_pkts_to_user(message *m)
+{
+	/* Copy as many received packets as there are, up to one per vector
+	 * element, and tell the size of each in its element. Return the
+	 * number of packets copied.
+	 */
+	int i, r, size;
+	iovec_s_t iovec[NR_IOREQS];
+	struct packet *p;
+
+	/* This should only be called if recv_list has some entries */
+	assert(!STAILQ_EMPTY(&recv_list));
+	assert(m->DL_COUNT <= BATCH_PACKETS);
+
+	virtio_net_fetch_iovec(iovec, m);
+
+	for (i = 0; i < m->DL_COUNT && !STAILQ_EMPTY(&recv_list); i++) {
+		p = STAILQ_FIRST(&recv_list);
+		STAILQ_REMOVE_HEAD(&recv_list, next);
+
+		size = MIN(iovec[i].iov_size, MAX_PACK_SIZE);
+		r = sys_safecopyto(m->m_source, iovec[i].iov_grant, 0,
+				   (vir_bytes) p->vdata, size);
+
+		if (r != OK)
+			panic("%s: copy to %d failed (%d)", name, m->m_source,
+									r);
+
+		iovec[i].iov_size = size;
+
+		/* Clean the packet */
+		memset(p->vhdr, 0, sizeof(*p->vhdr));
+		memset(p->vdata, 0, MAX_PACK_SIZE);
+		STAILQ_INSERT_HEAD(&free_list, p, next);
+	}
+
+	r = sys_safecopyto(m->m_source, m->DL_GRANT, 0, (vir_bytes) iovec,
+			   i * sizeof(iovec[0]));
+
+	if (r != OK)
+		panic("%s: iovec fail for %d (%d)", name, m->m_source, r);
+
+	return i;
+}
+
+static int
+virtio_net_cpy_pkts_from_user(message *m)
+{
+	/* Put the packets of a DL_WRITEV_M request, one per vector element,
+	 * into free packet buffers and forward them to the TX queue. If we
+	 * run out of free buffers, tx_done remembers how far we got. Return
+	 * TRUE once all packets are queued.
+	 */
+	int r;
+	iovec_s_t iovec[NR_IOREQS];
+	struct vumap_phys phys[2];
+	struct packet *p;
+	size_t size;
+
+	assert(m->DL_COUNT <= BATCH_PACKETS);
+
+	virtio_net_fetch_iovec(iovec, m);
+
+	while (tx_done < m->DL_COUNT && !STAILQ_EMPTY(&free_list)) {
+		p = STAILQ_FIRST(&free_list);
+		STAILQ_REMOVE_HEAD(&free_list, next);
+
+		size = MIN(iovec[tx_done].iov_size, MAX_PACK_SIZE);
+		r = sys_safecopyfrom(m->m_source, iovec[tx_done].iov_grant, 0,
+				     (vir_bytes) p->vdata, size);
+
+		if (r != OK)
+			panic("%s: copy from %d failed", name, m->m_source);
+
+		phys[0].vp_addr = p->phdr;
+		assert(!(phys[0].vp_addr & 1));
+		phys[0].vp_size = sizeof(struct virtio_net_hdr);
+		phys[1].vp_addr = p->pdata;
+		assert(!(phys[1].vp_addr & 1));
+		phys[1].vp_size = size;
+		virtio_to_queue(net_dev, TX_Q, phys, 2, p);
+
+		tx_done++;
+	}
+
+	if (tx_done < m->DL_COUNT)
+		return FALSE;
+
+	tx_done = 0;
+	return TRUE;
+}
+
 static void
 virtio_net_intr(message *m)
 {
@@ -477,7 +788,16 @@ virtio_net_write(message *m)
 	reply.DL_COUNT = 0;
 
 
-	if (!STAILQ_EMPTY(&free_list)) {
+	if (m->m_type == DL_WRITEV_M) {
+		/* Queue what fits now, the rest when packets are freed */
+		assert(tx_done == 0);
+		if (virtio_net_cpy_pkts_from_user(m)) {
+			reply.DL_FLAGS = DL_PACK_SEND;
+		} else {
+			pending_tx_msg = *m;
+			tx_pending = 1;
+		}
+	} else if (!STAILQ_EMPTY(&free_list)) {
 		/* free_list contains at least one  packet, use it */
 		reply.DL_COUNT = virtio_net_cpy_from_user(m);
 		reply.DL_FLAGS = DL_PACK_SEND;
@@ -502,7 +822,10 @@ virtio_net_read(message *m)
 
 	if (!STAILQ_EMPTY(&recv_list)) {
 		/* recv_list contains at least one  packet, copy it */
-		reply.DL_COUNT = virtio_net_cpy_to_user(m);
+		if (m->m_type == DL_READV_M)
+			reply.DL_COUNT = virtio_net_cpy_pkts_to_user(m);
+		else
+			reply.DL_COUNT = virtio_net_cpy_to_user(m);
 		reply.DL_FLAGS = DL_PACK_RECV;
 	} else {
 		rx_pending = 1;
@@ -538,6 +861,19 @@ virtio_net_conf(message *m)
 	reply.DL_STAT = OK;
 	reply.DL_COUNT = 0;
 
+	/* Tell a client that can send batches how large they may be, and
+	 * where the ring is if it asked for one.
+	 */
+	if (m->DL_MODE & (DL_BATCH_REQ | DL_RING_REQ)) {
+		reply.m_type = DL_CONF_REPLY_M;
+		reply.DL_BATCH = BATCH_PACKETS;
+		reply.DL_RING = NULL;
+
+		if ((m->DL_MODE & DL_RING_REQ) &&
+		    virtio_net_ring_setup(m->m_source) == OK)
+			reply.DL_RING = (char *) ring_user;
+	}
+
 	if ((r = send(m->m_source, &reply)) != OK)
 		panic("%s: send to %d failed (%d)", name, m->m_source, r);
 }
@@ -567,6 +903,9 @@ virtio_net_getstat(message *m)
 static void
 virtio_net_notify(message *m)
 {
+	/* A doorbell from the ring client needs no work here, the main loop
+	 * looks at the ring after every message.
+	 */
 	if (_ENDPOINT_P(m->m_source) == HARDWARE)
 		virtio_net_intr(m);
 }
@@ -576,9 +915,11 @@ virtio_net_msg(message *m)
 {
 	switch (m->m_type) {
 	case DL_WRITEV_S:
+	case DL_WRITEV_M:
 		virtio_net_write(m);
 		break;
 	case DL_READV_S:
+	case DL_READV_M:
 		virtio_net_read(m);
 		break;
 	case DL_CONF:
@@ -601,7 +942,10 @@ virtio_net_main_loop(void)
 
 	while (TRUE) {
 
-		virtio_net_refill_rx_queue();
+		if (ring != NULL)
+			virtio_net_ring_refill();
+		else
+			virtio_net_refill_rx_queue();
 
 		if ((r = netdriver_receive(ANY, &m, &ipc_status)) != OK)
 			panic("%s: netdriver_receive failed: %d", name, r);
@@ -671,6 +1015,11 @@ sef_cb_signal_handler(int signo)
 	free_contig(hdrs_vir, BUF_PACKETS * sizeof(hdrs_vir[0]));
 	free(packets);
 
+	if (ring != NULL) {
+		free_contig(ring, NETRING_SIZE);
+		free_contig(ring_hdrs, RING_HDRS_SZ);
+	}
+
 	virtio_reset_device(net_dev);
 	virtio_free_queues(net_dev);
 	virtio_free_device(net_dev);
@@ -54,6 +54,7 @@
 #define LSTAT		  53
 #define IOCTL		  54
 #define FCNTL		  55
+#define SETDEADLINE	  56
 #define FS_READY	  57
 #define EXEC		  59
 #define UMASK		  60 
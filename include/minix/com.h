@@ -257,11 +257,14 @@
 #define DL_GETSTAT_S	(DL_RQ_BASE + 1)
 #define DL_WRITEV_S	(DL_RQ_BASE + 2)
 #define DL_READV_S	(DL_RQ_BASE + 3)
+#define DL_WRITEV_M	(DL_RQ_BASE + 4)	/* one packet per vector element */
+#define DL_READV_M	(DL_RQ_BASE + 5)	/* one packet per vector element */
 
 /* Message type for data link layer replies. */
 #define DL_CONF_REPLY	(DL_RS_BASE + 0)
 #define DL_STAT_REPLY	(DL_RS_BASE + 1)
 #define DL_TASK_REPLY	(DL_RS_BASE + 2)
+#define DL_CONF_REPLY_M	(DL_RS_BASE + 3)	/* DL_CONF_REPLY, takes DL_*V_M */
 
 /* Field names for data link layer messages. */
 #define DL_COUNT	m2_i3
@@ -270,6 +273,8 @@
 #define DL_GRANT	m2_l2
 #define DL_STAT		m3_i1
 #define DL_HWADDR	m3_ca1
+#define DL_BATCH	m3_i2	/* max. packets in a DL_WRITEV_M/DL_READV_M */
+#define DL_RING		m3_p1	/* shared ring (<minix/netring.h>) or NULL */
 
 /* Bits in 'DL_FLAGS' field of DL replies. */
 #  define DL_NOFLAGS		0x00
@@ -281,6 +286,8 @@
 #  define DL_PROMISC_REQ	0x1
 #  define DL_MULTI_REQ		0x2
 #  define DL_BROAD_REQ		0x4
+#  define DL_BATCH_REQ		0x8	/* client can send DL_*V_M requests */
+#  define DL_RING_REQ		0x10	/* client can use a shared ring */
 
 /*===========================================================================*
  *                  SYSTASK request types and field names                    *
@@ -472,6 +479,7 @@
 #   define GET_IDLETSC	  21	/* get cumulative idle time stamp counter */
 #   define GET_CPUINFO    23    /* get information about cpus */
 #   define GET_REGS	  24	/* get general process registers */
+#   define GET_CPULOAD	  25	/* get run queue length and idle time per cpu */
 #define I_ENDPT        m7_i4	/* calling process (may only be SELF) */
 #define I_VAL_PTR      m7_p1	/* virtual address at caller */ 
 #define I_VAL_LEN      m7_i1	/* max length of value */
@@ -886,6 +894,11 @@
 
 #define PM_GETSID_PID				m1_i1
 
+/* SETDEADLINE */
+#define PM_DL_PID				m1_i1
+#define PM_DL_PERIOD				m1_i2
+#define PM_DL_DEADLINE				m1_i3
+
 /* Field names for SELECT (FS). */
 #define SEL_NFDS       m8_i1
 #define SEL_READFDS    m8_p1
@@ -998,12 +1011,12 @@
 #define VMYBGB_YIELDIDHI		m2_l1
 #define VMYBGB_YIELDIDLO		m2_l2
 
-/* Calls from VFS. */
-#	define VMV_ENDPOINT		m1_i1	/* for all VM_VFS_REPLY_* */
-#define VM_VFS_REPLY_OPEN	(VM_RQ_BASE+30)
-#	define VMVRO_FD			m1_i2
-#define VM_VFS_REPLY_MMAP	(VM_RQ_BASE+31)
-#define VM_VFS_REPLY_CLOSE	(VM_RQ_BASE+32)
+/* Calls from VFS, for memory mapped files. The fields are those of the
+ * VFS_VM_* requests below.
+ */
+#define VM_VFS_REPLY		(VM_RQ_BASE+30)	/* answer to a VFS_VM_* */
+#define VM_VFS_MMAP		(VM_RQ_BASE+31)	/* map an executable's file */
+#define VM_VFS_HANDLEMEM	(VM_RQ_BASE+32)	/* make memory present */
 
 #define VM_REMAP		(VM_RQ_BASE+33)
 #	define VMRE_D			m1_i1
@@ -1074,8 +1087,13 @@
 
 #define VMPPARAM_CLEAR		1	/* values for VMPCTL_PARAM */
 
+#define VM_WATCH_MEM		(VM_RQ_BASE+46)
+#	define VM_WM_ON		m1_i1
+
+#define VM_VFS_FORGET		(VM_RQ_BASE+47)	/* file changed, from VFS */
+
 /* Total. */
-#define NR_VM_CALLS				46
+#define NR_VM_CALLS				48
 #define VM_CALL_MASK_SIZE			BITMAP_CHUNKS(NR_VM_CALLS)
 
 /* not handled as a normal VM call, thus at the end of the reserved rage */
@@ -1086,7 +1104,8 @@
 /* Basic vm calls allowed to every process. */
 #define VM_BASIC_CALLS \
     VM_MMAP, VM_MUNMAP, VM_MAP_PHYS, VM_UNMAP_PHYS, \
-    VM_FORGETBLOCKS, VM_FORGETBLOCK, VM_YIELDBLOCKGETBLOCK, VM_INFO
+    VM_FORGETBLOCKS, VM_FORGETBLOCK, VM_YIELDBLOCKGETBLOCK, VM_INFO, \
+    VM_WATCH_MEM
 
 /*===========================================================================*
  *                Messages for IPC server				     *
@@ -1141,6 +1160,7 @@
 #	define SCHEDULING_ACNT_QUEUE		m9_l5
 #	define SCHEDULING_ACNT_CPU		m9_s1
 #	define SCHEDULING_ACNT_CPU_LOAD		m9_s2
+#	define SCHEDULING_ACNT_CPU_QLEN		m9_s3
 /* These are used for SYS_SCHEDULE, a reply to SCHEDULING_NO_QUANTUM */
 #	define SCHEDULING_ENDPOINT	m9_l1
 #	define SCHEDULING_QUANTUM	m9_l2
@@ -1164,6 +1184,11 @@
 #define SCHEDULING_INHERIT	(SCHEDULING_BASE+5)
 #define SCHEDULING_SWITCH_TYPE (SCHEDULING_BASE+6)
 
+/* SCHEDULING_SET_DEADLINE sets the EDF parameters of _ENDPOINT, both in ms */
+#define SCHEDULING_SET_DEADLINE	(SCHEDULING_BASE+7)
+#	define SCHEDULING_PERIOD	m9_l2
+#	define SCHEDULING_DEADLINE	m9_l3
+
 /*===========================================================================*
  *              Messages for USB                                             *
  *===========================================================================*/
@@ -1233,6 +1258,33 @@
 
 #endif
 
+/*===========================================================================*
+ *                Messages from VM to VFS				     *
+ *===========================================================================*/
+
+/* VM sends these asynchronously, as it must never block on VFS. VFS answers
+ * each with a VM_VFS_REPLY call; VM has only one outstanding at a time.
+ */
+#define VFS_VM_RQ_BASE		0xB00
+
+#define VFS_VM_FDLOOKUP		(VFS_VM_RQ_BASE+0)	/* file to mmap() */
+#define VFS_VM_PAGEIN		(VFS_VM_RQ_BASE+1)	/* read a file page */
+#define VFS_VM_PUT		(VFS_VM_RQ_BASE+2)	/* file no longer used */
+#define VFS_VM_REPLY		(VFS_VM_RQ_BASE+3)	/* VM_VFS_HANDLEMEM done */
+
+/* Field names for the VM-VFS protocol, in both directions. */
+#	define VMV_ENDPT		m10_i1	/* process concerned */
+#	define VMV_FS_E			m10_i2	/* file server of the file */
+#	define VMV_DRV_E		m10_i3	/* block driver of that FS */
+#	define VMV_ID			m10_i3	/* HANDLEMEM ID, kept in reply */
+#	define VMV_RESULT		m10_i4	/* result of the request */
+#	define VMV_LEN			m10_i4	/* number of bytes */
+#	define VMV_INO			m10_l1	/* inode number of the file */
+#	define VMV_POS			m10_l2	/* position in the file */
+#	define VMV_FD			m10_l2	/* file descriptor */
+#	define VMV_WRITE		m10_l2	/* nonzero for write access */
+#	define VMV_ADDR			m10_l3	/* virtual address */
+
 /*===========================================================================*
  *			VFS-FS TRANSACTION IDs				     *
  *===========================================================================*/
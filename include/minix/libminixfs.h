@@ -15,11 +15,34 @@ struct buf {
   struct buf *lmfs_next;       /* used to link all free bufs in a chain */
   struct buf *lmfs_prev;       /* used to link all free bufs the other way */
   struct buf *lmfs_hash;       /* used to link bufs on hash chains */
+  struct buf **lmfs_hlink;     /* link pointing to this buf on its chain */
   block_t lmfs_blocknr;        /* block number of its (minor) device */
   dev_t lmfs_dev;              /* major | minor device where block resides */
   char lmfs_dirt;              /* BP_CLEAN or BP_DIRTY */
   char lmfs_count;             /* number of users of this buffer */
+  char lmfs_queue;             /* replacement queue the buffer is on */
+  char lmfs_ra;                /* read ahead and not asked for yet */
   unsigned int lmfs_bytes;     /* Number of bytes allocated in bp */
+  unsigned int lmfs_dirtied;   /* write-back period the block was dirtied in */
+};
+
+/* Block cache statistics of one device. */
+struct lmfs_stats {
+  unsigned long ls_hits;       /* lookups found in the cache */
+  unsigned long ls_misses;     /* lookups that needed a buffer */
+  unsigned long ls_evictions;  /* blocks thrown out to make room */
+  unsigned long ls_ra_blocks;  /* blocks read ahead */
+  unsigned long ls_ra_hits;    /* blocks read ahead and then asked for */
+  unsigned long ls_ra_wasted;  /* blocks read ahead and evicted unused */
+  unsigned long ls_wb_blocks;  /* dirty blocks written back early */
+  unsigned long ls_throttled;  /* writers held up until blocks were written */
+};
+
+/* Read-ahead state of one file. */
+struct lmfs_ra {
+  off_t ra_next;               /* where a sequential reader reads next */
+  off_t ra_end;                /* end of what has been read ahead */
+  unsigned int ra_window;      /* blocks to read ahead, 0 if not sequential */
 };
 
 int fs_lookup_credentials(vfs_ucred_t *credentials,
@@ -34,6 +57,7 @@ dev_t lmfs_dev(struct buf *bp);
 int lmfs_bytes(struct buf *bp);
 int lmfs_bufs_in_use(void);
 int lmfs_nr_bufs(void);
+int lmfs_nr_dirty(void);
 void lmfs_flushall(void);
 int lmfs_fs_block_size(void);
 void lmfs_may_use_vmcache(int); 
@@ -41,10 +65,20 @@ void lmfs_set_blocksize(int blocksize, int major);
 void lmfs_reset_rdwt_err(void); 
 int lmfs_rdwt_err(void); 
 void lmfs_buf_pool(int new_nr_bufs);
+void lmfs_adjust_bufs(void);
 struct buf *lmfs_get_block(dev_t dev, block_t block,int only_search);
 void lmfs_invalidate(dev_t device);
 void lmfs_put_block(struct buf *bp, int block_type);
 void lmfs_rw_scattered(dev_t, struct buf **, int, int);
+void lmfs_readahead(dev_t dev, struct buf **bufq, int bufqsize, int wanted);
+void lmfs_writeback(void);
+void lmfs_alarm(void);
+int lmfs_get_stats(dev_t dev, struct lmfs_stats *stats);
+void lmfs_ra_init(struct lmfs_ra *ra);
+unsigned int lmfs_ra_read(struct lmfs_ra *ra, off_t pos, size_t bytes);
+int lmfs_ra_async(struct lmfs_ra *ra, off_t size, unsigned int block_size,
+	off_t *pos);
+void lmfs_ra_issued(struct lmfs_ra *ra, off_t end);
 
 /* calls that libminixfs does into fs */
 void fs_blockstats(u32_t *blocks, u32_t *free, u32_t *used);
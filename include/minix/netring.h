@@ -0,0 +1,58 @@
+/* Packet rings shared between a network driver and its client.
+ *
+ * A ring is set up when the client configures the driver: a client that sets
+ * DL_RING_REQ in the DL_CONF request may get a DL_CONF_REPLY_M with the
+ * address of the ring in its own address space in DL_RING. From then on,
+ * packets are no longer passed with DL_WRITEV and DL_READV requests, but by
+ * filling slots of the ring and moving the indices of its queues.
+ *
+ * Each queue has one producer and one consumer. The producer fills slots
+ * nq_prod, nq_prod + 1, ... and then advances nq_prod; the consumer takes
+ * slots from nq_cons up to nq_prod and then advances nq_cons. The indices
+ * run freely, slot i lives at i % NETRING_SLOTS.
+ *
+ * A side sends a notify() to the other only when that side may be waiting:
+ * the producer after it made an empty queue non-empty, the consumer after it
+ * made room in a full queue. Both check the indices again after moving their
+ * own, so no doorbell is lost.
+ */
+
+#ifndef _MINIX_NETRING_H
+#define _MINIX_NETRING_H
+
+#include <minix/types.h>
+
+#define NETRING_SLOTS		64	/* slots per queue, a power of two */
+#define NETRING_SLOT_SIZE	2048	/* room for one ethernet frame */
+
+struct netring_queue {
+	volatile u32_t nq_prod;			/* next slot to fill */
+	volatile u32_t nq_cons;			/* next slot to take */
+	volatile u32_t nq_len[NETRING_SLOTS];	/* packet size per slot */
+};
+
+struct netring {
+	struct netring_queue nr_tx;	/* from the client to the driver */
+	struct netring_queue nr_rx;	/* from the driver to the client */
+};
+
+/* The queues take the first page, the slots of both queues follow. */
+#define NETRING_HDR_SIZE	4096
+#define NETRING_SIZE		(NETRING_HDR_SIZE + \
+				 2 * NETRING_SLOTS * NETRING_SLOT_SIZE)
+
+#define NETRING_TX_OFF(i)	(NETRING_HDR_SIZE + \
+				 ((i) % NETRING_SLOTS) * NETRING_SLOT_SIZE)
+#define NETRING_RX_OFF(i)	(NETRING_TX_OFF(i) + \
+				 NETRING_SLOTS * NETRING_SLOT_SIZE)
+#define NETRING_TX_SLOT(r, i)	((char *) (r) + NETRING_TX_OFF(i))
+#define NETRING_RX_SLOT(r, i)	((char *) (r) + NETRING_RX_OFF(i))
+
+#define netring_used(q)		((u32_t) ((q)->nq_prod - (q)->nq_cons))
+#define netring_empty(q)	(netring_used(q) == 0)
+#define netring_full(q)		(netring_used(q) == NETRING_SLOTS)
+
+/* Make index updates visible to the other side in order. */
+#define netring_barrier()	__sync_synchronize()
+
+#endif /* _MINIX_NETRING_H */
@@ -3,6 +3,35 @@
 
 #include <minix/ipc.h>
 
+/* Scheduling policies of SCHED, switched with SCHEDULING_SWITCH_TYPE. */
+#define SCHEDULE_DEFAULT	0
+#define SCHEDULE_LOTTERY	1
+#define SCHEDULE_EDF		2
+
+/* Statistics exported by SCHED through getsysinfo(SI_SCHED_STATS). */
+struct sched_stats {
+	int ss_policy;			/* active policy, SCHEDULE_* */
+	unsigned ss_lottery_procs;	/* processes taking part in the lottery */
+	unsigned ss_lottery_tickets;	/* tickets held by those processes */
+	unsigned long ss_lottery_draws;	/* number of draws held */
+	u64_t ss_lottery_cycles;	/* TSC cycles spent drawing */
+	unsigned ss_edf_procs;		/* processes in the EDF run set */
+	unsigned long ss_edf_served;	/* EDF jobs served */
+	unsigned long ss_edf_missed;	/* EDF deadlines missed */
+	unsigned long ss_migrations;	/* processes moved between cpus */
+	unsigned long ss_steals;	/* processes pulled by idle cpus */
+};
+
+/* Per-process EDF statistics, one per slot, through SI_SCHED_EDF_TAB. */
+struct sched_edf_stats {
+	endpoint_t se_endpoint;		/* process, or NONE for a free slot */
+	clock_t se_period;		/* period in ticks, 0 if aperiodic */
+	clock_t se_deadline;		/* relative deadline in ticks */
+	unsigned long se_jobs;		/* jobs released */
+	unsigned long se_missed;	/* deadlines missed */
+	clock_t se_maxlate;		/* worst lateness in ticks */
+};
+
 int sched_stop(endpoint_t scheduler_e, endpoint_t schedulee_e);
 int sched_start(endpoint_t scheduler_e, endpoint_t schedulee_e,
 	endpoint_t parent_e, int maxprio, int quantum, int cpu, endpoint_t
@@ -14,6 +14,8 @@ int getsysinfo(endpoint_t who, int what, void *where, size_t size);
 #define SI_CALL_STATS	   9	/* system call statistics */
 #define SI_PROCPUB_TAB	   11	/* copy of public entries of process table */
 #define SI_VMNT_TAB        12   /* get vmnt table */
+#define SI_SCHED_STATS	   13	/* scheduler statistics */
+#define SI_SCHED_EDF_TAB   14	/* per-process EDF statistics */
 
 #endif
 
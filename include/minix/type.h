@@ -88,6 +88,14 @@ struct loadinfo {
   clock_t last_clock;
 };
 
+/* Per-cpu run queue length and idle time, as returned by GET_CPULOAD. */
+struct cpu_load_info {
+  unsigned cl_runq_len;		/* processes in the cpu's run queues */
+  u64_t cl_idle_cycles;		/* cycles the cpu has spent idle */
+  u64_t cl_tsc;			/* cycle counter at the time of sampling */
+  unsigned cl_wakeups;		/* times the cpu woke up from idle */
+};
+
 struct machine {
   unsigned processors_count;	/* how many cpus are available */
   unsigned bsp_id;		/* id of the bootstrap cpu */
@@ -147,5 +147,11 @@ typedef struct {
 #define IS_PFS_VFS_RQ(type)	(type >= PFS_BASE && \
 					type < (PFS_BASE + PFS_NREQS))
 
+/* Capacity of a pipe, unless changed with F_SETPIPE_SZ, and the largest
+ * capacity the FS holding the pipe data has to support.
+ */
+#define PIPE_SIZE		(64 * 1024)
+#define PIPE_SIZE_MAX		(1024 * 1024)
+
 #endif
 
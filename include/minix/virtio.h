@@ -90,6 +90,9 @@ int virtio_host_supports(struct virtio_device *dev, int bit);
  * data is opaque and returned by virtio_from_queue() when the host
  * processed the descriptor chain.
  *
+ * Returns OK, or ENOSPC if the chain does not fit into the queue
+ * until the host has processed some of it. Nothing is queued then.
+ *
  * Note: The last bit of vp_addr is used to flag whether an iovec is
  *	 writable. This implies that only word aligned buffers can be
  *	 used.
@@ -97,12 +100,21 @@ int virtio_host_supports(struct virtio_device *dev, int bit);
 int virtio_to_queue(struct virtio_device *dev, int qidx,
 			struct vumap_phys *bufs, size_t num, void *data);
 
+/*
+ * Return the longest chain virtio_to_queue() can ever take for queue
+ * qidx: the size of an indirect table if the host takes those, the size
+ * of the queue otherwise.
+ */
+int virtio_queue_max_chain(struct virtio_device *dev, int qidx);
+
 /*
  * If the host used a chain of descriptors, return 0 and set data
- * as was given to virtio_to_queue(). If the host has not processed
- * any element returns -1.
+ * as was given to virtio_to_queue(). If len is not NULL, it is set to
+ * the number of bytes the host wrote into the chain. If the host has
+ * not processed any element returns -1.
  */
-int virtio_from_queue(struct virtio_device *dev, int qidx, void **data);
+int virtio_from_queue(struct virtio_device *dev, int qidx, void **data,
+			size_t *len);
 
 /* IRQ related functions */
 void virtio_irq_enable(struct virtio_device *dev);
@@ -36,12 +36,18 @@ int vm_yield_block_get_block(u64_t yieldid, u64_t getid, void *mem,
 #define VMPTYPE_NONE		0
 #define VMPTYPE_CHECK		1
 
+#define VSI_ORDERS	11	/* free block sizes reported, 1 to 1024 pages */
+
 struct vm_stats_info {
   unsigned int vsi_pagesize;	/* page size */
   unsigned long vsi_total;	/* total number of memory pages */
   unsigned long vsi_free;	/* number of free pages */
   unsigned long vsi_largest;	/* largest number of consecutive free pages */
   unsigned long vsi_cached;	/* number of pages cached for file systems */
+  unsigned long vsi_blocks[VSI_ORDERS];	/* free blocks of 2^i pages */
+  unsigned long vsi_zeroed;	/* number of pages zeroed ahead of time */
+  unsigned long vsi_zero_hits;	/* cleared pages taken from those */
+  unsigned long vsi_zero_misses;	/* cleared pages zeroed on demand */
 };
 
 struct vm_usage_info {
@@ -60,6 +66,7 @@ struct vm_region_info {
 #define MAX_VRI_COUNT	64	/* max. number of regions provided at once */
 
 int vm_info_stats(struct vm_stats_info *vfi);
+int vm_watch_memory(int on);
 int vm_info_usage(endpoint_t who, struct vm_usage_info *vui);
 int vm_info_region(endpoint_t who, struct vm_region_info *vri, int
 	count, vir_bytes *next);
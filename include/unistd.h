@@ -335,6 +335,7 @@ pid_t getnpid(endpoint_t proc_ep);
 uid_t getnuid(endpoint_t proc_ep);
 gid_t getngid(endpoint_t proc_ep);
 int getnucred(endpoint_t proc_ep, struct ucred *ucred);
+int setdeadline(pid_t pid, unsigned int period, unsigned int deadline);
 ssize_t pread64(int fd, void *buf, size_t count, u64_t where);
 ssize_t pwrite64(int fd, const void *buf, size_t count, u64_t where);
 #endif /* __MINIX */
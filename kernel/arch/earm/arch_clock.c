@@ -54,22 +54,23 @@ void context_stop(struct proc * p)
 {
 	u64_t tsc;
 	u32_t tsc_delta;
+	struct proc *kbill;
 	u64_t * __tsc_ctr_switch = get_cpulocal_var_ptr(tsc_ctr_switch);
 
 	read_tsc_64(&tsc);
 	tsc_delta = tsc - *__tsc_ctr_switch;
 	p->p_cycles += tsc_delta;
 
-	if(kbill_ipc) {
-		kbill_ipc->p_kipc_cycles =
-			add64(kbill_ipc->p_kipc_cycles, tsc_delta);
-		kbill_ipc = NULL;
+	if((kbill = get_cpulocal_var(kbill_ipc))) {
+		kbill->p_kipc_cycles =
+			add64(kbill->p_kipc_cycles, tsc_delta);
+		get_cpulocal_var(kbill_ipc) = NULL;
 	}
 
-	if(kbill_kcall) {
-		kbill_kcall->p_kcall_cycles =
-			add64(kbill_kcall->p_kcall_cycles, tsc_delta);
-		kbill_kcall = NULL;
+	if((kbill = get_cpulocal_var(kbill_kcall))) {
+		kbill->p_kcall_cycles =
+			add64(kbill->p_kcall_cycles, tsc_delta);
+		get_cpulocal_var(kbill_kcall) = NULL;
 	}
 
 	/*
@@ -114,6 +115,12 @@ void restart_local_timer(void)
 {
 }
 
+int oneshot_local_timer(clock_t UNUSED(ticks))
+{
+	/* the omap timer only ticks periodically */
+	return 0;
+}
+
 int register_local_timer_handler(const irq_handler_t handler)
 {
 	return omap3_register_timer_handler(handler);
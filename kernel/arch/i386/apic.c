@@ -545,6 +545,17 @@ void lapic_set_timer_one_shot(const u32_t usec)
 	lapic_write(LAPIC_LVTTR, lvtt);
 }
 
+u32_t lapic_timer_max_usec(void)
+{
+	/* longest one-shot the timer counter can hold, in micro seconds */
+	u32_t ticks_per_us;
+	const u8_t cpu = cpuid;
+
+	ticks_per_us = (lapic_bus_freq[cpu] / 1000000) * config_apic_timer_x;
+
+	return 0xffffffff / ticks_per_us;
+}
+
 void lapic_set_timer_periodic(const unsigned freq)
 {
 	/* sleep in micro seconds */
@@ -154,6 +154,7 @@ int apic_single_cpu_init(void);
 
 void lapic_set_timer_periodic(const unsigned freq);
 void lapic_set_timer_one_shot(const u32_t value);
+u32_t lapic_timer_max_usec(void);
 void lapic_stop_timer(void);
 void lapic_restart_timer(void);
 
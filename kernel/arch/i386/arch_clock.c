@@ -172,6 +172,25 @@ void restart_local_timer(void)
 #endif
 }
 
+int oneshot_local_timer(clock_t ticks)
+{
+#ifdef USE_APIC
+	if (lapic_addr) {
+		u32_t usec, max;
+
+		/* as far as the counter goes, the cpu wakes up early if not */
+		usec = 1000000 / system_hz;
+		max = lapic_timer_max_usec() / usec;
+		if (ticks > (clock_t) max)
+			ticks = max;
+		lapic_set_timer_one_shot(usec * ticks);
+		return 1;
+	}
+#endif
+	/* the i8253 timer only ticks periodically */
+	return 0;
+}
+
 int register_local_timer_handler(const irq_handler_t handler)
 {
 #ifdef USE_APIC
@@ -203,10 +222,11 @@ void cycles_accounting_init(void)
 	make_zero64(get_cpu_var(cpu, cpu_last_idle));
 }
 
-void context_stop(struct proc * p)
+static void context_stop_lock(struct proc * p, int shared)
 {
 	u64_t tsc, tsc_delta;
 	u64_t * __tsc_ctr_switch = get_cpulocal_var_ptr(tsc_ctr_switch);
+	struct proc *kbill;
 #ifdef CONFIG_SMP
 	unsigned cpu = cpuid;
 	int must_bkl_unlock = 0;
@@ -225,7 +245,10 @@ void context_stop(struct proc * p)
 		read_tsc_64(&tsc);
 		tmp = sub64(tsc, *__tsc_ctr_switch);
 		kernel_ticks[cpu] = add64(kernel_ticks[cpu], tmp);
+		/* all cpus may be leaving the kernel if it is shared */
+		proc_lock(p);
 		p->p_cycles = add64(p->p_cycles, tmp);
+		proc_unlock(p);
 		must_bkl_unlock = 1;
 	} else {
 		u64_t bkl_tsc;
@@ -235,7 +258,10 @@ void context_stop(struct proc * p)
 		/* this only gives a good estimate */
 		succ = big_kernel_lock.val;
 		
-		BKL_LOCK();
+		if (shared)
+			BKL_LOCK_SHARED();
+		else
+			BKL_LOCK();
 		
 		read_tsc_64(&tsc);
 
@@ -254,9 +280,11 @@ void context_stop(struct proc * p)
 		 *
 		 * Therefore we always check if there is one pending and if so,
 		 * we handle it straight away so the other cpu can continue and
-		 * we do not deadlock.
+		 * we do not deadlock. With a shared lock we never wait for the
+		 * other cpu, so the IPI is left for when we return to user mode.
 		 */
-		smp_sched_handler();
+		if (!shared)
+			smp_sched_handler();
 #endif
 	}
 #else
@@ -266,16 +294,16 @@ void context_stop(struct proc * p)
 	
 	tsc_delta = sub64(tsc, *__tsc_ctr_switch);
 
-	if(kbill_ipc) {
-		kbill_ipc->p_kipc_cycles =
-			add64(kbill_ipc->p_kipc_cycles, tsc_delta);
-		kbill_ipc = NULL;
+	if((kbill = get_cpulocal_var(kbill_ipc))) {
+		kbill->p_kipc_cycles =
+			add64(kbill->p_kipc_cycles, tsc_delta);
+		get_cpulocal_var(kbill_ipc) = NULL;
 	}
 
-	if(kbill_kcall) {
-		kbill_kcall->p_kcall_cycles =
-			add64(kbill_kcall->p_kcall_cycles, tsc_delta);
-		kbill_kcall = NULL;
+	if((kbill = get_cpulocal_var(kbill_kcall))) {
+		kbill->p_kcall_cycles =
+			add64(kbill->p_kcall_cycles, tsc_delta);
+		get_cpulocal_var(kbill_kcall) = NULL;
 	}
 
 	/*
@@ -307,6 +335,20 @@ void context_stop(struct proc * p)
 #endif
 }
 
+void context_stop(struct proc * p)
+{
+	context_stop_lock(p, FALSE);
+}
+
+/*
+ * Like context_stop() but for the IPC entry, which may take the big kernel
+ * lock shared. do_ipc() upgrades it if the call needs more.
+ */
+void context_stop_ipc(struct proc * p)
+{
+	context_stop_lock(p, TRUE);
+}
+
 void context_stop_idle(void)
 {
 	int is_idle;
@@ -321,6 +363,8 @@ void context_stop_idle(void)
 
 	if (is_idle)
 		restart_local_timer();
+	if (cpu_is_bsp(cpuid))
+		tick_start();
 #if SPROFILE
 	if (sprofiling)
 		get_cpulocal_var(idle_interrupted) = 1;
@@ -341,7 +341,7 @@ int vm_lookup(const struct proc *proc, const vir_bytes virtual,
 		return EFAULT;
 	}
 
-	/* We don't expect to ever see this. */
+	/* VM maps big anonymous regions of processes with big pages. */
 	if(pde_v & I386_VM_BIGPAGE) {
 		*physical = pde_v & I386_VM_ADDR_MASK_4MB;
 		if(ptent) *ptent = pde_v;
@@ -484,6 +484,8 @@ void delivermsg(struct proc *rp)
 
 	if (copy_msg_to_user(&rp->p_delivermsg,
 				(message *) rp->p_delivermsg_vir)) {
+		/* signaling needs the kernel exclusively */
+		BKL_UPGRADE();
 		printf("WARNING wrong user pointer 0x%08lx from "
 				"process %s / %d\n",
 				rp->p_delivermsg_vir,
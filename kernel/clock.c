@@ -22,6 +22,8 @@
  *   set_timer:		set a watchdog timer (+)
  *   reset_timer:	reset a watchdog timer (+)
  *   read_clock:	read the counter of channel 0 of the 8253A timer
+ *   tick_stop:		stop the tick of the idle boot cpu in tickless mode
+ *   tick_start:	let the tick of the boot cpu run again
  *
  * (+) The CLOCK task keeps tracks of watchdog timers for the entire kernel.
  * It is crucial that watchdog functions not block, or the CLOCK task may
@@ -42,6 +44,7 @@
 /* Function prototype for PRIVATE functions.
  */ 
 static void load_update(void);
+static void tick_update(void);
 
 /* The CLOCK's timers queue. The functions in <timers.h> operate on this. 
  * Each system process possesses a single synchronous alarm timer. If other 
@@ -57,6 +60,18 @@ static clock_t next_timeout;	/* realtime that next timer expires */
  */
 static clock_t realtime = 0;		      /* real time clock */
 
+/* In tickless mode the boot cpu stops its tick while it is idle, and has its
+ * timer expire only when the next CLOCK timer does. The real time is then
+ * kept by the cycle counter rather than by counting ticks, and brought up to
+ * date on every tick and whenever the cpu wakes up. Other cpus read the cycle
+ * counter themselves while the tick is stopped, which assumes that the
+ * counters of all cpus run in step.
+ */
+static u64_t tsc_per_tick;	/* cycles per tick, 0 if not tickless */
+static u64_t tick_tsc;		/* cycle counter when tick 'realtime' began */
+static volatile int tick_stopped;	/* is the tick of the boot cpu off? */
+static clock_t tick_wakeup;	/* realtime at which it comes back */
+
 /*
  * The boot processos timer interrupt handler. In addition to non-boot cpus it
  * keeps real time and notifies the clock task if need be
@@ -82,8 +97,12 @@ int timer_int_handler(void)
 	watchdog_local_timer_ticks++;
 #endif
 
-	if (cpu_is_bsp(cpuid))
-		realtime++;
+	if (cpu_is_bsp(cpuid)) {
+		if (tsc_per_tick != 0)
+			tick_update();
+		else
+			realtime++;
+	}
 
 	/* Update user and system accounting times. Charge the current process
 	 * for user time. If the current process is not billable, that is, if a
@@ -157,9 +176,79 @@ int timer_int_handler(void)
 clock_t get_uptime(void)
 {
   /* Get and return the current clock uptime in ticks. */
+  u64_t tsc;
+
+  if (tick_stopped) {
+	/* The boot cpu is asleep and not counting. */
+	read_tsc_64(&tsc);
+	if (cmp64(tsc, tick_tsc) > 0)
+		return(realtime + ex64lo(div64(sub64(tsc, tick_tsc),
+			tsc_per_tick)));
+  }
   return(realtime);
 }
 
+/*===========================================================================*
+ *				tick_update				     *
+ *===========================================================================*/
+static void tick_update(void)
+{
+/* Advance the real time by the ticks that have passed by the cycle counter.
+ * Only the boot cpu does this.
+ */
+  u64_t tsc;
+  u32_t ticks;
+
+  read_tsc_64(&tsc);
+  if (cmp64(tsc, tick_tsc) <= 0) return;
+
+  ticks = ex64lo(div64(sub64(tsc, tick_tsc), tsc_per_tick));
+  realtime += ticks;
+  tick_tsc = add64(tick_tsc, mul64(tsc_per_tick, make64(ticks, 0)));
+}
+
+/*===========================================================================*
+ *				tick_stop				     *
+ *===========================================================================*/
+int tick_stop(void)
+{
+/* The boot cpu is about to go idle. In tickless mode, have its timer expire
+ * only when the first CLOCK timer does. Return FALSE if the tick has to keep
+ * running.
+ */
+  clock_t ticks;
+
+  if (tsc_per_tick == 0) return(FALSE);
+
+  tick_update();
+  if (next_timeout <= realtime) return(FALSE);
+
+  /* The timer may not be able to count that far; the cpu then wakes up
+   * earlier and goes back to sleep.
+   */
+  ticks = next_timeout - realtime;
+  if (!oneshot_local_timer(ticks)) return(FALSE);
+
+  tick_wakeup = next_timeout;
+  tick_stopped = TRUE;
+  return(TRUE);
+}
+
+/*===========================================================================*
+ *				tick_start				     *
+ *===========================================================================*/
+void tick_start(void)
+{
+/* The boot cpu has woken up. If its tick was stopped, catch up with the time
+ * it slept, and let the tick run again while there is work to do.
+ */
+  if (!tick_stopped) return;
+
+  tick_update();
+  tick_stopped = FALSE;
+  (void) oneshot_local_timer(1);
+}
+
 /*===========================================================================*
  *				set_timer				     *
  *===========================================================================*/
@@ -173,6 +262,12 @@ tmr_func_t watchdog;		/* watchdog to be called */
  */
   tmrs_settimer(&clock_timers, tp, exp_time, watchdog, NULL);
   next_timeout = clock_timers->tmr_exp_time;
+
+#ifdef CONFIG_SMP
+  /* Wake up the boot cpu if it would sleep past this timer. */
+  if (tick_stopped && next_timeout < tick_wakeup && !cpu_is_bsp(cpuid))
+	smp_schedule(bsp_cpu_id);
+#endif
 }
 
 /*===========================================================================*
@@ -195,7 +290,7 @@ struct timer *tp;		/* pointer to timer structure */
  *===========================================================================*/
 static void load_update(void)
 {
-	u16_t slot;
+	u16_t slot, last;
 	int enqueued = 0, q;
 	struct proc *p;
 	struct proc **rdy_head;
@@ -208,7 +303,12 @@ static void load_update(void)
 	 */
 	slot = (realtime / system_hz / _LOAD_UNIT_SECS) % _LOAD_HISTORY;
 	if(slot != kloadinfo.proc_last_slot) {
-		kloadinfo.proc_load_history[slot] = 0;
+		/* Also clear the slots passed while the tick was stopped. */
+		last = kloadinfo.proc_last_slot;
+		do {
+			last = (last + 1) % _LOAD_HISTORY;
+			kloadinfo.proc_load_history[last] = 0;
+		} while (last != slot);
 		kloadinfo.proc_last_slot = slot;
 	}
 
@@ -235,6 +335,17 @@ int boot_cpu_init_timer(unsigned freq)
 				(irq_handler_t) timer_int_handler))
 		return -1;
 
+	/* The watchdog takes a stopped tick for a locked up kernel. */
+#ifdef USE_WATCHDOG
+	if (watchdog_enabled)
+		config_tickless = 0;
+#endif
+	if (config_tickless) {
+		tsc_per_tick = div64u64(cpu_get_freq(cpuid), system_hz);
+		read_tsc_64(&tick_tsc);
+		BOOT_VERBOSE(printf("Stopping the tick when idle\n"));
+	}
+
 	return 0;
 }
 
@@ -15,6 +15,8 @@ void stop_local_timer(void);
 /* let the time tick again with the original settings after it was stopped */
 void restart_local_timer(void);
 int register_local_timer_handler(irq_handler_t handler);
+/* let the local timer expire once after the given number of ticks */
+int oneshot_local_timer(clock_t ticks);
 
 u64_t ms_2_cpu_time(unsigned ms);
 unsigned cpu_time_2_ms(u64_t cpu_time);
@@ -71,7 +71,19 @@ DECLARE_CPULOCAL(struct proc *, ptproc);
 /* CPU private run queues */
 DECLARE_CPULOCAL(struct proc *, run_q_head[NR_SCHED_QUEUES]); /* ptrs to ready list headers */
 DECLARE_CPULOCAL(struct proc *, run_q_tail[NR_SCHED_QUEUES]); /* ptrs to ready list tails */
+#if (NR_SCHED_QUEUES > 32)
+#error NR_SCHED_QUEUES must fit in the run queue bitmap
+#endif
+DECLARE_CPULOCAL(u32_t, run_q_bitmap); /* bit q set iff queue q is nonempty */
+DECLARE_CPULOCAL(unsigned, run_q_len); /* number of processes in the run queues */
+DECLARE_CPULOCAL(atomic_t, run_q_lock); /* spinlock for the run queues above */
 DECLARE_CPULOCAL(volatile int, cpu_is_idle); /* let the others know that you are idle */
+DECLARE_CPULOCAL(unsigned, idle_wakeups); /* times the cpu woke up from idle */
+DECLARE_CPULOCAL(int, bkl_shared); /* big kernel lock held shared, not exclusively */
+
+/* processes to bill kernel time to */
+DECLARE_CPULOCAL(struct proc *, kbill_kcall); /* process that made kernel call */
+DECLARE_CPULOCAL(struct proc *, kbill_ipc); /* process that invoked ipc */
 
 DECLARE_CPULOCAL(volatile int, idle_interrupted); /* to interrupt busy-idle
 						     while profiling */
@@ -18,10 +18,12 @@ int runqueues_ok_cpu(unsigned cpu)
 {
   int q, l = 0;
   register struct proc *xp;
-  struct proc **rdy_head, **rdy_tail;
+  struct proc **rdy_head, **rdy_tail, *prev;
+  u32_t bitmap;
 
   rdy_head = get_cpu_var(cpu, run_q_head);
   rdy_tail = get_cpu_var(cpu, run_q_tail);
+  bitmap = get_cpu_var(cpu, run_q_bitmap);
 
   for (xp = BEG_PROC_ADDR; xp < END_PROC_ADDR; ++xp) {
 	xp->p_found = 0;
@@ -41,7 +43,11 @@ int runqueues_ok_cpu(unsigned cpu)
 	printf("tail and tail->next not null in %d\n", q);
 	return 0;
     }
-    for(xp = rdy_head[q]; xp; xp = xp->p_nextready) {
+    if (!rdy_head[q] != !(bitmap & (1U << q))) {
+	printf("bitmap does not match queue %d\n", q);
+	return 0;
+    }
+    for(prev = NULL, xp = rdy_head[q]; xp; prev = xp, xp = xp->p_nextready) {
 	const vir_bytes vxp = (vir_bytes) xp;
 	vir_bytes dxp;
 	if(vxp < (vir_bytes) BEG_PROC_ADDR || vxp >= (vir_bytes) END_PROC_ADDR) {
@@ -77,6 +83,11 @@ int runqueues_ok_cpu(unsigned cpu)
 			q, xp->p_nr);
 		return 0;
 	}
+	if (xp->p_prevready != prev) {
+		printf("sched err: broken back link q %d proc %d\n",
+			q, xp->p_nr);
+		return 0;
+	}
 	xp->p_found = 1;
 	if (!xp->p_nextready && rdy_tail[q] != xp) {
 		printf("sched err: last element not tail q %d proc %d\n",
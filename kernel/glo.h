@@ -36,8 +36,6 @@ vir_bytes minix_kerninfo_user;
 EXTERN struct proc *vmrequest;  /* first process on vmrequest queue */
 EXTERN unsigned lost_ticks;	/* clock ticks counted outside clock task */
 EXTERN char *ipc_call_names[IPCNO_HIGHEST+1]; /* human-readable call names */
-EXTERN struct proc *kbill_kcall; /* process that made kernel call */
-EXTERN struct proc *kbill_ipc; /* process that invoked ipc */
 
 /* Interrupt related variables. */
 EXTERN irq_hook_t irq_hooks[NR_IRQ_HOOKS];	/* hooks for general use */
@@ -57,6 +55,7 @@ EXTERN int verboseflags;
 EXTERN int config_no_apic; /* optionaly turn off apic */
 EXTERN int config_apic_timer_x; /* apic timer slowdown factor */
 #endif
+EXTERN int config_tickless; /* stop the tick of the idle boot cpu */
 
 EXTERN u64_t cpu_hz[CONFIG_MAX_CPUS];
 
@@ -418,6 +418,12 @@ void cstart()
 	config_apic_timer_x = 1;
 #endif
 
+  value = env_get("tickless");
+  if(value)
+	config_tickless = atoi(value);
+  else
+	config_tickless = 0;
+
 #ifdef USE_WATCHDOG
   value = env_get("watchdog");
   if (value)
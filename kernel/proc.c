@@ -60,6 +60,15 @@ static int try_async(struct proc *caller_ptr);
 static int try_one(struct proc *src_ptr, struct proc *dst_ptr);
 static struct proc * pick_proc(void);
 static void enqueue_head(struct proc *rp);
+static int fast_sendrec(struct proc *caller_ptr, endpoint_t dst_e,
+	message *m_ptr, int *result);
+static void direct_switch(struct proc *caller_ptr, struct proc *dst_ptr);
+#ifdef CONFIG_SMP
+static int fast_sync_ipc(struct proc *caller_ptr, int call_nr,
+	endpoint_t src_dst_e, message *m_ptr, int *result);
+static void proc_lock_pair(struct proc *p1, struct proc *p2);
+static void proc_unlock_pair(struct proc *p1, struct proc *p2);
+#endif
 
 /* all idles share the same idle_priv structure */
 static struct priv idle_priv;
@@ -178,6 +187,20 @@ static void idle(void)
 	 * the CPU utiliziation of certain workloads with high precision.
 	 */
 
+#ifdef CONFIG_SMP
+	/* Other cpus may enqueue here while the kernel is locked shared.
+	 * Either their process shows up now, or they see that we are idle
+	 * and send us an IPI.
+	 */
+	spinlock_lock(get_cpulocal_var_ptr(run_q_lock));
+	if (get_cpulocal_var(run_q_bitmap)) {
+		spinlock_unlock(get_cpulocal_var_ptr(run_q_lock));
+		return;
+	}
+	get_cpulocal_var(cpu_is_idle) = 1;
+	spinlock_unlock(get_cpulocal_var_ptr(run_q_lock));
+#endif
+
 	p = get_cpulocal_var(proc_ptr) = get_cpulocal_var_ptr(idle_proc);
 	if (priv(p)->s_flags & BILLABLE)
 		get_cpulocal_var(bill_ptr) = p;
@@ -185,7 +208,6 @@ static void idle(void)
 	switch_address_space_idle();
 
 #ifdef CONFIG_SMP
-	get_cpulocal_var(cpu_is_idle) = 1;
 	/* we don't need to keep time on APs as it is handled on the BSP */
 	if (cpuid != bsp_cpu_id)
 		stop_local_timer();
@@ -194,9 +216,11 @@ static void idle(void)
 	{
 		/*
 		 * If the timer has expired while in kernel we must
-		 * rearm it before we go to sleep
+		 * rearm it before we go to sleep, unless it can stay off
+		 * until the next timer expires
 		 */
-		restart_local_timer();
+		if (!tick_stop())
+			restart_local_timer();
 	}
 
 	/* start accounting for the idle time */
@@ -217,6 +241,7 @@ static void idle(void)
 		*v = 0;
 	}
 #endif
+	get_cpulocal_var(idle_wakeups)++;
 	/*
 	 * end of accounting for the idle task does not happen here, the kernel
 	 * is handling stuff for quite a while before it gets back here!
@@ -249,6 +274,7 @@ void switch_to_user(void)
 	 * current process wasn' runnable, we pick a new one here
 	 */
 not_runnable_pick_new:
+	proc_lock(p);
 	if (proc_is_preempted(p)) {
 		p->p_rts_flags &= ~RTS_PREEMPTED;
 		if (proc_is_runnable(p)) {
@@ -258,6 +284,7 @@ not_runnable_pick_new:
 				enqueue(p);
 		}
 	}
+	proc_unlock(p);
 
 	/*
 	 * if we have no process to run, set IDLE as the current process for
@@ -281,6 +308,15 @@ not_runnable_pick_new:
 check_misc_flags:
 
 	assert(p);
+#ifdef CONFIG_SMP
+	/* Only message delivery is done with the kernel locked shared. */
+	if (BKL_IS_SHARED() && (p->p_misc_flags & (MF_KCALL_RESUME |
+			MF_SC_DEFER | MF_SC_TRACE | MF_SC_ACTIVE))) {
+		BKL_UPGRADE();
+		if (!proc_is_runnable(p))
+			goto not_runnable_pick_new;
+	}
+#endif
 	assert(proc_is_runnable(p));
 	while (p->p_misc_flags &
 		(MF_KCALL_RESUME | MF_DELIVERMSG |
@@ -348,8 +384,13 @@ check_misc_flags:
 	 * as we are sure that a possible out-of-quantum message to the
 	 * scheduler will not collide with the regular ipc
 	 */
-	if (is_zero64(p->p_cpu_time_left))
+	if (is_zero64(p->p_cpu_time_left)) {
+		BKL_UPGRADE();
+		/* Another cpu may have blocked it while the lock was shared. */
+		if (!proc_is_runnable(p))
+			goto not_runnable_pick_new;
 		proc_no_time(p);
+	}
 	/*
 	 * After handling the misc flags the selected process might not be
 	 * runnable anymore. We have to checkit and schedule another one
@@ -495,10 +536,23 @@ static int do_sync_ipc(struct proc * caller_ptr, /* who made the call */
 	return(ETRAPDENIED);		/* trap denied by mask or kernel */
   }
 
+#ifdef CONFIG_SMP
+  if (BKL_IS_SHARED()) {
+	if (fast_sync_ipc(caller_ptr, call_nr, src_dst_e, m_ptr, &result))
+		return(result);
+
+	/* Start over with the kernel locked exclusively. */
+	BKL_UPGRADE();
+	return do_sync_ipc(caller_ptr, call_nr, src_dst_e, m_ptr);
+  }
+#endif
+
   switch(call_nr) {
   case SENDREC:
 	/* A flag is set so that notifications cannot interrupt SENDREC. */
 	caller_ptr->p_misc_flags |= MF_REPLY_PEND;
+	if (fast_sendrec(caller_ptr, src_dst_e, m_ptr, &result))
+		break;
 	/* fall through */
   case SEND:			
 	result = mini_send(caller_ptr, src_dst_e, m_ptr, 0);
@@ -526,6 +580,274 @@ static int do_sync_ipc(struct proc * caller_ptr, /* who made the call */
   return(result);
 }
 
+#ifdef CONFIG_SMP
+/*===========================================================================*
+ *				proc_lock_pair				     *
+ *===========================================================================*/
+static void proc_lock_pair(struct proc *p1, struct proc *p2)
+{
+/* Take the IPC locks of two processes in the order of their slots. The
+ * second process may be NULL.
+ */
+  if (p2 && p2 < p1) {
+	proc_lock(p2);
+	proc_lock(p1);
+  } else {
+	proc_lock(p1);
+	if (p2)
+		proc_lock(p2);
+  }
+}
+
+/*===========================================================================*
+ *				proc_unlock_pair			     *
+ *===========================================================================*/
+static void proc_unlock_pair(struct proc *p1, struct proc *p2)
+{
+  if (p2)
+	proc_unlock(p2);
+  proc_unlock(p1);
+}
+
+/*===========================================================================*
+ *				sys_map_empty				     *
+ *===========================================================================*/
+static int sys_map_empty(sys_map_t *map)
+{
+  int id;
+
+  for (id = 0; id < NR_SYS_PROCS; id += BITCHUNK_BITS)
+	if (get_sys_bits(*map, id) != 0)
+		return FALSE;
+  return TRUE;
+}
+
+/*===========================================================================*
+ *				fast_sync_ipc				     *
+ *===========================================================================*/
+static int fast_sync_ipc(struct proc *caller_ptr, int call_nr,
+	endpoint_t src_dst_e, message *m_ptr, int *result)
+{
+/* Handle a synchronous IPC call with the big kernel lock held shared, under
+ * the IPC locks of the caller and its peer. Only the common cases are done
+ * here: handing a message to a process that is waiting for it, and blocking
+ * in RECEIVE when nothing is pending. Anything else, like queueing a blocked
+ * sender, may involve more processes than these two. Returns FALSE, having
+ * changed nothing, if the call needs the kernel locked exclusively.
+ */
+  struct proc *peer_ptr = NULL;
+  int src_dst_p, call, handled = FALSE;
+
+  if (src_dst_e != ANY) {
+	okendpt(src_dst_e, &src_dst_p);
+	peer_ptr = proc_addr(src_dst_p);
+	if (peer_ptr == caller_ptr)
+		return FALSE;
+  }
+
+  proc_lock_pair(caller_ptr, peer_ptr);
+
+  switch(call_nr) {
+  case SENDREC:
+  case SEND:
+  case SENDNB:
+	if (RTS_ISSET(peer_ptr, RTS_NO_ENDPOINT) ||
+			!WILLRECEIVE(peer_ptr, caller_ptr->p_endpoint))
+		break;
+
+	/* The peer becomes runnable and is not sending, so in SENDREC the
+	 * caller can only get its reply early by asynchronous message.
+	 */
+	if (call_nr == SENDREC && get_sys_bit(priv(caller_ptr)->s_asyn_pending,
+			nr_to_id(src_dst_p)))
+		break;
+
+	handled = TRUE;
+	if (call_nr == SENDREC)
+		caller_ptr->p_misc_flags |= MF_REPLY_PEND;
+	assert(!(peer_ptr->p_misc_flags & MF_DELIVERMSG));
+	if (copy_msg_from_user(m_ptr, &peer_ptr->p_delivermsg)) {
+		*result = EFAULT;
+		break;
+	}
+
+	peer_ptr->p_delivermsg.m_source = caller_ptr->p_endpoint;
+	peer_ptr->p_misc_flags |= MF_DELIVERMSG;
+
+	call = (caller_ptr->p_misc_flags & MF_REPLY_PEND ? SENDREC
+		: (call_nr == SENDNB ? SENDNB : SEND));
+	IPC_STATUS_ADD_CALL(peer_ptr, call);
+
+	if (peer_ptr->p_misc_flags & MF_REPLY_PEND)
+		peer_ptr->p_misc_flags &= ~MF_REPLY_PEND;
+
+#if DEBUG_IPC_HOOK
+	hook_ipc_msgsend(&peer_ptr->p_delivermsg, caller_ptr, peer_ptr);
+	hook_ipc_msgrecv(&peer_ptr->p_delivermsg, caller_ptr, peer_ptr);
+#endif
+
+	if (call_nr == SENDREC) {
+		caller_ptr->p_delivermsg_vir = (vir_bytes) m_ptr;
+		caller_ptr->p_getfrom_e = src_dst_e;
+		RTS_SET(caller_ptr, RTS_RECEIVING);
+		direct_switch(caller_ptr, peer_ptr);
+	}
+
+	/* Its cpu may pick the peer as soon as it is runnable. */
+	__insn_barrier();
+	RTS_UNSET(peer_ptr, RTS_RECEIVING);
+	*result = OK;
+	break;
+
+  case RECEIVE:
+	/* Processes sharing their privilege structure share the bit maps of
+	 * pending messages, which are only protected by the caller's lock.
+	 */
+	if (!(priv(caller_ptr)->s_flags & SYS_PROC))
+		break;
+	if (caller_ptr->p_caller_q)
+		break;
+	if (peer_ptr) {
+		if (RTS_ISSET(peer_ptr, RTS_NO_ENDPOINT))
+			break;
+		if (get_sys_bit(priv(caller_ptr)->s_notify_pending,
+				nr_to_id(src_dst_p)) ||
+				get_sys_bit(priv(caller_ptr)->s_asyn_pending,
+				nr_to_id(src_dst_p)))
+			break;
+		/* A peer blocked on IPC might close a cycle. */
+		if (P_BLOCKEDON(peer_ptr) != NONE)
+			break;
+	} else {
+		if (!sys_map_empty(&priv(caller_ptr)->s_notify_pending) ||
+			!sys_map_empty(&priv(caller_ptr)->s_asyn_pending))
+			break;
+	}
+
+	handled = TRUE;
+	assert(!(caller_ptr->p_misc_flags & MF_DELIVERMSG));
+	caller_ptr->p_misc_flags &= ~MF_REPLY_PEND;
+	IPC_STATUS_CLEAR(caller_ptr);
+	caller_ptr->p_delivermsg_vir = (vir_bytes) m_ptr;
+	caller_ptr->p_getfrom_e = src_dst_e;
+	RTS_SET(caller_ptr, RTS_RECEIVING);
+	*result = OK;
+	break;
+
+  case NOTIFY:
+	if (WILLRECEIVE(peer_ptr, caller_ptr->p_endpoint) &&
+			!(peer_ptr->p_misc_flags & MF_REPLY_PEND)) {
+		assert(!(peer_ptr->p_misc_flags & MF_DELIVERMSG));
+		BuildNotifyMessage(&peer_ptr->p_delivermsg,
+			proc_nr(caller_ptr), peer_ptr);
+		peer_ptr->p_delivermsg.m_source = caller_ptr->p_endpoint;
+		peer_ptr->p_misc_flags |= MF_DELIVERMSG;
+		IPC_STATUS_ADD_CALL(peer_ptr, NOTIFY);
+		__insn_barrier();
+		RTS_UNSET(peer_ptr, RTS_RECEIVING);
+	} else if (priv(peer_ptr)->s_flags & SYS_PROC) {
+		set_sys_bit(priv(peer_ptr)->s_notify_pending,
+			priv(caller_ptr)->s_id);
+	} else
+		break;
+	handled = TRUE;
+	*result = OK;
+	break;
+  }
+
+  proc_unlock_pair(caller_ptr, peer_ptr);
+
+  return handled;
+}
+#endif /* CONFIG_SMP */
+
+/*===========================================================================*
+ *				fast_sendrec				     *
+ *===========================================================================*/
+static int fast_sendrec(struct proc *caller_ptr, endpoint_t dst_e,
+	message *m_ptr, int *result)
+{
+/* The common case of SENDREC: the destination is waiting for the request, so
+ * the caller is certain to block for the reply. Do the send and the receive
+ * half in one go, without the checks mini_receive() makes for messages that
+ * cannot be there, and switch to the destination right away if possible.
+ * Returns FALSE, having changed nothing, if the call needs the general path.
+ */
+  struct proc *dst_ptr;
+
+  dst_ptr = proc_addr(_ENDPOINT_P(dst_e));
+  if (dst_ptr == caller_ptr || iskernelp(dst_ptr) ||
+		RTS_ISSET(dst_ptr, RTS_NO_ENDPOINT) ||
+		!WILLRECEIVE(dst_ptr, caller_ptr->p_endpoint))
+	return FALSE;
+
+  /* The reply may already be pending as an asynchronous message. */
+  if (get_sys_bit(priv(caller_ptr)->s_asyn_pending,
+		nr_to_id(proc_nr(dst_ptr))))
+	return FALSE;
+
+  assert(!(dst_ptr->p_misc_flags & MF_DELIVERMSG));
+  if (copy_msg_from_user(m_ptr, &dst_ptr->p_delivermsg)) {
+	*result = EFAULT;
+	return TRUE;
+  }
+  dst_ptr->p_delivermsg.m_source = caller_ptr->p_endpoint;
+  dst_ptr->p_misc_flags |= MF_DELIVERMSG;
+  IPC_STATUS_ADD_CALL(dst_ptr, SENDREC);
+  dst_ptr->p_misc_flags &= ~MF_REPLY_PEND;
+
+#if DEBUG_IPC_HOOK
+  hook_ipc_msgsend(&dst_ptr->p_delivermsg, caller_ptr, dst_ptr);
+  hook_ipc_msgrecv(&dst_ptr->p_delivermsg, caller_ptr, dst_ptr);
+#endif
+
+  /* The caller blocks for the reply before the destination is made
+   * runnable, so that the destination does not preempt it.
+   */
+  caller_ptr->p_delivermsg_vir = (vir_bytes) m_ptr;
+  caller_ptr->p_getfrom_e = dst_e;
+  RTS_SET(caller_ptr, RTS_RECEIVING);
+  direct_switch(caller_ptr, dst_ptr);
+  RTS_UNSET(dst_ptr, RTS_RECEIVING);
+
+  *result = OK;
+  return TRUE;
+}
+
+/*===========================================================================*
+ *				direct_switch				     *
+ *===========================================================================*/
+static void direct_switch(struct proc *caller_ptr, struct proc *dst_ptr)
+{
+/* The caller has just blocked in SENDREC on 'dst_ptr', which is about to be
+ * made runnable. If the destination is what pick_proc() would run next on
+ * this cpu, make it the current process here, so that switch_to_user()
+ * finds it runnable and goes straight to delivering the message.
+ */
+  u32_t higher;
+
+  if (get_cpulocal_var(proc_ptr) != caller_ptr || dst_ptr->p_cpu != cpuid)
+	return;
+#ifdef CONFIG_SMP
+  if (dst_ptr->p_misc_flags & MF_FLUSH_TLB)
+	return;
+#endif
+
+  /* Nothing may be ready at the priority of the destination or above. */
+  higher = (2U << dst_ptr->p_priority) - 1;
+  spinlock_lock(get_cpulocal_var_ptr(run_q_lock));
+  if (get_cpulocal_var(run_q_bitmap) & higher) {
+	spinlock_unlock(get_cpulocal_var_ptr(run_q_lock));
+	return;
+  }
+  spinlock_unlock(get_cpulocal_var_ptr(run_q_lock));
+
+  get_cpulocal_var(proc_ptr) = dst_ptr;
+  if (priv(dst_ptr)->s_flags & BILLABLE)
+	get_cpulocal_var(bill_ptr) = dst_ptr;
+  switch_address_space(dst_ptr);
+}
+
 int do_ipc(reg_t r1, reg_t r2, reg_t r3)
 {
   struct proc *const caller_ptr = get_cpulocal_var(proc_ptr);	/* get pointer to caller */
@@ -534,7 +856,15 @@ int do_ipc(reg_t r1, reg_t r2, reg_t r3)
   assert(!RTS_ISSET(caller_ptr, RTS_SLOT_FREE));
 
   /* bill kernel time to this process. */
-  kbill_ipc = caller_ptr;
+  get_cpulocal_var(kbill_ipc) = caller_ptr;
+
+#ifdef CONFIG_SMP
+  /* Only untraced synchronous IPC goes on with the kernel locked shared. */
+  if ((caller_ptr->p_misc_flags & (MF_SC_TRACE | MF_SC_DEFER)) ||
+		(call_nr != SENDREC && call_nr != SEND && call_nr != RECEIVE &&
+		call_nr != NOTIFY && call_nr != SENDNB))
+	BKL_UPGRADE();
+#endif
 
   /* If this process is subject to system call tracing, handle that first. */
   if (caller_ptr->p_misc_flags & (MF_SC_TRACE | MF_SC_DEFER)) {
@@ -1526,6 +1856,9 @@ void enqueue(
  */
   int q = rp->p_priority;	 		/* scheduling queue to use */
   struct proc **rdy_head, **rdy_tail;
+#ifdef CONFIG_SMP
+  int idle;
+#endif
   
   assert(proc_is_runnable(rp));
 
@@ -1534,16 +1867,27 @@ void enqueue(
   rdy_head = get_cpu_var(rp->p_cpu, run_q_head);
   rdy_tail = get_cpu_var(rp->p_cpu, run_q_tail);
 
+  spinlock_lock(get_cpu_var_ptr(rp->p_cpu, run_q_lock));
+
   /* Now add the process to the queue. */
   if (!rdy_head[q]) {		/* add to empty queue */
       rdy_head[q] = rdy_tail[q] = rp; 		/* create a new queue */
       rp->p_nextready = NULL;		/* mark new end */
+      rp->p_prevready = NULL;		/* mark new start */
+      get_cpu_var(rp->p_cpu, run_q_bitmap) |= (1U << q);
   } 
   else {					/* add to tail of queue */
       rdy_tail[q]->p_nextready = rp;		/* chain tail of queue */	
+      rp->p_prevready = rdy_tail[q];		/* link back to old tail */
       rdy_tail[q] = rp;				/* set new queue tail */
       rp->p_nextready = NULL;		/* mark new end */
   }
+  get_cpu_var(rp->p_cpu, run_q_len)++;
+#ifdef CONFIG_SMP
+  idle = get_cpu_var(rp->p_cpu, cpu_is_idle);
+#endif
+
+  spinlock_unlock(get_cpu_var_ptr(rp->p_cpu, run_q_lock));
 
   if (cpuid == rp->p_cpu) {
 	  /*
@@ -1564,7 +1908,7 @@ void enqueue(
    * the time is off, we need to wake up that cpu and let it schedule this new
    * process
    */
-  else if (get_cpu_var(rp->p_cpu, cpu_is_idle)) {
+  else if (idle) {
 	  smp_schedule(rp->p_cpu);
   }
 #endif
@@ -1608,14 +1952,23 @@ static void enqueue_head(struct proc *rp)
   rdy_head = get_cpu_var(rp->p_cpu, run_q_head);
   rdy_tail = get_cpu_var(rp->p_cpu, run_q_tail);
 
+  spinlock_lock(get_cpu_var_ptr(rp->p_cpu, run_q_lock));
+
   /* Now add the process to the queue. */
   if (!rdy_head[q]) {		/* add to empty queue */
       rdy_head[q] = rdy_tail[q] = rp; 		/* create a new queue */
       rp->p_nextready = NULL;		/* mark new end */
+      get_cpu_var(rp->p_cpu, run_q_bitmap) |= (1U << q);
   }
-  else						/* add to head of queue */
+  else {					/* add to head of queue */
       rp->p_nextready = rdy_head[q];		/* chain head of queue */
+      rdy_head[q]->p_prevready = rp;		/* link back to new head */
       rdy_head[q] = rp;				/* set new queue head */
+  }
+  rp->p_prevready = NULL;			/* mark new start */
+  get_cpu_var(rp->p_cpu, run_q_len)++;
+
+  spinlock_unlock(get_cpu_var_ptr(rp->p_cpu, run_q_lock));
 
   /* Make note of when this process was added to queue */
   read_tsc_64(&(get_cpulocal_var(proc_ptr->p_accounting.enter_queue)));
@@ -1644,11 +1997,9 @@ void dequeue(struct proc *rp)
  * queue of the cpu the process is currently assigned to.
  */
   int q = rp->p_priority;		/* queue to use */
-  struct proc **xpp;			/* iterate over queue */
-  struct proc *prev_xp;
   u64_t tsc, tsc_delta;
 
-  struct proc **rdy_tail;
+  struct proc **rdy_head, **rdy_tail;
 
   assert(proc_ptr_ok(rp));
   assert(!proc_is_runnable(rp));
@@ -1656,25 +2007,30 @@ void dequeue(struct proc *rp)
   /* Side-effect for kernel: check if the task's stack still is ok? */
   assert (!iskernelp(rp) || *priv(rp)->s_stack_guard == STACK_GUARD);
 
+  rdy_head = get_cpu_var(rp->p_cpu, run_q_head);
   rdy_tail = get_cpu_var(rp->p_cpu, run_q_tail);
 
   /* Now make sure that the process is not in its ready queue. Remove the 
    * process if it is found. A process can be made unready even if it is not 
-   * running by being sent a signal that kills it.
+   * running by being sent a signal that kills it. A queued process is either
+   * the head of its queue or has a predecessor, so no walk is needed.
    */
-  prev_xp = NULL;				
-  for (xpp = get_cpu_var_ptr(rp->p_cpu, run_q_head[q]); *xpp;
-		  xpp = &(*xpp)->p_nextready) {
-      if (*xpp == rp) {				/* found process to remove */
-          *xpp = (*xpp)->p_nextready;		/* replace with next chain */
-          if (rp == rdy_tail[q]) {		/* queue tail removed */
-              rdy_tail[q] = prev_xp;		/* set new tail */
-	  }
-
-          break;
-      }
-      prev_xp = *xpp;				/* save previous in chain */
+  spinlock_lock(get_cpu_var_ptr(rp->p_cpu, run_q_lock));
+  if (rdy_head[q] == rp || rp->p_prevready) {
+      if (rp->p_prevready)			/* unchain from predecessor */
+          rp->p_prevready->p_nextready = rp->p_nextready;
+      else					/* queue head removed */
+          rdy_head[q] = rp->p_nextready;
+      if (rp->p_nextready)			/* unchain from successor */
+          rp->p_nextready->p_prevready = rp->p_prevready;
+      else					/* queue tail removed */
+          rdy_tail[q] = rp->p_prevready;
+      if (!rdy_head[q])				/* queue is now empty */
+          get_cpu_var(rp->p_cpu, run_q_bitmap) &= ~(1U << q);
+      rp->p_nextready = rp->p_prevready = NULL;
+      get_cpu_var(rp->p_cpu, run_q_len)--;
   }
+  spinlock_unlock(get_cpu_var_ptr(rp->p_cpu, run_q_lock));
 
 	
   /* Process accounting for scheduling */
@@ -1709,25 +2065,28 @@ static struct proc * pick_proc(void)
  * This function always uses the run queues of the local cpu!
  */
   register struct proc *rp;			/* process to run */
-  struct proc **rdy_head;
-  int q;				/* iterate over queues */
+  u32_t bitmap;
+  int q;				/* highest nonempty queue */
 
-  /* Check each of the scheduling queues for ready processes. The number of
-   * queues is defined in proc.h, and priorities are set in the task table.
-   * If there are no processes ready to run, return NULL.
+  /* Every nonempty scheduling queue has its bit set in the run queue bitmap,
+   * so the highest priority ready process heads the queue of the lowest set
+   * bit. The number of queues is defined in proc.h, and priorities are set
+   * in the task table. If there are no processes ready to run, return NULL.
    */
-  rdy_head = get_cpulocal_var(run_q_head);
-  for (q=0; q < NR_SCHED_QUEUES; q++) {	
-	if(!(rp = rdy_head[q])) {
-		TRACE(VF_PICKPROC, printf("cpu %d queue %d empty\n", cpuid, q););
-		continue;
-	}
-	assert(proc_is_runnable(rp));
-	if (priv(rp)->s_flags & BILLABLE)	 	
-		get_cpulocal_var(bill_ptr) = rp; /* bill for system time */
-	return rp;
+  spinlock_lock(get_cpulocal_var_ptr(run_q_lock));
+  if (!(bitmap = get_cpulocal_var(run_q_bitmap))) {
+	spinlock_unlock(get_cpulocal_var_ptr(run_q_lock));
+	TRACE(VF_PICKPROC, printf("cpu %d all queues empty\n", cpuid););
+	return NULL;
   }
-  return NULL;
+  q = __builtin_ctz(bitmap);
+  rp = get_cpulocal_var(run_q_head[q]);
+  spinlock_unlock(get_cpulocal_var_ptr(run_q_lock));
+  assert(rp);
+  assert(proc_is_runnable(rp));
+  if (priv(rp)->s_flags & BILLABLE)	 	
+	get_cpulocal_var(bill_ptr) = rp; /* bill for system time */
+  return rp;
 }
 
 /*===========================================================================*
@@ -1802,6 +2161,7 @@ static void notify_scheduler(struct proc *p)
 	m_no_quantum.SCHEDULING_ACNT_PREEMPT   = p->p_accounting.preempted;
 	m_no_quantum.SCHEDULING_ACNT_CPU       = cpuid;
 	m_no_quantum.SCHEDULING_ACNT_CPU_LOAD  = cpu_load();
+	m_no_quantum.SCHEDULING_ACNT_CPU_QLEN  = get_cpulocal_var(run_q_len);
 
 	/* Reset accounting */
 	reset_proc_accounting(p);
@@ -65,6 +65,10 @@ struct proc {
   u64_t p_kipc_cycles;		/* cycles caused by this proc (ipc) */
 
   struct proc *p_nextready;	/* pointer to next ready process */
+  struct proc *p_prevready;	/* pointer to previous ready process */
+#ifdef CONFIG_SMP
+  atomic_t p_ipc_lock;		/* spinlock serializing IPC with this proc */
+#endif
   struct proc *p_caller_q;	/* head of list of procs wishing to send */
   struct proc *p_q_link;	/* link to next proc wishing to send */
   endpoint_t p_getfrom_e;	/* from whom does process want to receive? */
@@ -169,6 +173,10 @@ struct proc {
 #define proc_ptr_ok(p)		((p)->p_magic == PMAGIC)
 #define proc_used_fpu(p)	((p)->p_misc_flags & (MF_FPU_INITIALIZED))
 
+/* IPC locks of processes, see the big kernel lock in spinlock.h */
+#define proc_lock(p)		spinlock_lock(&(p)->p_ipc_lock)
+#define proc_unlock(p)		spinlock_unlock(&(p)->p_ipc_lock)
+
 /* test whether the process is scheduled by the kernel's default policy  */
 #define proc_kernel_scheduler(p)	((p)->p_scheduler == NULL || \
 					(p)->p_scheduler == (p))
@@ -18,6 +18,8 @@ struct timer;
 clock_t get_uptime(void);
 void set_timer(struct timer *tp, clock_t t, tmr_func_t f);
 void reset_timer(struct timer *tp);
+int tick_stop(void);
+void tick_start(void);
 void ser_dump_proc(void);
 
 void cycles_accounting_init(void);
@@ -29,6 +31,7 @@ void cycles_accounting_init(void);
  * dependent
  */
 void context_stop(struct proc * p);
+void context_stop_ipc(struct proc * p);
 /* this is a wrapper to make calling it from assembly easier */
 void context_stop_idle(void);
 int restore_fpu(struct proc *);
@@ -27,6 +27,66 @@ static volatile unsigned ap_cpus_booted;
 SPINLOCK_DEFINE(big_kernel_lock)
 SPINLOCK_DEFINE(boot_lock)
 
+/* number of cpus holding the big kernel lock shared */
+static volatile atomic_t bkl_readers;
+
+/*
+ * Take the big kernel lock exclusively. The lock word keeps new readers out,
+ * then we wait for the ones already in to leave.
+ */
+void bkl_lock(void)
+{
+	assert(!get_cpulocal_var(bkl_shared));
+
+	spinlock_lock(&big_kernel_lock);
+	while (bkl_readers)
+		arch_pause();
+}
+
+/*
+ * Take the big kernel lock shared. Announce ourselves first and back off if
+ * a writer holds or waits for the lock, so a writer is never starved.
+ */
+void bkl_lock_shared(void)
+{
+	volatile atomic_t * writer = &big_kernel_lock.val;
+
+	for (;;) {
+		while (*writer)
+			arch_pause();
+		arch_atomic_inc((atomic_t *) &bkl_readers);
+		if (!*writer)
+			break;
+		arch_atomic_dec((atomic_t *) &bkl_readers);
+	}
+	get_cpulocal_var(bkl_shared) = 1;
+}
+
+void bkl_unlock(void)
+{
+	if (get_cpulocal_var(bkl_shared)) {
+		get_cpulocal_var(bkl_shared) = 0;
+		arch_atomic_dec((atomic_t *) &bkl_readers);
+	} else
+		spinlock_unlock(&big_kernel_lock);
+}
+
+/*
+ * Trade a shared big kernel lock for an exclusive one. This is done by
+ * dropping the lock first, so the caller must not hold any finer locks and
+ * must expect the world to have changed meanwhile. Like any other exclusive
+ * entry, handle a pending scheduling IPI straight away.
+ */
+void bkl_upgrade(void)
+{
+	if (!get_cpulocal_var(bkl_shared))
+		return;
+
+	bkl_unlock();
+	bkl_lock();
+	smp_sched_handler();
+}
+
 void wait_for_APs_to_finish_booting(void)
 {
 	unsigned n = 0;
@@ -37,7 +37,33 @@ void arch_spinlock_unlock(atomic_t * sl);
 
 #endif /* CONFIG_SMP */
 
-#define BKL_LOCK()	spinlock_lock(&big_kernel_lock)
-#define BKL_UNLOCK()	spinlock_unlock(&big_kernel_lock)
+#ifdef CONFIG_SMP
+/*
+ * The big kernel lock is a reader/writer lock. The common cases of synchronous
+ * IPC hold it shared and serialize on finer locks instead (see proc.c), any
+ * other kernel entry holds it exclusively. The lock order is the big kernel
+ * lock first, then the IPC locks of processes in the order of their slots,
+ * then at most one run queue lock.
+ */
+void arch_atomic_inc(atomic_t * counter);
+void arch_atomic_dec(atomic_t * counter);
+
+void bkl_lock(void);
+void bkl_lock_shared(void);
+void bkl_unlock(void);
+void bkl_upgrade(void);
+
+#define BKL_LOCK()		bkl_lock()
+#define BKL_LOCK_SHARED()	bkl_lock_shared()
+#define BKL_UNLOCK()		bkl_unlock()
+#define BKL_UPGRADE()		bkl_upgrade()
+#define BKL_IS_SHARED()		get_cpulocal_var(bkl_shared)
+#else
+#define BKL_LOCK()
+#define BKL_LOCK_SHARED()
+#define BKL_UNLOCK()
+#define BKL_UPGRADE()
+#define BKL_IS_SHARED()		0
+#endif
 
 #endif /* __SPINLOCK_H__ */
@@ -172,6 +172,27 @@ int do_getinfo(struct proc * caller, message * m_ptr)
         src_vir = (vir_bytes) irq_actids;
         break;
     }
+    case GET_CPULOAD: {
+	static struct cpu_load_info cpu_load_tab[CONFIG_MAX_CPUS];
+	u64_t tsc, since;
+	int i;
+
+	read_tsc_64(&tsc);
+	for (i = 0; i < CONFIG_MAX_CPUS; i++) {
+		cpu_load_tab[i].cl_runq_len = get_cpu_var(i, run_q_len);
+		cpu_load_tab[i].cl_idle_cycles =
+			get_cpu_var(i, idle_proc).p_cycles;
+		/* include the idle period the cpu is in right now */
+		since = get_cpu_var(i, tsc_ctr_switch);
+		if (get_cpu_var(i, cpu_is_idle) && tsc > since)
+			cpu_load_tab[i].cl_idle_cycles += tsc - since;
+		cpu_load_tab[i].cl_tsc = tsc;
+		cpu_load_tab[i].cl_wakeups = get_cpu_var(i, idle_wakeups);
+	}
+        length = sizeof(cpu_load_tab);
+        src_vir = (vir_bytes) cpu_load_tab;
+        break;
+    }
     case GET_IDLETSC: {
 	struct proc * idl;
 	update_idle_time();
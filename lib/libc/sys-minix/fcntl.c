@@ -27,6 +27,7 @@ int fcntl(int fd, int cmd, ...)
      case F_DUPFD:
      case F_SETFD:
      case F_SETFL:
+     case F_SETPIPE_SZ:
 	m.m1_i3 = va_arg(argp, int);
 	break;
      case F_GETLK:
@@ -0,0 +1,21 @@
+#include <sys/cdefs.h>
+#include "namespace.h"
+#include <lib.h>
+
+#include <unistd.h>
+#include <string.h>
+
+/* Set the EDF period and relative deadline of a process, in milliseconds.
+ * A zero period makes the deadline a one-shot one; a zero deadline on a
+ * periodic process makes it equal to the period.
+ */
+int setdeadline(pid_t pid, unsigned int period, unsigned int deadline)
+{
+  message m;
+
+  memset(&m, 0, sizeof(m));
+  m.PM_DL_PID = pid;
+  m.PM_DL_PERIOD = period;
+  m.PM_DL_DEADLINE = deadline;
+  return(_syscall(PM_PROC_NR, SETDEADLINE, &m));
+}
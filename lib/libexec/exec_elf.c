@@ -178,6 +178,36 @@ int libexec_load_elf(struct exec_info *execi)
 		if(first || startv > vaddr) startv = vaddr;
 		first = 0;
 
+		/* If the caller can map the file, and the segment is laid
+		 * out in the file as it is in memory, map its file part
+		 * instead of copying it. Its pages are then shared with
+		 * other processes running the same file, and only read in
+		 * when used. The rest of the segment is zeroed memory.
+		 */
+		if(execi->memmap && ph->p_filesz > 0 &&
+			ph->p_offset % PAGE_SIZE == page_offset) {
+			vir_bytes filebytes, mapbytes;
+			filebytes = page_offset + ph->p_filesz;
+			mapbytes = roundup(filebytes, PAGE_SIZE);
+			if(execi->memmap(execi, vaddr, filebytes,
+				ph->p_offset - page_offset) == OK) {
+				if(mapbytes < seg_membytes &&
+					execi->allocmem_ondemand(execi,
+					vaddr + mapbytes,
+					seg_membytes - mapbytes) != OK) {
+					if(execi->clearproc)
+						execi->clearproc(execi);
+					return ENOMEM;
+				}
+#if ELF_DEBUG
+				printf("mapped 0x%lx-0x%lx\n", vaddr,
+					vaddr+seg_membytes);
+#endif
+				continue;
+			}
+			/* Couldn't map it; copy it after all. */
+		}
+
 		/* make us some memory */
 		if(execi->allocmem_prealloc(execi, vaddr, seg_membytes) != OK) {
 			if(execi->clearproc) execi->clearproc(execi);
@@ -16,6 +16,9 @@ typedef int (*libexec_allocfunc_t)(struct exec_info *execi,
 
 typedef int (*libexec_procclearfunc_t)(struct exec_info *execi);
 
+typedef int (*libexec_mmapfunc_t)(struct exec_info *execi,
+	off_t vaddr, size_t len, off_t foffset);
+
 struct exec_info {
     /* Filled in by libexec caller */
     endpoint_t  proc_e;                 /* Process endpoint */
@@ -36,6 +39,7 @@ struct exec_info {
     libexec_allocfunc_t allocmem_prealloc; /* Alloc callback */
     libexec_allocfunc_t allocmem_ondemand; /* Alloc callback */
     libexec_procclearfunc_t clearproc;	/* Clear process callback */
+    libexec_mmapfunc_t memmap;		/* Map file callback, optional */
     void *opaque;			/* Callback data */
 
     /* Filled in by libexec load function */
@@ -5,6 +5,7 @@
 #include <errno.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <sys/param.h>
 #include <sys/param.h>
@@ -19,30 +20,131 @@
 #define BP_CLEAN        0       /* on-disk block and memory copies identical */
 #define BP_DIRTY        1       /* on-disk block and memory copies differ */
 
-#define BUFHASH(b) ((b) % nr_bufs)
 #define MARKCLEAN  lmfs_markclean
 
 #define MINBUFS 6 	/* minimal no of bufs for sanity check */
 
-static struct buf *front;       /* points to least recently used free block */
-static struct buf *rear;        /* points to most recently used free block */
+/* Replacement follows the 2Q policy. A block enters the A1in queue when it is
+ * first read, and is promoted to the Am queue only if it is asked for again
+ * after it has been evicted from A1in, while its number is still remembered
+ * on the A1out ghost list. A1in is held to a quarter of the buffers, so a
+ * long scan through blocks that are used once cycles through A1in and leaves
+ * the working set on Am alone. Buffers without valid contents are kept apart
+ * on a free queue and are reused first.
+ *
+ * Each queue links its buffers that are not in use, 'front' being the next
+ * to be evicted and 'rear' the most recently used. Buffers in use stay
+ * members of their queue but are off its chain.
+ */
+#define Q_FREE	0	/* no valid contents */
+#define Q_A1IN	1	/* seen once recently */
+#define Q_AM	2	/* seen again after leaving A1in */
+#define Q_SPARE	3	/* not part of the pool, without data */
+#define NR_QUEUES 4
+
+static struct bufqueue {
+  struct buf *front;		/* least recently used buf not in use */
+  struct buf *rear;		/* most recently used buf not in use */
+  unsigned int members;		/* bufs on this queue, in use or not */
+} queue[NR_QUEUES];
+
 static unsigned int bufs_in_use;/* # bufs currently in use (not on free list)*/
+static unsigned int bufs_alloced;/* # bufs holding a data block */
+static unsigned int a1in_max;	/* target size of A1in */
+
+/* The pool grows and shrinks while blocks are in use, so buffers are
+ * allocated in chunks that never move. Shrinking the pool frees the data of
+ * buffers and parks them on the spare queue, for the pool to grow into again.
+ */
+struct bufchunk {
+  struct bufchunk *next;
+  unsigned int count;
+  struct buf *bufs;
+};
+static struct bufchunk *chunks;
+
+#define FOR_EACH_BUF(cp, bp) \
+	for (cp = chunks; cp != NULL; cp = cp->next) \
+		for (bp = &cp->bufs[0]; bp < &cp->bufs[cp->count]; bp++)
+
+/* The pool may take this share of the memory that is free or already ours,
+ * but no more than the file system holds.
+ */
+#define MEM_SHARE	4	/* one in MEM_SHARE */
+#define LMFS_MINBUFS	10	/* smallest pool we resize to */
+static int mem_watch;		/* is VM telling us about free memory? */
+static u32_t kbytes_total_fs;	/* size of the file system */
+
+/* The A1out ghost list remembers the blocks most recently evicted from A1in,
+ * in a ring that overwrites the oldest entry. Entries are hashed like bufs.
+ */
+struct ghost {
+  dev_t g_dev;			/* device, NO_DEV if the entry is unused */
+  block_t g_blocknr;		/* block number on that device */
+  int g_next;			/* next ghost on hash chain, or -1 */
+  int *g_link;			/* link pointing to this ghost */
+};
+
+static struct ghost *ghost;
+static int *ghost_hash;		/* heads of ghost hash chains */
+static unsigned int nr_ghosts;
+static unsigned int ghost_hand;	/* next ring entry to be overwritten */
+
+/* Dirty blocks are written back before they are evicted. Every WB_PERIOD
+ * seconds an alarm lets the file system write back the blocks that have been
+ * dirty for WB_EXPIRE periods or more. When more than WB_BG_RATIO percent of
+ * the buffers are dirty, the oldest are written back after each request, at
+ * most WB_BATCH at a time, until the share is below that again. A writer that
+ * releases a dirty block while more than WB_MAX_RATIO percent are dirty has
+ * to wait until enough of them have been written. Write-back leaves alone
+ * blocks that are in use, as they may be half modified.
+ */
+#define WB_PERIOD	5	/* seconds between write-back alarms */
+#define WB_EXPIRE	6	/* periods a block may stay dirty */
+#define WB_BG_RATIO	10	/* percentage of dirty bufs to start at */
+#define WB_MAX_RATIO	20	/* percentage of dirty bufs to throttle at */
+#define WB_BATCH	(NR_RUNS * NR_IOREQS)	/* most to write per request */
+
+static unsigned int nr_dirty;	/* # bufs marked dirty */
+static unsigned int wb_epoch;	/* # write-back periods passed */
+static int wb_alarm;		/* is the write-back alarm set? */
+
+/* Per-device statistics; devices past the first few are not counted. */
+#define NR_STATDEVS 4
+static struct devstats {
+  dev_t dev;
+  struct lmfs_stats stats;
+} devstats[NR_STATDEVS];
 
 static void rm_lru(struct buf *bp);
 static void read_block(struct buf *);
 static void flushall(dev_t dev);
+static void enqueue(struct buf *bp, int front_end);
+static void unhash(struct buf *bp);
+static void ghost_add(dev_t dev, block_t block);
+static void set_queue(struct buf *bp, int q);
+static struct buf *pick_victim(void);
+static int ghost_take(dev_t dev, block_t block);
+static struct lmfs_stats *stats_of(dev_t dev);
+static struct buf **dirty_list(void);
+static void write_back(unsigned int want, unsigned int max);
 
 static int vmcache = 0; /* are we using vm's secondary cache? (initially not) */
 
-static struct buf *buf;
 static struct buf **buf_hash;   /* the buffer hash table */
-static unsigned int nr_bufs;
+static unsigned int nr_bufs;	/* # bufs in the pool, not counting spares */
+static unsigned int hash_size;	/* # chains in the hash tables */
+static unsigned int hash_shift;	/* 32 - log2 of the hash table size */
 static int may_use_vmcache;
 
 static int fs_block_size = 1024;	/* raw i/o block size */
 
 static int rdwt_err;
 
+/* Hash (dev, block) with a multiplicative hash, keeping the top bits. */
+#define BUFHASH(d, b) \
+	((((u32_t) (b) ^ ((u32_t) (d) * 0x9E3779B1U)) * 0x9E3779B1U) >> hash_shift)
+
 u32_t fs_bufs_heuristic(int minbufs, u32_t btotal, u32_t bfree, 
          int blocksize, dev_t majordev)
 {
@@ -96,12 +198,20 @@ u32_t fs_bufs_heuristic(int minbufs, u32_t btotal, u32_t bfree,
 void
 lmfs_markdirty(struct buf *bp)
 {
+	if (bp->lmfs_dirt == BP_CLEAN) {
+		/* Blocks age from when they were first dirtied. */
+		nr_dirty++;
+		bp->lmfs_dirtied = wb_epoch;
+		if (!wb_alarm && sys_setalarm(WB_PERIOD * sys_hz(), 0) == OK)
+			wb_alarm = TRUE;
+	}
 	bp->lmfs_dirt = BP_DIRTY;
 }
 
 void
 lmfs_markclean(struct buf *bp)
 {
+	if (bp->lmfs_dirt == BP_DIRTY) nr_dirty--;
 	bp->lmfs_dirt = BP_CLEAN;
 }
 
@@ -133,37 +243,39 @@ struct buf *lmfs_get_block(
 {
 /* Check to see if the requested block is in the block cache.  If so, return
  * a pointer to it.  If not, evict some other block and fetch it (unless
- * 'only_search' is 1).  All the blocks in the cache that are not in use
- * are linked together in a chain, with 'front' pointing to the least recently
- * used block and 'rear' to the most recently used block.  If 'only_search' is
+ * 'only_search' is 1).  The block to evict is picked by the 2Q policy
+ * described at the top of this file.  If 'only_search' is
  * 1, the block being requested will be overwritten in its entirety, so it is
  * only necessary to see if it is in the cache; if it is not, any free buffer
  * will do.  It is not necessary to actually read the block in from disk.
  * If 'only_search' is PREFETCH, the block need not be read from the disk,
  * and the device is not to be marked on the block, so callers can tell if
  * the block returned is valid.
- * In addition to the LRU chain, there is also a hash chain to link together
- * blocks whose block numbers end with the same bit strings, for fast lookup.
+ * In addition to the replacement queues, there is also a hash chain to link
+ * together blocks whose device and block numbers hash alike, for fast lookup.
  */
 
   int b;
-  static struct buf *bp, *prev_ptr;
+  static struct buf *bp;
+  struct lmfs_stats *stats;
   u64_t yieldid = VM_BLOCKID_NONE, getid = make64(dev, block);
 
   assert(buf_hash);
-  assert(buf);
+  assert(chunks);
   assert(nr_bufs > 0);
 
   ASSERT(fs_block_size > 0);
 
   assert(dev != NO_DEV);
 
+  stats = stats_of(dev);
+
   /* Search the hash chain for (dev, block). Do_read() can use 
    * lmfs_get_block(NO_DEV ...) to get an unnamed block to fill with zeros when
    * someone wants to read from a hole in a file, in which case this search
    * is skipped
    */
-  b = BUFHASH(block);
+  b = BUFHASH(dev, block);
   bp = buf_hash[b];
   while (bp != NULL) {
   	if (bp->lmfs_blocknr == block && bp->lmfs_dev == dev) {
@@ -174,6 +286,12 @@ struct buf *lmfs_get_block(
   		ASSERT(bp->lmfs_dev == dev);
   		ASSERT(bp->lmfs_dev != NO_DEV);
   		ASSERT(bp->data);
+  		if (stats) stats->ls_hits++;
+  		if (bp->lmfs_ra && only_search != PREFETCH) {
+  			/* Read ahead, and now asked for. */
+  			bp->lmfs_ra = FALSE;
+  			if (stats) stats->ls_ra_hits++;
+  		}
   		return(bp);
   	} else {
   		/* This block is not the one sought. */
@@ -181,22 +299,29 @@ struct buf *lmfs_get_block(
   	}
   }
 
-  /* Desired block is not on available chain.  Take oldest block ('front'). */
-  if ((bp = front) == NULL) panic("all buffers in use: %d", nr_bufs);
+  if (stats) stats->ls_misses++;
+
+  /* Desired block is not in the cache.  Pick a buffer to reuse. */
+  if ((bp = pick_victim()) == NULL) panic("all buffers in use: %d", nr_bufs);
 
   if(bp->lmfs_bytes < fs_block_size) {
 	ASSERT(!bp->data);
 	ASSERT(bp->lmfs_bytes == 0);
 	if(!(bp->data = alloc_contig( (size_t) fs_block_size, 0, NULL))) {
+		int q;
 		printf("fs cache: couldn't allocate a new block.\n");
-		for(bp = front;
-			bp && bp->lmfs_bytes < fs_block_size; bp = bp->lmfs_next)
-			;
+		for(q = 0, bp = NULL; q < Q_SPARE && !bp; q++) {
+			for(bp = queue[q].front;
+			   bp && bp->lmfs_bytes < fs_block_size;
+			   bp = bp->lmfs_next)
+				;
+		}
 		if(!bp) {
 			panic("no buffer available");
 		}
 	} else {
   		bp->lmfs_bytes = fs_block_size;
+		bufs_alloced++;
 	}
   }
 
@@ -208,20 +333,7 @@ struct buf *lmfs_get_block(
   rm_lru(bp);
 
   /* Remove the block that was just taken from its hash chain. */
-  b = BUFHASH(bp->lmfs_blocknr);
-  prev_ptr = buf_hash[b];
-  if (prev_ptr == bp) {
-	buf_hash[b] = bp->lmfs_hash;
-  } else {
-	/* The block just taken is not on the front of its hash chain. */
-	while (prev_ptr->lmfs_hash != NULL)
-		if (prev_ptr->lmfs_hash == bp) {
-			prev_ptr->lmfs_hash = bp->lmfs_hash;	/* found it */
-			break;
-		} else {
-			prev_ptr = prev_ptr->lmfs_hash;	/* keep looking */
-		}
-  }
+  unhash(bp);
 
   /* If the block taken is dirty, make it clean by writing it to the disk.
    * Avoid hysteresis by flushing all other dirty blocks for the same device.
@@ -229,6 +341,16 @@ struct buf *lmfs_get_block(
   if (bp->lmfs_dev != NO_DEV) {
 	if (bp->lmfs_dirt == BP_DIRTY) flushall(bp->lmfs_dev);
 
+	/* Remember blocks that leave A1in; they are promoted when they
+	 * come back soon.
+	 */
+	if (bp->lmfs_queue == Q_A1IN)
+		ghost_add(bp->lmfs_dev, bp->lmfs_blocknr);
+	if ((stats = stats_of(bp->lmfs_dev)) != NULL) {
+		stats->ls_evictions++;
+		if (bp->lmfs_ra) stats->ls_ra_wasted++;
+	}
+
 	/* Are we throwing out a block that contained something?
 	 * Give it to VM for the second-layer cache.
 	 */
@@ -237,13 +359,20 @@ struct buf *lmfs_get_block(
 	bp->lmfs_dev = NO_DEV;
   }
 
+  /* Move the buffer to the queue its new block belongs on. */
+  set_queue(bp, ghost_take(dev, block) ? Q_AM : Q_A1IN);
+
   /* Fill in block's parameters and add it to the hash chain where it goes. */
   MARKCLEAN(bp);		/* NO_DEV blocks may be marked dirty */
+  bp->lmfs_ra = FALSE;
   bp->lmfs_dev = dev;		/* fill in device number */
   bp->lmfs_blocknr = block;	/* fill in block number */
   bp->lmfs_count++;		/* record that block is being used */
-  b = BUFHASH(bp->lmfs_blocknr);
+  b = BUFHASH(bp->lmfs_dev, bp->lmfs_blocknr);
   bp->lmfs_hash = buf_hash[b];
+  if (bp->lmfs_hash != NULL)
+	bp->lmfs_hash->lmfs_hlink = &bp->lmfs_hash;
+  bp->lmfs_hlink = &buf_hash[b];
 
   buf_hash[b] = bp;		/* add to hash list */
 
@@ -294,13 +423,15 @@ register struct buf *bp;	/* pointer to the buffer to be released */
 int block_type;			/* INODE_BLOCK, DIRECTORY_BLOCK, or whatever */
 {
 /* Return a block to the list of available blocks.   Depending on 'block_type'
- * it may be put on the front or rear of the LRU chain.  Blocks that are
+ * it may be put on the front or rear of its queue.  Blocks that are
  * expected to be needed again shortly (e.g., partially full data blocks)
  * go on the rear; blocks that are unlikely to be needed again shortly
  * (e.g., full data blocks) go on the front.  Blocks whose loss can hurt
  * the integrity of the file system (e.g., inode blocks) are written to
  * disk immediately if they are dirty.
  */
+  struct lmfs_stats *stats;
+
   if (bp == NULL) return;	/* it is easier to check here than in caller */
 
   bp->lmfs_count--;		/* there is one use fewer now */
@@ -308,30 +439,27 @@ int block_type;			/* INODE_BLOCK, DIRECTORY_BLOCK, or whatever */
 
   bufs_in_use--;		/* one fewer block buffers in use */
 
-  /* Put this block back on the LRU chain.  */
-  if (bp->lmfs_dev == DEV_RAM || (block_type & ONE_SHOT)) {
-	/* Block probably won't be needed quickly. Put it on front of chain.
-  	 * It will be the next block to be evicted from the cache.
-  	 */
-	bp->lmfs_prev = NULL;
-	bp->lmfs_next = front;
-	if (front == NULL)
-		rear = bp;	/* LRU chain was empty */
-	else
-		front->lmfs_prev = bp;
-	front = bp;
-  } 
-  else {
-	/* Block probably will be needed quickly.  Put it on rear of chain.
-  	 * It will not be evicted from the cache for a long time.
-  	 */
-	bp->lmfs_prev = rear;
-	bp->lmfs_next = NULL;
-	if (rear == NULL)
-		front = bp;
-	else
-		rear->lmfs_next = bp;
-	rear = bp;
+  if (bp->lmfs_dev == NO_DEV) {
+	/* Prefetched but never read, or invalidated. Nothing to keep. */
+	unhash(bp);
+	set_queue(bp, Q_FREE);
+	enqueue(bp, TRUE);
+	return;
+  }
+
+  /* Put this block back on its queue.  Blocks that probably won't be needed
+   * quickly go on the front, to be the next evicted from the cache.  Other
+   * blocks go on the rear and will not be evicted for a long time.
+   */
+  enqueue(bp, bp->lmfs_dev == DEV_RAM || (block_type & ONE_SHOT));
+
+  /* A writer that dirties blocks faster than they can be written waits
+   * here until the dirty share is back to where write-back starts.
+   */
+  if (bp->lmfs_dirt == BP_DIRTY &&
+      nr_dirty > nr_bufs * WB_MAX_RATIO / 100) {
+	if ((stats = stats_of(bp->lmfs_dev)) != NULL) stats->ls_throttled++;
+	write_back(nr_dirty - nr_bufs * WB_BG_RATIO / 100, nr_bufs);
   }
 }
 
@@ -384,9 +512,31 @@ void lmfs_invalidate(
 /* Remove all the blocks belonging to some device from the cache. */
 
   register struct buf *bp;
+  struct bufchunk *cp;
+  unsigned int i;
 
-  for (bp = &buf[0]; bp < &buf[nr_bufs]; bp++)
-	if (bp->lmfs_dev == device) bp->lmfs_dev = NO_DEV;
+  FOR_EACH_BUF(cp, bp) {
+	if (bp->lmfs_dev != device) continue;
+	bp->lmfs_dev = NO_DEV;
+	MARKCLEAN(bp);
+
+	/* Blocks in use are moved when they are put back. */
+	if (bp->lmfs_count != 0) continue;
+	rm_lru(bp);
+	bufs_in_use--;
+	unhash(bp);
+	set_queue(bp, Q_FREE);
+	enqueue(bp, TRUE);
+  }
+
+  for (i = 0; i < nr_ghosts; i++) {
+	if (ghost[i].g_dev == device) {
+		*ghost[i].g_link = ghost[i].g_next;
+		if (ghost[i].g_next >= 0)
+			ghost[ghost[i].g_next].g_link = ghost[i].g_link;
+		ghost[i].g_dev = NO_DEV;
+	}
+  }
 
   vm_forgetblocks();
 }
@@ -399,9 +549,29 @@ static void flushall(dev_t dev)
 /* Flush all dirty blocks for one device. */
 
   register struct buf *bp;
+  struct bufchunk *cp;
+  struct buf **dirty;
+  int ndirty;
+
+  dirty = dirty_list();
+  ndirty = 0;
+  FOR_EACH_BUF(cp, bp) {
+       if (bp->lmfs_dirt == BP_DIRTY && bp->lmfs_dev == dev) {
+               dirty[ndirty++] = bp;
+       }
+  }
+
+  lmfs_rw_scattered(dev, dirty, ndirty, WRITING);
+}
+
+/*===========================================================================*
+ *				dirty_list				     *
+ *===========================================================================*/
+static struct buf **dirty_list(void)
+{
+/* Return a list large enough to hold all bufs in the pool. */
   static struct buf **dirty;	/* static so it isn't on stack */
   static unsigned int dirtylistsize = 0;
-  int ndirty;
 
   if(dirtylistsize != nr_bufs) {
 	if(dirtylistsize > 0) {
@@ -413,13 +583,28 @@ static void flushall(dev_t dev)
 	dirtylistsize = nr_bufs;
   }
 
-  for (bp = &buf[0], ndirty = 0; bp < &buf[nr_bufs]; bp++) {
-       if (bp->lmfs_dirt == BP_DIRTY && bp->lmfs_dev == dev) {
-               dirty[ndirty++] = bp;
-       }
-  }
+  return dirty;
+}
 
-  lmfs_rw_scattered(dev, dirty, ndirty, WRITING);
+/* lmfs_rw_scattered() splits its buffers into runs of consecutive blocks, and
+ * keeps up to this many of them in flight at the driver at once.
+ */
+#define NR_RUNS		8
+
+struct run {
+  bdev_id_t id;			/* asynchronous call, or negative if none */
+  int count;			/* number of buffers in the run */
+  ssize_t result;		/* bytes transferred, or error */
+};
+
+/*===========================================================================*
+ *				rw_done					     *
+ *===========================================================================*/
+static void rw_done(dev_t dev, bdev_id_t id, bdev_param_t param, int result)
+{
+/* An asynchronous transfer of a run has completed. */
+
+  ((struct run *) param)->result = result;
 }
 
 /*===========================================================================*
@@ -439,8 +624,11 @@ void lmfs_rw_scattered(
   register int i;
   register iovec_t *iop;
   static iovec_t *iovec = NULL;
+  static struct run runs[NR_RUNS];
+  struct run *rp;
   u64_t pos;
-  int j, r;
+  int j, k, n, left, r;
+  ssize_t res;
 
   STATICINIT(iovec, NR_IOREQS);
 
@@ -462,59 +650,92 @@ void lmfs_rw_scattered(
 	}
   }
 
-  /* Set up I/O vector and do I/O.  The result of bdev I/O is OK if everything
-   * went fine, otherwise the error code for the first failed transfer.
-   */
   while (bufqsize > 0) {
-	for (j = 0, iop = iovec; j < NR_IOREQS && j < bufqsize; j++, iop++) {
-		bp = bufq[j];
-		if (bp->lmfs_blocknr != (block_t) bufq[0]->lmfs_blocknr + j) break;
-		iop->iov_addr = (vir_bytes) bp->data;
-		iop->iov_size = (vir_bytes) fs_block_size;
+	/* Set up an I/O vector for each run of consecutive blocks and start
+	 * the transfers asynchronously, so that the driver can work on all of
+	 * them at once. libbdev copies the vector, so it can be reused. If no
+	 * asynchronous call can be made, the run is transferred right away.
+	 */
+	for (n = 0, k = 0; n < NR_RUNS && k < bufqsize; n++, k += j) {
+		for (j = 0, iop = iovec; j < NR_IOREQS && k + j < bufqsize;
+		     j++, iop++) {
+			bp = bufq[k + j];
+			if (bp->lmfs_blocknr != (block_t) bufq[k]->lmfs_blocknr + j) break;
+			iop->iov_addr = (vir_bytes) bp->data;
+			iop->iov_size = (vir_bytes) fs_block_size;
+		}
+		pos = mul64u(bufq[k]->lmfs_blocknr, fs_block_size);
+
+		rp = &runs[n];
+		rp->count = j;
+		rp->result = EIO;
+		if (rw_flag == READING)
+			rp->id = bdev_gather_asyn(dev, pos, iovec, j,
+				BDEV_NOFLAGS, rw_done, (bdev_param_t) rp);
+		else
+			rp->id = bdev_scatter_asyn(dev, pos, iovec, j,
+				BDEV_NOFLAGS, rw_done, (bdev_param_t) rp);
+
+		if (rp->id < 0) {
+			if (rw_flag == READING)
+				rp->result = bdev_gather(dev, pos, iovec, j,
+					BDEV_NOFLAGS);
+			else
+				rp->result = bdev_scatter(dev, pos, iovec, j,
+					BDEV_NOFLAGS);
+		}
+	}
+
+	/* Wait for all of them. Replies may come in in any order. */
+	for (i = 0; i < n; i++) {
+		if (runs[i].id >= 0 && (r = bdev_wait_asyn(runs[i].id)) != OK &&
+		    r != ENOENT)
+			runs[i].result = r;
 	}
-	pos = mul64u(bufq[0]->lmfs_blocknr, fs_block_size);
-	if (rw_flag == READING)
-		r = bdev_gather(dev, pos, iovec, j, BDEV_NOFLAGS);
-	else
-		r = bdev_scatter(dev, pos, iovec, j, BDEV_NOFLAGS);
 
 	/* Harvest the results.  The driver may have returned an error, or it
-	 * may have done less than what we asked for.
+	 * may have done less than what we asked for.  Buffers that were not
+	 * read are released, buffers that were not written are kept at the
+	 * front of bufq, to be tried again.
 	 */
-	if (r < 0) {
-		printf("fs cache: I/O error %d on device %d/%d, block %u\n",
-			r, major(dev), minor(dev), bufq[0]->lmfs_blocknr);
-	}
-	for (i = 0; i < j; i++) {
-		bp = bufq[i];
-		if (r < (ssize_t) fs_block_size) {
-			/* Transfer failed. */
-			if (i == 0) {
-				bp->lmfs_dev = NO_DEV;	/* Invalidate block */
-				vm_forgetblocks();
-			}
-			break;
+	for (rp = runs, k = 0, left = 0; rp < &runs[n]; k += rp->count, rp++) {
+		res = rp->result;
+		if (res < 0) {
+			printf("fs cache: I/O error %d on device %d/%d, block %u\n",
+				(int) res, major(dev), minor(dev),
+				bufq[k]->lmfs_blocknr);
 		}
-		if (rw_flag == READING) {
-			bp->lmfs_dev = dev;	/* validate block */
-			lmfs_put_block(bp, PARTIAL_DATA_BLOCK);
-		} else {
-			MARKCLEAN(bp);
+		for (i = 0; i < rp->count; i++) {
+			bp = bufq[k + i];
+			if (res < (ssize_t) fs_block_size) {
+				/* Transfer failed. */
+				if (i == 0) {
+					bp->lmfs_dev = NO_DEV;	/* Invalidate block */
+					vm_forgetblocks();
+				}
+				break;
+			}
+			if (rw_flag == READING) {
+				bp->lmfs_dev = dev;	/* validate block */
+				lmfs_put_block(bp, PARTIAL_DATA_BLOCK);
+			} else {
+				MARKCLEAN(bp);
+			}
+			res -= fs_block_size;
 		}
-		r -= fs_block_size;
-	}
-	bufq += i;
-	bufqsize -= i;
-	if (rw_flag == READING) {
-		/* Don't bother reading more than the device is willing to
-		 * give at this time.  Don't forget to release those extras.
-		 */
-		while (bufqsize > 0) {
-			lmfs_put_block(*bufq++, PARTIAL_DATA_BLOCK);
-			bufqsize--;
+		for (; i < rp->count; i++) {
+			/* Don't bother reading more than the device is
+			 * willing to give at this time.  Don't forget to
+			 * release those extras.
+			 */
+			if (rw_flag == READING)
+				lmfs_put_block(bufq[k + i], PARTIAL_DATA_BLOCK);
+			else
+				bufq[left++] = bufq[k + i];
 		}
 	}
-	if (rw_flag == WRITING && i == 0) {
+
+	if (rw_flag == WRITING && left == k) {
 		/* We're not making progress, this means we might keep
 		 * looping. Buffers remain dirty if un-written. Buffers are
 		 * lost if invalidate()d or LRU-removed while dirty. This
@@ -522,7 +743,138 @@ void lmfs_rw_scattered(
 		 */
 		break;
 	}
+
+	/* Move the buffers that were not part of these runs up. */
+	for (i = k; i < bufqsize; i++)
+		bufq[left++] = bufq[i];
+	bufqsize = left;
+  }
+}
+
+/*===========================================================================*
+ *				lmfs_readahead				     *
+ *===========================================================================*/
+void lmfs_readahead(
+  dev_t dev,			/* major-minor device number */
+  struct buf **bufq,		/* buffers acquired with PREFETCH */
+  int bufqsize,			/* number of buffers */
+  int wanted			/* number of leading buffers asked for */
+)
+{
+/* Read a batch of blocks, of which only the first 'wanted' ones are asked for
+ * right now. The others are read ahead; they are counted as hits when they
+ * are asked for later, and as wasted when they are evicted before that.
+ */
+  struct lmfs_stats *stats;
+  int i;
+
+  stats = stats_of(dev);
+  for (i = wanted; i < bufqsize; i++) {
+	bufq[i]->lmfs_ra = TRUE;
+	if (stats) stats->ls_ra_blocks++;
   }
+
+  lmfs_rw_scattered(dev, bufq, bufqsize, READING);
+}
+
+/*===========================================================================*
+ *				write_back				     *
+ *===========================================================================*/
+static void write_back(
+  unsigned int want,		/* number of blocks to write at least */
+  unsigned int max		/* number of blocks to write at most */
+)
+{
+/* Write back the dirty blocks not in use that have expired, and more of the
+ * oldest ones until 'want' of them are written, but no more than 'max'.
+ * Blocks of the same age are written in no particular order.
+ */
+  struct buf *bp, **dirty;
+  struct bufchunk *cp;
+  struct lmfs_stats *stats;
+  unsigned int age, cutoff, count[WB_EXPIRE + 1];
+  unsigned int i, j, k, n, done;
+  dev_t dev;
+
+  /* Count the candidates by age, and find the youngest age to write. */
+  memset(count, 0, sizeof(count));
+  FOR_EACH_BUF(cp, bp) {
+	if (bp->lmfs_dirt != BP_DIRTY || bp->lmfs_dev == NO_DEV ||
+	    bp->lmfs_count != 0)
+		continue;
+	count[MIN(wb_epoch - bp->lmfs_dirtied, WB_EXPIRE)]++;
+  }
+  for (cutoff = WB_EXPIRE, n = count[WB_EXPIRE]; cutoff > 0 && n < want; )
+	n += count[--cutoff];
+  if (n == 0) return;
+
+  dirty = dirty_list();
+  n = 0;
+  FOR_EACH_BUF(cp, bp) {
+	if (n >= max) break;
+	if (bp->lmfs_dirt != BP_DIRTY || bp->lmfs_dev == NO_DEV ||
+	    bp->lmfs_count != 0)
+		continue;
+	age = wb_epoch - bp->lmfs_dirtied;
+	if (age >= cutoff) dirty[n++] = bp;
+  }
+
+  /* Write them one device at a time; lmfs_rw_scattered() sorts each batch
+   * on block number.
+   */
+  for (i = 0; i < n; i = k) {
+	dev = dirty[i]->lmfs_dev;
+	for (j = k = i + 1; j < n; j++) {
+		if (dirty[j]->lmfs_dev != dev) continue;
+		bp = dirty[k];
+		dirty[k++] = dirty[j];
+		dirty[j] = bp;
+	}
+
+	lmfs_rw_scattered(dev, &dirty[i], k - i, WRITING);
+
+	if ((stats = stats_of(dev)) != NULL) {
+		for (j = i, done = 0; j < k; j++)
+			if (dirty[j]->lmfs_dirt == BP_CLEAN) done++;
+		stats->ls_wb_blocks += done;
+	}
+  }
+}
+
+/*===========================================================================*
+ *				lmfs_writeback				     *
+ *===========================================================================*/
+void lmfs_writeback(void)
+{
+/* The file system calls this after replying to a request. If too many blocks
+ * are dirty, write back a batch of the oldest ones.
+ */
+  unsigned int limit;
+
+  limit = nr_bufs * WB_BG_RATIO / 100;
+  if (nr_dirty <= limit) return;
+
+  write_back(nr_dirty - limit, WB_BATCH);
+}
+
+/*===========================================================================*
+ *				lmfs_alarm				     *
+ *===========================================================================*/
+void lmfs_alarm(void)
+{
+/* The file system calls this when the alarm set for write-back goes off.
+ * Another period has passed; write back the blocks that have expired.
+ */
+  unsigned int limit;
+
+  wb_alarm = FALSE;
+  wb_epoch++;
+
+  limit = nr_bufs * WB_BG_RATIO / 100;
+  write_back(nr_dirty > limit ? nr_dirty - limit : 0, nr_bufs);
+
+  if (nr_dirty > 0 && sys_setalarm(WB_PERIOD * sys_hz(), 0) == OK)
+	wb_alarm = TRUE;
 }
 
 /*===========================================================================*
@@ -531,7 +883,8 @@ void lmfs_rw_scattered(
 static void rm_lru(bp)
 struct buf *bp;
 {
-/* Remove a block from its LRU chain. */
+/* Remove a block from the chain of its queue. */
+  struct bufqueue *qp = &queue[(int) bp->lmfs_queue];
   struct buf *next_ptr, *prev_ptr;
 
   bufs_in_use++;
@@ -540,12 +893,184 @@ struct buf *bp;
   if (prev_ptr != NULL)
 	prev_ptr->lmfs_next = next_ptr;
   else
-	front = next_ptr;	/* this block was at front of chain */
+	qp->front = next_ptr;	/* this block was at front of chain */
 
   if (next_ptr != NULL)
 	next_ptr->lmfs_prev = prev_ptr;
   else
-	rear = prev_ptr;	/* this block was at rear of chain */
+	qp->rear = prev_ptr;	/* this block was at rear of chain */
+}
+
+/*===========================================================================*
+ *				enqueue					     *
+ *===========================================================================*/
+static void enqueue(bp, front_end)
+struct buf *bp;
+int front_end;			/* put the block up for eviction first? */
+{
+/* Put a block that is no longer in use on the chain of its queue. */
+  struct bufqueue *qp = &queue[(int) bp->lmfs_queue];
+
+  if (front_end) {
+	bp->lmfs_prev = NULL;
+	bp->lmfs_next = qp->front;
+	if (qp->front == NULL)
+		qp->rear = bp;		/* chain was empty */
+	else
+		qp->front->lmfs_prev = bp;
+	qp->front = bp;
+  } else {
+	bp->lmfs_prev = qp->rear;
+	bp->lmfs_next = NULL;
+	if (qp->rear == NULL)
+		qp->front = bp;		/* chain was empty */
+	else
+		qp->rear->lmfs_next = bp;
+	qp->rear = bp;
+  }
+}
+
+/*===========================================================================*
+ *				unhash					     *
+ *===========================================================================*/
+static void unhash(bp)
+struct buf *bp;
+{
+/* Take a block off its hash chain, if it is on one. */
+  if (bp->lmfs_hlink == NULL) return;
+
+  *bp->lmfs_hlink = bp->lmfs_hash;
+  if (bp->lmfs_hash != NULL)
+	bp->lmfs_hash->lmfs_hlink = bp->lmfs_hlink;
+  bp->lmfs_hash = NULL;
+  bp->lmfs_hlink = NULL;
+}
+
+/*===========================================================================*
+ *				set_queue				     *
+ *===========================================================================*/
+static void set_queue(struct buf *bp, int q)
+{
+/* Make a buffer that is off its chain a member of another queue. */
+  queue[(int) bp->lmfs_queue].members--;
+  bp->lmfs_queue = q;
+  queue[q].members++;
+}
+
+/*===========================================================================*
+ *				pick_victim				     *
+ *===========================================================================*/
+static struct buf *pick_victim(void)
+{
+/* Return the buffer to reuse next, or NULL if all are in use.  Take a buffer
+ * without contents if there is one.  Otherwise evict the oldest block of A1in
+ * if that queue has outgrown its share, and the least recently used block of
+ * Am if not.
+ */
+  struct buf *bp;
+
+  if ((bp = queue[Q_FREE].front) == NULL) {
+	if (queue[Q_A1IN].members > a1in_max || queue[Q_AM].front == NULL)
+		bp = queue[Q_A1IN].front;
+	if (bp == NULL)
+		bp = queue[Q_AM].front;
+  }
+
+  return bp;
+}
+
+/*===========================================================================*
+ *				ghost_add				     *
+ *===========================================================================*/
+static void ghost_add(dev_t dev, block_t block)
+{
+/* Remember a block evicted from A1in, forgetting the oldest one remembered. */
+  struct ghost *gp;
+  int b, g;
+
+  if (nr_ghosts == 0) return;
+
+  g = ghost_hand;
+  ghost_hand = (ghost_hand + 1) % nr_ghosts;
+  gp = &ghost[g];
+
+  if (gp->g_dev != NO_DEV) {
+	*gp->g_link = gp->g_next;
+	if (gp->g_next >= 0)
+		ghost[gp->g_next].g_link = gp->g_link;
+  }
+
+  gp->g_dev = dev;
+  gp->g_blocknr = block;
+  b = BUFHASH(dev, block);
+  gp->g_next = ghost_hash[b];
+  if (gp->g_next >= 0)
+	ghost[gp->g_next].g_link = &gp->g_next;
+  gp->g_link = &ghost_hash[b];
+  ghost_hash[b] = g;
+}
+
+/*===========================================================================*
+ *				ghost_take				     *
+ *===========================================================================*/
+static int ghost_take(dev_t dev, block_t block)
+{
+/* Return TRUE and forget the block if it was recently evicted from A1in. */
+  struct ghost *gp;
+  int g;
+
+  if (nr_ghosts == 0) return FALSE;
+
+  for (g = ghost_hash[BUFHASH(dev, block)]; g >= 0; g = gp->g_next) {
+	gp = &ghost[g];
+	if (gp->g_blocknr == block && gp->g_dev == dev) {
+		*gp->g_link = gp->g_next;
+		if (gp->g_next >= 0)
+			ghost[gp->g_next].g_link = gp->g_link;
+		gp->g_dev = NO_DEV;
+		return TRUE;
+	}
+  }
+
+  return FALSE;
+}
+
+/*===========================================================================*
+ *				stats_of				     *
+ *===========================================================================*/
+static struct lmfs_stats *stats_of(dev_t dev)
+{
+/* Return the statistics of a device, or NULL if there is no room for them. */
+  int i;
+
+  for (i = 0; i < NR_STATDEVS; i++) {
+	if (devstats[i].dev == dev)
+		return &devstats[i].stats;
+	if (devstats[i].dev == NO_DEV) {
+		devstats[i].dev = dev;
+		return &devstats[i].stats;
+	}
+  }
+
+  return NULL;
+}
+
+/*===========================================================================*
+ *				lmfs_get_stats				     *
+ *===========================================================================*/
+int lmfs_get_stats(dev_t dev, struct lmfs_stats *stats)
+{
+/* Report the block cache statistics of a device. */
+  int i;
+
+  for (i = 0; i < NR_STATDEVS && devstats[i].dev != NO_DEV; i++) {
+	if (devstats[i].dev == dev) {
+		*stats = devstats[i].stats;
+		return OK;
+	}
+  }
+
+  return ENOENT;
 }
 
 /*===========================================================================*
@@ -554,11 +1079,12 @@ struct buf *bp;
 static void cache_resize(unsigned int blocksize, unsigned int bufs)
 {
   struct buf *bp;
+  struct bufchunk *cp;
 
   assert(blocksize > 0);
   assert(bufs >= MINBUFS);
 
-  for (bp = &buf[0]; bp < &buf[nr_bufs]; bp++)
+  FOR_EACH_BUF(cp, bp)
 	if(bp->lmfs_count != 0) panic("change blocksize with buffer in use");
 
   lmfs_buf_pool(bufs);
@@ -578,7 +1104,7 @@ void lmfs_set_blocksize(int new_block_size, int major)
 
   fs_blockstats(&btotal, &bfree, &bused);
 
-  bufs = fs_bufs_heuristic(10, btotal, bfree,
+  bufs = fs_bufs_heuristic(LMFS_MINBUFS, btotal, bfree,
         new_block_size, major);
 
   cache_resize(new_block_size, bufs);
@@ -595,6 +1121,173 @@ void lmfs_set_blocksize(int new_block_size, int major)
   	may_use_vmcache && major != MEMORY_MAJOR) {
 	vmcache = 1;
   }
+
+  /* Let the pool follow free memory from now on, unless we are a memory
+   * device. Buffers only take memory once they are used, so the pool may
+   * start out as large as memory allows.
+   */
+  kbytes_total_fs = div64u(mul64u(btotal, new_block_size), 1024);
+  mem_watch = (major != MEMORY_MAJOR && vm_watch_memory(TRUE) == OK);
+  lmfs_adjust_bufs();
+}
+
+/*===========================================================================*
+ *				hash_resize				     *
+ *===========================================================================*/
+static void hash_resize(void)
+{
+/* Size the hash tables to the pool, and rehash the buffers. This is only done
+ * between requests, when buffers that are hashed hold valid blocks. The ghost
+ * list is sized to half the pool and starts out empty.
+ */
+  struct buf *bp, **old_hash = buf_hash;
+  struct bufchunk *cp;
+  unsigned int i, b;
+
+  /* The hash tables have a power of two of chains, at least one per buf. */
+  for (hash_shift = 32, hash_size = 1; hash_size < nr_bufs;
+	hash_shift--, hash_size <<= 1)
+	;
+
+  if(!(buf_hash = calloc(sizeof(buf_hash[0]), hash_size)))
+	panic("couldn't allocate buf hash list (%d)", hash_size);
+
+  FOR_EACH_BUF(cp, bp) {
+	if (bp->lmfs_hlink == NULL) continue;
+	b = BUFHASH(bp->lmfs_dev, bp->lmfs_blocknr);
+	bp->lmfs_hash = buf_hash[b];
+	if (bp->lmfs_hash != NULL)
+		bp->lmfs_hash->lmfs_hlink = &bp->lmfs_hash;
+	bp->lmfs_hlink = &buf_hash[b];
+	buf_hash[b] = bp;
+  }
+
+  if(old_hash)
+	free(old_hash);
+
+  if(ghost)
+	free(ghost);
+  if(ghost_hash)
+	free(ghost_hash);
+  nr_ghosts = nr_bufs / 2;
+  if(!(ghost = calloc(sizeof(ghost[0]), nr_ghosts)) ||
+	!(ghost_hash = malloc(sizeof(ghost_hash[0]) * hash_size)))
+	panic("couldn't allocate ghost list (%d)", nr_ghosts);
+  for (i = 0; i < nr_ghosts; i++)
+	ghost[i].g_dev = NO_DEV;
+  for (i = 0; i < hash_size; i++)
+	ghost_hash[i] = -1;
+  ghost_hand = 0;
+
+  a1in_max = MAX(nr_bufs / 4, 1);
+}
+
+/*===========================================================================*
+ *				pool_grow				     *
+ *===========================================================================*/
+static void pool_grow(unsigned int bufs)
+{
+/* Grow the pool to 'bufs' buffers, taking spares first. */
+  struct bufchunk *cp;
+  struct buf *bp;
+  unsigned int n;
+
+  while (nr_bufs < bufs && (bp = queue[Q_SPARE].front) != NULL) {
+	rm_lru(bp);
+	bufs_in_use--;
+	set_queue(bp, Q_FREE);
+	enqueue(bp, FALSE);
+	nr_bufs++;
+  }
+
+  if (nr_bufs >= bufs) return;
+
+  n = bufs - nr_bufs;
+  if(!(cp = malloc(sizeof(*cp))) || !(cp->bufs = calloc(sizeof(cp->bufs[0]), n)))
+	panic("couldn't allocate buf list (%d)", n);
+  cp->count = n;
+  cp->next = chunks;
+  chunks = cp;
+
+  for (bp = &cp->bufs[0]; bp < &cp->bufs[n]; bp++) {
+        bp->lmfs_blocknr = NO_BLOCK;
+        bp->lmfs_dev = NO_DEV;
+        bp->lmfs_hash = NULL;
+        bp->lmfs_hlink = NULL;
+        bp->lmfs_queue = Q_FREE;
+        bp->data = NULL;
+        bp->lmfs_bytes = 0;
+        queue[Q_FREE].members++;
+        enqueue(bp, FALSE);
+  }
+  nr_bufs += n;
+}
+
+/*===========================================================================*
+ *				pool_shrink				     *
+ *===========================================================================*/
+static void pool_shrink(unsigned int bufs)
+{
+/* Shrink the pool towards 'bufs' buffers, evicting blocks in the usual order
+ * and freeing their memory.  Buffers in use are left alone.
+ */
+  struct buf *bp;
+  struct lmfs_stats *stats;
+
+  while (nr_bufs > bufs && (bp = pick_victim()) != NULL) {
+	rm_lru(bp);
+	bufs_in_use--;
+	if (bp->lmfs_dev != NO_DEV && bp->lmfs_dirt == BP_DIRTY)
+		flushall(bp->lmfs_dev);
+	if (bp->lmfs_dev != NO_DEV && bp->lmfs_ra &&
+	    (stats = stats_of(bp->lmfs_dev)) != NULL)
+		stats->ls_ra_wasted++;
+	bp->lmfs_ra = FALSE;
+	unhash(bp);
+	if (bp->data) {
+		free_contig(bp->data, bp->lmfs_bytes);
+		bp->data = NULL;
+		bp->lmfs_bytes = 0;
+		bufs_alloced--;
+	}
+	bp->lmfs_dev = NO_DEV;
+	bp->lmfs_blocknr = NO_BLOCK;
+	set_queue(bp, Q_SPARE);
+	enqueue(bp, FALSE);
+	nr_bufs--;
+  }
+}
+
+/*===========================================================================*
+ *				lmfs_adjust_bufs			     *
+ *===========================================================================*/
+void lmfs_adjust_bufs(void)
+{
+/* Resize the pool to the memory VM reports free. The file system calls this
+ * whenever VM notifies it, between requests.
+ */
+  struct vm_stats_info vsi;
+  u32_t kbytes_avail, kbytes;
+  unsigned int bufs;
+
+  if (!mem_watch || nr_bufs == 0 || vm_info_stats(&vsi) != OK)
+	return;
+
+  /* Count the memory we hold ourselves as available. */
+  kbytes_avail = div64u(mul64u(vsi.vsi_free, vsi.vsi_pagesize), 1024) +
+	div64u(mul64u(bufs_alloced, fs_block_size), 1024);
+  kbytes = MIN(kbytes_avail / MEM_SHARE, kbytes_total_fs);
+  bufs = MAX(kbytes / (fs_block_size / 1024), LMFS_MINBUFS);
+
+  /* Leave small differences be. */
+  if (bufs < nr_bufs + nr_bufs / 8 && bufs + nr_bufs / 8 > nr_bufs)
+	return;
+
+  if (bufs > nr_bufs)
+	pool_grow(bufs);
+  else
+	pool_shrink(bufs);
+  hash_resize();
 }
 
 /*===========================================================================*
@@ -604,13 +1297,14 @@ void lmfs_buf_pool(int new_nr_bufs)
 {
 /* Initialize the buffer pool. */
   register struct buf *bp;
+  struct bufchunk *cp;
+  unsigned int i;
 
   assert(new_nr_bufs >= MINBUFS);
 
-  if(nr_bufs > 0) {
-	assert(buf);
+  if(chunks) {
 	(void) fs_sync();
-  	for (bp = &buf[0]; bp < &buf[nr_bufs]; bp++) {
+	FOR_EACH_BUF(cp, bp) {
 		if(bp->data) {
 			assert(bp->lmfs_bytes > 0);
 			free_contig(bp->data, bp->lmfs_bytes);
@@ -618,36 +1312,26 @@ void lmfs_buf_pool(int new_nr_bufs)
 	}
   }
 
-  if(buf)
-	free(buf);
-
-  if(!(buf = calloc(sizeof(buf[0]), new_nr_bufs)))
-	panic("couldn't allocate buf list (%d)", new_nr_bufs);
-
-  if(buf_hash)
-	free(buf_hash);
-  if(!(buf_hash = calloc(sizeof(buf_hash[0]), new_nr_bufs)))
-	panic("couldn't allocate buf hash list (%d)", new_nr_bufs);
-
-  nr_bufs = new_nr_bufs;
+  while ((cp = chunks) != NULL) {
+	chunks = cp->next;
+	free(cp->bufs);
+	free(cp);
+  }
 
+  nr_bufs = 0;
   bufs_in_use = 0;
-  front = &buf[0];
-  rear = &buf[nr_bufs - 1];
+  bufs_alloced = 0;
+  nr_dirty = 0;
+  memset(queue, 0, sizeof(queue));
 
-  for (bp = &buf[0]; bp < &buf[nr_bufs]; bp++) {
-        bp->lmfs_blocknr = NO_BLOCK;
-        bp->lmfs_dev = NO_DEV;
-        bp->lmfs_next = bp + 1;
-        bp->lmfs_prev = bp - 1;
-        bp->data = NULL;
-        bp->lmfs_bytes = 0;
-  }
-  front->lmfs_prev = NULL;
-  rear->lmfs_next = NULL;
+  /* All buffers start out on the free queue. */
+  pool_grow(new_nr_bufs);
+  hash_resize();
 
-  for (bp = &buf[0]; bp < &buf[nr_bufs]; bp++) bp->lmfs_hash = bp->lmfs_next;
-  buf_hash[0] = front;
+  for (i = 0; i < NR_STATDEVS; i++) {
+	devstats[i].dev = NO_DEV;
+	memset(&devstats[i].stats, 0, sizeof(devstats[i].stats));
+  }
 
   vm_forgetblocks();
 }
@@ -662,10 +1346,16 @@ int lmfs_nr_bufs(void)
 	return nr_bufs;
 }
 
+int lmfs_nr_dirty(void)
+{
+	return nr_dirty;
+}
+
 void lmfs_flushall(void)
 {
 	struct buf *bp;
-	for(bp = &buf[0]; bp < &buf[nr_bufs]; bp++)
+	struct bufchunk *cp;
+	FOR_EACH_BUF(cp, bp)
 		if(bp->lmfs_dev != NO_DEV && bp->lmfs_dirt == BP_DIRTY) 
 			flushall(bp->lmfs_dev);
 }
@@ -0,0 +1,104 @@
+/* This file contains the sequential stream detector that drives read-ahead in
+ * the file systems using libminixfs. Each file being read has a struct
+ * lmfs_ra that remembers where a sequential reader would continue, and how
+ * far ahead of it blocks have been read. Every read that picks up where the
+ * previous one stopped counts as sequential; the first read of a stream gets
+ * a window of RA_MIN blocks, which doubles each time a read-ahead is issued,
+ * up to RA_MAX blocks or a share of the cache. Any other read collapses the
+ * window, so that random access only reads what it asks for.
+ *
+ * Read-ahead is issued both on a cache miss, by the read itself, and after
+ * the reply to a read, once the reader has consumed half of what was read
+ * ahead, so that the next blocks arrive before they are asked for.
+ *
+ * The entry points into this file are
+ *   lmfs_ra_init:	reset the read-ahead state of a file
+ *   lmfs_ra_read:	account for a read, return the read-ahead window
+ *   lmfs_ra_async:	tell if and where to read ahead after a read
+ *   lmfs_ra_issued:	account for blocks read ahead
+ */
+
+#define _SYSTEM
+
+#include <sys/param.h>
+
+#include <minix/const.h>
+#include <minix/libminixfs.h>
+
+#define RA_MIN		8		/* window of a new stream */
+#define RA_MAX		NR_IOREQS	/* largest window */
+#define RA_SHARE	4		/* at most one in RA_SHARE buffers */
+
+/*===========================================================================*
+ *				lmfs_ra_init				     *
+ *===========================================================================*/
+void lmfs_ra_init(struct lmfs_ra *ra)
+{
+/* A file starts out as if it is about to be read from the start. */
+  ra->ra_next = 0;
+  ra->ra_end = 0;
+  ra->ra_window = 0;
+}
+
+/*===========================================================================*
+ *				lmfs_ra_read				     *
+ *===========================================================================*/
+unsigned int lmfs_ra_read(struct lmfs_ra *ra, off_t pos, size_t bytes)
+{
+/* A read of 'bytes' bytes at 'pos' is about to be done. Return the number of
+ * blocks to read ahead from 'pos' if it misses in the cache.
+ */
+  if (pos == ra->ra_next) {
+	if (ra->ra_window == 0) ra->ra_window = RA_MIN;
+  } else {
+	/* Random access; forget what was read ahead. */
+	ra->ra_window = 0;
+	ra->ra_end = pos;
+  }
+  ra->ra_next = pos + bytes;
+
+  return(ra->ra_window);
+}
+
+/*===========================================================================*
+ *				lmfs_ra_async				     *
+ *===========================================================================*/
+int lmfs_ra_async(struct lmfs_ra *ra, off_t size, unsigned int block_size,
+	off_t *pos)
+{
+/* A read has been done on a file of 'size' bytes. Return TRUE and the block
+ * aligned position to read ahead from in 'pos' if the reader is catching up
+ * with the blocks read ahead for it.
+ */
+  off_t start;
+
+  if (ra->ra_window == 0) return(FALSE);
+
+  start = MAX(ra->ra_end, ra->ra_next);
+  start -= start % block_size;
+  if (start >= size) return(FALSE);
+
+  if (start - ra->ra_next > (off_t) (ra->ra_window / 2 * block_size))
+	return(FALSE);
+
+  *pos = start;
+  return(TRUE);
+}
+
+/*===========================================================================*
+ *				lmfs_ra_issued				     *
+ *===========================================================================*/
+void lmfs_ra_issued(struct lmfs_ra *ra, off_t end)
+{
+/* Blocks have been read ahead up to 'end'. Widen the window of a sequential
+ * reader for the next time.
+ */
+  unsigned int max;
+
+  if (end > ra->ra_end) ra->ra_end = end;
+
+  if (ra->ra_window == 0) return;
+
+  max = MIN(RA_MAX, MAX(lmfs_nr_bufs() / RA_SHARE, RA_MIN));
+  ra->ra_window = MIN(ra->ra_window * 2, max);
+}
@@ -52,3 +52,15 @@ int vm_info_region(endpoint_t who, struct vm_region_info *vri,
     return m.VMI_COUNT;
 }
 
+
+/*===========================================================================*
+ *                                vm_watch_memory			     *
+ *===========================================================================*/
+int vm_watch_memory(int on)
+{
+    message m;
+
+    m.VM_WM_ON = on;
+
+    return _taskcall(VM_PROC_NR, VM_WATCH_MEM, &m);
+}
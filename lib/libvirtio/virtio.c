@@ -28,9 +28,10 @@
  * About indirect descriptors:
  *
  * For each possible thread, a single indirect descriptor table is allocated.
- * If using direct descriptors would lead to the situation that another thread
- * might not be able to add another descriptor to the ring, indirect descriptors
- * are used.
+ * If the host supports VIRTIO_RING_F_INDIRECT_DESC, any chain of more than
+ * two descriptors is put into a free table, so that it only takes a single
+ * descriptor of the ring and many more requests can be in flight. Chains that
+ * are short, or for which no table is free, go into the ring directly.
  *
  * Indirect descriptors are pre-allocated. Each alloc_contig() call involves a
  * kernel call which is critical for performance.
@@ -89,6 +90,7 @@ struct virtio_device {
 
 	struct indirect_desc_table *indirect;	/* indirect descriptor tables */
 	int num_indirect;
+	int indirect_ok;			/* host takes indirect tables */
 };
 
 static int is_matching_device(u16_t expected_sdid, u16_t vid, u16_t sdid);
@@ -237,6 +239,10 @@ exchange_features(struct virtio_device *dev)
 		f->host_support =  ((host_features >> f->bit) & 1);
 	}
 
+	/* indirect descriptors are handled here, not by the driver */
+	guest_features |= (1 << VIRTIO_RING_F_INDIRECT_DESC);
+	dev->indirect_ok = (host_features >> VIRTIO_RING_F_INDIRECT_DESC) & 1;
+
 	/* let the device know about our features */
 	virtio_write32(dev, VIRTIO_GUEST_F_OFF, guest_features);
 
@@ -513,32 +519,38 @@ use_vring_desc(struct vring_desc *vd, struct vumap_phys *vp)
 		vd->flags |= VRING_DESC_F_WRITE;
 }
 
-static void
-set_indirect_descriptors(struct virtio_device *dev, struct virtio_queue *q,
-	struct vumap_phys *bufs, size_t num)
+static struct indirect_desc_table *
+get_indirect_table(struct virtio_device *dev)
 {
-	/* Indirect descriptor tables are simply filled from left to right */
+	/* Find the first unused indirect descriptor table, if the host
+	 * supports them at all.
+	 */
 	int i;
 	struct indirect_desc_table *desc;
-	struct vring *vring = &q->vring;
-	struct vring_desc *vd, *ivd;
 
-	/* Find the first unused indirect descriptor table */
+	if (!dev->indirect_ok)
+		return NULL;
+
 	for (i = 0; i < dev->num_indirect; i++) {
 		desc = &dev->indirect[i];
 
-		/* If an unused indirect descriptor table was found,
-		 * mark it as being used and exit the loop.
-		 */
 		if (!desc->in_use) {
 			desc->in_use = 1;
-			break;
+			return desc;
 		}
 	}
 
-	/* Sanity check */
-	if (i >= dev->num_indirect)
-		panic("%s: No indirect descriptor tables left");
+	return NULL;
+}
+
+static void
+set_indirect_descriptors(struct virtio_queue *q,
+	struct indirect_desc_table *desc, struct vumap_phys *bufs, size_t num)
+{
+	/* Indirect descriptor tables are simply filled from left to right */
+	int i;
+	struct vring *vring = &q->vring;
+	struct vring_desc *vd, *ivd;
 
 	/* For indirect descriptor tables, only a single descriptor from
 	 * the main ring is used.
@@ -600,23 +612,30 @@ virtio_to_queue(struct virtio_device *dev, int qidx, struct vumap_phys *bufs,
 	size_t num, void *data)
 {
 	u16_t free_first;
-	int left;
 	struct virtio_queue *q = &dev->queues[qidx];
 	struct vring *vring = &q->vring;
+	struct indirect_desc_table *desc;
 
 	assert(0 <= qidx && qidx <= dev->num_queues);
+	assert(0 < num && num <= MAPVEC_NR + MAPVEC_NR / 2);
 
 	if (!data)
 		panic("%s: NULL data received queue %d", dev->name, qidx);
 
-	free_first = q->free_head;
+	if (q->free_num == 0)
+		return ENOSPC;
 
-	left = (int)q->free_num - (int)num;
+	free_first = q->free_head;
 
-	if (left < dev->threads)
-		set_indirect_descriptors(dev, q, bufs, num);
-	else
+	/* Long chains take a single descriptor if there is a table for them,
+	 * everything else has to fit into the ring.
+	 */
+	if (num > 2 && (desc = get_indirect_table(dev)) != NULL)
+		set_indirect_descriptors(q, desc, bufs, num);
+	else if (num <= q->free_num)
 		set_direct_descriptors(q, bufs, num);
+	else
+		return ENOSPC;
 
 	/* Next index for host is old free_head */
 	vring->avail->ring[vring->avail->idx % q->num] = free_first;
@@ -635,11 +654,23 @@ virtio_to_queue(struct virtio_device *dev, int qidx, struct vumap_phys *bufs,
 
 	/* kick it! */
 	kick_queue(dev, qidx);
-	return 0;
+	return OK;
 }
 
 int
-virtio_from_queue(struct virtio_device *dev, int qidx, void **data)
+virtio_queue_max_chain(struct virtio_device *dev, int qidx)
+{
+	assert(0 <= qidx && qidx < dev->num_queues);
+
+	if (dev->indirect_ok || dev->queues[qidx].num > MAPVEC_NR + MAPVEC_NR / 2)
+		return MAPVEC_NR + MAPVEC_NR / 2;
+
+	return dev->queues[qidx].num;
+}
+
+int
+virtio_from_queue(struct virtio_device *dev, int qidx, void **data,
+	size_t *len)
 {
 	struct virtio_queue *q;
 	struct vring *vring;
@@ -718,6 +749,9 @@ virtio_from_queue(struct virtio_device *dev, int qidx, void **data)
 	*data = q->data[uel->id];
 	q->data[uel->id] = NULL;
 
+	if (len != NULL)
+		*len = uel->len;
+
 	return 0;
 }
 
@@ -9,6 +9,8 @@
 
 /* 
  * test for lottery and edf
+ * in lottery mode nice is the number of tickets,
+ * in edf mode the same value is used as deadline in ms
  */
 
 int main(int argc, const char* argv[]) {
@@ -20,12 +22,14 @@ int main(int argc, const char* argv[]) {
         pid_t t = fork();
         if (t != 0) {
             nice(nice_arg + 50);
+            setdeadline(0, 0, nice_arg + 50);
             int i=0;
             while (i<1000000000) {
                 i++;
             }
         } else if (t == 0) {
             nice(nice_arg);
+            setdeadline(0, 0, nice_arg);
             int i=0;
             while (i<1000000000) {
                 i++;
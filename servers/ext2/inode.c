@@ -173,6 +173,7 @@ struct inode *get_inode(
   rip->i_last_pos_bl_alloc = 0;
   rip->i_last_dentry_size = 0;
   rip->i_mountpoint= FALSE;
+  lmfs_ra_init(&rip->i_ra);  /* not read from yet */
 
   rip->i_preallocation = opt.use_prealloc;
   rip->i_prealloc_count = rip->i_prealloc_index = 0;
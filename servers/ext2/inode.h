@@ -88,6 +88,7 @@ EXTERN struct inode {
     char i_mountpoint;          /* true if mounted on */
 
     char i_seek;                /* set on LSEEK, cleared on READ/WRITE */
+    struct lmfs_ra i_ra;        /* read-ahead state */
     char i_update;              /* the ATIME, CTIME, and MTIME bits are here */
 
     block_t i_prealloc_blocks[EXT2_PREALLOC_BLOCKS];	/* preallocated blocks */
@@ -99,6 +99,8 @@ int main(int argc, char *argv[])
 
 	if (error == OK)
 		read_ahead(); /* do block read ahead */
+
+	lmfs_writeback(); /* write back if too many blocks are dirty */
   }
 
   return 0;
@@ -197,7 +199,11 @@ message *m_in;				/* pointer to message */
 		else
 			srcok = 1;		/* Normal FS request. */
 
-	} else
+	} else if(src == VM_PROC_NR && is_notify(m_in->m_type))
+		lmfs_adjust_bufs();	/* free memory changed */
+	else if(src == CLOCK && is_notify(m_in->m_type))
+		lmfs_alarm();		/* write back expired blocks */
+	else
 		printf("ext2: unexpected source %d\n", src);
   } while(!srcok);
 
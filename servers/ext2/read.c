@@ -24,6 +24,7 @@ static int rw_chunk(struct inode *rip, u64_t position, unsigned off,
 
 static off_t rdahedpos;         /* position to read ahead */
 static struct inode *rdahed_inode;      /* pointer to inode to read ahead */
+static struct lmfs_ra bdev_ra;  /* read-ahead state of block devices */
 
 /*===========================================================================*
  *				fs_readwrite				     *
@@ -68,6 +69,10 @@ int fs_readwrite(void)
 
   rdwt_err = OK;                /* set to EIO if disk error occurs */
 
+  /* Let the read-ahead engine see where this read falls. */
+  if (rw_flag == READING)
+	(void) lmfs_ra_read(&rip->i_ra, position, nrbytes);
+
   if (rw_flag == WRITING && !block_spec) {
 	/* Check in advance to see if file will grow too big. */
 	if (position > (off_t) (rip->i_sp->s_max_size - nrbytes))
@@ -110,12 +115,9 @@ int fs_readwrite(void)
   }
 
   /* Check to see if read-ahead is called for, and if so, set it up. */
-  if(rw_flag == READING && rip->i_seek == NO_SEEK &&
-     (unsigned int) position % block_size == 0 &&
-     (regular || mode_word == I_DIRECTORY)) {
+  if (rw_flag == READING && (regular || mode_word == I_DIRECTORY) &&
+      lmfs_ra_async(&rip->i_ra, rip->i_size, block_size, &rdahedpos))
 	rdahed_inode = rip;
-	rdahedpos = position;
-  }
 
   rip->i_seek = NO_SEEK;
 
@@ -162,9 +164,14 @@ int fs_breadwrite(void)
   rip.i_block[0] = (block_t) fs_m_in.REQ_DEV2;
   rip.i_mode = I_BLOCK_SPECIAL;
   rip.i_size = 0;
+  rip.i_seek = NO_SEEK;
+  rip.i_ra = bdev_ra;
 
   rdwt_err = OK;                /* set to EIO if disk error occurs */
 
+  if (rw_flag == READING)
+	(void) lmfs_ra_read(&rip.i_ra, (off_t) ex64lo(position), nrbytes);
+
   cum_io = 0;
   /* Split the transfer into chunks that don't span two blocks. */
   while (nrbytes > 0) {
@@ -187,6 +194,8 @@ int fs_breadwrite(void)
   fs_m_out.RES_SEEK_POS_LO = ex64lo(position);
   fs_m_out.RES_SEEK_POS_HI = ex64hi(position);
 
+  bdev_ra = rip.i_ra;
+
   if (rdwt_err != OK) r = rdwt_err;     /* check for disk error */
   if (rdwt_err == END_OF_FILE) r = OK;
 
@@ -389,8 +398,7 @@ int index;                      /* index into *bp */
  *===========================================================================*/
 void read_ahead()
 {
-/* Read a block into the cache before it is needed. */
-  unsigned int block_size;
+/* Read blocks into the cache before the reader asks for them. */
   register struct inode *rip;
   struct buf *bp;
   block_t b;
@@ -399,13 +407,12 @@ void read_ahead()
 	return;
 
   rip = rdahed_inode;           /* pointer to inode to read ahead from */
-  block_size = get_block_size(rip->i_dev);
   rdahed_inode = NULL;     /* turn off read ahead */
   if ( (b = read_map(rip, rdahedpos)) == NO_BLOCK) return;      /* at EOF */
 
   assert(rdahedpos >= 0); /* So we can safely cast it to unsigned below */
 
-  bp = rahead(rip, b, cvul64((unsigned long) rdahedpos), block_size);
+  bp = rahead(rip, b, cvul64((unsigned long) rdahedpos), 0);
   put_block(bp, PARTIAL_DATA_BLOCK);
 }
 
@@ -421,16 +428,16 @@ unsigned bytes_ahead;           /* bytes beyond position for immediate use */
 {
 /* Fetch a block from the cache or the device.  If a physical read is
  * required, prefetch as many more blocks as convenient into the cache.
- * This usually covers bytes_ahead and is at least BLOCKS_MINIMUM.
+ * This covers bytes_ahead and, for a sequential reader, the read-ahead
+ * window of the file.  If bytes_ahead is 0, the block is only read ahead,
+ * and NULL is returned.
  * The device driver may decide it knows better and stop reading at a
  * cylinder boundary (or after an error).  Rw_scattered() puts an optional
  * flag on all reads to allow this.
  */
-/* Minimum number of blocks to prefetch. */
-# define BLOCKS_MINIMUM		(nr_bufs < 50 ? 18 : 32)
   int nr_bufs = lmfs_nr_bufs();
   int block_spec, read_q_size;
-  unsigned int blocks_ahead, fragment, block_size;
+  unsigned int blocks_ahead, blocks_wanted, fragment, block_size;
   block_t block, blocks_left;
   off_t ind1_pos;
   dev_t dev;
@@ -492,6 +499,7 @@ unsigned bytes_ahead;           /* bytes beyond position for immediate use */
   bytes_ahead += fragment;
 
   blocks_ahead = (bytes_ahead + block_size - 1) / block_size;
+  blocks_wanted = blocks_ahead;
 
   if (block_spec && rip->i_size == 0) {
 	blocks_left = (block_t) NR_IOREQS;
@@ -509,15 +517,16 @@ unsigned bytes_ahead;           /* bytes beyond position for immediate use */
 	}
   }
 
+  /* Read at least the window of a sequential reader. */
+  if (blocks_ahead < rip->i_ra.ra_window)
+	blocks_ahead = rip->i_ra.ra_window;
+
   /* No more than the maximum request. */
   if (blocks_ahead > NR_IOREQS) blocks_ahead = NR_IOREQS;
 
-  /* Read at least the minimum number of blocks, but not after a seek. */
-  if (blocks_ahead < BLOCKS_MINIMUM && rip->i_seek == NO_SEEK)
-	blocks_ahead = BLOCKS_MINIMUM;
-
   /* Can't go past end of file. */
   if (blocks_ahead > blocks_left) blocks_ahead = blocks_left;
+  if (blocks_ahead == 0) blocks_ahead = 1;
 
   read_q_size = 0;
 
@@ -539,7 +548,11 @@ unsigned bytes_ahead;           /* bytes beyond position for immediate use */
 		break;
 	}
   }
-  lmfs_rw_scattered(dev, read_q, read_q_size, READING);
+  lmfs_readahead(dev, read_q, read_q_size, (int) blocks_wanted);
+  lmfs_ra_issued(&rip->i_ra,
+	(off_t) ex64lo(position) + (off_t) read_q_size * block_size);
+
+  if (bytes_ahead == 0) return(NULL);
   return(get_block(dev, baseblock, NORMAL));
 }
 
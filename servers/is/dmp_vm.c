@@ -73,6 +73,16 @@ void vm_dmp()
 		vsi.vsi_largest * (vsi.vsi_pagesize / 1024),
 		vsi.vsi_cached * (vsi.vsi_pagesize / 1024));
 	n++;
+	printf("Free blocks:");
+	for (i = 0; i < VSI_ORDERS; i++)
+		printf(" %lukB:%lu", (vsi.vsi_pagesize / 1024) << i,
+			vsi.vsi_blocks[i]);
+	printf("\n");
+	n++;
+	printf("Zeroed %lu kB, %lu hits, %lu misses\n",
+		vsi.vsi_zeroed * (vsi.vsi_pagesize / 1024),
+		vsi.vsi_zero_hits, vsi.vsi_zero_misses);
+	n++;
 	printf("\n");
 	n++;
 
@@ -111,11 +111,17 @@ void nic_init_all(void)
 	for (i = 0; i < MAX_DEVS; i++) {
 		devices[i].drv_ep = NONE;
 		devices[i].is_default = 0;
+		devices[i].batch = 0;
+		devices[i].ring = NULL;
 
 		if (cpf_getgrants(&devices[i].rx_iogrant, 1) != 1)
 			panic("Cannot initialize grants");
-		if (cpf_getgrants(&devices[i].rx_iovec[0].iov_grant, 1) != 1)
-			panic("Cannot initialize grants");
+		for (g = 0; g < RX_IOVEC_NUM; g++) {
+			cp_grant_id_t * gid = &devices[i].rx_iovec[g].iov_grant;
+			if (cpf_getgrants(gid, 1) != 1)
+				panic("Cannot initialize grants");
+			devices[i].rx_pbuf[g] = NULL;
+		}
 		if (cpf_getgrants(&devices[i].tx_iogrant, 1) != 1)
 			panic("Cannot initialize grants");
 		for (g = 0; g < TX_IOVEC_NUM; g++) {
@@ -127,37 +133,190 @@ void nic_init_all(void)
 	}
 }
 
+static unsigned driver_rx_count(struct nic * nic)
+{
+	if (nic->batch == 0)
+		return 1;
+	return nic->batch < RX_IOVEC_NUM ? nic->batch : RX_IOVEC_NUM;
+}
+
+static unsigned driver_tx_count(struct nic * nic)
+{
+	if (nic->batch == 0)
+		return 1;
+	return nic->batch < TX_IOVEC_NUM ? nic->batch : TX_IOVEC_NUM;
+}
+
 static void driver_setup_read(struct nic * nic)
 {
 	message m;
+	unsigned i, n;
 
 	debug_print("device /dev/%s", nic->name);
-	//assert(nic->rx_pbuf == NULL);
-	if (!(nic->rx_pbuf == NULL)) {
-		panic("device /dev/%s rx_pbuf %p", nic->name, nic->rx_pbuf);
-	}
 
-	if (!(nic->rx_pbuf = pbuf_alloc(PBUF_RAW, ETH_MAX_PACK_SIZE + ETH_CRC_SIZE, PBUF_RAM)))
-		panic("Cannot allocate rx pbuf");
+	/*
+	 * Buffers the driver did not fill last time are given to it again,
+	 * only the slots of the packets passed up need new ones
+	 */
+	n = driver_rx_count(nic);
+	for (i = 0; i < n; i++) {
+		struct pbuf * p;
+
+		if ((p = nic->rx_pbuf[i]) == NULL) {
+			p = pbuf_alloc(PBUF_RAW,
+					ETH_MAX_PACK_SIZE + ETH_CRC_SIZE,
+					PBUF_RAM);
+			if (p == NULL)
+				panic("Cannot allocate rx pbuf");
+			nic->rx_pbuf[i] = p;
+		}
 
-	if (cpf_setgrant_direct(nic->rx_iovec[0].iov_grant,
-				nic->drv_ep, (vir_bytes) nic->rx_pbuf->payload,
-				nic->rx_pbuf->len, CPF_WRITE) != OK)
-		panic("Failed to set grant");
-	nic->rx_iovec[0].iov_size = nic->rx_pbuf->len;
+		if (cpf_setgrant_direct(nic->rx_iovec[i].iov_grant,
+					nic->drv_ep, (vir_bytes) p->payload,
+					p->len, CPF_WRITE) != OK)
+			panic("Failed to set grant");
+		nic->rx_iovec[i].iov_size = p->len;
+	}
 
-	m.m_type = DL_READV_S;
-	m.DL_COUNT = 1;
+	m.m_type = nic->batch ? DL_READV_M : DL_READV_S;
+	m.DL_COUNT = n;
 	m.DL_GRANT = nic->rx_iogrant;
 
 	if (asynsend(nic->drv_ep, &m) != OK)
 		panic("asynsend to the driver failed!");
 }
 
+/*
+ * Make the slots up to prod of the TX ring visible to the driver. It only
+ * needs a doorbell if it has sent everything before
+ */
+static void ring_tx_publish(struct nic * nic, u32_t prod)
+{
+	struct netring_queue * q = &nic->ring->nr_tx;
+	u32_t old = q->nq_prod;
+
+	netring_barrier();
+	q->nq_prod = prod;
+	netring_barrier();
+
+	if (q->nq_cons == old)
+		notify(nic->drv_ep);
+}
+
+static void ring_tx_pad(struct nic * nic, u32_t prod, unsigned len)
+{
+	struct netring_queue * q = &nic->ring->nr_tx;
+
+	if (len < nic->min_pkt_sz) {
+		memset(NETRING_TX_SLOT(nic->ring, prod) + len, 0,
+				nic->min_pkt_sz - len);
+		len = nic->min_pkt_sz;
+	}
+	q->nq_len[prod % NETRING_SLOTS] = len;
+}
+
+int driver_ring_output(struct nic * nic, struct pbuf * pbuf)
+{
+	struct netring_queue * q = &nic->ring->nr_tx;
+	u32_t prod = q->nq_prod;
+
+	if (prod - q->nq_cons == NETRING_SLOTS)
+		return 0;
+
+	assert(pbuf->tot_len <= nic->max_pkt_sz);
+	pbuf_copy_partial(pbuf, NETRING_TX_SLOT(nic->ring, prod),
+			pbuf->tot_len, 0);
+	ring_tx_pad(nic, prod, pbuf->tot_len);
+	ring_tx_publish(nic, prod + 1);
+
+	return 1;
+}
+
+/*
+ * Move queued packets into the TX ring while there is room. If the ring
+ * fills up, the driver rings the doorbell once it has sent some
+ */
+static int driver_ring_tx(struct nic * nic)
+{
+	struct netring_queue * q = &nic->ring->nr_tx;
+	struct packet_q * pkt;
+	u32_t prod = q->nq_prod;
+
+	for (;;) {
+		while ((pkt = driver_tx_head(nic)) != NULL &&
+				prod - q->nq_cons < NETRING_SLOTS) {
+			assert(pkt->buf_len <= nic->max_pkt_sz);
+			memcpy(NETRING_TX_SLOT(nic->ring, prod), pkt->buf,
+					pkt->buf_len);
+			ring_tx_pad(nic, prod, pkt->buf_len);
+			driver_tx_dequeue(nic);
+			prod++;
+		}
+		if (prod != q->nq_prod)
+			ring_tx_publish(nic, prod);
+
+		/* the driver may have made room while we were not looking */
+		if (pkt == NULL || prod - q->nq_cons == NETRING_SLOTS)
+			break;
+	}
+
+	nic->state = pkt ? DRV_SENDING : DRV_IDLE;
+	return 1;
+}
+
+/*
+ * Pass up all packets the driver put in the RX ring. The driver only needs
+ * a doorbell if the ring was full and it has nowhere to receive to
+ */
+static void driver_ring_rx(struct nic * nic)
+{
+	struct netring_queue * q = &nic->ring->nr_rx;
+	u32_t cons, prod, old;
+
+	assert(nic->netif.input);
+
+	cons = q->nq_cons;
+	while (cons != (prod = q->nq_prod)) {
+		netring_barrier();
+
+		for (old = cons; cons != prod; cons++) {
+			struct pbuf * p;
+			unsigned len = q->nq_len[cons % NETRING_SLOTS];
+
+			if (len > NETRING_SLOT_SIZE)
+				len = NETRING_SLOT_SIZE;
+			if ((p = pbuf_alloc(PBUF_RAW, len, PBUF_RAM)) == NULL) {
+				debug_print("dropping packet, no pbuf");
+				continue;
+			}
+			pbuf_take(p, NETRING_RX_SLOT(nic->ring, cons), len);
+			nic->netif.input(p, &nic->netif);
+		}
+
+		q->nq_cons = cons;
+		netring_barrier();
+
+		if (q->nq_prod - old == NETRING_SLOTS)
+			notify(nic->drv_ep);
+	}
+}
+
 static void nic_up(struct nic * nic, message * m)
 {
 	memcpy(nic->netif.hwaddr, m->DL_HWADDR, NETIF_MAX_HWADDR_LEN);
 
+	/* a driver that takes batches tells us how many packets at most */
+	if (m->m_type == DL_CONF_REPLY_M && m->DL_BATCH > 1)
+		nic->batch = m->DL_BATCH;
+	else
+		nic->batch = 0;
+
+	/* and a driver that shares a ring where it is mapped */
+	if (m->m_type == DL_CONF_REPLY_M && m->DL_RING != NULL)
+		nic->ring = (struct netring *) m->DL_RING;
+	else
+		nic->ring = NULL;
+
 	debug_print("device %s is up MAC : %02x:%02x:%02x:%02x:%02x:%02x",
 			nic->name,
 			nic->netif.hwaddr[0],
@@ -167,7 +326,11 @@ static void nic_up(struct nic * nic, message * m)
 			nic->netif.hwaddr[4],
 			nic->netif.hwaddr[5]);
 
-	driver_setup_read(nic);
+	/* packets arrive in the ring without being asked for */
+	if (nic->ring)
+		driver_ring_rx(nic);
+	else
+		driver_setup_read(nic);
 
 	netif_set_link_up(&nic->netif);
 	netif_set_up(&nic->netif);
@@ -176,7 +339,7 @@ static void nic_up(struct nic * nic, message * m)
 int driver_tx(struct nic * nic)
 {
 	struct packet_q * pkt;
-	unsigned len;
+	unsigned len, n, max;
 	message m;
 
 	int err;
@@ -184,38 +347,49 @@ int driver_tx(struct nic * nic)
 	debug_print("device /dev/%s", nic->name);
 	assert(nic->tx_buffer);
 
+	if (nic->ring)
+		return driver_ring_tx(nic);
+
 	pkt = driver_tx_head(nic);
 	if (pkt == NULL) {
 		debug_print("no packets enqueued");
 		return 0;
 	}
 
-	assert(pkt->buf_len <= nic->max_pkt_sz);
-	
-	if ((len = pkt->buf_len) < nic->min_pkt_sz)
-		len = nic->min_pkt_sz;
-	err = cpf_setgrant_direct(nic->tx_iovec[0].iov_grant,
-			nic->drv_ep, (vir_bytes) pkt->buf,
-			len, CPF_READ);
-	debug_print("packet len %d", len);
-	if (err != OK)
-		panic("Failed to set grant");
-	nic->tx_iovec[0].iov_size = len;
-	
+	/*
+	 * A driver that takes batches gets as many of the queued packets as
+	 * it can, one per vector element, others get the first one
+	 */
+	max = driver_tx_count(nic);
+	for (n = 0; pkt && n < max; pkt = pkt->next, n++) {
+		assert(pkt->buf_len <= nic->max_pkt_sz);
+
+		if ((len = pkt->buf_len) < nic->min_pkt_sz)
+			len = nic->min_pkt_sz;
+		err = cpf_setgrant_direct(nic->tx_iovec[n].iov_grant,
+				nic->drv_ep, (vir_bytes) pkt->buf,
+				len, CPF_READ);
+		debug_print("packet len %d", len);
+		if (err != OK)
+			panic("Failed to set grant");
+		nic->tx_iovec[n].iov_size = len;
+	}
+
 	if (cpf_setgrant_direct(nic->tx_iogrant, nic->drv_ep,
 			(vir_bytes) &nic->tx_iovec,
-			sizeof(iovec_s_t), CPF_READ) != OK)
+			n * sizeof(iovec_s_t), CPF_READ) != OK)
 		panic("Failed to set grant");
 
-	m.m_type = DL_WRITEV_S;
-	m.DL_COUNT = 1;
+	m.m_type = nic->batch ? DL_WRITEV_M : DL_WRITEV_S;
+	m.DL_COUNT = n;
 	m.DL_GRANT = nic->tx_iogrant;
 
 	if (asynsend(nic->drv_ep, &m) != OK)
 		panic("asynsend to the driver failed!");
 	nic->state = DRV_SENDING;
+	nic->tx_count = n;
 	
-	debug_print("packet sent to driver");
+	debug_print("%d packets sent to driver", n);
 
 	return 1;
 }
@@ -225,8 +399,11 @@ static void nic_pkt_sent(struct nic * nic)
 	debug_print("device /dev/%s", nic->name);
 	assert(nic->state != DRV_IDLE);
 
-	/* packet has been sent, we are not intereted anymore */
-	driver_tx_dequeue(nic);
+	/* packets have been sent, we are not intereted anymore */
+	while (nic->tx_count > 0) {
+		driver_tx_dequeue(nic);
+		nic->tx_count--;
+	}
 	/*
 	 * Try to transmit the next packet. Failure means that no packet is
 	 * enqueued and thus the device is entering idle state
@@ -343,19 +520,38 @@ int raw_socket_input(struct pbuf * pbuf, struct nic * nic)
 	return 0;
 }
 
-static void nic_pkt_received(struct nic * nic, unsigned size)
+static void nic_input(struct nic * nic, unsigned i, unsigned size)
 {
-	assert(nic->netif.input);
+	struct pbuf * p = nic->rx_pbuf[i];
 
 #if 0
-	print_pkt((unsigned char *) nic->rx_pbuf->payload, 64 /*nic->rx_pbuf->len */);
+	print_pkt((unsigned char *) p->payload, 64 /*p->len */);
 #endif
 	
-	assert(nic->rx_pbuf->tot_len == nic->rx_pbuf->len);
-	nic->rx_pbuf->tot_len = nic->rx_pbuf->len = size - ETH_CRC_SIZE;
+	assert(p->tot_len == p->len);
+	p->tot_len = p->len = size - ETH_CRC_SIZE;
+
+	nic->netif.input(p, &nic->netif);
+	nic->rx_pbuf[i] = NULL;
+}
+
+static void nic_pkt_received(struct nic * nic, unsigned count)
+{
+	unsigned i;
+
+	assert(nic->netif.input);
+
+	/*
+	 * In batch mode the driver reports the number of packets and leaves the
+	 * size of each in its vector element, otherwise the size of the packet
+	 */
+	if (nic->batch) {
+		assert(count <= driver_rx_count(nic));
+		for (i = 0; i < count; i++)
+			nic_input(nic, i, nic->rx_iovec[i].iov_size);
+	} else
+		nic_input(nic, 0, count);
 
-	nic->netif.input(nic->rx_pbuf, &nic->netif);
-	nic->rx_pbuf = NULL;
 	driver_setup_read(nic);
 }
 
@@ -370,6 +566,7 @@ void driver_request(message * m)
 
 	switch (m->m_type) {
 	case DL_CONF_REPLY:
+	case DL_CONF_REPLY_M:
 		if (m->DL_STAT == OK)
 			nic_up(nic, m);
 		break;
@@ -393,6 +590,21 @@ void driver_request(message * m)
 	}
 }
 
+void driver_notify(endpoint_t ep)
+{
+	struct nic * nic;
+
+	if ((nic = lookup_nic_by_drv_ep(ep)) == NULL || nic->ring == NULL) {
+		printf("LWIP : unexpected notify from %d\n", ep);
+		return;
+	}
+
+	/* the driver received packets or made room for more */
+	driver_ring_rx(nic);
+	if (nic->state == DRV_SENDING)
+		driver_tx(nic);
+}
+
 void driver_up(const char * label, endpoint_t ep)
 {
 	struct nic * nic;
@@ -429,11 +641,15 @@ void driver_up(const char * label, endpoint_t ep)
 	if (nic->tx_buffer == NULL)
 		panic("Cannot allocate tx_buffer");
 
-	/* prepare the RX grant once and forever */
+	/*
+	 * prepare the RX grant once and forever, in batch mode the driver
+	 * writes the packet sizes back
+	 */
 	if (cpf_setgrant_direct(nic->rx_iogrant,
 				nic->drv_ep,
 				(vir_bytes) &nic->rx_iovec,
-				1 * sizeof(iovec_s_t), CPF_READ) != OK)
+				RX_IOVEC_NUM * sizeof(iovec_s_t),
+				CPF_READ | CPF_WRITE) != OK)
 		panic("Failed to set grant");
 }
 
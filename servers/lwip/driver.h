@@ -3,6 +3,7 @@
 
 #include <minix/endpoint.h>
 #include <minix/ds.h>
+#include <minix/netring.h>
 
 #include <lwip/pbuf.h>
 
@@ -10,6 +11,7 @@
 #define DRV_NAME_LEN	DS_MAX_KEYLEN
 
 #define TX_IOVEC_NUM	16 /* something the drivers assume */
+#define RX_IOVEC_NUM	8  /* packets received in one batch */
 
 struct packet_q {
 	struct packet_q *	next;
@@ -28,11 +30,14 @@ struct nic {
 	endpoint_t		drv_ep;
 	int			is_default;
 	int			state;
+	unsigned		batch; /* packets per request, 0 if one */
+	struct netring *	ring; /* shared with the driver or NULL */
 	cp_grant_id_t		rx_iogrant;
-	iovec_s_t		rx_iovec[1];
-	struct pbuf *		rx_pbuf;
+	iovec_s_t		rx_iovec[RX_IOVEC_NUM];
+	struct pbuf *		rx_pbuf[RX_IOVEC_NUM];
 	cp_grant_id_t		tx_iogrant;
 	iovec_s_t		tx_iovec[TX_IOVEC_NUM];
+	unsigned		tx_count; /* packets the driver is sending */
 	struct packet_q	*	tx_head;
 	struct packet_q	*	tx_tail;
 	void *			tx_buffer;
@@ -47,10 +52,15 @@ void driver_tx_dequeue(struct nic * nic);
 struct packet_q * driver_tx_head(struct nic * nic);
 
 /*
- * Transmit the next packet in the TX queue of this device. Returns 1 if
- * success, 0 otherwise.
+ * Transmit the next packets in the TX queue of this device, as many as the
+ * driver takes in one request. Returns 1 if success, 0 otherwise.
  */
 int driver_tx(struct nic * nic);
+/*
+ * Copy a packet straight into the TX ring shared with the driver. Returns 1
+ * if it fit, 0 if it must be queued.
+ */
+int driver_ring_output(struct nic * nic, struct pbuf * pbuf);
 int raw_socket_input(struct pbuf * pbuf, struct nic * nic);
 
 #endif /* __LWIP_DRIVER_H_ */
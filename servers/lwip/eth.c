@@ -72,6 +72,11 @@ static err_t low_level_output(__unused struct netif *netif, struct pbuf *pbuf)
 
 	debug_print("device /dev/%s", nic->name);
 
+	/* nothing waits for room in the ring, put the packet right there */
+	if (nic->ring && nic->state == DRV_IDLE &&
+			driver_ring_output(nic, pbuf))
+		return ERR_OK;
+
 	if (driver_tx_enqueue(nic, pbuf) != OK)
 		return ERR_MEM;
 
@@ -109,6 +114,10 @@ static void low_level_init(struct netif *netif)
                 m.DL_MODE |= DL_MULTI_REQ;
         if (nic->flags & NWEO_EN_PROMISC)
                 m.DL_MODE |= DL_PROMISC_REQ;
+        /* we can pass several packets in one request if the driver can */
+        m.DL_MODE |= DL_BATCH_REQ;
+        /* or without any requests if it can share a ring with us */
+        m.DL_MODE |= DL_RING_REQ;
 
         m.m_type = DL_CONF;
 
@@ -283,9 +283,9 @@ int main(__unused int argc, __unused char ** argv)
 				panic("LWIP : unhandled event from PM");
 				break;
 			default:
-				printf("LWIP : unexpected notify from %d\n",
-								m.m_source);
-				continue;
+				/* drivers sharing a ring ring the doorbell */
+				driver_notify(m.m_source);
+				break;
 			}
 		} else
 			/* all other request can be from drivers only */
@@ -27,6 +27,7 @@ void nic_assign_driver(const char * dev_type,
 void nic_init_all(void);
 void driver_request(message * m);
 void driver_up(const char * label, endpoint_t ep);
+void driver_notify(endpoint_t ep);
 /* opens a raw NIC socket */
 void nic_open(message *m);
 void nic_default_ioctl(message *m);
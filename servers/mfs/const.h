@@ -47,6 +47,10 @@
 #define DELETE             2 /* tells search_dir to delete entry */
 #define IS_EMPTY           3 /* tells search_dir to ret. OK or ENOTEMPTY */  
 
+/* Directory hashing. */
+#define DIRHASH_MINBLOCKS  4	/* hash directories of this many blocks */
+#define DIRHASH_MAXMEM (2048*1024) /* max. bytes used by all directory hashes */
+
 /* write_map() args */
 #define WMAP_FREE	(1 << 0)
 
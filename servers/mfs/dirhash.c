@@ -0,0 +1,403 @@
+/* This file contains the in-memory index of large directories. Looking up,
+ * entering and deleting a name in a directory means scanning it block by
+ * block. For directories of DIRHASH_MINBLOCKS blocks or more, an index is
+ * built on first use that maps hashes of names to directory slots, and keeps
+ * track of which slots are free. It lives as long as the inode stays in the
+ * inode cache, and is kept up to date by search_dir(), through which every
+ * change to a directory goes.
+ *
+ * The indexes share a memory budget of DIRHASH_MAXMEM bytes. When it is used
+ * up, the index of the least recently used directory is thrown away.
+ *
+ *  The entry points into this file are
+ *   dirhash_get:	return the index of a directory, building it if needed
+ *   dirhash_search:	look up or delete a name using the index
+ *   dirhash_enter_pos:	return where to start looking for a free slot
+ *   dirhash_add:	record that a name was entered in a slot
+ *   dirhash_drop:	throw away the index of a directory
+ */
+
+#include "fs.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <sys/queue.h>
+#include "buf.h"
+#include "inode.h"
+#include "super.h"
+
+#define SLOT_FREE	0	/* slot holds no name */
+#define SLOT_USED	1	/* slot holds a name */
+
+#define NO_SLOT		(-1)
+
+struct dirhash {
+  struct inode *dh_ip;		/* the directory indexed */
+  unsigned int dh_nslots;	/* # slots the arrays below have room for */
+  unsigned int dh_used;		/* # slots holding a name */
+  unsigned int dh_nbuckets;	/* # hash chains, a power of two */
+  int *dh_bucket;		/* first slot of each hash chain */
+  int *dh_next;			/* next slot on the same hash chain */
+  u32_t *dh_hval;		/* hash of the name in each slot */
+  unsigned char *dh_state;	/* SLOT_FREE or SLOT_USED */
+  unsigned int dh_freehint;	/* no slot below this one is free */
+  size_t dh_mem;		/* bytes allocated for this index */
+  TAILQ_ENTRY(dirhash) dh_lru;	/* LRU list of all indexes */
+};
+
+static TAILQ_HEAD(dirhash_lru_t, dirhash) dirhash_lru =
+	TAILQ_HEAD_INITIALIZER(dirhash_lru);
+static size_t dirhash_mem;	/* bytes allocated for all indexes */
+
+static u32_t hash_name(const char *name);
+static int dirhash_alloc(struct dirhash *dh, unsigned int nslots,
+	unsigned int nbuckets);
+static void dirhash_free(struct dirhash *dh);
+static struct dirhash *dirhash_build(struct inode *dirp);
+static void dirhash_insert(struct dirhash *dh, int slot, u32_t hval);
+static void dirhash_remove(struct dirhash *dh, int slot);
+static struct direct *get_slot(struct inode *dirp, int slot,
+	struct buf **bpp);
+
+/*===========================================================================*
+ *				hash_name				     *
+ *===========================================================================*/
+static u32_t hash_name(const char *name)
+{
+/* Hash a name of at most MFS_NAME_MAX characters (FNV-1a) */
+  u32_t h = 2166136261U;
+  int i;
+
+  for (i = 0; i < MFS_NAME_MAX && name[i] != '\0'; i++)
+	h = (h ^ (unsigned char) name[i]) * 16777619U;
+
+  return(h);
+}
+
+/*===========================================================================*
+ *				dirhash_alloc				     *
+ *===========================================================================*/
+static int dirhash_alloc(struct dirhash *dh, unsigned int nslots,
+	unsigned int nbuckets)
+{
+/* Size the arrays of an index for 'nslots' slots and 'nbuckets' hash chains,
+ * keeping what they hold. Throw away the indexes of other directories if
+ * needed to stay within the memory budget. Return OK or ENOMEM; an index that
+ * would not fit in the budget by itself is refused before anything is thrown
+ * away.
+ */
+  struct dirhash *victim;
+  size_t mem;
+  int *bucket, *next;
+  u32_t *hval;
+  unsigned char *state;
+  unsigned int i;
+
+  mem = nbuckets * sizeof(int) +
+	nslots * (sizeof(int) + sizeof(u32_t) + sizeof(unsigned char));
+  if (mem > DIRHASH_MAXMEM) return(ENOMEM);
+
+  while (dirhash_mem - dh->dh_mem + mem > DIRHASH_MAXMEM) {
+	victim = TAILQ_FIRST(&dirhash_lru);
+	while (victim == dh)
+		victim = TAILQ_NEXT(victim, dh_lru);
+	if (victim == NULL) return(ENOMEM);
+	dirhash_drop(victim->dh_ip);
+  }
+
+  next = realloc(dh->dh_next, nslots * sizeof(int));
+  if (next != NULL) dh->dh_next = next;
+  hval = realloc(dh->dh_hval, nslots * sizeof(u32_t));
+  if (hval != NULL) dh->dh_hval = hval;
+  state = realloc(dh->dh_state, nslots * sizeof(unsigned char));
+  if (state != NULL) dh->dh_state = state;
+  bucket = malloc(nbuckets * sizeof(int));
+  if (next == NULL || hval == NULL || state == NULL || bucket == NULL) {
+	free(bucket);
+	return(ENOMEM);
+  }
+
+  /* New slots lie beyond the end of the directory; they are free. */
+  for (i = dh->dh_nslots; i < nslots; i++)
+	dh->dh_state[i] = SLOT_FREE;
+
+  /* Rehash into the new chains. */
+  free(dh->dh_bucket);
+  dh->dh_bucket = bucket;
+  dh->dh_nbuckets = nbuckets;
+  for (i = 0; i < nbuckets; i++)
+	dh->dh_bucket[i] = NO_SLOT;
+  for (i = 0; i < dh->dh_nslots; i++)
+	if (dh->dh_state[i] == SLOT_USED)
+		dirhash_insert(dh, i, dh->dh_hval[i]);
+  dh->dh_nslots = nslots;
+
+  dirhash_mem = dirhash_mem - dh->dh_mem + mem;
+  dh->dh_mem = mem;
+
+  return(OK);
+}
+
+/*===========================================================================*
+ *				dirhash_free				     *
+ *===========================================================================*/
+static void dirhash_free(struct dirhash *dh)
+{
+  dirhash_mem -= dh->dh_mem;
+  free(dh->dh_bucket);
+  free(dh->dh_next);
+  free(dh->dh_hval);
+  free(dh->dh_state);
+  free(dh);
+}
+
+/*===========================================================================*
+ *				dirhash_insert				     *
+ *===========================================================================*/
+static void dirhash_insert(struct dirhash *dh, int slot, u32_t hval)
+{
+  int b;
+
+  b = hval & (dh->dh_nbuckets - 1);
+  dh->dh_hval[slot] = hval;
+  dh->dh_next[slot] = dh->dh_bucket[b];
+  dh->dh_bucket[b] = slot;
+}
+
+/*===========================================================================*
+ *				dirhash_remove				     *
+ *===========================================================================*/
+static void dirhash_remove(struct dirhash *dh, int slot)
+{
+/* Take a slot off its hash chain and mark it free */
+  int *sp;
+
+  sp = &dh->dh_bucket[dh->dh_hval[slot] & (dh->dh_nbuckets - 1)];
+  while (*sp != slot) {
+	assert(*sp != NO_SLOT);
+	sp = &dh->dh_next[*sp];
+  }
+  *sp = dh->dh_next[slot];
+
+  dh->dh_state[slot] = SLOT_FREE;
+  dh->dh_used--;
+  if ((unsigned int) slot < dh->dh_freehint) dh->dh_freehint = slot;
+}
+
+/*===========================================================================*
+ *				get_slot				     *
+ *===========================================================================*/
+static struct direct *get_slot(struct inode *dirp, int slot,
+	struct buf **bpp)
+{
+/* Get the block holding a directory slot, and return the slot in it. */
+  unsigned int per_block;
+  block_t b;
+
+  per_block = NR_DIR_ENTRIES(dirp->i_sp->s_block_size);
+  b = read_map(dirp, (off_t) (slot / per_block) * dirp->i_sp->s_block_size);
+
+  /* Since directories don't have holes, 'b' cannot be NO_BLOCK. */
+  *bpp = get_block(dirp->i_dev, b, NORMAL);
+  assert(*bpp != NULL);
+
+  return(&b_dir(*bpp)[slot % per_block]);
+}
+
+/*===========================================================================*
+ *				dirhash_build				     *
+ *===========================================================================*/
+static struct dirhash *dirhash_build(struct inode *dirp)
+{
+/* Build the index of a directory by scanning all of it once. */
+  struct dirhash *dh;
+  struct direct *dp;
+  struct buf *bp;
+  unsigned int nslots, nbuckets, slot, per_block;
+  off_t pos;
+  block_t b;
+
+  if ((dh = calloc(1, sizeof(*dh))) == NULL) return(NULL);
+  dh->dh_ip = dirp;
+
+  nslots = (unsigned int) (dirp->i_size / DIR_ENTRY_SIZE);
+  for (nbuckets = 1; nbuckets < nslots; nbuckets <<= 1)
+	;
+
+  if (dirhash_alloc(dh, nslots, nbuckets) != OK) {
+	dirhash_free(dh);
+	return(NULL);
+  }
+
+  per_block = NR_DIR_ENTRIES(dirp->i_sp->s_block_size);
+  slot = 0;
+  for (pos = 0; pos < dirp->i_size; pos += dirp->i_sp->s_block_size) {
+	b = read_map(dirp, pos);
+	bp = get_block(dirp->i_dev, b, NORMAL);
+	assert(bp != NULL);
+
+	for (dp = &b_dir(bp)[0];
+	     dp < &b_dir(bp)[per_block] && slot < nslots; dp++, slot++) {
+		if (dp->mfs_d_ino == NO_ENTRY) continue;
+		dh->dh_state[slot] = SLOT_USED;
+		dh->dh_used++;
+		dirhash_insert(dh, slot, hash_name(dp->mfs_d_name));
+	}
+
+	put_block(bp, DIRECTORY_BLOCK);
+  }
+
+  for (dh->dh_freehint = 0; dh->dh_freehint < nslots &&
+       dh->dh_state[dh->dh_freehint] == SLOT_USED; dh->dh_freehint++)
+	;
+
+  TAILQ_INSERT_TAIL(&dirhash_lru, dh, dh_lru);
+  return(dh);
+}
+
+/*===========================================================================*
+ *				dirhash_get				     *
+ *===========================================================================*/
+struct dirhash *dirhash_get(struct inode *dirp)
+{
+/* Return the index of a directory, building it on the first use of a large
+ * directory. Return NULL if the directory is small or there is no memory.
+ * A directory too large to index at all is refused by dirhash_alloc() from
+ * its size alone, before it is scanned or other indexes are thrown away.
+ */
+  struct dirhash *dh;
+
+  if ((dh = dirp->i_dirhash) != NULL) {
+	TAILQ_REMOVE(&dirhash_lru, dh, dh_lru);
+	TAILQ_INSERT_TAIL(&dirhash_lru, dh, dh_lru);
+	return(dh);
+  }
+
+  if (dirp->i_size < DIRHASH_MINBLOCKS * dirp->i_sp->s_block_size)
+	return(NULL);
+
+  dirp->i_dirhash = dirhash_build(dirp);
+  return(dirp->i_dirhash);
+}
+
+/*===========================================================================*
+ *				dirhash_search				     *
+ *===========================================================================*/
+int dirhash_search(struct inode *dirp, char string[MFS_NAME_MAX],
+	ino_t *numb, int flag)
+{
+/* Do what search_dir does for LOOK_UP and DELETE, using the index. */
+  struct dirhash *dh = dirp->i_dirhash;
+  struct direct *dp;
+  struct buf *bp;
+  u32_t hval;
+  int slot, t;
+  off_t pos;
+
+  assert(dh != NULL);
+  assert(flag == LOOK_UP || flag == DELETE);
+
+  hval = hash_name(string);
+  for (slot = dh->dh_bucket[hval & (dh->dh_nbuckets - 1)]; slot != NO_SLOT;
+       slot = dh->dh_next[slot]) {
+	if (dh->dh_hval[slot] != hval) continue;
+
+	dp = get_slot(dirp, slot, &bp);
+	if (dp->mfs_d_ino == NO_ENTRY ||
+	    strncmp(dp->mfs_d_name, string, sizeof(dp->mfs_d_name)) != 0) {
+		put_block(bp, DIRECTORY_BLOCK);
+		continue;
+	}
+
+	if (flag == DELETE) {
+		/* Save d_ino for recovery. */
+		t = MFS_NAME_MAX - sizeof(ino_t);
+		*((ino_t *) &dp->mfs_d_name[t]) = dp->mfs_d_ino;
+		dp->mfs_d_ino = NO_ENTRY;	/* erase entry */
+		MARKDIRTY(bp);
+		dirp->i_update |= CTIME | MTIME;
+		IN_MARKDIRTY(dirp);
+		pos = (off_t) slot * DIR_ENTRY_SIZE;
+		pos -= pos % dirp->i_sp->s_block_size;
+		if (pos < dirp->i_last_dpos)
+			dirp->i_last_dpos = pos;
+		dirhash_remove(dh, slot);
+	} else {
+		*numb = (ino_t) conv4(dirp->i_sp->s_native,
+				      (int) dp->mfs_d_ino);
+	}
+	put_block(bp, DIRECTORY_BLOCK);
+	return(OK);
+  }
+
+  return(ENOENT);
+}
+
+/*===========================================================================*
+ *				dirhash_enter_pos			     *
+ *===========================================================================*/
+off_t dirhash_enter_pos(struct inode *dirp)
+{
+/* Return the start of the block with the first free slot of a directory, or
+ * the start of the last block if it has none. An ENTER that starts there
+ * finds room in the first block it looks at.
+ */
+  struct dirhash *dh = dirp->i_dirhash;
+  off_t pos;
+
+  assert(dh != NULL);
+
+  while (dh->dh_freehint < dh->dh_nslots &&
+	 dh->dh_state[dh->dh_freehint] == SLOT_USED)
+	dh->dh_freehint++;
+
+  pos = MIN((off_t) dh->dh_freehint * DIR_ENTRY_SIZE, dirp->i_size);
+  return(pos - pos % dirp->i_sp->s_block_size);
+}
+
+/*===========================================================================*
+ *				dirhash_add				     *
+ *===========================================================================*/
+void dirhash_add(struct inode *dirp, char string[MFS_NAME_MAX], off_t pos)
+{
+/* Record that 'string' was entered in the slot at 'pos' of a directory. */
+  struct dirhash *dh;
+  unsigned int slot, nslots, nbuckets;
+
+  if ((dh = dirp->i_dirhash) == NULL) return;
+
+  slot = (unsigned int) (pos / DIR_ENTRY_SIZE);
+
+  /* The directory grew, or the index is getting crowded. */
+  if (slot >= dh->dh_nslots || dh->dh_used >= 2 * dh->dh_nbuckets) {
+	nslots = MAX(dh->dh_nslots, slot + 1);
+	if (slot >= dh->dh_nslots) nslots = MAX(nslots, 2 * dh->dh_nslots);
+	nbuckets = dh->dh_nbuckets;
+	while (nbuckets < nslots) nbuckets <<= 1;
+	if (dirhash_alloc(dh, nslots, nbuckets) != OK) {
+		dirhash_drop(dirp);
+		return;
+	}
+  }
+
+  assert(dh->dh_state[slot] == SLOT_FREE);
+  dh->dh_state[slot] = SLOT_USED;
+  dh->dh_used++;
+  dirhash_insert(dh, slot, hash_name(string));
+}
+
+/*===========================================================================*
+ *				dirhash_drop				     *
+ *===========================================================================*/
+void dirhash_drop(struct inode *rip)
+{
+/* Throw away the index of a directory, if it has one. */
+  struct dirhash *dh;
+
+  if ((dh = rip->i_dirhash) == NULL) return;
+
+  TAILQ_REMOVE(&dirhash_lru, dh, dh_lru);
+  dirhash_free(dh);
+  rip->i_dirhash = NULL;
+}
@@ -164,6 +164,9 @@ struct inode *get_inode(
   /* Inode is not unused any more */
   TAILQ_REMOVE(&unused_inodes, rip, i_unused);
 
+  /* The directory index belongs to the inode that used this slot before. */
+  dirhash_drop(rip);
+
   /* Load the inode. */
   rip->i_dev = dev;
   rip->i_num = numb;
@@ -173,6 +176,7 @@ struct inode *get_inode(
   rip->i_zsearch = NO_ZONE;	/* no zones searched for yet */
   rip->i_mountpoint= FALSE;
   rip->i_last_dpos = 0;		/* no dentries searched for yet */
+  lmfs_ra_init(&rip->i_ra);	/* not read from yet */
 
   /* Add to hash */
   addhash_inode(rip);
@@ -235,6 +239,7 @@ register struct inode *rip;	/* pointer to inode to be released */
 		rip->i_mode = I_NOT_ALLOC;     /* clear I_TYPE field */
 		IN_MARKDIRTY(rip);
 		free_inode(rip->i_dev, rip->i_num);
+		dirhash_drop(rip);
 	} 
 
         rip->i_mountpoint = FALSE;
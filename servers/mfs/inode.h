@@ -41,8 +41,10 @@ EXTERN struct inode {
   off_t i_last_dpos;		/* where to start dentry search */
   
   char i_mountpoint;		/* true if mounted on */
+  struct dirhash *i_dirhash;	/* index of a large directory, or NULL */
 
   char i_seek;			/* set on LSEEK, cleared on READ/WRITE */
+  struct lmfs_ra i_ra;		/* read-ahead state */
   char i_update;		/* the ATIME, CTIME, and MTIME bits are here */
 
   LIST_ENTRY(inode) i_hash;     /* hash list */
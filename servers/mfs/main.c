@@ -76,6 +76,11 @@ int main(int argc, char *argv[])
 		fs_m_out.m_type = TRNS_ADD_ID(fs_m_out.m_type, transid);
 	}
 	reply(src, &fs_m_out);
+
+	if (error == OK)
+		read_ahead(); /* do block read ahead */
+
+	lmfs_writeback(); /* write back if too many blocks are dirty */
   }
 
   return(OK);
@@ -160,7 +165,11 @@ message *m_in;				/* pointer to message */
 		else 
 			srcok = 1;		/* Normal FS request. */
 		
-	} else
+	} else if(src == VM_PROC_NR && is_notify(m_in->m_type))
+		lmfs_adjust_bufs();	/* free memory changed */
+	else if(src == CLOCK && is_notify(m_in->m_type))
+		lmfs_alarm();		/* write back expired blocks */
+	else
 		printf("MFS: unexpected source %d\n", src);
   } while(!srcok);
 
@@ -510,6 +510,10 @@ int check_permissions;		 /* check permissions when flag is !IS_EMPTY */
 	}
   }
   if (r != OK) return(r);
+
+  /* Large directories are searched through their index, if they have one. */
+  if ((flag == LOOK_UP || flag == DELETE) && dirhash_get(ldir_ptr) != NULL)
+	return(dirhash_search(ldir_ptr, string, numb, flag));
   
   /* Step through the directory one block at a time. */
   old_slots = (unsigned) (ldir_ptr->i_size/DIR_ENTRY_SIZE);
@@ -518,8 +522,12 @@ int check_permissions;		 /* check permissions when flag is !IS_EMPTY */
   match = 0;			/* set when a string match occurs */
 
   pos = 0;
-  if (flag == ENTER && ldir_ptr->i_last_dpos < ldir_ptr->i_size) {
-	pos = ldir_ptr->i_last_dpos;
+  if (flag == ENTER) {
+	/* The index knows where the first free slot is. */
+	if (dirhash_get(ldir_ptr) != NULL)
+		pos = dirhash_enter_pos(ldir_ptr);
+	else if (ldir_ptr->i_last_dpos < ldir_ptr->i_size)
+		pos = ldir_ptr->i_last_dpos;
 	new_slots = (unsigned) (pos/DIR_ENTRY_SIZE);
   }
 
@@ -625,6 +633,7 @@ int check_permissions;		 /* check permissions when flag is !IS_EMPTY */
 	/* Send the change to disk if the directory is extended. */
 	if (extended) rw_inode(ldir_ptr, WRITING);
   }
+  dirhash_add(ldir_ptr, string, (off_t) (new_slots - 1) * DIR_ENTRY_SIZE);
   return(OK);
 }
 
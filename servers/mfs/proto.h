@@ -9,6 +9,7 @@
 
 /* Structs used in prototypes must be declared as such first. */
 struct buf;
+struct dirhash;
 struct filp;		
 struct inode;
 struct super_block;
@@ -54,6 +55,14 @@ int fs_mkdir(void);
 int fs_mknod(void);
 int fs_slink(void);
 
+/* dirhash.c */
+struct dirhash *dirhash_get(struct inode *dirp);
+int dirhash_search(struct inode *dirp, char string[MFS_NAME_MAX], ino_t
+	*numb, int flag);
+off_t dirhash_enter_pos(struct inode *dirp);
+void dirhash_add(struct inode *dirp, char string[MFS_NAME_MAX], off_t pos);
+void dirhash_drop(struct inode *rip);
+
 /* path.c */
 int fs_lookup(void);
 struct inode *advance(struct inode *dirp, char string[MFS_NAME_MAX], int
@@ -1,26 +1,18 @@
 #ifndef __PFS_BUF_H__
 #define __PFS_BUF_H__
 
-/* Buffer (block) cache.
+/* Pipe buffers. Each pipe inode in use has one buffer, holding the data of
+ * the pipe in a ring. The ring grows as needed, in powers of two, up to
+ * PIPE_SIZE_MAX bytes; VFS decides how much of it a pipe may use.
  */
 
 struct buf {
-  /* Data portion of the buffer. */
-  char b_data[PIPE_BUF];     /* ordinary user data */
-
-  /* Header portion of the buffer. */
-  struct buf *b_next;           /* used to link all free bufs in a chain */
-  struct buf *b_prev;           /* used to link all free bufs the other way */
-  ino_t b_num;			/* inode number on minor device */
-  dev_t b_dev;                  /* major | minor device where block resides */
-  int b_bytes;                  /* Number of bytes allocated in bp */
+  char *b_data;			/* the ring; NULL until data is written */
+  size_t b_size;		/* bytes allocated for b_data */
+  size_t b_head;		/* offset of the first byte in the ring */
   int b_count;			/* Number of users of this buffer */
 };
 
-/* A block is free if b_dev == NO_DEV. */
-
-
-EXTERN struct buf *front;	/* points to least recently used free block */
-EXTERN struct buf *rear;	/* points to most recently used free block */
+#define PIPE_RING_MIN	(8 * PIPE_BUF)	/* smallest ring allocated */
 
 #endif
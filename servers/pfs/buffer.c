@@ -2,102 +2,87 @@
 #include "buf.h"
 #include "inode.h"
 #include <sys/types.h>
+#include <sys/param.h>
 #include <stdlib.h>
 #include <string.h>
 
-static struct buf *new_block(dev_t dev, ino_t inum);
 
 /*===========================================================================*
- *                              buf_pool                                     *
+ *				get_block				     *
  *===========================================================================*/
-void buf_pool(void)
+struct buf *get_block(struct inode *rip)
 {
-/* Initialize the buffer pool. */
-
-  front = NULL;
-  rear = NULL;
-}
-
+/* Return the buffer of a pipe inode, creating it if it does not exist yet. */
+  struct buf *bp;
 
+  if ((bp = rip->i_buf) != NULL) {
+	bp->b_count++;
+	return(bp);
+  }
 
-/*===========================================================================*
- *				get_block				     *
- *===========================================================================*/
-struct buf *get_block(dev_t dev, ino_t inum)
-{
-  struct buf *bp = front;
-
-  while(bp != NULL) {
-	if (bp->b_dev == dev && bp->b_num == inum) {
-		bp->b_count++;
-		return(bp);
-	}
-	bp = bp->b_next;
+  bp = malloc(sizeof(struct buf));
+  if (bp == NULL) {
+	err_code = ENOSPC;
+	return(NULL);
   }
+  bp->b_data = NULL;
+  bp->b_size = 0;
+  bp->b_head = 0;
+  bp->b_count = 1;
+  rip->i_buf = bp;
 
-  /* Buffer was not found. Try to allocate a new one */
-  return new_block(dev, inum);
+  return(bp);
 }
 
 
 /*===========================================================================*
- *				new_block				     *
+ *				grow_block				     *
  *===========================================================================*/
-static struct buf *new_block(dev_t dev, ino_t inum)
+int grow_block(struct buf *bp, size_t used, size_t size)
 {
-/* Allocate a new buffer and add it to the double linked buffer list */
-  struct buf *bp;
+/* Make the ring of a buffer holding 'used' bytes large enough to hold 'size'
+ * bytes. The data is moved to the start of the new ring.
+ */
+  char *data;
+  size_t new_size, chunk;
 
-  bp = malloc(sizeof(struct buf));
-  if (bp == NULL) {
-	err_code = ENOSPC;
-	return(NULL);
-  }
-  bp->b_num = inum;
-  bp->b_dev = dev;
-  bp->b_bytes = 0;
-  bp->b_count = 1;
-  memset(bp->b_data, 0 , PIPE_BUF);
-
-  /* Add at the end of the buffer */
-  if (front == NULL) {	/* Empty list? */
-	front = bp;
-	bp->b_prev = NULL;
-  } else {
-	rear->b_next = bp;
-	bp->b_prev = rear;
+  if (size <= bp->b_size) return(OK);
+  if (size > PIPE_SIZE_MAX) return(EFBIG);
+
+  for (new_size = MAX(bp->b_size, PIPE_RING_MIN); new_size < size;
+       new_size <<= 1)
+	;
+
+  if ((data = malloc(new_size)) == NULL) return(ENOSPC);
+
+  if (used > 0) {
+	chunk = MIN(used, bp->b_size - bp->b_head);
+	memcpy(data, bp->b_data + bp->b_head, chunk);
+	memcpy(data + chunk, bp->b_data, used - chunk);
   }
-  bp->b_next = NULL;
-  rear = bp;
 
-  return(bp);
+  free(bp->b_data);
+  bp->b_data = data;
+  bp->b_size = new_size;
+  bp->b_head = 0;
+
+  return(OK);
 }
 
 
 /*===========================================================================*
  *				put_block				     *
  *===========================================================================*/
-void put_block(dev_t dev, ino_t inum)
+void put_block(struct inode *rip)
 {
   struct buf *bp;
 
-  bp = get_block(dev, inum);
-  if (bp == NULL) return; /* We didn't find the block. Nothing to put. */
+  if ((bp = rip->i_buf) == NULL) return; /* Nothing to put. */
 
-  bp->b_count--;	/* Compensate for above 'get_block'. */
   if (--bp->b_count > 0) return;
 
-  /* Cut bp out of the loop */
-  if (bp->b_prev == NULL)
-	front = bp->b_next;
-  else
-	bp->b_prev->b_next = bp->b_next;
-
-  if (bp->b_next == NULL)
-	rear = bp->b_prev;
-  else
-	bp->b_next->b_prev = bp->b_prev;
-
   /* Buffer administration is done. Now it's safe to free up bp. */
+  rip->i_buf = NULL;
+  free(bp->b_data);
   free(bp);
 }
@@ -36,6 +36,8 @@ static int uds_perform_read(int minor, endpoint_t m_source, size_t
 	size, int pretend);
 static int uds_perform_write(int minor, endpoint_t m_source, size_t
 	size, int pretend);
+static int uds_handoff(int minor, int peer, endpoint_t m_source, size_t
+	size);
 
 int uds_open(message *dev_m_in, message *dev_m_out)
 {
@@ -482,6 +484,46 @@ static int uds_perform_read(int minor, endpoint_t m_source,
 	return fs_m_out.RES_NBYTES; /* return number of bytes read */
 }
 
+static int uds_handoff(int minor, int peer, endpoint_t m_source,
+						size_t size)
+{
+	/* The peer is suspended reading from an empty stream and wants at
+	 * least 'size' bytes. Deliver the data of the writer straight to the
+	 * reader and revive it, rather than going through the socket buffer
+	 * and then performing the suspended read. A grant can only be copied
+	 * to or from our own memory, so the data passes through 'stage'.
+	 */
+	static char stage[PIPE_BUF];
+	message m_out;
+	int rc;
+
+	rc = sys_safecopyfrom(VFS_PROC_NR, uds_fd_table[minor].io_gr,
+			(vir_bytes) 0, (vir_bytes) stage, size);
+	if (rc != OK) {
+		return rc;
+	}
+
+	rc = sys_safecopyto(VFS_PROC_NR, uds_fd_table[peer].io_gr,
+			(vir_bytes) 0, (vir_bytes) stage, size);
+	if (rc != OK) {
+		return rc;
+	}
+
+#if DEBUG == 1
+	printf("(uds) [%d] handed %d bytes to [%d]\n", minor, size, peer);
+#endif
+
+	/* the read is complete, revive the reader */
+	uds_fd_table[peer].ready_to_revive = 0;
+	uds_fd_table[peer].suspended = UDS_NOT_SUSPENDED;
+
+	uds_set_reply(&m_out, DEV_REVIVE, uds_fd_table[peer].endpoint,
+		      uds_fd_table[peer].io_gr, size);
+	reply(m_source, &m_out);
+
+	return size;
+}
+
 static int uds_perform_write(int minor, endpoint_t m_source,
 						size_t size, int pretend)
 {
@@ -560,6 +602,15 @@ static int uds_perform_write(int minor, endpoint_t m_source,
 		return ENOENT;
 	}
 
+	/* a reader waiting on an empty stream can get the data directly */
+	if (!pretend && uds_fd_table[minor].type == SOCK_STREAM &&
+		uds_fd_table[peer].size == 0 &&
+		uds_fd_table[peer].suspended == UDS_SUSPENDED_READ &&
+		uds_fd_table[peer].io_gr_size >= size) {
+
+		return uds_handoff(minor, peer, m_source, size);
+	}
+
 	/* check if write would overrun buffer. check if message
 	 * boundry preserving types (SEQPACKET and DGRAM) wouldn't write
 	 * to an empty buffer. check if connectionless sockets have a
@@ -32,8 +32,6 @@ int fs_putnode(message *fs_m_in, message *fs_m_out)
 
   struct inode *rip;
   int count;
-  dev_t dev;
-  ino_t inum;
 
   rip = find_inode( (ino_t) fs_m_in->REQ_INODE_NR);
 
@@ -57,10 +55,8 @@ int fs_putnode(message *fs_m_in, message *fs_m_out)
   /* Decrease reference counter, but keep one reference; it will be consumed by
    * put_inode(). */
   rip->i_count -= count - 1;
-  dev = rip->i_dev;
-  inum = rip->i_num;
   put_inode(rip);
-  if (rip->i_count == 0) put_block(dev, inum);
+  if (rip->i_count == 0) put_block(rip);
   return(OK);
 }
 
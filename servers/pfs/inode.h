@@ -22,6 +22,7 @@ EXTERN struct inode {
   ino_t i_num;			/* inode number on its (minor) device */
   int i_count;			/* # times inode used; 0 means slot is free */
   char i_update;		/* the ATIME, CTIME, and MTIME bits are here */
+  struct buf *i_buf;		/* data of a pipe, or NULL */
 
   LIST_ENTRY(inode) i_hash;     /* hash list */
   TAILQ_ENTRY(inode) i_unused;  /* free and unused list */
@@ -130,11 +130,11 @@ static int sef_cb_init_fresh(int type, sef_init_info_t *info)
   /* Init inode table */
   for (i = 0; i < NR_INODES; ++i) {
 	inode[i].i_count = 0;
+	inode[i].i_buf = NULL;
   }
 
   init_inode_cache();
   uds_init();
-  buf_pool();
 
 
   /* Drop root privileges */
@@ -29,7 +29,7 @@ int fs_newnode(message *fs_m_in, message *fs_m_out)
 		rip->i_rdev = dev;		/* Major/minor dev numbers */
 		break;
 	case S_IFIFO:
-		if ((get_block(dev, rip->i_num)) == NULL)
+		if ((get_block(rip)) == NULL)
 			r = EIO;
 		break;
 	default:
@@ -10,11 +10,9 @@ struct sockaddr_un;
 struct ancillary;
 
 /* buffer.c */
-struct buf *get_block(dev_t dev, ino_t inum);
-void put_block(dev_t dev, ino_t inum);
-
-/* cache.c */
-void buf_pool(void);
+struct buf *get_block(struct inode *rip);
+void put_block(struct inode *rip);
+int grow_block(struct buf *bp, size_t used, size_t size);
 
 /* inode.c */
 struct inode *alloc_inode(dev_t dev, mode_t mode);
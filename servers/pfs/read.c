@@ -3,6 +3,7 @@
 #include "inode.h"
 #include <minix/com.h>
 #include <string.h>
+#include <sys/param.h>
 
 
 /*===========================================================================*
@@ -14,7 +15,7 @@ int fs_readwrite(message *fs_m_in, message *fs_m_out)
   struct buf *bp;
   cp_grant_id_t gid;
   off_t position, f_size;
-  unsigned int nrbytes, cum_io;
+  unsigned int nrbytes, cum_io, off, chunk;
   mode_t mode_word;
   struct inode *rip;
   ino_t inumb;
@@ -36,11 +37,11 @@ int fs_readwrite(message *fs_m_in, message *fs_m_out)
   nrbytes = (unsigned) fs_m_in->REQ_NBYTES;
 
   /* We can't read beyond the max file position */
-  if (nrbytes > PIPE_BUF) return(EFBIG);
+  if (nrbytes > PIPE_SIZE_MAX) return(EFBIG);
 
   /* Mark inode in use */
   if ((get_inode(rip->i_dev, rip->i_num)) == NULL) return(err_code);
-  if ((bp = get_block(rip->i_dev, rip->i_num)) == NULL) return(err_code);
+  if ((bp = get_block(rip)) == NULL) return(err_code);
 
   if (rw_flag == WRITING) {
 	/* Check in advance to see if file will grow too big. */
@@ -48,10 +49,11 @@ int fs_readwrite(message *fs_m_in, message *fs_m_out)
 	 * be beyond max signed value (i.e., MAX_FILE_POS).
 	 */
 	position = rip->i_size;
-	if ((unsigned) position + nrbytes > PIPE_BUF) {
+	if ((r = grow_block(bp, (size_t) position,
+			    (size_t) position + nrbytes)) != OK) {
 		put_inode(rip);
-		put_block(rip->i_dev, rip->i_num);
-		return(EFBIG);
+		put_block(rip);
+		return(r);
 	}
   } else {
 	position = 0;
@@ -61,14 +63,28 @@ int fs_readwrite(message *fs_m_in, message *fs_m_out)
 	}
   }
 
-  if (rw_flag == READING) {
-	/* Copy a chunk from the block buffer to user space. */
-	r = sys_safecopyto(VFS_PROC_NR, gid, (vir_bytes) 0,
-		(vir_bytes) (bp->b_data+position), (size_t) nrbytes);
-  } else {
-	/* Copy a chunk from user space to the block buffer. */
-	r = sys_safecopyfrom(VFS_PROC_NR, gid, (vir_bytes) 0,
-		(vir_bytes) (bp->b_data+position), (size_t) nrbytes);
+  /* The data starts at b_head in the ring and may wrap around its end, so
+   * copy in at most two pieces.
+   */
+  if (nrbytes > 0) {
+	off = (bp->b_head + (size_t) position) % bp->b_size;
+	chunk = MIN(nrbytes, bp->b_size - off);
+
+	if (rw_flag == READING) {
+		/* Copy a chunk from the block buffer to user space. */
+		r = sys_safecopyto(VFS_PROC_NR, gid, (vir_bytes) 0,
+			(vir_bytes) (bp->b_data+off), (size_t) chunk);
+		if (r == OK && chunk < nrbytes)
+			r = sys_safecopyto(VFS_PROC_NR, gid, (vir_bytes) chunk,
+				(vir_bytes) bp->b_data, (size_t) (nrbytes-chunk));
+	} else {
+		/* Copy a chunk from user space to the block buffer. */
+		r = sys_safecopyfrom(VFS_PROC_NR, gid, (vir_bytes) 0,
+			(vir_bytes) (bp->b_data+off), (size_t) chunk);
+		if (r == OK && chunk < nrbytes)
+			r = sys_safecopyfrom(VFS_PROC_NR, gid, (vir_bytes) chunk,
+				(vir_bytes) bp->b_data, (size_t) (nrbytes-chunk));
+	}
   }
 
   if (r == OK) {
@@ -80,8 +96,8 @@ int fs_readwrite(message *fs_m_in, message *fs_m_out)
   if (rw_flag == WRITING) {
 	rip->i_size = position;
   } else {
-	memmove(bp->b_data, bp->b_data+nrbytes, rip->i_size - nrbytes);
-	rip->i_size -= nrbytes;
+	rip->i_size -= cum_io;
+	bp->b_head = (rip->i_size == 0 ? 0 : (bp->b_head + cum_io) % bp->b_size);
   }
 
   if (rw_flag == READING) rip->i_update |= ATIME;
@@ -90,7 +106,7 @@ int fs_readwrite(message *fs_m_in, message *fs_m_out)
   fs_m_out->RES_SEEK_POS_LO = rip->i_size;
 
   put_inode(rip);
-  put_block(rip->i_dev, rip->i_num);
+  put_block(rip);
 
   return(r);
 }
@@ -1,4 +1,5 @@
 #include "fs.h"
+#include "buf.h"
 #include "inode.h"
 #include <string.h>
 #include <sys/stat.h>
@@ -43,7 +44,7 @@ static int stat_inode(
   statbuf.st_atime = rip->i_atime;
   statbuf.st_mtime = rip->i_mtime;
   statbuf.st_ctime = rip->i_ctime;
-  statbuf.st_blksize = PIPE_BUF;
+  statbuf.st_blksize = PIPE_RING_MIN;	/* let stdio use larger chunks */
   statbuf.st_blocks = blocks;
 
   /* Copy the struct to user space. */
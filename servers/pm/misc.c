@@ -6,6 +6,7 @@
  *   do_getprocnr: lookup process slot number  (Jorrit N. Herder)
  *   do_getepinfo: get the pid/uid/gid of a process given its endpoint
  *   do_getsetpriority: get/set process priority
+ *   do_setdeadline: set the EDF period and deadline of a process
  *   do_svrctl: process manager control
  */
 
@@ -365,6 +366,30 @@ int do_getsetpriority()
 	return(OK);
 }
 
+/*===========================================================================*
+ *				do_setdeadline				     *
+ *===========================================================================*/
+int do_setdeadline()
+{
+	pid_t arg_pid;
+	struct mproc *rmp;
+
+	arg_pid = m_in.PM_DL_PID;
+
+	if (arg_pid == 0)
+		rmp = mp;
+	else
+		if ((rmp = find_proc(arg_pid)) == NULL)
+			return(ESRCH);
+
+	if (mp->mp_effuid != SUPER_USER &&
+	   mp->mp_effuid != rmp->mp_effuid && mp->mp_effuid != rmp->mp_realuid)
+		return EPERM;
+
+	return sched_deadline(rmp, (unsigned) m_in.PM_DL_PERIOD,
+		(unsigned) m_in.PM_DL_DEADLINE);
+}
+
 /*===========================================================================*
  *				do_svrctl				     *
  *===========================================================================*/
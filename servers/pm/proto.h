@@ -56,11 +56,13 @@ int do_getepinfo(void);
 int do_getepinfo_o(void);
 int do_svrctl(void);
 int do_getsetpriority(void);
+int do_setdeadline(void);
 
 /* schedule.c */
 void sched_init(void);
 int sched_start_user(endpoint_t ep, struct mproc *rmp);
 int sched_nice(struct mproc *rmp, int nice);
+int sched_deadline(struct mproc *rmp, unsigned period, unsigned deadline);
 
 /* profile.c */
 int do_sprofile(void);
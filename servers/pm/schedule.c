@@ -99,3 +99,20 @@ int sched_nice(struct mproc *rmp, int nice)
 
 	return (OK);
 }
+
+/*===========================================================================*
+ *				sched_deadline				     *
+ *===========================================================================*/
+int sched_deadline(struct mproc *rmp, unsigned period, unsigned deadline)
+{
+	message m;
+
+	/* As with nice, only a user-space scheduler can honor deadlines. */
+	if (rmp->mp_scheduler == KERNEL || rmp->mp_scheduler == NONE)
+		return (EINVAL);
+
+	m.SCHEDULING_ENDPOINT	= rmp->mp_endpoint;
+	m.SCHEDULING_PERIOD	= period;
+	m.SCHEDULING_DEADLINE	= deadline;
+	return _taskcall(rmp->mp_scheduler, SCHEDULING_SET_DEADLINE, &m);
+}
@@ -67,7 +67,7 @@ int (*call_vec[])(void) = {
 	no_sys,		/* 53 = (lstat)	*/
 	no_sys,		/* 54 = ioctl	*/
 	no_sys,		/* 55 = fcntl	*/
-	no_sys,		/* 56 = unused	*/
+	do_setdeadline,	/* 56 = setdeadline */
 	no_sys,		/* 57 = unused	*/
 	no_sys,		/* 58 = unused	*/
 	do_exec,	/* 59 = execve	*/
@@ -86,9 +86,11 @@ static void print_cpu_flags(u32_t * flags)
 	buf_printf("\n");
 }
 
-static void print_cpu(struct cpu_info * cpu_info, unsigned id)
+static void print_cpu(struct cpu_info * cpu_info,
+	struct cpu_load_info * load, unsigned id)
 {
 	buf_printf("%-16s: %d\n", "processor", id);
+	buf_printf("%-16s: %u\n", "wakeups", load->cl_wakeups);
 
 #if defined(__i386__)
 	switch (cpu_info->vendor) {
@@ -117,6 +119,7 @@ static void print_cpu(struct cpu_info * cpu_info, unsigned id)
 void root_cpuinfo(void)
 {
 	struct cpu_info cpu_info[CONFIG_MAX_CPUS];
+	static struct cpu_load_info load[CONFIG_MAX_CPUS];
 	struct machine machine;
 	unsigned c;
 
@@ -128,7 +131,11 @@ void root_cpuinfo(void)
 		printf("PROCFS: cannot get cpu info\n");
 		return;
 	}
+	if (sys_getcpuload(load)) {
+		printf("PROCFS: cannot get cpu load\n");
+		return;
+	}
 
 	for (c = 0; c < machine.processors_count; c++)
-		print_cpu(&cpu_info[c], c);
+		print_cpu(&cpu_info[c], &load[c], c);
 }
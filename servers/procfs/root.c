@@ -6,6 +6,7 @@
 #include <machine/pci.h>
 #endif
 #include <minix/dmap.h>
+#include <minix/sched.h>
 #include "cpuinfo.h"
 #include "mounts.h"
 
@@ -19,6 +20,8 @@ static void root_pci(void);
 #endif
 static void root_dmap(void);
 static void root_ipcvecs(void);
+static void root_sched(void);
+static void root_edf(void);
 
 struct file root_files[] = {
 	{ "hz",		REG_ALL_MODE,	(data_t) root_hz	},
@@ -35,6 +38,8 @@ struct file root_files[] = {
 #endif
 	{ "ipcvecs",	REG_ALL_MODE,	(data_t) root_ipcvecs	},
 	{ "mounts",	REG_ALL_MODE,	(data_t) root_mounts	},
+	{ "sched",	REG_ALL_MODE,	(data_t) root_sched	},
+	{ "edf",	REG_ALL_MODE,	(data_t) root_edf	},
 	{ NULL,		0,		NULL			}
 };
 
@@ -179,6 +184,54 @@ static void root_dmap(void)
 	}
 }
 
+/*===========================================================================*
+ *				root_sched				     *
+ *===========================================================================*/
+static void root_sched(void)
+{
+	/* Print scheduler statistics.
+	 */
+	struct sched_stats stats;
+
+	if (getsysinfo(SCHED_PROC_NR, SI_SCHED_STATS, &stats,
+			sizeof(stats)) != OK)
+		return;
+
+	buf_printf("%d %u %u %lu %lu %lu %u %lu %lu %lu %lu\n",
+		stats.ss_policy, stats.ss_lottery_procs,
+		stats.ss_lottery_tickets, stats.ss_lottery_draws,
+		ex64hi(stats.ss_lottery_cycles),
+		ex64lo(stats.ss_lottery_cycles), stats.ss_edf_procs,
+		stats.ss_edf_served, stats.ss_edf_missed, stats.ss_migrations,
+		stats.ss_steals);
+}
+
+/*===========================================================================*
+ *				root_edf				     *
+ *===========================================================================*/
+static void root_edf(void)
+{
+	/* Print the EDF parameters and statistics of every process that has
+	 * had a deadline set.
+	 */
+	static struct sched_edf_stats tab[NR_PROCS];
+	int i;
+
+	if (getsysinfo(SCHED_PROC_NR, SI_SCHED_EDF_TAB, tab,
+			sizeof(tab)) != OK)
+		return;
+
+	for (i = 0; i < NR_PROCS; i++) {
+		if (tab[i].se_endpoint == NONE || tab[i].se_jobs == 0)
+			continue;
+
+		buf_printf("%d %ld %ld %lu %lu %ld\n", tab[i].se_endpoint,
+			(long) tab[i].se_period, (long) tab[i].se_deadline,
+			tab[i].se_jobs, tab[i].se_missed,
+			(long) tab[i].se_maxlate);
+	}
+}
+
 /*===========================================================================*
  *				root_ipcvecs				     *
  *===========================================================================*/
@@ -0,0 +1,315 @@
+/* This file contains the run set behind the EDF policy of SCHED.
+ *
+ * Processes waiting in the lowest user queue are kept in a binary min-heap
+ * keyed on their absolute deadline, in clock ticks since boot as returned by
+ * getuptime(). Processes without a deadline sort after all others. A process
+ * may be periodic, in which case a new job with a fresh deadline is released
+ * every period. Deadlines are re-armed lazily, whenever a process enters the
+ * run set or surfaces at the top of the heap.
+ *
+ * A deadline counts as missed when a job is first served after its deadline
+ * has passed, or when its period ends while the process is still waiting in
+ * the run set without having been served at all.
+ *
+ * The entry points are:
+ *   edf_enter:		add a process to the run set
+ *   edf_leave:		take a process out of the run set
+ *   edf_pick:		take the process with the earliest deadline
+ *   edf_set_deadline:	set the period and relative deadline of a process
+ *   edf_rebuild:	recompute the run set from the process table
+ *   edf_getstats:	report the global EDF statistics
+ *   edf_gettab:	report the per-process EDF statistics
+ */
+#include "sched.h"
+#include "schedproc.h"
+#include <assert.h>
+#include <minix/sched.h>
+#include <machine/archtypes.h>
+#include "kernel/proc.h" /* for queue constants */
+
+static struct schedproc *edf_heap[NR_PROCS];
+static int edf_size;
+
+static unsigned long edf_served;	/* jobs served */
+static unsigned long edf_missed;	/* deadlines missed */
+
+static int edf_before(struct schedproc *a, struct schedproc *b);
+static void edf_place(int i, struct schedproc *rmp);
+static void sift_up(int i);
+static void sift_down(int i);
+static void edf_rearm(struct schedproc *rmp, clock_t now, int waiting);
+
+/*===========================================================================*
+ *				edf_before				     *
+ *===========================================================================*/
+static int edf_before(struct schedproc *a, struct schedproc *b)
+{
+	/* A process without a deadline never runs before one with a deadline.
+	 */
+	if (a->deadline == 0)
+		return FALSE;
+	if (b->deadline == 0)
+		return TRUE;
+	return a->deadline < b->deadline;
+}
+
+/*===========================================================================*
+ *				edf_place				     *
+ *===========================================================================*/
+static void edf_place(int i, struct schedproc *rmp)
+{
+	edf_heap[i] = rmp;
+	rmp->edf_index = i;
+}
+
+/*===========================================================================*
+ *				sift_up					     *
+ *===========================================================================*/
+static void sift_up(int i)
+{
+	struct schedproc *rmp = edf_heap[i];
+	int parent;
+
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (!edf_before(rmp, edf_heap[parent]))
+			break;
+		edf_place(i, edf_heap[parent]);
+		i = parent;
+	}
+	edf_place(i, rmp);
+}
+
+/*===========================================================================*
+ *				sift_down				     *
+ *===========================================================================*/
+static void sift_down(int i)
+{
+	struct schedproc *rmp = edf_heap[i];
+	int child;
+
+	while ((child = 2 * i + 1) < edf_size) {
+		if (child + 1 < edf_size &&
+				edf_before(edf_heap[child + 1], edf_heap[child]))
+			child++;
+		if (!edf_before(edf_heap[child], rmp))
+			break;
+		edf_place(i, edf_heap[child]);
+		i = child;
+	}
+	edf_place(i, rmp);
+}
+
+/*===========================================================================*
+ *				edf_rearm				     *
+ *===========================================================================*/
+static void edf_rearm(struct schedproc *rmp, clock_t now, int waiting)
+{
+	/* Advance a periodic process to the job that is current at 'now'. If
+	 * the process has been waiting in the run set all along, the jobs that
+	 * ended without being served have missed their deadline.
+	 */
+	unsigned long jobs, missed;
+
+	if (rmp->edf_period == 0 || now - rmp->edf_release < rmp->edf_period)
+		return;
+
+	jobs = (now - rmp->edf_release) / rmp->edf_period;
+	if (waiting) {
+		missed = jobs - ((rmp->flags & EDF_SERVED) ? 1 : 0);
+		rmp->edf_missed += missed;
+		edf_missed += missed;
+	}
+	rmp->edf_jobs += jobs;
+	rmp->edf_release += jobs * rmp->edf_period;
+	rmp->deadline = rmp->edf_release + rmp->edf_reldl;
+	rmp->flags &= ~EDF_SERVED;
+}
+
+/*===========================================================================*
+ *				edf_enter				     *
+ *===========================================================================*/
+void edf_enter(struct schedproc *rmp)
+{
+	clock_t now;
+	int r;
+
+	if (rmp->flags & IN_EDF)
+		return;
+
+	if ((r = getuptime(&now)) != OK)
+		panic("SCHED: getuptime failed: %d", r);
+	edf_rearm(rmp, now, FALSE);
+
+	rmp->flags |= IN_EDF;
+	edf_heap[edf_size] = rmp;
+	sift_up(edf_size++);
+}
+
+/*===========================================================================*
+ *				edf_leave				     *
+ *===========================================================================*/
+void edf_leave(struct schedproc *rmp)
+{
+	struct schedproc *last;
+	int i;
+
+	if (!(rmp->flags & IN_EDF))
+		return;
+
+	rmp->flags &= ~IN_EDF;
+	i = rmp->edf_index;
+	assert(i >= 0 && i < edf_size && edf_heap[i] == rmp);
+	rmp->edf_index = -1;
+
+	if (i == --edf_size)
+		return;
+	last = edf_heap[edf_size];
+	edf_place(i, last);
+	sift_up(i);
+	sift_down(last->edf_index);
+}
+
+/*===========================================================================*
+ *				edf_pick				     *
+ *===========================================================================*/
+struct schedproc *edf_pick(void)
+{
+	/* Take the process with the earliest current deadline out of the run
+	 * set and account for its job being served. Returns NULL if the run
+	 * set is empty.
+	 */
+	struct schedproc *rmp;
+	clock_t now, old;
+	int r;
+
+	if (edf_size == 0)
+		return NULL;
+
+	if ((r = getuptime(&now)) != OK)
+		panic("SCHED: getuptime failed: %d", r);
+
+	/* Re-arming only moves deadlines forward, so a stale top is the only
+	 * thing that can hide the real earliest deadline.
+	 */
+	for (;;) {
+		rmp = edf_heap[0];
+		old = rmp->deadline;
+		edf_rearm(rmp, now, TRUE);
+		if (rmp->deadline == old)
+			break;
+		sift_down(0);
+	}
+
+	edf_leave(rmp);
+
+	if (rmp->deadline != 0 && !(rmp->flags & EDF_SERVED)) {
+		rmp->flags |= EDF_SERVED;
+		edf_served++;
+		if (now > rmp->deadline) {
+			rmp->edf_missed++;
+			edf_missed++;
+			if (now - rmp->deadline > rmp->edf_maxlate)
+				rmp->edf_maxlate = now - rmp->deadline;
+		}
+	}
+
+	return rmp;
+}
+
+/*===========================================================================*
+ *				edf_set_deadline			     *
+ *===========================================================================*/
+int edf_set_deadline(struct schedproc *rmp, unsigned period_ms,
+	unsigned deadline_ms)
+{
+	/* Set new EDF parameters, given in milliseconds, and release the first
+	 * job right away. A zero deadline on a periodic process defaults to
+	 * the period; a zero deadline on an aperiodic one clears the deadline.
+	 */
+	clock_t now;
+	int r;
+
+	if ((r = getuptime(&now)) != OK)
+		return r;
+
+	if (deadline_ms == 0)
+		deadline_ms = period_ms;
+
+	rmp->edf_period = (clock_t) ((u64_t) period_ms * sys_hz() / 1000);
+	rmp->edf_reldl = (clock_t) ((u64_t) deadline_ms * sys_hz() / 1000);
+	if (period_ms != 0 && rmp->edf_period == 0)
+		rmp->edf_period = 1;
+	if (deadline_ms != 0 && rmp->edf_reldl == 0)
+		rmp->edf_reldl = 1;
+
+	rmp->edf_release = now;
+	rmp->deadline = deadline_ms != 0 ? now + rmp->edf_reldl : 0;
+	rmp->edf_jobs = deadline_ms != 0 ? 1 : 0;
+	rmp->edf_missed = 0;
+	rmp->edf_maxlate = 0;
+	rmp->flags &= ~EDF_SERVED;
+
+	/* The key may have moved either way. */
+	if (rmp->flags & IN_EDF) {
+		sift_up(rmp->edf_index);
+		sift_down(rmp->edf_index);
+	}
+
+	return OK;
+}
+
+/*===========================================================================*
+ *				edf_rebuild				     *
+ *===========================================================================*/
+void edf_rebuild(int enable)
+{
+	/* Recompute the run set from scratch. If 'enable' is set, every process
+	 * waiting in the lowest user queue is put into the run set; otherwise
+	 * the run set is emptied.
+	 */
+	struct schedproc *rmp;
+	int i;
+
+	for (i = 0; i < edf_size; i++) {
+		edf_heap[i]->flags &= ~IN_EDF;
+		edf_heap[i]->edf_index = -1;
+	}
+	edf_size = 0;
+
+	if (!enable)
+		return;
+
+	for (i = 0, rmp = schedproc; i < NR_PROCS; i++, rmp++) {
+		if ((rmp->flags & IN_USE) && rmp->priority == MIN_USER_Q)
+			edf_enter(rmp);
+	}
+}
+
+/*===========================================================================*
+ *				edf_getstats				     *
+ *===========================================================================*/
+void edf_getstats(struct sched_stats *stats)
+{
+	stats->ss_edf_procs = edf_size;
+	stats->ss_edf_served = edf_served;
+	stats->ss_edf_missed = edf_missed;
+}
+
+/*===========================================================================*
+ *				edf_gettab				     *
+ *===========================================================================*/
+void edf_gettab(struct sched_edf_stats *tab)
+{
+	struct schedproc *rmp;
+	int i;
+
+	for (i = 0, rmp = schedproc; i < NR_PROCS; i++, rmp++, tab++) {
+		tab->se_endpoint = (rmp->flags & IN_USE) ? rmp->endpoint : NONE;
+		tab->se_period = rmp->edf_period;
+		tab->se_deadline = rmp->edf_reldl;
+		tab->se_jobs = rmp->edf_jobs;
+		tab->se_missed = rmp->edf_missed;
+		tab->se_maxlate = rmp->edf_maxlate;
+	}
+}
@@ -0,0 +1,164 @@
+/* This file contains the ticket tree behind the LOTTERY policy of SCHED.
+ *
+ * The tickets of all processes taking part in the lottery are kept in a
+ * binary indexed (Fenwick) tree, keyed by schedproc slot. Entering, leaving
+ * and re-weighting a process as well as drawing a winner each take
+ * O(log NR_PROCS) steps, rather than two scans over the process table.
+ *
+ * The entry points are:
+ *   lottery_enter:	   add a process' tickets to the draw
+ *   lottery_leave:	   take a process' tickets out of the draw
+ *   lottery_set_tickets:  change the number of tickets a process holds
+ *   lottery_draw:	   draw a winner, weighted by tickets
+ *   lottery_rebuild:	   recompute the tree from the process table
+ *   lottery_getstats:	   report the lottery statistics
+ */
+#include "sched.h"
+#include "schedproc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <minix/sched.h>
+#include <minix/minlib.h>
+#include <machine/archtypes.h>
+#include "kernel/proc.h" /* for queue constants */
+
+/* Partial ticket sums. Entry i (1-based) covers slots i-lowbit(i) .. i-1. */
+static unsigned lottery_tree[NR_PROCS + 1];
+static unsigned lottery_top;		/* highest power of two <= NR_PROCS */
+
+static unsigned lottery_procs;		/* processes in the draw */
+static unsigned lottery_tickets;	/* sum of their tickets */
+static unsigned long lottery_draws;	/* number of draws held */
+static u64_t lottery_cycles;		/* TSC cycles spent drawing */
+
+#define lowbit(i)	((i) & -(i))
+
+static void tree_add(int slot, int delta);
+
+/*===========================================================================*
+ *				tree_add				     *
+ *===========================================================================*/
+static void tree_add(int slot, int delta)
+{
+	unsigned i;
+
+	for (i = slot + 1; i <= NR_PROCS; i += lowbit(i))
+		lottery_tree[i] += delta;
+	lottery_tickets += delta;
+}
+
+/*===========================================================================*
+ *				lottery_enter				     *
+ *===========================================================================*/
+void lottery_enter(struct schedproc *rmp)
+{
+	if (rmp->flags & IN_LOTTERY)
+		return;
+
+	rmp->flags |= IN_LOTTERY;
+	tree_add(rmp - schedproc, rmp->lottery_num);
+	lottery_procs++;
+}
+
+/*===========================================================================*
+ *				lottery_leave				     *
+ *===========================================================================*/
+void lottery_leave(struct schedproc *rmp)
+{
+	if (!(rmp->flags & IN_LOTTERY))
+		return;
+
+	rmp->flags &= ~IN_LOTTERY;
+	tree_add(rmp - schedproc, -(int) rmp->lottery_num);
+	lottery_procs--;
+}
+
+/*===========================================================================*
+ *				lottery_set_tickets			     *
+ *===========================================================================*/
+void lottery_set_tickets(struct schedproc *rmp, unsigned tickets)
+{
+	if (rmp->flags & IN_LOTTERY)
+		tree_add(rmp - schedproc, (int) tickets - (int) rmp->lottery_num);
+	rmp->lottery_num = tickets;
+}
+
+/*===========================================================================*
+ *				lottery_draw				     *
+ *===========================================================================*/
+struct schedproc *lottery_draw(void)
+{
+	/* Draw a ticket and descend the tree to the slot holding it. Returns
+	 * NULL if nobody takes part in the lottery. The winner is not taken
+	 * out of the draw; that is up to the caller.
+	 */
+	unsigned ticket, step, pos;
+	u64_t start, end;
+
+	if (lottery_tickets == 0)
+		return NULL;
+
+	read_tsc_64(&start);
+
+	ticket = random() % lottery_tickets + 1;
+	pos = 0;
+	for (step = lottery_top; step > 0; step >>= 1) {
+		if (pos + step <= NR_PROCS && lottery_tree[pos + step] < ticket) {
+			pos += step;
+			ticket -= lottery_tree[pos];
+		}
+	}
+
+	read_tsc_64(&end);
+	lottery_cycles += end - start;
+	lottery_draws++;
+
+	assert(pos < NR_PROCS);
+	assert(schedproc[pos].flags & IN_LOTTERY);
+	return &schedproc[pos];
+}
+
+/*===========================================================================*
+ *				lottery_rebuild				     *
+ *===========================================================================*/
+void lottery_rebuild(int enable)
+{
+	/* Recompute the tree from scratch in O(NR_PROCS). If 'enable' is set,
+	 * every process waiting in the lowest user queue takes part in the
+	 * lottery; otherwise the lottery is emptied.
+	 */
+	struct schedproc *rmp;
+	unsigned i, j;
+
+	lottery_top = 1;
+	while (lottery_top * 2 <= NR_PROCS)
+		lottery_top *= 2;
+
+	lottery_procs = lottery_tickets = 0;
+	memset(lottery_tree, 0, sizeof(lottery_tree));
+
+	for (i = 1, rmp = schedproc; i <= NR_PROCS; i++, rmp++) {
+		rmp->flags &= ~IN_LOTTERY;
+		if (enable && (rmp->flags & IN_USE) &&
+				rmp->priority == MIN_USER_Q) {
+			rmp->flags |= IN_LOTTERY;
+			lottery_tree[i] += rmp->lottery_num;
+			lottery_tickets += rmp->lottery_num;
+			lottery_procs++;
+		}
+		if ((j = i + lowbit(i)) <= NR_PROCS)
+			lottery_tree[j] += lottery_tree[i];
+	}
+}
+
+/*===========================================================================*
+ *				lottery_getstats			     *
+ *===========================================================================*/
+void lottery_getstats(struct sched_stats *stats)
+{
+	stats->ss_lottery_procs = lottery_procs;
+	stats->ss_lottery_tickets = lottery_tickets;
+	stats->ss_lottery_draws = lottery_draws;
+	stats->ss_lottery_cycles = lottery_cycles;
+}
@@ -70,6 +70,9 @@ int main(void)
 		case SCHEDULING_SET_NICE:
 			result = do_nice(&m_in);
 			break;
+		case SCHEDULING_SET_DEADLINE:
+			result = do_set_deadline(&m_in);
+			break;
 		case SCHEDULING_NO_QUANTUM:
 			/* This message was sent from the kernel, don't reply */
 			if (IPC_STATUS_FLAGS_TEST(ipc_status,
@@ -91,6 +94,9 @@ int main(void)
 			switch_schedule_type();
 			result = OK;
 			break;
+		case COMMON_GETSYSINFO:
+			result = do_getsysinfo(&m_in);
+			break;
 		default:
 			result = no_sys(who_e, call_nr);
 		}
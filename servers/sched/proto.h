@@ -12,11 +12,33 @@ int do_noquantum(message *m_ptr);
 int do_start_scheduling(message *m_ptr);
 int do_stop_scheduling(message *m_ptr);
 int do_nice(message *m_ptr);
+int do_set_deadline(message *m_ptr);
+int do_getsysinfo(message *m_ptr);
 void init_scheduling(void);
 int lottery_scheduling(void);
 int edf_scheduling(void);
 void switch_schedule_type(void);
 
+/* lottery.c */
+struct sched_stats;
+void lottery_enter(struct schedproc *rmp);
+void lottery_leave(struct schedproc *rmp);
+void lottery_set_tickets(struct schedproc *rmp, unsigned tickets);
+struct schedproc *lottery_draw(void);
+void lottery_rebuild(int enable);
+void lottery_getstats(struct sched_stats *stats);
+
+/* edf.c */
+struct sched_edf_stats;
+void edf_enter(struct schedproc *rmp);
+void edf_leave(struct schedproc *rmp);
+struct schedproc *edf_pick(void);
+int edf_set_deadline(struct schedproc *rmp, unsigned period_ms,
+	unsigned deadline_ms);
+void edf_rebuild(int enable);
+void edf_getstats(struct sched_stats *stats);
+void edf_gettab(struct sched_edf_stats *tab);
+
 /* utility.c */
 int no_sys(int who_e, int call_nr);
 int sched_isokendpt(int ep, int *proc);
@@ -34,11 +34,22 @@ EXTERN struct schedproc {
 	bitchunk_t cpu_mask[BITMAP_CHUNKS(CONFIG_MAX_CPUS)]; /* what CPUs is hte
 								process allowed
 								to run on */
+	unsigned nr_noquantum;	/* recent quantum expiries, for cpu balancing */
 	/* lottery scheduling */
 	unsigned lottery_num;
 	/* edf scheduling */
-	clock_t deadline;
+	clock_t deadline;	/* absolute deadline of the current job */
+	clock_t edf_period;	/* job period in ticks, 0 if aperiodic */
+	clock_t edf_reldl;	/* deadline relative to job release */
+	clock_t edf_release;	/* release time of the current job */
+	clock_t edf_maxlate;	/* worst lateness seen, in ticks */
+	unsigned long edf_jobs;	/* number of jobs released */
+	unsigned long edf_missed; /* number of deadlines missed */
+	int edf_index;		/* position in the EDF heap, or -1 */
 } schedproc[NR_PROCS];
 
 /* Flag values */
 #define IN_USE		0x00001	/* set when 'schedproc' slot in use */
+#define IN_LOTTERY	0x00002	/* set when the process' tickets are in the draw */
+#define IN_EDF		0x00004	/* set when the process is in the EDF run set */
+#define EDF_SERVED	0x00008	/* set when the current EDF job has been served */
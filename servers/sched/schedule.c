@@ -5,21 +5,23 @@
  *   do_start_scheduling  Request to start scheduling a proc
  *   do_stop_scheduling   Request to stop scheduling a proc
  *   do_nice		  Request to change the nice level on a proc
+ *   do_set_deadline	  Request to change the EDF deadline of a proc
+ *   do_getsysinfo	  Request a copy of the scheduler statistics
  *   init_scheduling      Called from main.c to set up/prepare scheduling
  */
 #include "sched.h"
 #include "schedproc.h"
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/resource.h>
 #include <assert.h>
 #include <minix/com.h>
+#include <minix/sched.h>
+#include <minix/sysinfo.h>
 #include <machine/archtypes.h>
 #include "kernel/proc.h" /* for queue constants */
 
-#define SCHEDULE_DEFAULT 0
-#define SCHEDULE_LOTTERY 1
-#define SCHEDULE_EDF 2
 static int schedule_type = SCHEDULE_DEFAULT;
 
 static timer_t sched_timer;
@@ -30,11 +32,6 @@ static unsigned balance_timeout;
 static int schedule_process(struct schedproc * rmp, unsigned flags);
 static void balance_queues(struct timer *tp);
 
-static timer_t edf_timer;
-static unsigned edf_timeout;
-static clock_t edf_clock;
-
-static void set_edf_timer(struct timer* tp);
 
 #define SCHEDULE_CHANGE_PRIO	0x1
 #define SCHEDULE_CHANGE_QUANTUM	0x2
@@ -51,52 +48,209 @@ static void set_edf_timer(struct timer* tp);
 #define schedule_process_migrate(p)	\
 	schedule_process(p, SCHEDULE_CHANGE_CPU)
 
-#define CPU_DEAD	-1
-
-#define cpu_is_available(c)	(cpu_proc[c] >= 0)
+#define cpu_is_available(c)	(!cpu_dead[c])
 
 #define DEFAULT_USER_TIME_SLICE 200
 
 /* processes created by RS are sysytem processes */
 #define is_system_proc(p)	((p)->parent == RS_PROC_NR)
 
-static unsigned cpu_proc[CONFIG_MAX_CPUS];
+static int cpu_proc[CONFIG_MAX_CPUS];	/* processes placed on each cpu */
+static int cpu_dead[CONFIG_MAX_CPUS];	/* cpus the kernel refused */
+
+#ifdef CONFIG_SMP
+static timer_t migrate_timer;
+static unsigned migrate_timeout;
+
+#define MIGRATE_TIMEOUT	(sys_hz() / 2) /* how often to balance cpus */
+
+/* What we know about the load of each cpu. The run queue length is sampled
+ * from the kernel every migration period and refreshed whenever a process
+ * on that cpu runs out of quantum; in between, it is adjusted for the
+ * processes we place and move ourselves.
+ */
+static unsigned cpu_runq[CONFIG_MAX_CPUS];	/* runnable processes */
+static unsigned cpu_util[CONFIG_MAX_CPUS];	/* recent utilization, % */
+static struct cpu_load_info cpu_sample[CONFIG_MAX_CPUS]; /* last sample */
+
+static unsigned long nr_migrations;	/* processes moved by the balancer */
+static unsigned long nr_steals;		/* processes pulled by idle cpus */
+
+static void update_cpu_load(void);
+static void steal_proc(struct schedproc *rmp, message *m_ptr);
+static void balance_cpus(struct timer *tp);
+static int migrate_proc(struct schedproc *rmp, unsigned cpu);
+
+/* Lower is better: queue length first, utilization to break ties. */
+#define cpu_score(c)	(cpu_runq[c] * 100 + cpu_util[c])
+#endif
 
 static void pick_cpu(struct schedproc * proc)
 {
 #ifdef CONFIG_SMP
 	unsigned cpu, c;
-	unsigned cpu_load = (unsigned) -1;
 
+	/* every placed process is counted; do_stop_scheduling uncounts it */
 	if (machine.processors_count == 1) {
 		proc->cpu = machine.bsp_id;
+		cpu_proc[proc->cpu]++;
 		return;
 	}
 
 	/* schedule sysytem processes only on the boot cpu */
 	if (is_system_proc(proc)) {
 		proc->cpu = machine.bsp_id;
+		cpu_proc[proc->cpu]++;
 		return;
 	}
 
-	/* if no other cpu available, try BSP */
+	/* pick the least loaded cpu that is alive, BSP if nothing else is */
 	cpu = machine.bsp_id;
 	for (c = 0; c < machine.processors_count; c++) {
-		/* skip dead cpus */
 		if (!cpu_is_available(c))
 			continue;
-		if (c != machine.bsp_id && cpu_load > cpu_proc[c]) {
-			cpu_load = cpu_proc[c];
+		if (cpu_score(c) < cpu_score(cpu))
 			cpu = c;
-		}
 	}
 	proc->cpu = cpu;
 	cpu_proc[cpu]++;
+	cpu_runq[cpu]++;
 #else
 	proc->cpu = 0;
 #endif
 }
 
+#ifdef CONFIG_SMP
+/*===========================================================================*
+ *				steal_proc				     *
+ *===========================================================================*/
+static void steal_proc(struct schedproc *rmp, message *m_ptr)
+{
+	/* A process ran out of quantum on a cpu that has more work queued.
+	 * Refresh what we know about that cpu, and if another cpu has nothing
+	 * to run, let it pull this process over.
+	 */
+	unsigned cpu, c;
+
+	cpu = m_ptr->SCHEDULING_ACNT_CPU;
+	if (cpu >= machine.processors_count || cpu != rmp->cpu)
+		return;
+	cpu_runq[cpu] = m_ptr->SCHEDULING_ACNT_CPU_QLEN;
+	cpu_util[cpu] = m_ptr->SCHEDULING_ACNT_CPU_LOAD;
+
+	if (is_system_proc(rmp) || cpu_runq[cpu] <= 1)
+		return;
+
+	for (c = 0; c < machine.processors_count; c++) {
+		if (c == cpu || !cpu_is_available(c) || cpu_runq[c] != 0)
+			continue;
+		if (migrate_proc(rmp, c) == OK)
+			nr_steals++;
+		return;
+	}
+}
+
+/*===========================================================================*
+ *				update_cpu_load				     *
+ *===========================================================================*/
+static void update_cpu_load(void)
+{
+	/* Sample the run queue length and idle time of every cpu from the
+	 * kernel, and derive each cpu's utilization since the last sample.
+	 */
+	static struct cpu_load_info tab[CONFIG_MAX_CPUS];
+	u64_t dtsc, didle;
+	unsigned c;
+	int r;
+
+	if ((r = sys_getcpuload(tab)) != OK) {
+		printf("SCHED: unable to get cpu load: %d\n", r);
+		return;
+	}
+
+	for (c = 0; c < machine.processors_count; c++) {
+		cpu_runq[c] = tab[c].cl_runq_len;
+		if (cpu_sample[c].cl_tsc != 0 &&
+				tab[c].cl_tsc > cpu_sample[c].cl_tsc) {
+			dtsc = tab[c].cl_tsc - cpu_sample[c].cl_tsc;
+			didle = tab[c].cl_idle_cycles -
+				cpu_sample[c].cl_idle_cycles;
+			if (didle > dtsc)
+				didle = dtsc;
+			cpu_util[c] = 100 - (unsigned) (didle * 100 / dtsc);
+		}
+		cpu_sample[c] = tab[c];
+	}
+}
+
+/*===========================================================================*
+ *				migrate_proc				     *
+ *===========================================================================*/
+static int migrate_proc(struct schedproc *rmp, unsigned cpu)
+{
+	unsigned old_cpu = rmp->cpu;
+	int rv;
+
+	rmp->cpu = cpu;
+	if ((rv = schedule_process_migrate(rmp)) != OK) {
+		rmp->cpu = old_cpu;
+		if (rv == EBADCPU)
+			cpu_dead[cpu] = TRUE;
+		return rv;
+	}
+
+	cpu_proc[old_cpu]--;
+	cpu_proc[cpu]++;
+	if (cpu_runq[old_cpu] > 0)
+		cpu_runq[old_cpu]--;
+	cpu_runq[cpu]++;
+	return OK;
+}
+
+/*===========================================================================*
+ *				balance_cpus				     *
+ *===========================================================================*/
+static void balance_cpus(struct timer *tp)
+{
+	/* Move one user process from the busiest to the least busy cpu when
+	 * their run queues differ by more than one. The process that ran out
+	 * of quantum most often since the last period is moved, as it is the
+	 * one most likely to be runnable.
+	 */
+	struct schedproc *rmp, *victim;
+	unsigned c, busiest, idlest;
+	int proc_nr;
+
+	update_cpu_load();
+
+	busiest = idlest = machine.bsp_id;
+	for (c = 0; c < machine.processors_count; c++) {
+		if (!cpu_is_available(c))
+			continue;
+		if (cpu_score(c) > cpu_score(busiest))
+			busiest = c;
+		if (cpu_score(c) < cpu_score(idlest))
+			idlest = c;
+	}
+
+	victim = NULL;
+	for (proc_nr=0, rmp=schedproc; proc_nr<NR_PROCS; proc_nr++, rmp++) {
+		if (!(rmp->flags & IN_USE))
+			continue;
+		if (rmp->cpu == busiest && !is_system_proc(rmp) &&
+				rmp->nr_noquantum > 0 && (victim == NULL ||
+				rmp->nr_noquantum > victim->nr_noquantum))
+			victim = rmp;
+		rmp->nr_noquantum /= 2;
+	}
+
+	if (victim != NULL && cpu_runq[busiest] > cpu_runq[idlest] + 1 &&
+			migrate_proc(victim, idlest) == OK)
+		nr_migrations++;
+
+	set_timer(&migrate_timer, migrate_timeout, balance_cpus, 0);
+}
+#endif
 
 static int nice_to_priority(int nice, unsigned* new_q) {
 	/* PRIO_MIN, PRIO_MAX defined in sys/resources */
@@ -131,6 +285,12 @@ int do_noquantum(message *m_ptr)
 	}
 
 	rmp = &schedproc[proc_nr_n];
+	rmp->nr_noquantum++;
+
+#ifdef CONFIG_SMP
+	steal_proc(rmp, m_ptr);
+#endif
+
 	switch (schedule_type) {
 	case SCHEDULE_DEFAULT:
 		/* the default way of handling no quantum */
@@ -147,6 +307,7 @@ int do_noquantum(message *m_ptr)
 		/* directly dump to the lowest level */
 		if (rmp->priority >= MAX_USER_Q && rmp->priority <= MIN_USER_Q) {
 			rmp->priority = MIN_USER_Q;
+			lottery_enter(rmp);
 		}
 		if ((rv = schedule_process_local(rmp)) != OK) {
 			return rv;
@@ -155,6 +316,7 @@ int do_noquantum(message *m_ptr)
 	case SCHEDULE_EDF:
 		if (rmp->priority >= MAX_USER_Q && rmp->priority <= MIN_USER_Q) {
 			rmp->priority = MIN_USER_Q;
+			edf_enter(rmp);
 		}
 		if ((rv = schedule_process_local(rmp)) != OK) {
 			return rv;
@@ -187,6 +349,8 @@ int do_stop_scheduling(message *m_ptr)
 #ifdef CONFIG_SMP
 	cpu_proc[rmp->cpu]--;
 #endif
+	lottery_leave(rmp);
+	edf_leave(rmp);
 	rmp->flags = 0; /*&= ~IN_USE;*/
 
 	switch (schedule_type) {
@@ -238,7 +402,12 @@ int do_start_scheduling(message *m_ptr)
 	rmp->max_priority = new_q;
 	/* init lottery number and deadline */
 	rmp->lottery_num = 1;
+	rmp->nr_noquantum = 0;
 	rmp->deadline = 0;
+	rmp->edf_period = rmp->edf_reldl = rmp->edf_release = 0;
+	rmp->edf_maxlate = 0;
+	rmp->edf_jobs = rmp->edf_missed = 0;
+	rmp->edf_index = -1;
 	if (rmp->max_priority >= NR_SCHED_QUEUES) {
 		return EINVAL;
 	}
@@ -321,7 +490,10 @@ int do_start_scheduling(message *m_ptr)
 	pick_cpu(rmp);
 	while ((rv = schedule_process(rmp, SCHEDULE_CHANGE_ALL)) == EBADCPU) {
 		/* don't try this CPU ever again */
-		cpu_proc[rmp->cpu] = CPU_DEAD;
+		cpu_dead[rmp->cpu] = TRUE;
+#ifdef CONFIG_SMP
+		cpu_proc[rmp->cpu]--;
+#endif
 		pick_cpu(rmp);
 	}
 
@@ -340,6 +512,12 @@ int do_start_scheduling(message *m_ptr)
 
 	m_ptr->SCHEDULING_SCHEDULER = SCHED_PROC_NR;
 
+	/* Processes starting out in the lowest user queue join the lottery */
+	if (schedule_type == SCHEDULE_LOTTERY && rmp->priority == MIN_USER_Q)
+		lottery_enter(rmp);
+	if (schedule_type == SCHEDULE_EDF && rmp->priority == MIN_USER_Q)
+		edf_enter(rmp);
+
 	return OK;
 }
 
@@ -394,23 +572,45 @@ int do_nice(message *m_ptr)
 		if (nice < 1) {
 			nice = 1;
 		}
-		rmp->lottery_num = nice;
-		printf("INFO: do_nice: set lottery num: %d, endpoint: %d\n", nice, rmp->endpoint);
+		lottery_set_tickets(rmp, nice);
 		return OK;
 	case SCHEDULE_EDF:
-		/* change deadline by nice, deadline is the time to complete */
-		if (nice <= 0) {
-			rmp->deadline = 0;
-		} else {
-			rmp->deadline = edf_clock + (double)sys_hz()/1000.0f*(double)nice;
+		/* deadlines are set with SCHEDULING_SET_DEADLINE; only remember
+		 * the new maximum priority for when EDF is switched off
+		 */
+		if ((rv = nice_to_priority(nice, &new_q)) != OK) {
+			return rv;
 		}
-		printf("INFO: do_nice: set deadline: %d, endpoint: %d\n", (int)rmp->deadline, rmp->endpoint);
+		rmp->max_priority = new_q;
 		return OK;
 	default:
 		assert(0);
 	}
 }
 
+/*===========================================================================*
+ *				do_set_deadline				     *
+ *===========================================================================*/
+int do_set_deadline(message *m_ptr)
+{
+	struct schedproc *rmp;
+	int proc_nr_n;
+
+	/* check who can send you requests */
+	if (!accept_message(m_ptr))
+		return EPERM;
+
+	if (sched_isokendpt(m_ptr->SCHEDULING_ENDPOINT, &proc_nr_n) != OK) {
+		printf("SCHED: WARNING: got an invalid endpoint in deadline msg "
+			   "%ld\n", m_ptr->SCHEDULING_ENDPOINT);
+		return EBADEPT;
+	}
+
+	rmp = &schedproc[proc_nr_n];
+	return edf_set_deadline(rmp, (unsigned) m_ptr->SCHEDULING_PERIOD,
+		(unsigned) m_ptr->SCHEDULING_DEADLINE);
+}
+
 /*===========================================================================*
  *				schedule_process			     *
  *===========================================================================*/
@@ -418,8 +618,6 @@ static int schedule_process(struct schedproc* rmp, unsigned flags) {
 	int err;
 	int new_prio, new_quantum, new_cpu;
 
-	pick_cpu(rmp);
-
 	if (flags & SCHEDULE_CHANGE_PRIO)
 		new_prio = rmp->priority;
 	else
@@ -453,16 +651,15 @@ void init_scheduling(void)
 	balance_timeout = BALANCE_TIMEOUT * sys_hz();
 	init_timer(&sched_timer);
 	set_timer(&sched_timer, balance_timeout, balance_queues, 0);
-	edf_clock = 0;
-	edf_timeout = sys_hz()/10;
-	init_timer(&edf_timer);
-	set_timer(&edf_timer, edf_timeout, set_edf_timer, 0);
-}
-
-static void set_edf_timer(struct timer* tp) {
-	edf_clock += edf_timeout;
-	/* timer, tick, watch dog */
-	set_timer(&edf_timer, edf_timeout, set_edf_timer, 0);
+#ifdef CONFIG_SMP
+	if (machine.processors_count > 1) {
+		migrate_timeout = MIGRATE_TIMEOUT;
+		init_timer(&migrate_timer);
+		set_timer(&migrate_timer, migrate_timeout, balance_cpus, 0);
+	}
+#endif
+	lottery_rebuild(FALSE);
+	edf_rebuild(FALSE);
 }
 
 /*===========================================================================*
@@ -500,88 +697,89 @@ static void balance_queues(struct timer *tp)
 	set_timer(&sched_timer, balance_timeout, balance_queues, 0);
 }
 
-/*
- * works like re-balancing the queues are achieved in this method
- */
-int lottery_scheduling(void) {
-	struct schedproc *rmp;
-	unsigned total;
-	unsigned ticket;
-	unsigned now;
-	unsigned num_schedproc;
-	int i;
-
-	total = 0;
-	num_schedproc = 0;
-	/* 
-	 * NR_PROCS: Number of slots in the process table for non-kernel processes
-	 * IN_USE: shedproc in in use
-	 * rmp->priority == MIN_USER_Q: initially set?
+/*===========================================================================*
+ *				lottery_scheduling			     *
+ *===========================================================================*/
+int lottery_scheduling(void)
+{
+	/* Draw a winner among the processes waiting in the lowest user queue
+	 * and lift it up to USER_Q until its quantum runs out again.
 	 */
+	struct schedproc *rmp;
 
-	for (i=0, rmp=schedproc; i<NR_PROCS; ++i, ++rmp) {
-		if ((rmp->flags & IN_USE)
-				&& rmp->priority==MIN_USER_Q) {
-			total += rmp->lottery_num;
-			num_schedproc ++;
-		}
-	}
-	printf("INFO: lottery_scheduling: number sched procs: %d total tickets:%d\n", num_schedproc, total);
-
-	/* this case is no process to schedule? */
-	if (!total) {
-		// printf("INFO: lottery_scheduling: lottery total: %d\n", total);
+	if ((rmp = lottery_draw()) == NULL)
 		return OK;
-	}
 
-	/*
-	 * schedproc[256]: list of process info?
-	 * USER_Q: ((MIN_USER_Q - MAX_USER_Q) / 2 + MAX_USER_Q)
-	 */
-	ticket = random() % total + 1;
-	now = 0;
-	for (i=0, rmp=schedproc; i<NR_PROCS; ++i, ++rmp) {
-		if ((rmp->flags & IN_USE) && rmp->priority == MIN_USER_Q) {
-			if ((now += rmp->lottery_num) >= ticket) {
-				rmp->priority = USER_Q;
-				printf("INFO: lottery_scheduling: lottery lucy ticket: %d, total: %d, endpoint (pid): %d\n", ticket, total, rmp->endpoint);
-				schedule_process_local(rmp);
-				return OK;
-			}
-		}
-	}
-	return OK;
+	lottery_leave(rmp);
+	rmp->priority = USER_Q;
+	return schedule_process_local(rmp);
 }
 
-int edf_scheduling(void) {
-	struct schedproc *rmp, *min_rmp;
-	clock_t min_deadline;
-	int i;
-
-	min_deadline = 0;
-	min_rmp = NULL;
-	for (i=0, rmp=schedproc; i<NR_PROCS; ++i,++rmp) {
-		/* pick the eaerlest deadline */
-		if ((rmp->flags & IN_USE) 
-				&& rmp->priority == MIN_USER_Q
-				&& (!min_rmp || (rmp->deadline && rmp->deadline < min_deadline))) {
-			min_deadline = rmp->deadline;
-			min_rmp = rmp;
-		}
-	}
+/*===========================================================================*
+ *				edf_scheduling				     *
+ *===========================================================================*/
+int edf_scheduling(void)
+{
+	/* Lift the waiting process with the earliest deadline up to USER_Q
+	 * until its quantum runs out again.
+	 */
+	struct schedproc *rmp;
 
-	if (!min_rmp) {
-		// printf("INFO: edf_scheduling: earliest deadline not found\n");
+	if ((rmp = edf_pick()) == NULL)
 		return OK;
-	}
 
-	printf("INFO: edf_scheduling: earliest deadline: %d\n", min_deadline);
-	min_rmp->priority = USER_Q;
-	schedule_process_local(min_rmp);
-	return OK;
+	rmp->priority = USER_Q;
+	return schedule_process_local(rmp);
 }
 
 void switch_schedule_type(void) {
 	schedule_type = (schedule_type+1)%3;
+	lottery_rebuild(schedule_type == SCHEDULE_LOTTERY);
+	edf_rebuild(schedule_type == SCHEDULE_EDF);
 	printf("INFO: switch_schedule_type: switch to %d\n(schedulers SCHEDULE_DEFAULT 0; SCHEDULE_LOTTERY 1; SCHEDULE_EDF 2;)\n", schedule_type);
-}
\ No newline at end of file
+}
+
+/*===========================================================================*
+ *				do_getsysinfo				     *
+ *===========================================================================*/
+int do_getsysinfo(message *m_ptr)
+{
+	static struct sched_stats stats;
+	static struct sched_edf_stats edf_tab[NR_PROCS];
+	vir_bytes src_addr;
+	size_t len;
+	int s;
+
+	switch (m_ptr->SI_WHAT) {
+	case SI_SCHED_STATS:
+		memset(&stats, 0, sizeof(stats));
+		stats.ss_policy = schedule_type;
+#ifdef CONFIG_SMP
+		stats.ss_migrations = nr_migrations;
+		stats.ss_steals = nr_steals;
+#endif
+		lottery_getstats(&stats);
+		edf_getstats(&stats);
+		src_addr = (vir_bytes) &stats;
+		len = sizeof(stats);
+		break;
+	case SI_SCHED_EDF_TAB:
+		edf_gettab(edf_tab);
+		src_addr = (vir_bytes) edf_tab;
+		len = sizeof(edf_tab);
+		break;
+	default:
+		return EINVAL;
+	}
+
+	if (m_ptr->SI_SIZE != len)
+		return EINVAL;
+
+	if ((s = sys_datacopy(SELF, src_addr, m_ptr->m_source,
+			(vir_bytes) m_ptr->SI_WHERE, len)) != OK) {
+		printf("SCHED: copy failed: %d\n", s);
+		return s;
+	}
+
+	return OK;
+}
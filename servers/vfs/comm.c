@@ -132,6 +132,13 @@ int fs_sendrec(endpoint_t fs_e, message *reqmp)
   }
   if (fs_e == fp->fp_endpoint) return(EDEADLK);
 
+  /* Don't let a hung FS take all workers: wait for a free slot. Requests that
+   * drop references are never held back, or the FS would keep them.
+   */
+  if (reqmp->m_type != REQ_PUTNODE && reqmp->m_type != REQ_UNMOUNT &&
+      (r = worker_capwait(fs_e, &vmp->m_comm.c_workers)) != OK)
+	return(r);
+
   self->w_fs_sendrec = reqmp;	/* Where to store request and reply */
 
   /* Find out whether we can send right away or have to enqueue */
@@ -146,7 +153,10 @@ int fs_sendrec(endpoint_t fs_e, message *reqmp)
 
   if (r != OK) return(r);
 
+  vmp->m_comm.c_workers++;
   worker_wait();	/* Yield execution until we've received the reply. */
+  vmp->m_comm.c_workers--;
+  worker_capwake(fs_e);
 
   return(reqmp->m_type);
 }
@@ -7,6 +7,8 @@ typedef struct {
   int c_max_reqs;	/* Max requests an FS can handle simultaneously */
   int c_cur_reqs;	/* Number of requests the FS is currently handling */
   struct worker_thread *c_req_queue;/* Queue of procs waiting to send a message */
+  int c_workers;	/* Number of workers waiting on the FS; kept by the
+			 * workers themselves, so never reset */
 } comm_t;
 
 #endif
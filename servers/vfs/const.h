@@ -6,7 +6,12 @@
 #define NR_LOCKS           8	/* # slots in the file locking table */
 #define NR_MNTS           16 	/* # slots in mount table */
 #define NR_VNODES        512	/* # slots in vnode table */
-#define NR_WTHREADS	   8	/* # slots in worker thread table */
+#define NR_WTHREADS	  32	/* # slots in worker thread table */
+#define NR_DNLC		1024	/* # slots in directory name lookup cache */
+#define DNLC_NAMELEN	  31	/* longest name in the name lookup cache */
+#define WTHREADS_MIN	   8	/* # worker threads kept around */
+#define WTHREADS_VMNT	  24	/* # worker threads waiting on one FS */
+#define WTHREADS_RESERVE   4	/* # worker threads the FS cap leaves free */
 
 #define NR_NONEDEVS	NR_MNTS	/* # slots in nonedev bitmap */
 
@@ -0,0 +1,264 @@
+/* This file contains the directory name lookup cache (DNLC). It maps a name
+ * in a directory, identified by FS endpoint and inode number, to the inode
+ * the name refers to, or records that the name does not exist. Path lookups
+ * consult the cache before asking the FS, so that names that are resolved
+ * over and over do not cost a REQ_LOOKUP round trip each time.
+ *
+ * Entries are learned from single-name lookups that do not follow symbolic
+ * links, so they always describe the directory entry itself. They are dropped
+ * whenever VFS asks the FS to change the name, and when the FS goes away.
+ * Names longer than DNLC_NAMELEN are not cached.
+ *
+ * The entry points into this file are
+ *   dnlc_init:		initialize the cache
+ *   dnlc_lookup:	look up a name in a directory
+ *   dnlc_enter:	remember what a name in a directory refers to
+ *   dnlc_purge:	forget a name in a directory
+ *   dnlc_purge_fs:	forget all names on a file system
+ *   dnlc_getparam:	report statistics
+ */
+
+#include "fs.h"
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+
+#define DNLC_HASH	256	/* # hash chains; a power of two */
+
+static struct dnlc {
+  endpoint_t d_fs_e;		/* FS of the directory; NONE if free */
+  ino_t d_dir;			/* inode number of the directory */
+  ino_t d_ino;			/* inode the name refers to; 0 if none */
+  unsigned char d_len;		/* length of the name */
+  char d_name[DNLC_NAMELEN];	/* the name, not null terminated */
+  struct dnlc *d_hnext;		/* next entry on hash chain */
+  struct dnlc **d_hlink;	/* pointer to us on hash chain */
+  struct dnlc *d_prev;		/* previous entry in LRU order */
+  struct dnlc *d_next;		/* next entry in LRU order */
+} dnlc[NR_DNLC];
+
+static struct dnlc *dnlc_hash[DNLC_HASH];
+static struct dnlc *lru_front;	/* least recently used entry */
+static struct dnlc *lru_rear;	/* most recently used entry */
+
+/* Statistics */
+static unsigned long dnlc_hits, dnlc_neghits, dnlc_misses;
+static unsigned long dnlc_enters, dnlc_purges;
+
+static unsigned int dnlc_hashval(endpoint_t fs_e, ino_t dir, char *name,
+	size_t len);
+static struct dnlc *dnlc_find(endpoint_t fs_e, ino_t dir, char *name,
+	size_t len);
+static void dnlc_unlink(struct dnlc *dp);
+static void dnlc_free(struct dnlc *dp);
+static void dnlc_touch(struct dnlc *dp);
+
+/*===========================================================================*
+ *				dnlc_init				     *
+ *===========================================================================*/
+void dnlc_init(void)
+{
+  struct dnlc *dp;
+
+  memset(dnlc_hash, 0, sizeof(dnlc_hash));
+  lru_front = lru_rear = NULL;
+
+  for (dp = &dnlc[0]; dp < &dnlc[NR_DNLC]; dp++) {
+	dp->d_fs_e = NONE;
+	dp->d_hlink = NULL;
+	dp->d_prev = lru_rear;
+	dp->d_next = NULL;
+	if (lru_rear != NULL) lru_rear->d_next = dp;
+	else lru_front = dp;
+	lru_rear = dp;
+  }
+}
+
+/*===========================================================================*
+ *				dnlc_hashval				     *
+ *===========================================================================*/
+static unsigned int dnlc_hashval(endpoint_t fs_e, ino_t dir, char *name,
+	size_t len)
+{
+  u32_t h;
+
+  h = (u32_t) fs_e * 0x9E3779B1U ^ (u32_t) dir;
+  while (len-- > 0)
+	h = h * 31 + (unsigned char) *name++;
+
+  return((h ^ (h >> 16)) & (DNLC_HASH - 1));
+}
+
+/*===========================================================================*
+ *				dnlc_find				     *
+ *===========================================================================*/
+static struct dnlc *dnlc_find(endpoint_t fs_e, ino_t dir, char *name,
+	size_t len)
+{
+  struct dnlc *dp;
+
+  for (dp = dnlc_hash[dnlc_hashval(fs_e, dir, name, len)]; dp != NULL;
+       dp = dp->d_hnext) {
+	if (dp->d_dir == dir && dp->d_fs_e == fs_e && dp->d_len == len &&
+	    memcmp(dp->d_name, name, len) == 0)
+		return(dp);
+  }
+
+  return(NULL);
+}
+
+/*===========================================================================*
+ *				dnlc_unlink				     *
+ *===========================================================================*/
+static void dnlc_unlink(struct dnlc *dp)
+{
+/* Take an entry out of LRU order */
+  if (dp->d_prev != NULL) dp->d_prev->d_next = dp->d_next;
+  else lru_front = dp->d_next;
+  if (dp->d_next != NULL) dp->d_next->d_prev = dp->d_prev;
+  else lru_rear = dp->d_prev;
+}
+
+/*===========================================================================*
+ *				dnlc_touch				     *
+ *===========================================================================*/
+static void dnlc_touch(struct dnlc *dp)
+{
+/* Make an entry the most recently used one */
+  if (dp == lru_rear) return;
+
+  dnlc_unlink(dp);
+  dp->d_prev = lru_rear;
+  dp->d_next = NULL;
+  lru_rear->d_next = dp;
+  lru_rear = dp;
+}
+
+/*===========================================================================*
+ *				dnlc_free				     *
+ *===========================================================================*/
+static void dnlc_free(struct dnlc *dp)
+{
+/* Drop an entry and make it the first to be reused */
+  if (dp->d_fs_e == NONE) return;
+
+  *dp->d_hlink = dp->d_hnext;
+  if (dp->d_hnext != NULL) dp->d_hnext->d_hlink = dp->d_hlink;
+  dp->d_hlink = NULL;
+  dp->d_fs_e = NONE;
+
+  if (dp == lru_front) return;
+  dnlc_unlink(dp);
+  dp->d_prev = NULL;
+  dp->d_next = lru_front;
+  lru_front->d_prev = dp;
+  lru_front = dp;
+}
+
+/*===========================================================================*
+ *				dnlc_lookup				     *
+ *===========================================================================*/
+int dnlc_lookup(endpoint_t fs_e, ino_t dir, char *name, size_t len,
+	ino_t *ino)
+{
+/* Look up 'name' of 'len' characters in a directory. Return OK and the inode
+ * number in 'ino', ENOENT if the name is known not to exist, or ESRCH if the
+ * cache does not know.
+ */
+  struct dnlc *dp;
+
+  if (len > DNLC_NAMELEN || (dp = dnlc_find(fs_e, dir, name, len)) == NULL) {
+	dnlc_misses++;
+	return(ESRCH);
+  }
+
+  dnlc_touch(dp);
+
+  if (dp->d_ino == 0) {
+	dnlc_neghits++;
+	return(ENOENT);
+  }
+
+  dnlc_hits++;
+  *ino = dp->d_ino;
+  return(OK);
+}
+
+/*===========================================================================*
+ *				dnlc_enter				     *
+ *===========================================================================*/
+void dnlc_enter(endpoint_t fs_e, ino_t dir, char *name, size_t len,
+	ino_t ino)
+{
+/* Remember that 'name' in a directory refers to inode 'ino', or that it does
+ * not exist if 'ino' is 0.
+ */
+  struct dnlc *dp;
+  unsigned int h;
+
+  if (len == 0 || len > DNLC_NAMELEN) return;
+
+  if ((dp = dnlc_find(fs_e, dir, name, len)) == NULL) {
+	/* Reuse the least recently used entry */
+	dp = lru_front;
+	dnlc_free(dp);
+
+	h = dnlc_hashval(fs_e, dir, name, len);
+	dp->d_fs_e = fs_e;
+	dp->d_dir = dir;
+	dp->d_len = len;
+	memcpy(dp->d_name, name, len);
+	dp->d_hnext = dnlc_hash[h];
+	if (dp->d_hnext != NULL) dp->d_hnext->d_hlink = &dp->d_hnext;
+	dp->d_hlink = &dnlc_hash[h];
+	dnlc_hash[h] = dp;
+  }
+
+  dp->d_ino = ino;
+  dnlc_touch(dp);
+  dnlc_enters++;
+}
+
+/*===========================================================================*
+ *				dnlc_purge				     *
+ *===========================================================================*/
+void dnlc_purge(endpoint_t fs_e, ino_t dir, char *name)
+{
+/* Forget about a name in a directory, as it is about to change */
+  struct dnlc *dp;
+
+  if ((dp = dnlc_find(fs_e, dir, name, strlen(name))) != NULL) {
+	dnlc_free(dp);
+	dnlc_purges++;
+  }
+}
+
+/*===========================================================================*
+ *				dnlc_purge_fs				     *
+ *===========================================================================*/
+void dnlc_purge_fs(endpoint_t fs_e)
+{
+/* Forget about all names on a file system */
+  struct dnlc *dp;
+
+  for (dp = &dnlc[0]; dp < &dnlc[NR_DNLC]; dp++) {
+	if (dp->d_fs_e == fs_e) {
+		dnlc_free(dp);
+		dnlc_purges++;
+	}
+  }
+}
+
+/*===========================================================================*
+ *				dnlc_getparam				     *
+ *===========================================================================*/
+int dnlc_getparam(char *key, char *buf, size_t len)
+{
+/* Report the cache statistics. Return ESRCH if the key is not ours. */
+  if (strcmp(key, "dnlc_stats")) return(ESRCH);
+
+  snprintf(buf, len, "%lu %lu %lu %lu %lu", dnlc_hits, dnlc_neghits,
+	dnlc_misses, dnlc_enters, dnlc_purges);
+
+  return(OK);
+}
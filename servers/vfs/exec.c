@@ -4,7 +4,7 @@
  *    - fetch the initial args and environment from the user space
  *    - allocate the memory for the new process
  *    - copy the initial stack from PM to the process
- *    - read in the text and data segments and copy to the process
+ *    - map the text and data segments into the process, or read them in
  *    - take care of setuid and setgid bits
  *    - fix up 'mproc' table
  *    - tell kernel about EXEC
@@ -62,6 +62,8 @@ static int stack_prepare_elf(struct vfs_exec_info *execi,
 	char *curstack, size_t *frame_len, vir_bytes *vsp, int *extrabase);
 static int map_header(struct vfs_exec_info *execi);
 static int read_seg(struct exec_info *execi, off_t off, off_t seg_addr, size_t seg_bytes);
+static int map_seg(struct exec_info *execi, off_t vaddr, size_t len,
+	off_t foffset);
 
 #define PTRSIZE	sizeof(char *) /* Size of pointers in argv[] and envp[]. */
 
@@ -230,7 +232,7 @@ int pm_exec(endpoint_t proc_e, vir_bytes path, size_t path_len,
   if (frame_len > ARG_MAX)
 	FAILCHECK(ENOMEM); /* stack too big */
 
-  r = sys_datacopy(proc_e, (vir_bytes) frame, SELF, (vir_bytes) mbuf,
+  r = vm_datacopy(proc_e, (vir_bytes) frame, SELF, (vir_bytes) mbuf,
 		   (size_t) frame_len);
   if (r != OK) { /* can't fetch stack (e.g. bad virtual addr) */
         printf("VFS: pm_exec: sys_datacopy failed\n");
@@ -304,6 +306,7 @@ int pm_exec(endpoint_t proc_e, vir_bytes path, size_t path_len,
 
   /* callback functions and data */
   execi.args.copymem = read_seg;
+  execi.args.memmap = map_seg;
   execi.args.clearproc = libexec_clearproc_vm_procctl;
   execi.args.clearmem = libexec_clear_sys_memset;
   execi.args.allocmem_prealloc = libexec_alloc_mmap_prealloc;
@@ -334,7 +337,7 @@ int pm_exec(endpoint_t proc_e, vir_bytes path, size_t path_len,
 
   /* Patch up stack and copy it from VFS to new core image. */
   libexec_patch_ptr(mbuf, vsp + extrabase);
-  FAILCHECK(sys_datacopy(SELF, (vir_bytes) mbuf, proc_e, (vir_bytes) vsp,
+  FAILCHECK(vm_datacopy(SELF, (vir_bytes) mbuf, proc_e, (vir_bytes) vsp,
 		   (phys_bytes)frame_len));
 
   /* Return new stack pointer to caller */
@@ -638,6 +641,26 @@ static int read_seg(struct exec_info *execi, off_t off, off_t seg_addr, size_t s
 }
 
 
+/*===========================================================================*
+ *				map_seg					     *
+ *===========================================================================*/
+static int map_seg(struct exec_info *execi, off_t vaddr, size_t len,
+	off_t foffset)
+{
+/* Map 'len' bytes of the executable, from 'foffset' on, into the new process
+ * at 'vaddr'. VM reads the pages when they are first used, and shares them
+ * with other processes running the same file.
+ */
+  struct vnode *vp = ((struct vfs_exec_info *) execi->opaque)->vp;
+
+  /* Make sure that the file is big enough */
+  if (foffset + len > LONG_MAX) return(EIO);
+  if ((unsigned long) vp->v_size < foffset + len) return(EIO);
+
+  return(vm_mmap_exec(vp, execi->proc_e, (vir_bytes) vaddr, len, foffset));
+}
+
+
 /*===========================================================================*
  *				clo_exec				     *
  *===========================================================================*/
@@ -44,6 +44,9 @@ EXTERN struct fproc {
 
   mutex_t fp_lock;		/* mutex to lock fproc object */
   struct job fp_job;		/* pending job */
+  struct fproc *fp_pend_next;	/* next process with a pending job */
+  struct fproc *fp_pend_prev;	/* previous process with a pending job */
+  clock_t fp_pend_since;	/* when the pending job was queued */
   thread_t fp_wtid;		/* Thread ID of worker */
   char fp_name[PROC_NAME_LEN];	/* Last exec() */
 #if LOCK_DEBUG
@@ -43,6 +43,7 @@ EXTERN mutex_t bsf_lock;/* Global lock for access to block special files */
 EXTERN struct worker_thread workers[NR_WTHREADS];
 EXTERN struct worker_thread sys_worker;
 EXTERN struct worker_thread dl_worker;
+EXTERN struct worker_thread vm_worker;
 EXTERN thread_t invalid_thread_id;
 EXTERN char mount_label[LABEL_MAX];	/* label of file system to mount */
 
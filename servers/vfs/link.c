@@ -386,8 +386,10 @@ off_t newsize;
    * called for open(2), which requires an update to the file times if O_TRUNC
    * is given, even if the file size remains the same.
    */
-  if ((r = req_ftrunc(vp->v_fs_e, vp->v_inode_nr, newsize, 0)) == OK)
+  if ((r = req_ftrunc(vp->v_fs_e, vp->v_inode_nr, newsize, 0)) == OK) {
 	vp->v_size = newsize;
+	vm_forget(vp);
+  }
   return(r);
 }
 
@@ -77,7 +77,8 @@ int main(void)
   /* SEF local startup. */
   sef_local_startup();
 
-  printf("Started VFS: %d worker thread(s)\n", NR_WTHREADS);
+  printf("Started VFS: %d to %d worker thread(s)\n", WTHREADS_MIN,
+	NR_WTHREADS);
 
   if (OK != (sys_getkinfo(&kinfo)))
 	panic("couldn't get kernel kinfo");
@@ -104,6 +105,13 @@ int main(void)
 	if (job != NULL) {
 		do_fs_reply(job);
 		continue;
+	} else if (who_e == VM_PROC_NR && !is_notify(call_nr)) {
+		/* Requests from VM, for memory mapped files */
+		if (call_nr == VFS_VM_REPLY)
+			vm_reply();
+		else
+			vm_worker_start(do_vm_request);
+		continue;
 	} else if (who_e == PM_PROC_NR) { /* Calls from PM */
 		/* Special control messages from PM */
 		sys_worker_start(do_pm);
@@ -561,11 +569,7 @@ static int sef_cb_init_fresh(int UNUSED(type), sef_init_info_t *info)
   if (s != OK) panic("VFS: can't subscribe to driver events (%d)", s);
 
   /* Initialize worker threads */
-  for (i = 0; i < NR_WTHREADS; i++)  {
-	worker_init(&workers[i]);
-  }
-  worker_init(&sys_worker); /* exclusive system worker thread */
-  worker_init(&dl_worker); /* exclusive worker thread to resolve deadlocks */
+  worker_init();
 
   /* Initialize global locks */
   if (mthread_mutex_init(&pm_lock, NULL) != 0)
@@ -587,6 +591,7 @@ static int sef_cb_init_fresh(int UNUSED(type), sef_init_info_t *info)
 
   init_dmap_locks();		/* init dmap locks */
   init_vnodes();		/* init vnodes */
+  dnlc_init();			/* init name lookup cache */
   init_vmnts();			/* init vmnt structures */
   init_select();		/* init select() structures */
   init_filps();			/* Init filp structures */
@@ -882,9 +887,10 @@ static void service_pm_postponed(void)
 	panic("Unhandled postponed PM call %d", job_m_in.m_type);
   }
 
-  r = send(PM_PROC_NR, &m_out);
+  /* PM may be waiting for VM, and VM for this process to read a page. */
+  r = asynsend3(PM_PROC_NR, &m_out, AMF_NOREPLY);
   if (r != OK)
-	panic("service_pm_postponed: send failed: %d", r);
+	panic("service_pm_postponed: asynsend failed: %d", r);
 }
 
 /*===========================================================================*
@@ -1048,9 +1054,10 @@ static void service_pm()
 	return;
   }
 
-  r = send(PM_PROC_NR, &m_out);
+  /* Don't block on PM; see service_pm_postponed(). */
+  r = asynsend3(PM_PROC_NR, &m_out, AMF_NOREPLY);
   if (r != OK)
-	panic("service_pm: send failed: %d", r);
+	panic("service_pm: asynsend failed: %d", r);
 
 }
 
@@ -29,6 +29,7 @@
 #include <minix/com.h>
 #include <minix/sysinfo.h>
 #include <minix/u64.h>
+#include <sys/param.h>
 #include <sys/ptrace.h>
 #include <sys/svrctl.h>
 #include "file.h"
@@ -103,7 +104,7 @@ int do_getsysinfo()
   if (len != buf_size)
 	return(EINVAL);
 
-  return sys_datacopy(SELF, src_addr, who_e, dst_addr, len);
+  return vm_datacopy(SELF, src_addr, who_e, dst_addr, len);
 }
 
 /*===========================================================================*
@@ -177,7 +178,8 @@ int do_fcntl()
   fcntl_argx = job_m_in.addr;
 
   /* Is the file descriptor valid? */
-  locktype = (fcntl_req == F_FREESP) ? VNODE_WRITE : VNODE_READ;
+  locktype = (fcntl_req == F_FREESP || fcntl_req == F_SETPIPE_SZ) ?
+	VNODE_WRITE : VNODE_READ;
   if ((f = get_filp(scratch(fp).file.fd_nr, locktype)) == NULL)
 	return(err_code);
 
@@ -227,6 +229,28 @@ int do_fcntl()
 	r = lock_op(f, fcntl_req);
 	break;
 
+    case F_GETPIPE_SZ:
+	/* Get the capacity of a pipe. */
+	if (!S_ISFIFO(f->filp_vno->v_mode)) r = EINVAL;
+	else r = (int) f->filp_vno->v_pipe_size;
+	break;
+
+    case F_SETPIPE_SZ:
+	/* Set the capacity of a pipe, in whole PIPE_BUF units. It cannot
+	 * become smaller than what the pipe holds right now.
+	 */
+	if (!S_ISFIFO(f->filp_vno->v_mode)) r = EINVAL;
+	else if (fcntl_argx <= 0 || fcntl_argx > PIPE_SIZE_MAX) r = EINVAL;
+	else if (roundup(fcntl_argx, PIPE_BUF) < f->filp_vno->v_size) r = EBUSY;
+	else {
+		f->filp_vno->v_pipe_size = roundup(fcntl_argx, PIPE_BUF);
+		r = (int) f->filp_vno->v_pipe_size;
+
+		/* Writers waiting for room may fit now. */
+		if (susp_count > 0) release(f->filp_vno, WRITE, susp_count);
+	}
+	break;
+
     case F_FREESP:
      {
 	/* Free a section of a file */
@@ -239,7 +263,7 @@ int do_fcntl()
 	else if (!(f->filp_mode & W_BIT)) r = EBADF;
 	else
 		/* Copy flock data from userspace. */
-		r = sys_datacopy(who_e, (vir_bytes) scratch(fp).io.io_buffer,
+		r = vm_datacopy(who_e, (vir_bytes) scratch(fp).io.io_buffer,
 				 SELF, (vir_bytes) &flock_arg,
 				 sizeof(flock_arg));
 
@@ -283,6 +307,7 @@ int do_fcntl()
 
 	if (r == OK && flock_arg.l_len == 0)
 		f->filp_vno->v_size = start;
+	if (r == OK) vm_forget(f->filp_vno);
 
 	break;
      }
@@ -535,8 +560,7 @@ static void free_proc(struct fproc *exiter, int flags)
 
   /* Exit done. Mark slot as free. */
   exiter->fp_pid = PID_FREE;
-  if (exiter->fp_flags & FP_PENDING)
-	pending--;	/* No longer pending job, not going to do it */
+  worker_forget(exiter);	/* No longer pending job, not going to do it */
   exiter->fp_flags = FP_NOFLAGS;
 }
 
@@ -589,7 +613,7 @@ gid_t *groups;
   rfp = &fproc[slot];
   if (ngroups * sizeof(gid_t) > sizeof(rfp->fp_sgroups))
 	panic("VFS: pm_setgroups: too much data to copy");
-  if (sys_datacopy(who_e, (vir_bytes) groups, SELF, (vir_bytes) rfp->fp_sgroups,
+  if (vm_datacopy(who_e, (vir_bytes) groups, SELF, (vir_bytes) rfp->fp_sgroups,
 		   ngroups * sizeof(gid_t)) == OK) {
 	rfp->fp_ngroups = ngroups;
   } else
@@ -637,7 +661,7 @@ int do_svrctl()
 		int r, s;
 
 		/* Copy sysgetenv structure to VFS */
-		if (sys_datacopy(who_e, ptr, SELF, (vir_bytes) &sysgetenv,
+		if (vm_datacopy(who_e, ptr, SELF, (vir_bytes) &sysgetenv,
 				 sizeof(sysgetenv)) != OK)
 			return(EFAULT);
 
@@ -652,7 +676,7 @@ int do_svrctl()
 		}
 
 		/* Copy parameter "key" */
-		if ((s = sys_datacopy(who_e, (vir_bytes) sysgetenv.key,
+		if ((s = vm_datacopy(who_e, (vir_bytes) sysgetenv.key,
 				      SELF, (vir_bytes) search_key,
 				      sysgetenv.keylen)) != OK)
 			return(s);
@@ -662,7 +686,7 @@ int do_svrctl()
 		if (svrctl == VFSSETPARAM) {
 			if (!strcmp(search_key, "verbose")) {
 				int verbose_val;
-				if ((s = sys_datacopy(who_e,
+				if ((s = vm_datacopy(who_e,
 				    (vir_bytes) sysgetenv.val, SELF,
 				    (vir_bytes) &val, sysgetenv.vallen)) != OK)
 					return(s);
@@ -674,10 +698,17 @@ int do_svrctl()
 				verbose = verbose_val;
 				r = OK;
 			} else {
-				r = ESRCH;
+				/* The worker pool is shared by everyone. */
+				if (!super_user) return(EPERM);
+				if ((s = vm_datacopy(who_e,
+				    (vir_bytes) sysgetenv.val, SELF,
+				    (vir_bytes) &val, sysgetenv.vallen)) != OK)
+					return(s);
+				val[sysgetenv.vallen] = '\0'; /* Limit string */
+				r = worker_setparam(search_key, atoi(val));
 			}
 		} else { /* VFSGETPARAM */
-			char small_buf[60];
+			char small_buf[80];
 
 			r = ESRCH;
 			if (!strcmp(search_key, "print_traces")) {
@@ -685,21 +716,20 @@ int do_svrctl()
 				sysgetenv.val = 0;
 				sysgetenv.vallen = 0;
 				r = OK;
-			} else if (!strcmp(search_key, "active_threads")) {
-				int active = NR_WTHREADS - worker_available();
-				snprintf(small_buf, sizeof(small_buf) - 1,
-					 "%d", active);
+			} else if ((r = worker_getparam(search_key, small_buf,
+			    sizeof(small_buf))) == OK ||
+			    (r = dnlc_getparam(search_key, small_buf,
+			    sizeof(small_buf))) == OK) {
 				sysgetenv.vallen = strlen(small_buf);
-				r = OK;
 			}
 
 			if (r == OK) {
-				if ((s = sys_datacopy(SELF,
+				if ((s = vm_datacopy(SELF,
 				    (vir_bytes) &sysgetenv, who_e, ptr,
 				    sizeof(sysgetenv))) != OK)
 					return(s);
 				if (sysgetenv.val != 0) {
-					if ((s = sys_datacopy(SELF,
+					if ((s = vm_datacopy(SELF,
 					    (vir_bytes) small_buf, who_e,
 					    (vir_bytes) sysgetenv.val,
 					    sysgetenv.vallen)) != OK)
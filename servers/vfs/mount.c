@@ -121,7 +121,7 @@ int do_mount()
   /* FS process' endpoint number */
   if (mflags & MS_LABEL16) {
 	/* Get the label from the caller, and ask DS for the endpoint. */
-	r = sys_datacopy(who_e, label, SELF, (vir_bytes) mount_label,
+	r = vm_datacopy(who_e, label, SELF, (vir_bytes) mount_label,
 			 sizeof(mount_label));
 	if (r != OK) return(r);
 
@@ -36,7 +36,11 @@
 #define DO_POSIX_PATHNAME_RES	0
 
 static int lookup(struct vnode *dirp, struct lookup *resolve,
-	node_details_t *node, struct fproc *rfp);
+	node_details_t *node, struct fproc *rfp, int *cached);
+static int lookup_dnlc(struct vnode *dirp, ino_t root_ino, uid_t uid,
+	gid_t gid, struct lookup *resolve, lookup_res_t *res,
+	struct fproc *rfp, int *cached);
+static int is_mountpoint(struct vnode *vp);
 static int check_perms(endpoint_t ep, cp_grant_id_t io_gr, size_t
 	pathlen);
 
@@ -49,7 +53,7 @@ struct lookup *resolve;
 struct fproc *rfp;
 {
 /* Resolve a path name starting at dirp to a vnode. */
-  int r;
+  int r, cached;
   int do_downgrade = 1;
   struct vnode *new_vp, *vp;
   struct vmnt *vmp;
@@ -70,14 +74,22 @@ struct fproc *rfp;
   lock_vnode(new_vp, initial_locktype);
 
   /* Lookup vnode belonging to the file. */
-  if ((r = lookup(dirp, resolve, &res, rfp)) != OK) {
+  if ((r = lookup(dirp, resolve, &res, rfp, &cached)) != OK) {
 	err_code = r;
 	unlock_vnode(new_vp);
 	return(NULL);
   }
 
-  /* Check whether we already have a vnode for that file */
-  if ((vp = find_vnode(res.fs_e, res.inode_nr)) != NULL) {
+  if (cached) {
+	/* The name cache found a vnode in use. We got no reference from the
+	 * FS, so hold on to the vnode before we might block on its lock. */
+	vp = find_vnode(res.fs_e, res.inode_nr);
+	assert(vp != NULL);
+	unlock_vnode(new_vp);	/* Don't need this anymore */
+	dup_vnode(vp);
+	do_downgrade = (lock_vnode(vp, initial_locktype) != EBUSY);
+  } else if ((vp = find_vnode(res.fs_e, res.inode_nr)) != NULL) {
+	/* We already have a vnode for that file */
 	unlock_vnode(new_vp);	/* Don't need this anymore */
 	do_downgrade = (lock_vnode(vp, initial_locktype) != EBUSY);
 
@@ -118,7 +130,7 @@ struct fproc *rfp;
 	vp = new_vp;
   }
 
-  dup_vnode(vp);
+  if (!cached) dup_vnode(vp);
   if (do_downgrade) {
 	/* Only downgrade a lock if we managed to lock it in the first place */
 	*(resolve->l_vnode) = vp;
@@ -391,18 +403,21 @@ struct fproc *rfp;
 /*===========================================================================*
  *				lookup					     *
  *===========================================================================*/
-static int lookup(start_node, resolve, result_node, rfp)
+static int lookup(start_node, resolve, result_node, rfp, cached)
 struct vnode *start_node;
 struct lookup *resolve;
 node_details_t *result_node;
 struct fproc *rfp;
+int *cached;
 {
-/* Resolve a path name relative to start_node. */
+/* Resolve a path name relative to start_node. Set 'cached' if the name cache
+ * resolved it to a vnode in use, so that the FS was not asked for a reference.
+ */
 
   int r, symloop;
   endpoint_t fs_e;
   size_t path_off, path_left_len;
-  ino_t dir_ino, root_ino;
+  ino_t root_ino;
   uid_t uid;
   gid_t gid;
   struct vnode *dir_vp;
@@ -414,6 +429,7 @@ struct fproc *rfp;
   assert(resolve->l_vnode);
 
   *(resolve->l_vmp) = vmpres = NULL; /* No vmnt found nor locked yet */
+  *cached = FALSE;
 
   /* Empty (start) path? */
   if (resolve->l_path[0] == '\0') {
@@ -427,7 +443,6 @@ struct fproc *rfp;
   }
 
   fs_e = start_node->v_fs_e;
-  dir_ino = start_node->v_inode_nr;
   vmpres = find_vmnt(fs_e);
 
   if (vmpres == NULL) return(EIO);	/* mountpoint vanished? */
@@ -460,7 +475,7 @@ struct fproc *rfp;
   *(resolve->l_vmp) = vmpres;
 
   /* Issue the request */
-  r = req_lookup(fs_e, dir_ino, root_ino, uid, gid, resolve, &res, rfp);
+  r = lookup_dnlc(start_node, root_ino, uid, gid, resolve, &res, rfp, cached);
 
   if (r != OK && r != EENTERMOUNT && r != ELEAVEMOUNT && r != ESYMLINK) {
 	if (vmpres) unlock_vmnt(vmpres);
@@ -533,9 +548,8 @@ struct fproc *rfp;
 		dir_vp = vmp->m_mounted_on;
 	}
 
-	/* Set the starting directories inode number and FS endpoint */
+	/* Set the starting directory's FS endpoint */
 	fs_e = dir_vp->v_fs_e;
-	dir_ino = dir_vp->v_inode_nr;
 
 	/* Is the process' root directory on the same partition?,
 	 * if so, set the chroot directory too. */
@@ -556,7 +570,8 @@ struct fproc *rfp;
 	}
 	*(resolve->l_vmp) = vmpres;
 
-	r = req_lookup(fs_e, dir_ino, root_ino, uid, gid, resolve, &res, rfp);
+	r = lookup_dnlc(dir_vp, root_ino, uid, gid, resolve, &res, rfp,
+		cached);
 
 	if (r != OK && r != EENTERMOUNT && r != ELEAVEMOUNT && r != ESYMLINK) {
 		if (vmpres) unlock_vmnt(vmpres);
@@ -582,6 +597,113 @@ struct fproc *rfp;
   return(r);
 }
 
+/*===========================================================================*
+ *				lookup_dnlc				     *
+ *===========================================================================*/
+static int lookup_dnlc(dirp, root_ino, uid, gid, resolve, res, rfp, cached)
+struct vnode *dirp;
+ino_t root_ino;
+uid_t uid;
+gid_t gid;
+struct lookup *resolve;
+lookup_res_t *res;
+struct fproc *rfp;
+int *cached;
+{
+/* Resolve a path name relative to dirp, within one FS. Walk the path through
+ * the name cache for as long as the names found lead to vnodes in use, then
+ * ask the FS to resolve what is left. Learn from single-name lookups that do
+ * not follow symlinks.
+ */
+  int r, last;
+  endpoint_t fs_e;
+  ino_t ino;
+  char *cp, *name;
+  size_t len;
+  struct vnode *vp;
+
+  fs_e = dirp->v_fs_e;
+  cp = resolve->l_path;
+
+  for (;;) {
+	name = cp;
+	while (*name == '/') name++;
+	if (*name == '\0') {
+		/* Trailing slashes are for directories only */
+		if (name != cp && !S_ISDIR(dirp->v_mode)) break;
+		res->fs_e = fs_e;
+		res->inode_nr = dirp->v_inode_nr;
+		res->fmode = dirp->v_mode;
+		res->fsize = dirp->v_size;
+		res->dev = dirp->v_sdev;
+		res->uid = dirp->v_uid;
+		res->gid = dirp->v_gid;
+		*cached = TRUE;
+		return(OK);
+	}
+
+	for (len = 0; name[len] != '\0' && name[len] != '/'; len++)
+		;
+	last = (name[len] == '\0');
+
+	/* The FS knows best about dot and dot-dot, and about errors */
+	if (name[0] == '.' && (len == 1 || (len == 2 && name[1] == '.')))
+		break;
+	if (!S_ISDIR(dirp->v_mode) || forbidden(rfp, dirp, X_BIT) != OK)
+		break;
+
+	r = dnlc_lookup(fs_e, dirp->v_inode_nr, name, len, &ino);
+	if (r == ENOENT) return(ENOENT);
+	if (r != OK) break;
+
+	/* Go on only with a vnode in use, and not one that may be on its way
+	 * out: put_vnode locks the last reference while the FS drops it. */
+	if ((vp = find_vnode(fs_e, ino)) == NULL) break;
+	if (vp->v_ref_count == 1 && is_vnode_locked(vp)) break;
+	if (is_mountpoint(vp)) break;
+	if (S_ISLNK(vp->v_mode) &&
+	    !(last && (resolve->l_flags & PATH_RET_SYMLINK)))
+		break;
+
+	dirp = vp;
+	cp = name + len;
+  }
+
+  /* Hand what is left of the path to the FS */
+  if (cp != resolve->l_path)
+	memmove(resolve->l_path, cp, strlen(cp) + 1);
+
+  r = req_lookup(fs_e, dirp->v_inode_nr, root_ino, uid, gid, resolve, res,
+	rfp);
+
+  name = resolve->l_path;
+  if ((resolve->l_flags & PATH_RET_SYMLINK) && strchr(name, '/') == NULL &&
+      strcmp(name, ".") && strcmp(name, "..")) {
+	if (r == OK && res->fs_e == fs_e)
+		dnlc_enter(fs_e, dirp->v_inode_nr, name, strlen(name),
+			res->inode_nr);
+	else if (r == ENOENT)
+		dnlc_enter(fs_e, dirp->v_inode_nr, name, strlen(name), 0);
+  }
+
+  return(r);
+}
+
+/*===========================================================================*
+ *				is_mountpoint				     *
+ *===========================================================================*/
+static int is_mountpoint(struct vnode *vp)
+{
+/* Tell whether a file system is mounted on a vnode */
+  struct vmnt *vmp;
+
+  for (vmp = &vmnt[0]; vmp < &vmnt[NR_MNTS]; vmp++)
+	if (vmp->m_dev != NO_DEV && vmp->m_mounted_on == vp)
+		return(TRUE);
+
+  return(FALSE);
+}
+
 /*===========================================================================*
  *				lookup_init				     *
  *===========================================================================*/
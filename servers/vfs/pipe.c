@@ -7,6 +7,7 @@
  * The entry points into this file are
  *   do_pipe:	  perform the PIPE system call
  *   pipe_check:  check to see that a read or write on a pipe is feasible now
+ *   pipe_handoff: copy data being written straight to a suspended reader
  *   suspend:	  suspend a process that cannot do a requested read or write
  *   release:	  check to see if a suspended process can be released and do
  *                it
@@ -19,6 +20,7 @@
 #include <fcntl.h>
 #include <signal.h>
 #include <assert.h>
+#include <sys/param.h>
 #include <minix/callnr.h>
 #include <minix/endpoint.h>
 #include <minix/com.h>
@@ -228,8 +230,10 @@ int notouch		/* check only */
 	return(EPIPE);
   }
 
-  /* Calculate how many bytes can be written. */
-  if (pos + bytes > PIPE_BUF) {
+  /* Calculate how many bytes can be written. Writes of up to PIPE_BUF bytes
+   * are atomic; larger ones may be split up to fill the pipe.
+   */
+  if (pos + bytes > vp->v_pipe_size) {
 	if (oflags & O_NONBLOCK) {
 		if (bytes <= PIPE_BUF) {
 			/* Write has to be atomic */
@@ -237,7 +241,7 @@ int notouch		/* check only */
 		}
 
 		/* Compute available space */
-		bytes = PIPE_BUF - pos;
+		bytes = vp->v_pipe_size - pos;
 
 		if (bytes > 0)  {
 			/* Do a partial write. Need to wakeup reader */
@@ -252,7 +256,7 @@ int notouch		/* check only */
 
 	if (bytes > PIPE_BUF) {
 		/* Compute available space */
-		bytes = PIPE_BUF - pos;
+		bytes = vp->v_pipe_size - pos;
 
 		if (bytes > 0) {
 			/* Do a partial write. Need to wakeup reader
@@ -277,6 +281,53 @@ int notouch		/* check only */
 }
 
 
+/*===========================================================================*
+ *				pipe_handoff				     *
+ *===========================================================================*/
+size_t pipe_handoff(
+struct vnode *vp,	/* the inode of the pipe */
+endpoint_t usr_e,	/* the writing process */
+char *buf,		/* the data being written */
+size_t size		/* bytes to be written */
+)
+{
+/* A process is about to write to an empty pipe. If a reader is suspended on
+ * the pipe, copy the data straight from the writer to the reader and release
+ * the reader with what it got, instead of passing the data through the pipe
+ * buffer in the FS and having the reader come back for it. Return the number
+ * of bytes handed off.
+ */
+  struct fproc *rp;
+  size_t bytes;
+
+  if (vp->v_size != 0 || susp_count == 0) return(0);
+
+  for (rp = &fproc[0]; rp < &fproc[NR_PROCS]; rp++) {
+	if (rp->fp_pid == PID_FREE || rp->fp_blocked_on != FP_BLOCKED_ON_PIPE ||
+	    (rp->fp_flags & FP_REVIVED) || rp->fp_block_callnr != READ)
+		continue;
+	if (scratch(rp).file.filp == NULL ||
+	    scratch(rp).file.filp->filp_vno != vp)
+		continue;
+
+	bytes = MIN(size, scratch(rp).io.io_nbytes);
+	if (vm_datacopy(usr_e, (vir_bytes) buf, rp->fp_endpoint,
+			 (vir_bytes) scratch(rp).io.io_buffer, bytes) != OK)
+		return(0);	/* Let the reader try again itself */
+
+	/* The read is done; the reader is no longer suspended. */
+	rp->fp_blocked_on = FP_BLOCKED_ON_NONE;
+	scratch(rp).file.filp = NULL;
+	susp_count--;
+	reply(rp->fp_endpoint, (int) bytes);
+
+	return(bytes);
+  }
+
+  return(0);
+}
+
+
 /*===========================================================================*
  *				suspend					     *
  *===========================================================================*/
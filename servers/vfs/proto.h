@@ -72,6 +72,16 @@ int map_driver(const char *label, int major, endpoint_t proc_nr, int
 	dev_style, int flags);
 int map_service(struct rprocpub *rpub);
 
+/* dnlc.c */
+void dnlc_init(void);
+int dnlc_lookup(endpoint_t fs_e, ino_t dir, char *name, size_t len,
+	ino_t *ino);
+void dnlc_enter(endpoint_t fs_e, ino_t dir, char *name, size_t len,
+	ino_t ino);
+void dnlc_purge(endpoint_t fs_e, ino_t dir, char *name);
+void dnlc_purge_fs(endpoint_t fs_e);
+int dnlc_getparam(char *key, char *buf, size_t len);
+
 /* elf_core_dump.c */
 void write_elf_core_file(struct filp *f, int csig, char *exe_name);
 
@@ -192,6 +202,8 @@ void release(struct vnode *vp, int op, int count);
 void revive(endpoint_t proc_e, int returned);
 void suspend(int why);
 void pipe_suspend(struct filp *rfilp, char *buf, size_t size);
+size_t pipe_handoff(struct vnode *vp, endpoint_t usr_e, char *buf,
+	size_t size);
 void unsuspend_by_endpt(endpoint_t proc_e);
 void wait_for(endpoint_t proc_e);
 
@@ -333,6 +345,16 @@ void put_vnode(struct vnode *vp);
 void vnode_clean_refs(struct vnode *vp);
 void upgrade_vnode_lock(struct vnode *vp);
 
+/* vm.c */
+void *do_vm_request(void *arg);
+void vm_reply(void);
+int vm_handlemem(endpoint_t ep, vir_bytes addr, size_t len, int wr);
+int vm_datacopy(endpoint_t src_e, vir_bytes src_addr, endpoint_t dst_e,
+	vir_bytes dst_addr, size_t len);
+int vm_mmap_exec(struct vnode *vp, endpoint_t proc_e, vir_bytes vaddr,
+	size_t len, off_t pos);
+void vm_forget(struct vnode *vp);
+
 /* write.c */
 int do_write(void);
 
@@ -354,9 +376,14 @@ void select_unsuspend_by_endpt(endpoint_t proc);
 
 /* worker.c */
 int worker_available(void);
+int worker_capwait(endpoint_t fs_e, int *waiting);
+void worker_capwake(endpoint_t fs_e);
+void worker_forget(struct fproc *rfp);
+int worker_getparam(char *key, char *buf, size_t len);
+int worker_setparam(char *key, int value);
 struct worker_thread *worker_get(thread_t worker_tid);
 struct job *worker_getjob(thread_t worker_tid);
-void worker_init(struct worker_thread *worker);
+void worker_init(void);
 void worker_signal(struct worker_thread *worker);
 void worker_start(void *(*func)(void *arg));
 void worker_stop(struct worker_thread *worker);
@@ -364,4 +391,5 @@ void worker_stop_by_endpt(endpoint_t proc_e);
 void worker_wait(void);
 void sys_worker_start(void *(*func)(void *arg));
 void dl_worker_start(void *(*func)(void *arg));
+void vm_worker_start(void *(*func)(void *arg));
 #endif
@@ -204,6 +204,9 @@ int read_write(int rw_flag, struct filp *f, char *buf, size_t size,
 			vp->v_size = ex64lo(position);
 		}
 	}
+
+	/* Pages VM cached of the file are no longer up to date. */
+	if (S_ISREG(vp->v_mode) && cum_io > 0) vm_forget(vp);
   }
 
   f->filp_pos = position;
@@ -277,6 +280,18 @@ size_t req_size;
   /* fp->fp_cum_io_partial is only nonzero when doing partial writes */
   cum_io = fp->fp_cum_io_partial;
 
+  /* Hand data for a suspended reader over directly. */
+  if (rw_flag == WRITING && req_size > 0 &&
+      (cum_io_incr = pipe_handoff(vp, usr_e, buf, req_size)) > 0) {
+	cum_io += cum_io_incr;
+	buf += cum_io_incr;
+	req_size -= cum_io_incr;
+	if (req_size == 0) {
+		fp->fp_cum_io_partial = 0;
+		return(cum_io);
+	}
+  }
+
   r = pipe_check(vp, rw_flag, oflags, req_size, 0);
   if (r <= 0) {
 	if (r == SUSPEND) pipe_suspend(f, buf, req_size);
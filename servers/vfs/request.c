@@ -24,6 +24,36 @@
 #include "path.h"
 #include "param.h"
 
+static int user_sendrec(endpoint_t fs_e, message *reqmp, endpoint_t user_e,
+	vir_bytes buf, size_t len, int wr);
+
+
+/*===========================================================================*
+ *				user_sendrec				     *
+ *===========================================================================*/
+static int user_sendrec(endpoint_t fs_e, message *reqmp, endpoint_t user_e,
+	vir_bytes buf, size_t len, int wr)
+{
+/* Send a request for which the FS copies to or from a buffer of process
+ * 'user_e'. If the copy failed because the buffer is paged in from a file
+ * that VM couldn't read while the FS waited, have VM make it present, and
+ * send the request once more.
+ */
+  message m;
+  int r;
+
+  m = *reqmp;
+  r = fs_sendrec(fs_e, reqmp);
+
+  if (r == EFAULT && user_e != VFS_PROC_NR && user_e != VM_PROC_NR &&
+      vm_handlemem(user_e, buf, len, wr) == OK) {
+	*reqmp = m;
+	r = fs_sendrec(fs_e, reqmp);
+  }
+
+  return(r);
+}
+
 
 /*===========================================================================*
  *			req_breadwrite					     *
@@ -58,7 +88,8 @@ int req_breadwrite(
   m.REQ_NBYTES = num_of_bytes;
 
   /* Send/rec request */
-  r = fs_sendrec(fs_e, &m);
+  r = user_sendrec(fs_e, &m, user_e, (vir_bytes) user_addr, num_of_bytes,
+	rw_flag == READING);
   cpf_revoke(grant_id);
   if (r != OK) return(r);
 
@@ -165,6 +196,7 @@ int req_create(
 
   /* Send/rec request */
   r = fs_sendrec(fs_e, &m);
+  dnlc_purge(fs_e, inode_nr, path);	/* The name has changed */
   cpf_revoke(grant_id);
   if (r != OK) return(r);
 
@@ -216,7 +248,7 @@ int req_fstatfs(endpoint_t fs_e, endpoint_t proc_e, vir_bytes buf)
   m.REQ_GRANT = grant_id;
 
   /* Send/rec request */
-  r = fs_sendrec(fs_e, &m);
+  r = user_sendrec(fs_e, &m, proc_e, buf, sizeof(struct statfs), TRUE);
   cpf_revoke(grant_id);
 
   return(r);
@@ -242,7 +274,7 @@ int req_statvfs(endpoint_t fs_e, endpoint_t proc_e, vir_bytes buf)
   m.REQ_GRANT = grant_id;
 
   /* Send/rec request */
-  r = fs_sendrec(fs_e, &m);
+  r = user_sendrec(fs_e, &m, proc_e, buf, sizeof(struct statvfs), TRUE);
   cpf_revoke(grant_id);
 
   return(r);
@@ -305,7 +337,8 @@ int req_getdents(
   m.REQ_SEEK_POS_LO = ex64lo(pos);
   m.REQ_SEEK_POS_HI = 0;	/* Not used for now, so clear it. */
 
-  r = fs_sendrec(fs_e, &m);
+  r = user_sendrec(fs_e, &m, direct ? VFS_PROC_NR : who_e, (vir_bytes) buf,
+	size, TRUE);
   cpf_revoke(grant_id);
 
   if (r == OK) {
@@ -360,6 +393,7 @@ int req_link(
 
   /* Send/rec request */
   r = fs_sendrec(fs_e, &m);
+  dnlc_purge(fs_e, link_parent, lastc);	/* The name has changed */
   cpf_revoke(grant_id);
 
   return(r);
@@ -501,6 +535,7 @@ int req_mkdir(
 
   /* Send/rec request */
   r = fs_sendrec(fs_e, &m);
+  dnlc_purge(fs_e, inode_nr, lastc);	/* The name has changed */
   cpf_revoke(grant_id);
 
   return(r);
@@ -542,6 +577,7 @@ int req_mknod(
 
   /* Send/rec request */
   r = fs_sendrec(fs_e, &m);
+  dnlc_purge(fs_e, inode_nr, lastc);	/* The name has changed */
   cpf_revoke(grant_id);
 
   return(r);
@@ -686,7 +722,7 @@ int direct; /* set to 1 to use direct grants instead of magic grants */
   m.REQ_MEM_SIZE = len;
 
   /* Send/rec request */
-  r = fs_sendrec(fs_e, &m);
+  r = user_sendrec(fs_e, &m, direct ? VFS_PROC_NR : proc_e, buf, len, TRUE);
   cpf_revoke(grant_id);
 
   if (r == OK) r = m.RES_NBYTES;
@@ -782,7 +818,8 @@ unsigned int *cum_iop;
   m.REQ_NBYTES = num_of_bytes;
 
   /* Send/rec request */
-  r = fs_sendrec(fs_e, &m);
+  r = user_sendrec(fs_e, &m, user_e, (vir_bytes) user_addr, num_of_bytes,
+	rw_flag == READING);
   cpf_revoke(grant_id);
 
   if (r == OK) {
@@ -831,6 +868,8 @@ char *new_name;
 
   /* Send/rec request */
   r = fs_sendrec(fs_e, &m);
+  dnlc_purge(fs_e, old_dir, old_name);	/* The names have changed */
+  dnlc_purge(fs_e, new_dir, new_name);
   cpf_revoke(gid_old);
   cpf_revoke(gid_new);
 
@@ -864,6 +903,7 @@ char *lastc;
 
   /* Send/rec request */
   r = fs_sendrec(fs_e, &m);
+  dnlc_purge(fs_e, inode_nr, lastc);	/* The name has changed */
   cpf_revoke(grant_id);
 
   return(r);
@@ -911,7 +951,8 @@ int req_slink(
   m.REQ_MEM_SIZE = path_length;
 
   /* Send/rec request */
-  r = fs_sendrec(fs_e, &m);
+  r = user_sendrec(fs_e, &m, proc_e, path_addr, path_length, FALSE);
+  dnlc_purge(fs_e, inode_nr, lastc);	/* The name has changed */
   cpf_revoke(gid_name);
   cpf_revoke(gid_buf);
 
@@ -952,7 +993,8 @@ int req_stat(endpoint_t fs_e, ino_t inode_nr, endpoint_t proc_e, vir_bytes buf,
   m.REQ_GRANT = grant_id;
 
   /* Send/rec request */
-  r = fs_sendrec(fs_e, &m);
+  r = user_sendrec(fs_e, &m, old_stat ? VFS_PROC_NR : proc_e, buf,
+	sizeof(struct stat), TRUE);
   cpf_revoke(grant_id);
 
   if (r != OK || old_stat == 0)
@@ -985,7 +1027,7 @@ int req_stat(endpoint_t fs_e, ino_t inode_nr, endpoint_t proc_e, vir_bytes buf,
   old_sb.st_ctime = sb.st_ctime;
 #endif
 
-  r = sys_vircopy(SELF, (vir_bytes) &old_sb, proc_e, buf,
+  r = vm_datacopy(SELF, (vir_bytes) &old_sb, proc_e, buf,
 		  sizeof(struct minix_prev_stat));
 
   return(r);
@@ -1034,6 +1076,7 @@ char *lastc;
 
   /* Send/rec request */
   r = fs_sendrec(fs_e, &m);
+  dnlc_purge(fs_e, inode_nr, lastc);	/* The name has changed */
   cpf_revoke(grant_id);
 
   return(r);
@@ -34,6 +34,8 @@ struct worker_thread {
   endpoint_t w_task;
   struct dmap *w_dmap;
   struct worker_thread *w_next;
+  struct worker_thread *w_nextidle;
+  endpoint_t w_capped_fs;	/* FS the vmnt cap holds this worker back for */
 };
 
 #endif
@@ -78,7 +78,7 @@ int fetch_name(vir_bytes path, size_t len, char *dest)
   }
 
   /* String is not contained in the message.  Get it from user space. */
-  r = sys_datacopy(who_e, path, VFS_PROC_NR, (vir_bytes) dest, len);
+  r = vm_datacopy(who_e, path, VFS_PROC_NR, (vir_bytes) dest, len);
   if (r != OK) {
 	err_code = EINVAL;
 	return(r);
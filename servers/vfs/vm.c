@@ -0,0 +1,317 @@
+/* This file handles the requests VM makes of VFS for memory mapped files,
+ * and the calls VFS makes of VM for them.
+ *
+ * VM never blocks on VFS. It sends its requests asynchronously, and they are
+ * carried out one after the other by the VM worker thread, which is never
+ * used for anything else. In particular it never waits for VM itself, so
+ * that VM can always get a page of a file read.
+ *
+ * The entry points into this file are:
+ *   do_vm_request:	carry out a request from VM, in the VM worker thread
+ *   vm_reply:		VM is done with a VM_VFS_HANDLEMEM call
+ *   vm_handlemem:	have VM make user memory present
+ *   vm_datacopy:	copy data, making user memory present if needed
+ *   vm_mmap_exec:	map part of an executable into a process
+ *   vm_forget:		tell VM a file it may have pages of has changed
+ */
+
+#include "fs.h"
+#include <sys/stat.h>
+#include <minix/com.h>
+#include <minix/endpoint.h>
+#include <minix/u64.h>
+#include <string.h>
+#include <assert.h>
+#include "file.h"
+#include "fproc.h"
+#include "dmap.h"
+#include "vmnt.h"
+#include "vnode.h"
+
+static int vm_fdlookup(message *m_out);
+static int vm_pagein(void);
+static int vm_put(void);
+static endpoint_t vm_driver(struct vnode *vp);
+
+/*===========================================================================*
+ *				do_vm_request				     *
+ *===========================================================================*/
+void *do_vm_request(void *arg)
+{
+/* VM wants something done with a file. Answer the request with a
+ * VM_VFS_REPLY call; VM sends the next one only then.
+ */
+  struct job my_job;
+  message m_out;
+  int r;
+
+  my_job = *((struct job *) arg);
+  fp = my_job.j_fp;
+
+  memset(&m_out, 0, sizeof(m_out));
+
+  switch (job_call_nr) {
+  case VFS_VM_FDLOOKUP:	r = vm_fdlookup(&m_out);	break;
+  case VFS_VM_PAGEIN:	r = vm_pagein();		break;
+  case VFS_VM_PUT:	r = vm_put();			break;
+  default:
+	printf("VFS: unknown request %d from VM\n", job_call_nr);
+	return(NULL);
+  }
+
+  m_out.m_type = VM_VFS_REPLY;
+  m_out.VMV_RESULT = r;
+  if ((r = asynsend3(VM_PROC_NR, &m_out, AMF_NOREPLY)) != OK)
+	panic("VFS: couldn't reply to VM: %d", r);
+
+  return(NULL);
+}
+
+/*===========================================================================*
+ *				vm_fdlookup				     *
+ *===========================================================================*/
+static int vm_fdlookup(message *m_out)
+{
+/* Find the file a process wants to mmap(), and give VM a reference to it.
+ * The filp is not locked: this thread must not wait for the process' own
+ * calls, and nothing here gives up the CPU.
+ */
+  struct fproc *rfp;
+  struct filp *f;
+  struct vnode *vp;
+  int slot, fd;
+
+  if (isokendpt(job_m_in.VMV_ENDPT, &slot) != OK) return(ESRCH);
+  rfp = &fproc[slot];
+
+  fd = job_m_in.VMV_FD;
+  if (fd < 0 || fd >= OPEN_MAX || (f = rfp->fp_filp[fd]) == NULL ||
+      f->filp_count <= 0)
+	return(EBADF);
+
+  if (!(f->filp_mode & R_BIT)) return(EACCES);
+  if ((vp = f->filp_vno) == NULL || !S_ISREG(vp->v_mode)) return(ENODEV);
+
+  dup_vnode(vp);
+  vp->v_vmcount++;
+
+  m_out->VMV_FS_E = vp->v_fs_e;
+  m_out->VMV_INO = vp->v_inode_nr;
+  m_out->VMV_DRV_E = vm_driver(vp);
+
+  return(OK);
+}
+
+/*===========================================================================*
+ *				vm_pagein				     *
+ *===========================================================================*/
+static int vm_pagein(void)
+{
+/* Read a page of a file into VM. VM holds a reference to the file, so its
+ * vnode is there. Return the number of bytes read.
+ */
+  struct vnode *vp;
+  u64_t new_pos;
+  unsigned int cum_io;
+  int r;
+
+  if ((vp = find_vnode(job_m_in.VMV_FS_E, job_m_in.VMV_INO)) == NULL)
+	return(EIO);
+
+  if ((unsigned long) job_m_in.VMV_POS >= (unsigned long) vp->v_size)
+	return(0);
+
+  r = req_readwrite(vp->v_fs_e, vp->v_inode_nr, cvul64(job_m_in.VMV_POS),
+	READING, VM_PROC_NR, (char *) job_m_in.VMV_ADDR,
+	(unsigned int) job_m_in.VMV_LEN, &new_pos, &cum_io);
+
+  return(r == OK ? (int) cum_io : r);
+}
+
+/*===========================================================================*
+ *				vm_put					     *
+ *===========================================================================*/
+static int vm_put(void)
+{
+/* VM no longer uses a file. If VM holds the only reference, nobody else can
+ * have the vnode locked; otherwise drop the reference without taking a
+ * lock, as its holder may be waiting for this thread to read a page. VM
+ * knows the file server may have to answer first, and keeps copies by it
+ * from waiting for the pages asked for after this.
+ */
+  struct vnode *vp;
+
+  if ((vp = find_vnode(job_m_in.VMV_FS_E, job_m_in.VMV_INO)) == NULL ||
+      vp->v_vmcount <= 0) {
+	printf("VFS: VM put unknown file %d/%d\n", job_m_in.VMV_FS_E,
+		(int) job_m_in.VMV_INO);
+	return(EINVAL);
+  }
+
+  vp->v_vmcount--;
+  if (vp->v_ref_count > 1)
+	vp->v_ref_count--;
+  else
+	put_vnode(vp);
+
+  return(OK);
+}
+
+/*===========================================================================*
+ *				vm_driver				     *
+ *===========================================================================*/
+static endpoint_t vm_driver(struct vnode *vp)
+{
+/* Return the driver of the device the file system of a file is on, or NONE.
+ * VM must not wait for a page of the file when this driver asks it for
+ * memory, as reading the page may need the driver.
+ */
+  struct vmnt *vmp;
+  int major_dev;
+
+  if ((vmp = vp->v_vmnt) == NULL) return(NONE);
+
+  major_dev = major(vmp->m_dev);
+  if (major_dev < 0 || major_dev >= NR_DEVICES) return(NONE);
+
+  return(dmap[major_dev].dmap_driver);
+}
+
+/*===========================================================================*
+ *				vm_reply				     *
+ *===========================================================================*/
+void vm_reply(void)
+{
+/* VM answers a VM_VFS_HANDLEMEM call. Wake up the worker that made it. */
+  struct worker_thread *wp;
+
+  wp = worker_get((thread_t) m_in.VMV_ID);
+  if (wp == NULL || wp->w_task != VM_PROC_NR || wp->w_drv_sendrec == NULL) {
+	printf("VFS: spurious reply from VM for thread %d\n", m_in.VMV_ID);
+	return;
+  }
+
+  *wp->w_drv_sendrec = m_in;
+  wp->w_drv_sendrec = NULL;
+  wp->w_task = NONE;
+  worker_signal(wp);
+}
+
+/*===========================================================================*
+ *				vm_handlemem				     *
+ *===========================================================================*/
+int vm_handlemem(endpoint_t ep, vir_bytes addr, size_t len, int wr)
+{
+/* A copy to or from a process failed, which may be because its memory is
+ * paged in from a file, and VM can't read the file while VFS or the file
+ * server waits for the copy. Have VM make the memory present, waiting for
+ * it in this thread only. Return OK if a copy may be retried.
+ */
+  message m;
+  int r;
+
+  /* The memory of VFS and VM is always there. */
+  if (ep == SELF || ep == VFS_PROC_NR || ep == VM_PROC_NR) return(OK);
+
+  /* Only a worker can wait, and the VM worker must not wait for VM. */
+  if (self == NULL || self == &vm_worker) return(EFAULT);
+
+  memset(&m, 0, sizeof(m));
+  m.m_type = VM_VFS_HANDLEMEM;
+  m.VMV_ENDPT = ep;
+  m.VMV_ADDR = (long) addr;
+  m.VMV_LEN = (int) len;
+  m.VMV_WRITE = wr;
+  m.VMV_ID = (int) self->w_tid;
+
+  self->w_task = VM_PROC_NR;
+  self->w_drv_sendrec = &m;
+
+  if ((r = asynsend3(VM_PROC_NR, &m, AMF_NOREPLY)) != OK) {
+	self->w_task = NONE;
+	self->w_drv_sendrec = NULL;
+	printf("VFS: couldn't send to VM: %d\n", r);
+	return(r);
+  }
+
+  worker_wait();	/* Yield execution until VM is done */
+
+  return(m.m_type == VFS_VM_REPLY ? m.VMV_RESULT : EIO);
+}
+
+/*===========================================================================*
+ *				vm_datacopy				     *
+ *===========================================================================*/
+int vm_datacopy(endpoint_t src_e, vir_bytes src_addr, endpoint_t dst_e,
+	vir_bytes dst_addr, size_t len)
+{
+/* Copy data, like sys_datacopy. If that fails because memory is not there,
+ * have VM make it present and try once more.
+ */
+  int r;
+
+  r = sys_datacopy(src_e, src_addr, dst_e, dst_addr, (phys_bytes) len);
+  if (r != EFAULT) return(r);
+
+  if (vm_handlemem(src_e, src_addr, len, FALSE) != OK ||
+      vm_handlemem(dst_e, dst_addr, len, TRUE) != OK)
+	return(r);
+
+  return(sys_datacopy(src_e, src_addr, dst_e, dst_addr, (phys_bytes) len));
+}
+
+/*===========================================================================*
+ *				vm_mmap_exec				     *
+ *===========================================================================*/
+int vm_mmap_exec(struct vnode *vp, endpoint_t proc_e, vir_bytes vaddr,
+	size_t len, off_t pos)
+{
+/* Map 'len' bytes of an executable file, from 'pos' on, into a process at
+ * 'vaddr', for VM to page in when they are used. VM gets a reference to the
+ * file for the mapping; if the mapping fails, VM gives it back with a PUT.
+ */
+  message m;
+  int r;
+
+  if (!S_ISREG(vp->v_mode)) return(ENODEV);
+
+  memset(&m, 0, sizeof(m));
+  m.m_type = VM_VFS_MMAP;
+  m.VMV_ENDPT = proc_e;
+  m.VMV_FS_E = vp->v_fs_e;
+  m.VMV_INO = vp->v_inode_nr;
+  m.VMV_DRV_E = vm_driver(vp);
+  m.VMV_POS = (long) pos;
+  m.VMV_ADDR = (long) vaddr;
+  m.VMV_LEN = (int) len;
+
+  dup_vnode(vp);
+  vp->v_vmcount++;
+
+  if ((r = sendrec(VM_PROC_NR, &m)) != OK)
+	panic("VFS: couldn't talk to VM: %d", r);
+
+  return(m.m_type);
+}
+
+/*===========================================================================*
+ *				vm_forget				     *
+ *===========================================================================*/
+void vm_forget(struct vnode *vp)
+{
+/* The contents of a file changed. If VM may have pages of it in its cache,
+ * have it drop them, so that mappings made from now on see the change.
+ */
+  message m;
+  int r;
+
+  if (vp->v_vmcount <= 0) return;
+
+  memset(&m, 0, sizeof(m));
+  m.m_type = VM_VFS_FORGET;
+  m.VMV_FS_E = vp->v_fs_e;
+  m.VMV_INO = vp->v_inode_nr;
+
+  if ((r = asynsend3(VM_PROC_NR, &m, AMF_NOREPLY)) != OK)
+	printf("VFS: couldn't send to VM: %d\n", r);
+}
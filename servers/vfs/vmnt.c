@@ -67,6 +67,7 @@ void mark_vmnt_free(struct vmnt *vmp)
 {
   ASSERTVMP(vmp);
 
+  if (vmp->m_fs_e != NONE) dnlc_purge_fs(vmp->m_fs_e);
   vmp->m_fs_e = NONE;
   vmp->m_dev = NO_DEV;
 }
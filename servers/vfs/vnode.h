@@ -10,9 +10,11 @@ EXTERN struct vnode {
   uid_t v_uid;			/* uid of inode. */
   gid_t v_gid;			/* gid of inode. */
   off_t v_size;			/* current file size in bytes */
+  off_t v_pipe_size;		/* capacity of a pipe in bytes */
   int v_ref_count;		/* # times vnode used; 0 means slot is free */
   int v_fs_count;		/* # reference at the underlying FS */
   int v_mapfs_count;		/* # reference at the underlying mapped FS */
+  int v_vmcount;		/* # references held by VM for mappings */
 #if 0
   int v_ref_check;		/* for consistency checks */
 #endif
@@ -4,17 +4,43 @@
 #include "threads.h"
 #include "job.h"
 #include <assert.h>
+#include <stdio.h>
+#include <string.h>
 
 static void append_job(struct job *job, void *(*func)(void *arg));
-static void get_work(struct worker_thread *worker);
+static int get_work(struct worker_thread *worker);
 static void *worker_main(void *arg);
+static void worker_create(struct worker_thread *wp);
+static struct worker_thread *worker_spawn(void);
 static void worker_sleep(struct worker_thread *worker);
 static void worker_wake(struct worker_thread *worker);
 static int worker_waiting_for(struct worker_thread *worker, endpoint_t
 	proc_e);
-static int init = 0;
+static void pending_add(struct fproc *rfp);
+static void pending_del(struct fproc *rfp);
 static mthread_attr_t tattr;
 
+/* The pool of worker threads grows on demand up to 'worker_max' threads, and
+ * shrinks back to 'worker_min' threads when they run out of work. Idle
+ * threads are kept on a stack, processes with work waiting for a thread on a
+ * FIFO queue.
+ */
+static int worker_min = WTHREADS_MIN;	/* threads kept around */
+static int worker_max = NR_WTHREADS;	/* threads at most */
+static int vmnt_max_workers = WTHREADS_VMNT; /* threads waiting on one FS */
+static int nr_workers;			/* threads in the pool */
+static int nr_idle;			/* threads without work */
+static int nr_capwait;			/* threads held back by vmnt cap */
+static struct worker_thread *idle;	/* stack of threads without work */
+static struct fproc *pend_head, *pend_tail;	/* queue of pending work */
+
+/* Statistics */
+static unsigned long spawned, retired;	/* threads started and stopped */
+static unsigned long pend_jobs;		/* jobs that had to wait */
+static int pend_max;			/* longest pending queue */
+static clock_t pend_ticks, pend_max_ticks; /* total and longest wait */
+static unsigned long capped;		/* requests held back by vmnt cap */
+
 #ifdef MKCOVERAGE
 # define TH_STACKSIZE (10 * 1024)
 #else
@@ -22,76 +48,144 @@ static mthread_attr_t tattr;
 #endif
 
 #define ASSERTW(w) assert((w) == &sys_worker || (w) == &dl_worker || \
+		   (w) == &vm_worker || \
 		   ((w) >= &workers[0] && (w) < &workers[NR_WTHREADS]));
 
+#define IS_POOL(w)	((w) != &sys_worker && (w) != &dl_worker && \
+			 (w) != &vm_worker)
+
 /*===========================================================================*
  *				worker_init				     *
  *===========================================================================*/
-void worker_init(struct worker_thread *wp)
+void worker_init(void)
 {
-/* Initialize worker thread */
-  if (!init) {
-	threads_init();
-	if (mthread_attr_init(&tattr) != 0)
-		panic("failed to initialize attribute");
-	if (mthread_attr_setstacksize(&tattr, TH_STACKSIZE) != 0)
-		panic("couldn't set default thread stack size");
-	if (mthread_attr_setdetachstate(&tattr, MTHREAD_CREATE_DETACHED) != 0)
-		panic("couldn't set default thread detach state");
-	invalid_thread_id = mthread_self(); /* Assuming we're the main thread*/
-	pending = 0;
-	init = 1;
+/* Initialize the worker threads: the system, deadlock resolving and VM
+ * workers, and the smallest pool of ordinary workers.
+ */
+  int i;
+
+  threads_init();
+  if (mthread_attr_init(&tattr) != 0)
+	panic("failed to initialize attribute");
+  if (mthread_attr_setstacksize(&tattr, TH_STACKSIZE) != 0)
+	panic("couldn't set default thread stack size");
+  if (mthread_attr_setdetachstate(&tattr, MTHREAD_CREATE_DETACHED) != 0)
+	panic("couldn't set default thread detach state");
+  invalid_thread_id = mthread_self(); /* Assuming we're the main thread*/
+  pending = 0;
+
+  for (i = 0; i < NR_WTHREADS; i++)
+	workers[i].w_tid = invalid_thread_id;	/* Mark slot free */
+
+  worker_create(&sys_worker); /* exclusive system worker thread */
+  yield();
+  worker_create(&dl_worker); /* exclusive worker thread to resolve deadlocks */
+  yield();
+  worker_create(&vm_worker); /* exclusive worker thread for requests of VM */
+  yield();
+
+  for (i = 0; i < worker_min; i++) {
+	(void) worker_spawn();
+	yield();	/* Let it go idle */
   }
+}
 
+/*===========================================================================*
+ *				worker_create				     *
+ *===========================================================================*/
+static void worker_create(struct worker_thread *wp)
+{
+/* Start a thread for a worker slot. The thread runs once we yield. */
   ASSERTW(wp);
 
   wp->w_job.j_func = NULL;		/* Mark not in use */
   wp->w_next = NULL;
+  wp->w_nextidle = NULL;
+  wp->w_capped_fs = NONE;
   if (mutex_init(&wp->w_event_mutex, NULL) != 0)
 	panic("failed to initialize mutex");
   if (cond_init(&wp->w_event, NULL) != 0)
 	panic("failed to initialize conditional variable");
   if (mthread_create(&wp->w_tid, &tattr, worker_main, (void *) wp) != 0)
 	panic("unable to start thread");
-  yield();
+}
+
+/*===========================================================================*
+ *				worker_spawn				     *
+ *===========================================================================*/
+static struct worker_thread *worker_spawn(void)
+{
+/* Grow the pool by one worker. Return NULL if it is as large as allowed. */
+  struct worker_thread *wp;
+
+  if (nr_workers >= worker_max) return(NULL);
+
+  for (wp = &workers[0]; wp < &workers[NR_WTHREADS]; wp++)
+	if (wp->w_tid == invalid_thread_id) break;
+  assert(wp < &workers[NR_WTHREADS]);
+
+  worker_create(wp);
+  nr_workers++;
+  spawned++;
+  return(wp);
 }
 
 /*===========================================================================*
  *				get_work				     *
  *===========================================================================*/
-static void get_work(struct worker_thread *worker)
+static int get_work(struct worker_thread *worker)
 {
 /* Find new work to do. Work can be 'queued', 'pending', or absent. In the
- * latter case wait for new work to come in. */
-
+ * latter case wait for new work to come in, unless the pool has more workers
+ * than it needs; then return FALSE to have this worker stop.
+ */
   struct job *new_job;
   struct fproc *rfp;
+  clock_t now, waited;
 
   ASSERTW(worker);
   self = worker;
 
+  /* Were we handed work when we were started? */
+  if (worker->w_job.j_func != NULL)
+	return(TRUE);
+
   /* Do we have queued work to do? */
   if ((new_job = worker->w_job.j_next) != NULL) {
 	worker->w_job = *new_job;
 	free(new_job);
-	return;
-  } else if (worker != &sys_worker && worker != &dl_worker && pending > 0) {
-	/* Find pending work */
-	for (rfp = &fproc[0]; rfp < &fproc[NR_PROCS]; rfp++) {
-		if (rfp->fp_flags & FP_PENDING) {
-			worker->w_job = rfp->fp_job;
-			rfp->fp_job.j_func = NULL;
-			rfp->fp_flags &= ~FP_PENDING; /* No longer pending */
-			pending--;
-			assert(pending >= 0);
-			return;
-		}
+	return(TRUE);
+  } else if (IS_POOL(worker) && (rfp = pend_head) != NULL) {
+	/* Take the oldest pending work */
+	pending_del(rfp);
+	worker->w_job = rfp->fp_job;
+	rfp->fp_job.j_func = NULL;
+
+	if (getuptime(&now) == OK) {
+		waited = now - rfp->fp_pend_since;
+		pend_ticks += waited;
+		if (waited > pend_max_ticks) pend_max_ticks = waited;
 	}
-	panic("Pending work inconsistency");
+	return(TRUE);
+  }
+
+  if (IS_POOL(worker)) {
+	/* Keep at most one idle worker beyond the smallest pool */
+	if (nr_workers > worker_min && nr_idle > 0) {
+		worker->w_tid = invalid_thread_id;	/* Mark slot free */
+		nr_workers--;
+		retired++;
+		return(FALSE);
+	}
+
+	worker->w_nextidle = idle;
+	idle = worker;
+	nr_idle++;
   }
 
   /* Wait for work to come to us */
   worker_sleep(worker);
+  return(TRUE);
 }
 
 /*===========================================================================*
@@ -99,15 +193,59 @@ static void get_work(struct worker_thread *worker)
  *===========================================================================*/
 int worker_available(void)
 {
-  int busy, i;
+/* Return the number of jobs that can be started without waiting: one for
+ * every idle worker and every worker the pool may still grow by.
+ */
+  return(nr_idle + MAX(worker_max - nr_workers, 0));
+}
+
+/*===========================================================================*
+ *				worker_capwait				     *
+ *===========================================================================*/
+int worker_capwait(endpoint_t fs_e, int *waiting)
+{
+/* Hold the current worker back while '*waiting' other workers already wait on
+ * file server 'fs_e', so that one hung file server cannot have the whole pool
+ * send it requests. A worker held back keeps its thread, so rather than leave
+ * fewer than WTHREADS_RESERVE threads for other work, fail with EAGAIN. The
+ * system, deadlock resolving and VM workers are exempt.
+ */
+  if (!IS_POOL(self) || *waiting < vmnt_max_workers)
+	return(OK);
+
+  capped++;
+  if (nr_capwait + *waiting >= worker_max - WTHREADS_RESERVE)
+	return(EAGAIN);
+
+  nr_capwait++;
+  do {
+	self->w_capped_fs = fs_e;
+	worker_wait();
+	self->w_capped_fs = NONE;
+  } while (*waiting >= vmnt_max_workers);
+  nr_capwait--;
+
+  return(OK);
+}
+
+/*===========================================================================*
+ *				worker_capwake				     *
+ *===========================================================================*/
+void worker_capwake(endpoint_t fs_e)
+{
+/* A worker is done waiting on file server 'fs_e'. Let a worker the cap holds
+ * back for it go on.
+ */
+  int i;
 
-  busy = 0;
   for (i = 0; i < NR_WTHREADS; i++) {
-	if (workers[i].w_job.j_func != NULL)
-		busy++;
+	if (workers[i].w_tid != invalid_thread_id &&
+	    workers[i].w_capped_fs == fs_e) {
+		workers[i].w_capped_fs = NONE;
+		worker_signal(&workers[i]);
+		return;
+	}
   }
-
-  return(NR_WTHREADS - busy);
 }
 
 /*===========================================================================*
@@ -121,8 +259,7 @@ static void *worker_main(void *arg)
   me = (struct worker_thread *) arg;
   ASSERTW(me);
 
-  while(TRUE) {
-	get_work(me);
+  while (get_work(me)) {
 
 	/* Register ourselves in fproc table if possible */
 	if (me->w_job.j_fp != NULL) {
@@ -142,7 +279,12 @@ static void *worker_main(void *arg)
 	me->w_job.j_fp = NULL;
   }
 
-  return(NULL);	/* Unreachable */
+  /* The pool has shrunk; let this thread exit */
+  if (mutex_destroy(&me->w_event_mutex) != 0)
+	panic("failed to destroy mutex");
+  if (cond_destroy(&me->w_event) != 0)
+	panic("failed to destroy conditional variable");
+  return(NULL);
 }
 
 /*===========================================================================*
@@ -181,6 +323,26 @@ void sys_worker_start(void *(*func)(void *arg))
   }
 }
 
+/*===========================================================================*
+ *				vm_worker_start				     *
+ *===========================================================================*/
+void vm_worker_start(void *(*func)(void *arg))
+{
+/* Carry out a request of VM. VM's requests are done one after the other, by
+ * a thread that never waits for VM or for the pool of workers, so VM can
+ * always have a page of a file read even when all other workers wait for it.
+ */
+
+  if (vm_worker.w_job.j_func == NULL) {
+	vm_worker.w_job.j_fp = fp;
+	vm_worker.w_job.j_m_in = m_in;
+	vm_worker.w_job.j_func = func;
+	worker_wake(&vm_worker);
+  } else {
+	append_job(&vm_worker.w_job, func);
+  }
+}
+
 /*===========================================================================*
  *				append_job				     *
  *===========================================================================*/
@@ -211,22 +373,23 @@ static void append_job(struct job *job, void *(*func)(void *arg))
 void worker_start(void *(*func)(void *arg))
 {
 /* Find an available worker or wait for one */
-  int i;
   struct worker_thread *worker;
 
   if (fp->fp_flags & FP_DROP_WORK) {
 	return;	/* This process is not allowed to accept new work */
   }
 
-  worker = NULL;
-  for (i = 0; i < NR_WTHREADS; i++) {
-	if (workers[i].w_job.j_func == NULL) {
-		worker = &workers[i];
-		break;
-	}
+  /* Take an idle worker, or grow the pool */
+  if ((worker = idle) != NULL) {
+	idle = worker->w_nextidle;
+	worker->w_nextidle = NULL;
+	nr_idle--;
+  } else {
+	worker = worker_spawn();
   }
 
   if (worker != NULL) {
+	assert(worker->w_job.j_func == NULL);
 	worker->w_job.j_fp = fp;
 	worker->w_job.j_m_in = m_in;
 	worker->w_job.j_func = func;
@@ -249,11 +412,67 @@ void worker_start(void *(*func)(void *arg))
 	fp->fp_job.j_func = func;
 	fp->fp_job.j_next = NULL;
 	fp->fp_job.j_err_code = OK;
-	fp->fp_flags |= FP_PENDING;
-	pending++;
+	pending_add(fp);
   }
 }
 
+/*===========================================================================*
+ *				pending_add				     *
+ *===========================================================================*/
+static void pending_add(struct fproc *rfp)
+{
+/* Queue a process whose job waits for a worker */
+  assert(!(rfp->fp_flags & FP_PENDING));
+
+  rfp->fp_flags |= FP_PENDING;
+  rfp->fp_pend_next = NULL;
+  rfp->fp_pend_prev = pend_tail;
+  if (pend_tail != NULL)
+	pend_tail->fp_pend_next = rfp;
+  else
+	pend_head = rfp;
+  pend_tail = rfp;
+  if (getuptime(&rfp->fp_pend_since) != OK)
+	rfp->fp_pend_since = 0;
+
+  pending++;
+  pend_jobs++;
+  if (pending > pend_max) pend_max = pending;
+}
+
+/*===========================================================================*
+ *				pending_del				     *
+ *===========================================================================*/
+static void pending_del(struct fproc *rfp)
+{
+/* Take a process off the pending queue */
+  assert(rfp->fp_flags & FP_PENDING);
+
+  if (rfp->fp_pend_prev != NULL)
+	rfp->fp_pend_prev->fp_pend_next = rfp->fp_pend_next;
+  else
+	pend_head = rfp->fp_pend_next;
+  if (rfp->fp_pend_next != NULL)
+	rfp->fp_pend_next->fp_pend_prev = rfp->fp_pend_prev;
+  else
+	pend_tail = rfp->fp_pend_prev;
+  rfp->fp_pend_next = rfp->fp_pend_prev = NULL;
+
+  rfp->fp_flags &= ~FP_PENDING; /* No longer pending */
+  pending--;
+  assert(pending >= 0);
+}
+
+/*===========================================================================*
+ *				worker_forget				     *
+ *===========================================================================*/
+void worker_forget(struct fproc *rfp)
+{
+/* An exiting process will not have its pending job done */
+  if (rfp->fp_flags & FP_PENDING)
+	pending_del(rfp);
+}
+
 /*===========================================================================*
  *				worker_sleep				     *
  *===========================================================================*/
@@ -340,9 +559,11 @@ void worker_stop_by_endpt(endpoint_t proc_e)
 
   if (worker_waiting_for(&sys_worker, proc_e)) worker_stop(&sys_worker);
   if (worker_waiting_for(&dl_worker, proc_e)) worker_stop(&dl_worker);
+  if (worker_waiting_for(&vm_worker, proc_e)) worker_stop(&vm_worker);
 
   for (i = 0; i < NR_WTHREADS; i++) {
 	worker = &workers[i];
+	if (worker->w_tid == invalid_thread_id) continue;
 	if (worker_waiting_for(worker, proc_e))
 		worker_stop(worker);
   }
@@ -361,9 +582,12 @@ struct worker_thread *worker_get(thread_t worker_tid)
 	worker = &sys_worker;
   else if (worker_tid == dl_worker.w_tid)
 	worker = &dl_worker;
+  else if (worker_tid == vm_worker.w_tid)
+	worker = &vm_worker;
   else {
 	for (i = 0; i < NR_WTHREADS; i++) {
-		if (workers[i].w_tid == worker_tid) {
+		if (workers[i].w_tid == worker_tid &&
+		    worker_tid != invalid_thread_id) {
 			worker = &workers[i];
 			break;
 		}
@@ -403,3 +627,49 @@ static int worker_waiting_for(struct worker_thread *worker, endpoint_t proc_e)
 
   return(0);
 }
+
+/*===========================================================================*
+ *				worker_setparam				     *
+ *===========================================================================*/
+int worker_setparam(char *key, int value)
+{
+/* Change one of the bounds of the worker pool. Return ESRCH if the key is not
+ * ours. The pool follows new bounds as work comes and goes.
+ */
+  if (!strcmp(key, "worker_min")) {
+	if (value < 1 || value > worker_max) return(EINVAL);
+	worker_min = value;
+  } else if (!strcmp(key, "worker_max")) {
+	if (value < worker_min || value > NR_WTHREADS) return(EINVAL);
+	worker_max = value;
+  } else if (!strcmp(key, "vmnt_max_workers")) {
+	if (value < 1) return(EINVAL);
+	vmnt_max_workers = value;
+  } else {
+	return(ESRCH);
+  }
+
+  return(OK);
+}
+
+/*===========================================================================*
+ *				worker_getparam				     *
+ *===========================================================================*/
+int worker_getparam(char *key, char *buf, size_t len)
+{
+/* Report the state of the worker pool. Return ESRCH if the key is not ours. */
+
+  if (!strcmp(key, "active_threads")) {
+	snprintf(buf, len, "%d", nr_workers - nr_idle);
+  } else if (!strcmp(key, "worker_stats")) {
+	snprintf(buf, len, "%d %d %d %d %lu %lu %d %d %lu %lu %lu %lu",
+		worker_min, worker_max, nr_workers, nr_idle, spawned,
+		retired, pending, pend_max, pend_jobs,
+		(unsigned long) pend_ticks, (unsigned long) pend_max_ticks,
+		capped);
+  } else {
+	return(ESRCH);
+  }
+
+  return(OK);
+}
@@ -1,5 +1,19 @@
 /* This file is concerned with allocating and freeing arbitrary-size blocks of
  * physical memory.
+ *
+ * Free memory is kept by a binary buddy allocator. For every order from 0 (one
+ * page) to MAX_ORDER (4 MB) there is a bitmap with a bit for each naturally
+ * aligned block of that size, set if the block is free as a whole. Every such
+ * bitmap carries a hierarchy of summary bitmaps, a bit per nonzero word of
+ * the level below, so that the highest free block under an address limit is
+ * found in a few word operations. Allocations take the smallest fitting block,
+ * splitting larger ones; frees coalesce with free buddies. Besides that, a
+ * plain per-page bitmap records which pages are free, for statistics, sanity
+ * checks and the rare contiguous allocation no single block can satisfy.
+ *
+ * Single pages that must be cleared are taken from a pool of pages zeroed
+ * ahead of time. VM refills the pool between requests, a batch of pages per
+ * kernel call, so that anonymous page faults need no sys_memset() of their own.
  */
 
 #define _SYSTEM 1
@@ -33,15 +47,39 @@
 #define NUMBER_PHYSICAL_PAGES (0x100000000ULL/VM_PAGE_SIZE)
 #define PAGE_BITMAP_CHUNKS BITMAP_CHUNKS(NUMBER_PHYSICAL_PAGES)
 static bitchunk_t free_pages_bitmap[PAGE_BITMAP_CHUNKS];
-#define PAGE_CACHE_MAX 10000
-static int free_page_cache[PAGE_CACHE_MAX];
-static int free_page_cache_size = 0;
+
+/* Buddy bitmaps. The level 0 bitmap of order o has a bit per block of 2^o
+ * pages; each next level has a bit per word of the one below it, up to a
+ * level that fits in a single word. All levels share one array.
+ */
+#define MAX_ORDER	10	/* largest block is 2^MAX_ORDER pages */
+#define NR_ORDERS	(MAX_ORDER + 1)
+#define MAX_LEVELS	5
+#define BUDDY_CHUNKS	(2 * PAGE_BITMAP_CHUNKS + PAGE_BITMAP_CHUNKS / 8)
+static bitchunk_t buddy_map[BUDDY_CHUNKS];
+static int buddy_off[NR_ORDERS][MAX_LEVELS];	/* start of each level */
+static int buddy_levels[NR_ORDERS];		/* number of levels */
+static unsigned long buddy_blocks[NR_ORDERS];	/* free blocks per order */
+static phys_bytes free_count;			/* free pages */
+
+/* Pool of zeroed pages. */
+#define ZERO_BATCH_ORDER 4	/* zero 2^ZERO_BATCH_ORDER pages per call */
+#define ZERO_POOL_MAX	512	/* pages kept zeroed, a multiple of a batch */
+#define ZERO_RESERVE	2048	/* free pages to leave alone when refilling */
+static phys_bytes zero_pool[ZERO_POOL_MAX];
+static int zero_pool_size;
+static unsigned long zero_hits, zero_misses;
 
 /* Used for sanity check. */
 static phys_bytes mem_low, mem_high;
 
 static void free_pages(phys_bytes addr, int pages);
 static phys_bytes alloc_pages(int pages, int flags);
+static void zero_pool_drain(void);
+static void buddy_init(void);
+static void buddy_insert(phys_bytes start, phys_bytes end);
+static void buddy_carve(phys_bytes start, phys_bytes end);
+static phys_bytes buddy_take(int order, phys_bytes limit);
 
 #if SANITYCHECKS
 struct {
@@ -79,6 +117,10 @@ phys_clicks alloc_mem(phys_clicks clicks, u32_t memflags)
     free_yielded(clicks * CLICK_SIZE);
     mem = alloc_pages(clicks, memflags);
   }
+  if(mem == NO_MEM && zero_pool_size > 0) {
+    zero_pool_drain();
+    mem = alloc_pages(clicks, memflags);
+  }
 
   if(mem == NO_MEM)
   	return mem;
@@ -139,6 +181,7 @@ struct memory *chunks;		/* list of free memory chunks */
   total_pages = 0;
 
   memset(free_pages_bitmap, 0, sizeof(free_pages_bitmap));
+  buddy_init();
 
   /* Use the chunks of physical memory to allocate holes. */
   for (i=NR_MEMS-1; i>=0; i--) {
@@ -186,6 +229,20 @@ void memstats(int *nodes, int *pages, int *largest)
 	}
 }
 
+/*===========================================================================*
+ *				memstats_blocks				     *
+ *===========================================================================*/
+void memstats_blocks(unsigned long *blocks, int orders)
+{
+/* Report the number of free blocks of 2^i pages, for i below 'orders'. How
+ * free memory spreads over the orders shows how fragmented it is.
+ */
+	int i;
+
+	for(i = 0; i < orders; i++)
+		blocks[i] = i < NR_ORDERS ? buddy_blocks[i] : 0;
+}
+
 static int findbit(int low, int startscan, int pages, int memflags, int *len)
 {
 	int run_length = 0, i;
@@ -218,6 +275,219 @@ static int findbit(int low, int startscan, int pages, int memflags, int *len)
 	return NO_MEM;
 }
 
+/*===========================================================================*
+ *				buddy_init				     *
+ *===========================================================================*/
+static void buddy_init(void)
+{
+/* Lay out the levels of all buddy bitmaps and mark everything in use. */
+	int order, level, bits, off = 0;
+
+	for(order = 0; order < NR_ORDERS; order++) {
+		bits = NUMBER_PHYSICAL_PAGES >> order;
+		for(level = 0; ; level++) {
+			assert(level < MAX_LEVELS);
+			buddy_off[order][level] = off;
+			off += BITMAP_CHUNKS(bits);
+			if(bits <= BITCHUNK_BITS)
+				break;
+			bits = BITMAP_CHUNKS(bits);
+		}
+		buddy_levels[order] = level + 1;
+		buddy_blocks[order] = 0;
+	}
+	assert(off <= BUDDY_CHUNKS);
+
+	memset(buddy_map, 0, sizeof(buddy_map));
+}
+
+/*===========================================================================*
+ *				buddy_set				     *
+ *===========================================================================*/
+static void buddy_set(int order, phys_bytes block)
+{
+	bitchunk_t *chunk, old;
+	int level;
+
+	for(level = 0; level < buddy_levels[order]; level++) {
+		chunk = &MAP_CHUNK(buddy_map + buddy_off[order][level], block);
+		old = *chunk;
+		*chunk |= 1 << CHUNK_OFFSET(block);
+		if(old) break;	/* summary bit above is set already */
+		block /= BITCHUNK_BITS;
+	}
+}
+
+/*===========================================================================*
+ *				buddy_unset				     *
+ *===========================================================================*/
+static void buddy_unset(int order, phys_bytes block)
+{
+	bitchunk_t *chunk;
+	int level;
+
+	for(level = 0; level < buddy_levels[order]; level++) {
+		chunk = &MAP_CHUNK(buddy_map + buddy_off[order][level], block);
+		*chunk &= ~(1 << CHUNK_OFFSET(block));
+		if(*chunk) break;	/* summary bit above stays set */
+		block /= BITCHUNK_BITS;
+	}
+}
+
+#define buddy_isset(order, block) \
+	GET_BIT(buddy_map + buddy_off[order][0], block)
+
+/*===========================================================================*
+ *				buddy_find				     *
+ *===========================================================================*/
+static int buddy_find(int order, int level, int limit)
+{
+/* Return the highest set bit below 'limit' in the given level of a buddy
+ * bitmap, or -1 if there is none. A clear word at this level sends the search
+ * up to the summary level, which names the highest nonzero word below it.
+ */
+	bitchunk_t *map = buddy_map + buddy_off[order][level], bits;
+	int chunk, offset;
+
+	if(limit <= 0)
+		return -1;
+
+	chunk = (limit - 1) / BITCHUNK_BITS;
+	offset = CHUNK_OFFSET(limit - 1);
+	bits = map[chunk];
+	if(offset < BITCHUNK_BITS - 1)
+		bits &= (1 << (offset + 1)) - 1;
+
+	if(!bits) {
+		if(level + 1 >= buddy_levels[order])
+			return -1;
+		if((chunk = buddy_find(order, level + 1, chunk)) < 0)
+			return -1;
+		bits = map[chunk];
+		assert(bits);
+	}
+
+	return chunk * BITCHUNK_BITS + BITCHUNK_BITS - 1 - __builtin_clz(bits);
+}
+
+/*===========================================================================*
+ *				block_add				     *
+ *===========================================================================*/
+static void block_add(phys_bytes page, int order)
+{
+	assert(!(page & ((1 << order) - 1)));
+	buddy_set(order, page >> order);
+	buddy_blocks[order]++;
+}
+
+/*===========================================================================*
+ *				block_del				     *
+ *===========================================================================*/
+static void block_del(phys_bytes page, int order)
+{
+	assert(buddy_isset(order, page >> order));
+	buddy_unset(order, page >> order);
+	buddy_blocks[order]--;
+}
+
+/*===========================================================================*
+ *				buddy_insert				     *
+ *===========================================================================*/
+static void buddy_insert(phys_bytes start, phys_bytes end)
+{
+/* Give the pages from 'start' up to 'end' to the buddy allocator. The range is
+ * cut into the largest naturally aligned blocks it holds, and each of those is
+ * merged with its buddy for as long as that buddy is free.
+ */
+	phys_bytes page, buddy, next;
+	int order;
+
+	while(start < end) {
+		order = 0;
+		while(order < MAX_ORDER && !(start & (1 << order)) &&
+			start + (2 << order) <= end)
+			order++;
+		next = start + (1 << order);
+
+		page = start;
+		while(order < MAX_ORDER) {
+			buddy = page ^ (1 << order);
+			if(!buddy_isset(order, buddy >> order))
+				break;
+			block_del(buddy, order);
+			page &= ~(1 << order);
+			order++;
+		}
+		block_add(page, order);
+
+		start = next;
+	}
+}
+
+/*===========================================================================*
+ *				buddy_take				     *
+ *===========================================================================*/
+static phys_bytes buddy_take(int want, phys_bytes limit)
+{
+/* Take a free block of 2^want pages that lies below page 'limit', splitting
+ * the smallest larger block if there is none of the exact size. Like the scan
+ * this replaced, prefer high memory and leave low memory for the callers that
+ * need it.
+ */
+	phys_bytes page;
+	int order, block = -1;
+
+	for(order = want; order <= MAX_ORDER; order++) {
+		if((block = buddy_find(order, 0, limit >> order)) >= 0)
+			break;
+	}
+	if(block < 0)
+		return NO_MEM;
+
+	page = (phys_bytes) block << order;
+	block_del(page, order);
+
+	/* Hand the lower halves back and keep the upper one. */
+	while(order > want) {
+		order--;
+		block_add(page, order);
+		page += 1 << order;
+	}
+
+	return page;
+}
+
+/*===========================================================================*
+ *				buddy_carve				     *
+ *===========================================================================*/
+static void buddy_carve(phys_bytes start, phys_bytes end)
+{
+/* Take the free pages from 'start' up to 'end' out of the buddy allocator,
+ * whatever blocks they are part of. Pieces of those blocks outside the range
+ * are given back.
+ */
+	phys_bytes page, base, top;
+	int order;
+
+	for(page = start; page < end; page = top) {
+		for(order = 0; order <= MAX_ORDER; order++) {
+			if(buddy_isset(order, page >> order))
+				break;
+		}
+		assert(order <= MAX_ORDER);
+
+		base = page & ~((1 << order) - 1);
+		top = base + (1 << order);
+		block_del(base, order);
+		if(base < start)
+			buddy_insert(base, start);
+		if(top > end) {
+			buddy_insert(end, top);
+			top = end;
+		}
+	}
+}
+
 /*===========================================================================*
  *				alloc_pages				     *
  *===========================================================================*/
@@ -225,49 +495,46 @@ static phys_bytes alloc_pages(int pages, int memflags)
 {
 	phys_bytes boundary16 = 16 * 1024 * 1024 / VM_PAGE_SIZE;
 	phys_bytes boundary1  =  1 * 1024 * 1024 / VM_PAGE_SIZE;
+	phys_bytes limit = NUMBER_PHYSICAL_PAGES;
 	phys_bytes mem = NO_MEM;
-	int maxpage = NUMBER_PHYSICAL_PAGES - 1, i;
-	static int lastscan = -1;
-	int startscan, run_length;
+	int order, i, run_length;
 
-	if(memflags & PAF_LOWER16MB)
-		maxpage = boundary16 - 1;
-	else if(memflags & PAF_LOWER1MB)
-		maxpage = boundary1 - 1;
-	else {
-		/* no position restrictions: check page cache */
-		if(pages == 1) {
-			while(free_page_cache_size > 0) {
-				i = free_page_cache[free_page_cache_size-1];
-				if(page_isfree(i)) {
-					free_page_cache_size--;
-					mem = i;
-					assert(mem != NO_MEM);
-					run_length = 1;
-					break;
-				}
-				free_page_cache_size--;
-			}
+	if((memflags & PAF_CLEAR) && pages == 1 &&
+		!(memflags & (PAF_LOWER16MB | PAF_LOWER1MB))) {
+		if(zero_pool_size > 0) {
+			zero_hits++;
+			return zero_pool[--zero_pool_size];
 		}
+		zero_misses++;
 	}
 
-	if(lastscan < maxpage && lastscan >= 0)
-		startscan = lastscan;
-	else	startscan = maxpage;
-
-	if(mem == NO_MEM)
-		mem = findbit(0, startscan, pages, memflags, &run_length);
-	if(mem == NO_MEM)
-		mem = findbit(0, maxpage, pages, memflags, &run_length);
+	if(memflags & PAF_LOWER16MB)
+		limit = boundary16;
+	else if(memflags & PAF_LOWER1MB)
+		limit = boundary1;
+
+	for(order = 0; order <= MAX_ORDER && (1 << order) < pages; order++)
+		;
+
+	if(order <= MAX_ORDER && (mem = buddy_take(order, limit)) != NO_MEM) {
+		/* Give back what the block holds beyond the request. */
+		buddy_insert(mem + pages, mem + (1 << order));
+	} else if(order > 0) {
+		/* No single block will do; the pages may still be free in a
+		 * row across block boundaries.
+		 */
+		mem = findbit(0, limit - 1, pages, memflags, &run_length);
+		if(mem != NO_MEM)
+			buddy_carve(mem, mem + pages);
+	}
 	if(mem == NO_MEM)
 		return NO_MEM;
 
-	/* remember for next time */
-	lastscan = mem;
-
 	for(i = mem; i < mem + pages; i++) {
+		assert(page_isfree(i));
 		UNSET_BIT(free_pages_bitmap, i);
 	}
+	free_count -= pages;
 
 	if(memflags & PAF_CLEAR) {
 		int s;
@@ -293,11 +560,74 @@ static void free_pages(phys_bytes pageno, int npages)
 #endif
 
 	for(i = pageno; i <= lim; i++) {
+		assert(!page_isfree(i));
 		SET_BIT(free_pages_bitmap, i);
-		if(free_page_cache_size < PAGE_CACHE_MAX) {
-			free_page_cache[free_page_cache_size++] = i;
-		}
 	}
+
+	free_count += npages;
+	buddy_insert(pageno, pageno + npages);
+}
+
+/*===========================================================================*
+ *				zero_pool_refill			     *
+ *===========================================================================*/
+void zero_pool_refill(void)
+{
+/* Add a batch of zeroed pages to the pool, unless it is full or memory is
+ * short. One block is cleared with a single kernel call. VM calls this before
+ * it waits for the next request, keeping the work off the fault path.
+ */
+	phys_bytes mem;
+	int i, pages = 1 << ZERO_BATCH_ORDER, s;
+
+	if(zero_pool_size + pages > ZERO_POOL_MAX ||
+		free_count < ZERO_RESERVE + pages)
+		return;
+
+	if((mem = buddy_take(ZERO_BATCH_ORDER, NUMBER_PHYSICAL_PAGES)) == NO_MEM)
+		return;
+
+	for(i = mem; i < mem + pages; i++) {
+		assert(page_isfree(i));
+		UNSET_BIT(free_pages_bitmap, i);
+	}
+	free_count -= pages;
+
+	if((s = sys_memset(NONE, 0, CLICK_SIZE*mem, VM_PAGE_SIZE*pages)) != OK)
+		panic("zero_pool_refill: sys_memset failed: %d", s);
+
+	for(i = pages - 1; i >= 0; i--)
+		zero_pool[zero_pool_size++] = mem + i;
+}
+
+/*===========================================================================*
+ *				mem_free_pages				     *
+ *===========================================================================*/
+phys_bytes mem_free_pages(void)
+{
+/* Return the number of pages that are free or can be made free at once. */
+	return free_count + zero_pool_size;
+}
+
+/*===========================================================================*
+ *				zero_pool_drain				     *
+ *===========================================================================*/
+static void zero_pool_drain(void)
+{
+/* Memory is short; give the zeroed pages back. */
+	while(zero_pool_size > 0)
+		free_pages(zero_pool[--zero_pool_size], 1);
+}
+
+/*===========================================================================*
+ *				zero_pool_stats				     *
+ *===========================================================================*/
+void zero_pool_stats(unsigned long *pages, unsigned long *hits,
+	unsigned long *misses)
+{
+	*pages = zero_pool_size;
+	*hits = zero_hits;
+	*misses = zero_misses;
 }
 
 /*===========================================================================*
@@ -305,11 +635,16 @@ static void free_pages(phys_bytes pageno, int npages)
  *===========================================================================*/
 void printmemstats(void)
 {
-	int nodes, pages, largest;
+	int nodes, pages, largest, i;
         memstats(&nodes, &pages, &largest);
         printf("%d blocks, %d pages (%lukB) free, largest %d pages (%lukB)\n",
                 nodes, pages, (unsigned long) pages * (VM_PAGE_SIZE/1024),
 		largest, (unsigned long) largest * (VM_PAGE_SIZE/1024));
+	for(i = 0; i < NR_ORDERS; i++)
+		printf("%lu%s", buddy_blocks[i], i < MAX_ORDER ? " " : "");
+	printf(" free blocks of 1 to %d pages\n", 1 << MAX_ORDER);
+	printf("%d zeroed pages, %lu hits, %lu misses\n",
+		zero_pool_size, zero_hits, zero_misses);
 }
 
 
@@ -577,6 +577,67 @@ static int pt_ptalloc(pt_t *pt, int pde, u32_t flags)
 	return OK;
 }
 
+#if defined(__i386__)
+/*===========================================================================*
+ *				pt_bigpte		     		     *
+ *===========================================================================*/
+static u32_t pt_bigpte(u32_t bigpde, vir_bytes v)
+{
+/* Return the page table entry that maps 'v' like big page 'bigpde' does. */
+	return ((bigpde & I386_VM_ADDR_MASK_4MB) +
+		(v & I386_VM_OFFSET_MASK_4MB & ARCH_VM_ADDR_MASK)) |
+		(bigpde & (ARCH_VM_PTE_PRESENT | ARCH_VM_PTE_USER |
+		ARCH_VM_PTE_RW | I386_VM_PWT | I386_VM_PCD |
+		I386_VM_ACC | I386_VM_DIRTY));
+}
+
+/*===========================================================================*
+ *				pt_bigsplit		     		     *
+ *===========================================================================*/
+static int pt_bigsplit(pt_t *pt, int pde)
+{
+/* Replace a big page of user memory by a page table that maps the same
+ * memory page by page, so that pages of it can be mapped differently.
+ */
+	int i;
+	u32_t bigpde;
+	phys_bytes pt_phys;
+
+	bigpde = pt->pt_dir[pde];
+	assert(bigpde & ARCH_VM_BIGPAGE);
+	assert(bigpde & ARCH_VM_PTE_USER);	/* Never split the kernel. */
+	assert(!pt->pt_pt[pde]);
+
+	if(!(pt->pt_pt[pde] = vm_allocpage(&pt_phys, VMP_PAGETABLE)))
+		return ENOMEM;
+
+	for(i = 0; i < ARCH_VM_PT_ENTRIES; i++)
+		pt->pt_pt[pde][i] = pt_bigpte(bigpde, i * VM_PAGE_SIZE);
+
+	pt->pt_dir[pde] = (pt_phys & ARCH_VM_ADDR_MASK)
+		| ARCH_VM_PDE_PRESENT | ARCH_VM_PTE_USER | ARCH_VM_PTE_RW;
+
+	return OK;
+}
+
+/*===========================================================================*
+ *				pt_bigsame		     		     *
+ *===========================================================================*/
+static int pt_bigsame(pt_t *pt, vir_bytes v, phys_bytes physaddr,
+	size_t bytes, u32_t flags)
+{
+/* Does a big page map the whole range to 'physaddr' with 'flags' already? */
+	int pde = I386_VM_PDE(v);
+
+	if(!(pt->pt_dir[pde] & ARCH_VM_BIGPAGE) || physaddr == MAP_NONE ||
+	  bytes == 0 || I386_VM_PDE(v + bytes - 1) != pde)
+		return 0;
+
+	return (pt_bigpte(pt->pt_dir[pde], v) & ~(I386_VM_ACC|I386_VM_DIRTY)) ==
+		((physaddr & ARCH_VM_ADDR_MASK) | flags);
+}
+#endif
+
 /*===========================================================================*
  *			    pt_ptalloc_in_range		     		     *
  *===========================================================================*/
@@ -598,7 +659,20 @@ int pt_ptalloc_in_range(pt_t *pt, vir_bytes start, vir_bytes end,
 
 	/* Scan all page-directory entries in the range. */
 	for(pde = first_pde; pde <= last_pde; pde++) {
+#if defined(__i386__)
+		/* A big page gets a page table of its own, unless it only
+		 * has to be verified.
+		 */
+		if(pt->pt_dir[pde] & ARCH_VM_BIGPAGE) {
+			int r;
+			if(verify)
+				continue;
+			if((r=pt_bigsplit(pt, pde)) != OK)
+				return r;
+		}
+#else
 		assert(!(pt->pt_dir[pde] & ARCH_VM_BIGPAGE));
+#endif
 		if(!(pt->pt_dir[pde] & ARCH_VM_PDE_PRESENT)) {
 			int r;
 			if(verify) {
@@ -861,6 +935,15 @@ int pt_writemap(struct vmproc * vmp,
 	assert(physaddr == MAP_NONE || (flags & ARCH_VM_PTE_PRESENT));
 	assert(physaddr != MAP_NONE || !flags);
 
+#if defined(__i386__)
+	/* Leave a big page alone if it maps the range as asked already;
+	 * the mapping of a page that is present is often written again.
+	 */
+	if(!verify && !(writemapflags & (WMF_WRITEFLAGSONLY|WMF_FREE)) &&
+	  pt_bigsame(pt, v, physaddr, bytes, flags))
+		goto resume_exit;
+#endif
+
 	/* First make sure all the necessary page tables are allocated,
 	 * before we start writing in any of them, because it's a pain
 	 * to undo our work properly.
@@ -873,7 +956,7 @@ int pt_writemap(struct vmproc * vmp,
 
 	/* Now write in them. */
 	for(p = 0; p < pages; p++) {
-		u32_t entry;
+		u32_t entry, cur;
 #if defined(__i386__)
 		int pde = I386_VM_PDE(v);
 		int pte = I386_VM_PTE(v);
@@ -889,13 +972,20 @@ int pt_writemap(struct vmproc * vmp,
 		/* Page table has to be there. */
 		assert(pt->pt_dir[pde] & ARCH_VM_PDE_PRESENT);
 
-		/* We do not expect it to be a bigpage. */
-		assert(!(pt->pt_dir[pde] & ARCH_VM_BIGPAGE));
-
-		/* Make sure page directory entry for this page table
-		 * is marked present and page table entry is available.
-		 */
-		assert(pt->pt_pt[pde]);
+#if defined(__i386__)
+		/* A big page is left there only to be verified. */
+		if(pt->pt_dir[pde] & ARCH_VM_BIGPAGE) {
+			assert(verify);
+			cur = pt_bigpte(pt->pt_dir[pde], v);
+		} else
+#endif
+		{
+			/* Make sure page directory entry for this page table
+			 * is marked present and page table entry is available.
+			 */
+			assert(pt->pt_pt[pde]);
+			cur = pt->pt_pt[pde][pte];
+		}
 
 #if SANITYCHECKS
 		/* We don't expect to overwrite a page. */
@@ -923,7 +1013,7 @@ int pt_writemap(struct vmproc * vmp,
 
 		if(verify) {
 			u32_t maskedentry;
-			maskedentry = pt->pt_pt[pde][pte];
+			maskedentry = cur;
 #if defined(__i386__)
 			maskedentry &= ~(I386_VM_ACC|I386_VM_DIRTY);
 #endif
@@ -952,12 +1042,12 @@ int pt_writemap(struct vmproc * vmp,
 						(long)entry, (long)maskedentry);
 				} else printf("phys ok; ");
 				printf(" flags: found %s; ",
-					ptestr(pt->pt_pt[pde][pte]));
+					ptestr(cur));
 				printf(" masked %s; ",
 					ptestr(maskedentry));
 				printf(" expected %s\n", ptestr(entry));
 				printf("found 0x%x, wanted 0x%x\n", 
-					pt->pt_pt[pde][pte], entry);
+					cur, entry);
 				ret = EFAULT;
 				goto resume_exit;
 			}
@@ -996,6 +1086,7 @@ int pt_checkrange(pt_t *pt, vir_bytes v,  size_t bytes,
 	pages = bytes / VM_PAGE_SIZE;
 
 	for(p = 0; p < pages; p++) {
+		u32_t entry;
 #if defined(__i386__)
 		int pde = I386_VM_PDE(v);
 		int pte = I386_VM_PTE(v);
@@ -1012,19 +1103,27 @@ int pt_checkrange(pt_t *pt, vir_bytes v,  size_t bytes,
 		if(!(pt->pt_dir[pde] & ARCH_VM_PDE_PRESENT))
 			return EFAULT;
 
-		/* Make sure page directory entry for this page table
-		 * is marked present and page table entry is available.
-		 */
-		assert((pt->pt_dir[pde] & ARCH_VM_PDE_PRESENT) && pt->pt_pt[pde]);
+#if defined(__i386__)
+		if(pt->pt_dir[pde] & ARCH_VM_BIGPAGE)
+			entry = pt_bigpte(pt->pt_dir[pde], v);
+		else
+#endif
+		{
+			/* Make sure page directory entry for this page table
+			 * is marked present and page table entry is available.
+			 */
+			assert(pt->pt_pt[pde]);
+			entry = pt->pt_pt[pde][pte];
+		}
 
-		if(!(pt->pt_pt[pde][pte] & ARCH_VM_PTE_PRESENT)) {
+		if(!(entry & ARCH_VM_PTE_PRESENT)) {
 			return EFAULT;
 		}
 
 #if defined(__i386__)
-		if(write && !(pt->pt_pt[pde][pte] & ARCH_VM_PTE_RW)) {
+		if(write && !(entry & ARCH_VM_PTE_RW)) {
 #elif defined(__arm__)
-		if(write && (pt->pt_pt[pde][pte] & ARCH_VM_PTE_RO)) {
+		if(write && (entry & ARCH_VM_PTE_RO)) {
 #endif
 			return EFAULT;
 		}
@@ -1035,6 +1134,153 @@ int pt_checkrange(pt_t *pt, vir_bytes v,  size_t bytes,
 	return OK;
 }
 
+/*===========================================================================*
+ *				pt_writeprotect		     		     *
+ *===========================================================================*/
+void pt_writeprotect(struct vmproc *vmp, pt_t *pt, vir_bytes v, size_t bytes)
+{
+/* Take write access away from every page mapped in a range, as fork does
+ * for the pages it shares copy-on-write. The range is walked one page table
+ * at a time, skipping the ones that aren't there, and the process is stopped
+ * only once for the whole range rather than for every page.
+ */
+	vir_bytes end;
+
+#ifdef CONFIG_SMP
+	int vminhibit_clear = 0;
+	if (vmp && vmp->vm_endpoint != NONE && vmp->vm_endpoint != VM_PROC_NR &&
+			!(vmp->vm_flags & VMF_EXITING)) {
+		sys_vmctl(vmp->vm_endpoint, VMCTL_VMINHIBIT_SET, 0);
+		vminhibit_clear = 1;
+	}
+#endif
+
+	assert(!(v % VM_PAGE_SIZE));
+	assert(!(bytes % VM_PAGE_SIZE));
+
+	for(end = v + bytes; v < end; ) {
+#if defined(__i386__)
+		int pde = I386_VM_PDE(v);
+		int pte = I386_VM_PTE(v);
+#elif defined(__arm__)
+		int pde = ARM_VM_PDE(v);
+		int pte = ARM_VM_PTE(v);
+#endif
+		u32_t *ptp;
+
+		assert(pde >= 0 && pde < ARCH_VM_DIR_ENTRIES);
+
+		/* No page table, nothing mapped up to the next one. */
+		if(!(pt->pt_dir[pde] & ARCH_VM_PDE_PRESENT)) {
+			vir_bytes next;
+			next = (v / ARCH_BIG_PAGE_SIZE + 1) * ARCH_BIG_PAGE_SIZE;
+			if(next <= v)
+				break;
+			v = next;
+			continue;
+		}
+
+#if defined(__i386__)
+		/* A big page wholly in the range is protected as a whole,
+		 * one partly in it is split up first.
+		 */
+		if(pt->pt_dir[pde] & ARCH_VM_BIGPAGE) {
+			if(pte == 0 && end - v >= ARCH_BIG_PAGE_SIZE) {
+				pt->pt_dir[pde] &= ~ARCH_VM_PTE_RW;
+				v += ARCH_BIG_PAGE_SIZE;
+				continue;
+			}
+			if(pt_bigsplit(pt, pde) != OK)
+				panic("pt_writeprotect: can't split big page");
+		}
+#else
+		assert(!(pt->pt_dir[pde] & ARCH_VM_BIGPAGE));
+#endif
+		assert(pt->pt_pt[pde]);
+
+		ptp = pt->pt_pt[pde];
+		for(; pte < ARCH_VM_PT_ENTRIES && v < end;
+			pte++, v += VM_PAGE_SIZE) {
+			if(!(ptp[pte] & ARCH_VM_PTE_PRESENT))
+				continue;
+#if defined(__i386__)
+			ptp[pte] &= ~ARCH_VM_PTE_RW;
+#elif defined(__arm__)
+			ptp[pte] |= ARCH_VM_PTE_RO;
+#endif
+		}
+	}
+
+#ifdef CONFIG_SMP
+	if (vminhibit_clear)
+		sys_vmctl(vmp->vm_endpoint, VMCTL_VMINHIBIT_CLEAR, 0);
+#endif
+}
+
+/*===========================================================================*
+ *				pt_bigpage_ok		     		     *
+ *===========================================================================*/
+int pt_bigpage_ok(void)
+{
+/* Can user memory be mapped with big pages? */
+#if defined(__i386__)
+	return bigpage_ok;
+#else
+	return 0;
+#endif
+}
+
+/*===========================================================================*
+ *				pt_bigmap		     		     *
+ *===========================================================================*/
+int pt_bigmap(struct vmproc *vmp, pt_t *pt, vir_bytes v, phys_bytes physaddr,
+	u32_t flags)
+{
+/* Map a big page of user memory, aligned both virtually and physically to
+ * its size, with a single page directory entry. A page table that mapped the
+ * range before is freed. Mapping pages of it differently later on splits the
+ * big page up again.
+ */
+#if defined(__i386__)
+	int pde;
+	u32_t *oldpt;
+
+#ifdef CONFIG_SMP
+	int vminhibit_clear = 0;
+	if (vmp && vmp->vm_endpoint != NONE && vmp->vm_endpoint != VM_PROC_NR &&
+			!(vmp->vm_flags & VMF_EXITING)) {
+		sys_vmctl(vmp->vm_endpoint, VMCTL_VMINHIBIT_SET, 0);
+		vminhibit_clear = 1;
+	}
+#endif
+
+	assert(bigpage_ok);
+	assert(!(v % ARCH_BIG_PAGE_SIZE));
+	assert(!(physaddr % ARCH_BIG_PAGE_SIZE));
+	assert(!(flags & ~(PTF_ALLFLAGS)));
+	assert((flags & ARCH_VM_PTE_PRESENT) && (flags & ARCH_VM_PTE_USER));
+
+	pde = I386_VM_PDE(v);
+	assert(pde >= 0 && pde < ARCH_VM_DIR_ENTRIES);
+
+	oldpt = pt->pt_pt[pde];
+	pt->pt_pt[pde] = NULL;
+	pt->pt_dir[pde] = physaddr | flags | ARCH_VM_BIGPAGE;
+
+#ifdef CONFIG_SMP
+	if (vminhibit_clear)
+		sys_vmctl(vmp->vm_endpoint, VMCTL_VMINHIBIT_CLEAR, 0);
+#endif
+
+	if(oldpt)
+		vm_freepages((vir_bytes) oldpt, 1);
+
+	return OK;
+#else
+	return ENOSYS;
+#endif
+}
+
 /*===========================================================================*
  *				pt_new			     		     *
  *===========================================================================*/
@@ -39,7 +39,6 @@ void clear_proc(struct vmproc *vmp)
 {
 	region_init(&vmp->vm_regions_avl);
 	vmp->vm_region_top = 0;
-	vmp->vm_callback = NULL;	/* No pending vfs callback. */
 	vmp->vm_flags = 0;		/* Clear INUSE, so slot is free. */
 	vmp->vm_yielded = 0;
 #if VMSTATS
@@ -28,6 +28,64 @@
 #include "sanitycheck.h"
 #include "region.h"
 
+/* Where the kernel delivers messages, kept while a fork waits for a page. */
+#define VMF_MSGADDR	m1_p1
+
+static int fork_msgpages(message *msg);
+
+/*===========================================================================*
+ *				fork_retry				     *
+ *===========================================================================*/
+static void fork_retry(message *m, int result)
+{
+/* A fork had to wait for a page from a file. Finish it and answer PM. */
+  int r;
+
+  if(result != OK)
+	panic("do_fork: reading page for message failed: %d", result);
+
+  if(fork_msgpages(m) == SUSPEND)
+	return;
+
+  m->m_type = OK;
+  if((r = send(m->m_source, m)) != OK)
+	printf("VM: couldn't send fork reply to %d: %d\n", m->m_source, r);
+}
+
+/*===========================================================================*
+ *				fork_msgpages				     *
+ *===========================================================================*/
+static int fork_msgpages(message *msg)
+{
+/* Make the pages the kernel delivers messages to present and writable in
+ * the child and the parent. If one is mapped from a file and not read in
+ * yet, have the fork wait for it and return SUSPEND.
+ */
+  vir_bytes vir = (vir_bytes) msg->VMF_MSGADDR;
+  int r, p;
+
+  if(vm_isokendpt(msg->VMF_CHILD_ENDPOINT, &p) != OK)
+	panic("do_fork: child %d gone", msg->VMF_CHILD_ENDPOINT);
+  r = handle_memory(&vmproc[p], vir, sizeof(message), 1);
+
+  if(r == OK) {
+	if(vm_isokendpt(msg->VMF_ENDPOINT, &p) != OK)
+		panic("do_fork: parent %d gone", msg->VMF_ENDPOINT);
+	r = handle_memory(&vmproc[p], vir, sizeof(message), 1);
+  }
+
+  if(r == SUSPEND) {
+	if(vfs_wait(fork_retry, msg) != OK)
+		panic("do_fork: can't wait for page for message");
+	return SUSPEND;
+  }
+
+  if(r != OK)
+	panic("do_fork: handle_memory for message failed: %d", r);
+
+  return OK;
+}
+
 /*===========================================================================*
  *				do_fork					     *
  *===========================================================================*/
@@ -96,23 +154,14 @@ int do_fork(message *msg)
   if((r=pt_bind(&vmc->vm_pt, vmc)) != OK)
 	panic("fork can't pt_bind: %d", r);
 
-  {
-	vir_bytes vir;
-	/* making these messages writable is an optimisation
-	 * and its return value needn't be checked.
-	 */
-	vir = msgaddr;
-	if (handle_memory(vmc, vir, sizeof(message), 1) != OK)
-	    panic("do_fork: handle_memory for child failed\n");
-	vir = msgaddr;
-	if (handle_memory(vmp, vir, sizeof(message), 1) != OK)
-	    panic("do_fork: handle_memory for parent failed\n");
-  }
-
   /* Inform caller of new child endpoint. */
   msg->VMF_CHILD_ENDPOINT = vmc->vm_endpoint;
 
+  /* The reply is sent once the message pages are there. */
+  msg->VMF_MSGADDR = (char *) msgaddr;
+  r = fork_msgpages(msg);
+
   SANITYCHECK(SCL_FUNCTIONS);
-  return OK;
+  return r;
 }
 
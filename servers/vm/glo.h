@@ -32,7 +32,8 @@ EXTERN char *sc_lastfile;
 EXTERN  mem_type_t mem_type_anon,       /* anonymous memory */
         mem_type_directphys,		/* direct physical mapping memory */
 	mem_type_anon_contig,		/* physically contig anon memory */
-	mem_type_shared;		/* memory shared by multiple processes */
+	mem_type_shared,		/* memory shared by multiple processes */
+	mem_type_mappedfile;		/* memory mapped from a file */
 
 /* total number of memory pages */
 EXTERN int total_pages;
@@ -97,6 +97,8 @@ int main(void)
 	if(missing_spares > 0) {
 		pt_cycle();	/* pagetable code wants to be called */
 	}
+	zero_pool_refill();	/* keep zeroed pages in stock */
+	mem_watch_check();	/* tell watchers about free memory */
 
   	if ((r=sef_receive_status(ANY, &msg, &rcv_sts)) != OK)
 		panic("sef_receive_status() error: %d", r);
@@ -430,6 +432,13 @@ void init_vm(void)
 	CALLMAP(VM_INFO, do_info);
 	CALLMAP(VM_QUERY_EXIT, do_query_exit);
 	CALLMAP(VM_WATCH_EXIT, do_watch_exit);
+	CALLMAP(VM_WATCH_MEM, do_watch_mem);
+
+	/* Calls from VFS. */
+	CALLMAP(VM_VFS_REPLY, do_vfs_reply);
+	CALLMAP(VM_VFS_MMAP, do_vfs_mmap);
+	CALLMAP(VM_VFS_HANDLEMEM, do_vfs_handlemem);
+	CALLMAP(VM_VFS_FORGET, do_vfs_forget);
 	CALLMAP(VM_FORGETBLOCKS, do_forgetblocks);
 	CALLMAP(VM_FORGETBLOCK, do_forgetblock);
 	CALLMAP(VM_YIELDBLOCKGETBLOCK, do_yieldblockgetblock);
@@ -59,8 +59,24 @@ static int anon_pagefault(struct vmproc *vmp, struct vir_region *region,
 	struct phys_block *pb;
 	u32_t allocflags;
 
+	/* A read of a page that is there, such as a page that a forked child
+	 * shares with its parent, only needs the page to be mapped in.
+	 */
+	if(ph->ph->phys != MAP_NONE && !write)
+		return OK;
+
+	if(ph->ph->phys != MAP_NONE && ph->ph->refcount < 2) {
+		printf("anon_pagefault: %d refcount, %d write - not handling pagefault\n",
+			ph->ph->refcount, write);
+		return OK;
+	}
+
 	allocflags = vrallocflags(region->flags);
 
+	/* A copy-on-write page is overwritten below, no need to clear it. */
+	if(ph->ph->phys != MAP_NONE)
+		allocflags &= ~PAF_CLEAR;
+
 	assert(ph->ph->refcount > 0);
 
 	if((new_page_cl = alloc_mem(1, allocflags)) == NO_MEM)
@@ -75,12 +91,6 @@ static int anon_pagefault(struct vmproc *vmp, struct vir_region *region,
 		return OK;
 	}
 
-	if(ph->ph->refcount < 2 || !write) {
-		printf("anon_pagefault: %d refcount, %d write - not handling pagefault\n",
-			ph->ph->refcount, write);
-		return OK;
-	}	
-
         assert(region->flags & VR_WRITABLE);
 
 	if(sys_abscopy(ph->ph->phys, new_page, VM_PAGE_SIZE) != OK) {
@@ -0,0 +1,205 @@
+
+/* This file implements the methods of memory mapped files.
+ *
+ * The mapping is private: a process that writes to a page gets its own
+ * copy of it. Pages that are only read are shared, through the page cache,
+ * by all processes that map the same part of the same file, such as the
+ * text of a program that runs more than once. Pages are read from the file
+ * only when first used.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "proto.h"
+#include "vm.h"
+#include "region.h"
+#include "glo.h"
+#include "vfs.h"
+
+/* These functions are static so as to not pollute the
+ * global namespace, and are accessed through their function
+ * pointers.
+ */
+
+static int mappedfile_reference(struct phys_region *pr);
+static int mappedfile_unreference(struct phys_region *pr);
+static int mappedfile_pagefault(struct vmproc *vmp, struct vir_region *region,
+	struct phys_region *ph, int write);
+static int mappedfile_sanitycheck(struct phys_region *pr, char *file, int line);
+static int mappedfile_writable(struct phys_region *pr);
+static int mappedfile_resize(struct vmproc *vmp, struct vir_region *vr,
+	vir_bytes l);
+static void mappedfile_lowshrink(struct vir_region *vr, vir_bytes len);
+static int mappedfile_copy(struct vir_region *vr, struct vir_region *newvr);
+static void mappedfile_delete(struct vir_region *region);
+static u32_t mappedfile_regionid(struct vir_region *region);
+static int mappedfile_refcount(struct vir_region *vr);
+
+struct mem_type mem_type_mappedfile = {
+	.name = "file-mapped memory",
+	.ev_reference = mappedfile_reference,
+	.ev_unreference = mappedfile_unreference,
+	.ev_pagefault = mappedfile_pagefault,
+	.ev_resize = mappedfile_resize,
+	.ev_lowshrink = mappedfile_lowshrink,
+	.ev_copy = mappedfile_copy,
+	.ev_delete = mappedfile_delete,
+	.ev_sanitycheck = mappedfile_sanitycheck,
+	.regionid = mappedfile_regionid,
+	.writable = mappedfile_writable,
+	.refcount = mappedfile_refcount
+};
+
+static int mappedfile_reference(struct phys_region *pr)
+{
+	return OK;
+}
+
+static int mappedfile_unreference(struct phys_region *pr)
+{
+	assert(pr->ph->refcount == 0);
+	if(pr->ph->cached)
+		cache_remove(pr->ph);
+	if(pr->ph->phys != MAP_NONE)
+		free_mem(ABS2CLICK(pr->ph->phys), 1);
+	return OK;
+}
+
+static int mappedfile_pagefault(struct vmproc *vmp, struct vir_region *region,
+	struct phys_region *ph, int write)
+{
+	phys_bytes new_page, new_page_cl;
+	struct phys_block *pb, *cpb = NULL;
+	vir_bytes filebytes = 0;
+	u32_t allocflags, pos;
+
+	assert(ph->ph->refcount > 0);
+
+	if(ph->ph->phys != MAP_NONE) {
+		/* A read only needs the page to be mapped in. */
+		if(!write)
+			return OK;
+
+		/* The last user of a page from the cache can simply have
+		 * it; nobody else will get it from the cache any more.
+		 */
+		if(ph->ph->refcount == 1) {
+			assert(ph->ph->cached);
+			cache_remove(ph->ph);
+			return OK;
+		}
+
+		cpb = ph->ph;
+		filebytes = VM_PAGE_SIZE;
+	} else {
+		/* Find out how much of the page comes from the file; the
+		 * rest of it is zero.
+		 */
+		if(ph->offset < region->param.file.filelen)
+			filebytes = MIN(VM_PAGE_SIZE,
+				region->param.file.filelen - ph->offset);
+
+		pos = region->param.file.pos + ph->offset;
+
+		if(filebytes > 0 && !(cpb = cache_lookup(
+			region->param.file.file, pos)))
+			return vfs_pagein(region->param.file.file, pos);
+
+		/* Read a whole page of the file: share the cached one. */
+		if(cpb && filebytes == VM_PAGE_SIZE && !write) {
+			pb_free(ph->ph);
+			pb_link(ph, cpb, ph->offset, region);
+			return OK;
+		}
+	}
+
+	/* This process needs a page of its own. */
+	allocflags = vrallocflags(region->flags);
+	if(filebytes == VM_PAGE_SIZE)
+		allocflags &= ~PAF_CLEAR;
+
+	if((new_page_cl = alloc_mem(1, allocflags)) == NO_MEM)
+		return ENOMEM;
+	new_page = CLICK2ABS(new_page_cl);
+
+	if(filebytes > 0 && sys_abscopy(cpb->phys, new_page, filebytes) != OK)
+		panic("VM: abscopy failed\n");
+
+	/* Totally new block? Fill it in. */
+	if(ph->ph->phys == MAP_NONE) {
+		ph->ph->phys = new_page;
+		return OK;
+	}
+
+	if(!(pb = pb_new(new_page))) {
+		free_mem(new_page_cl, 1);
+		return ENOMEM;
+	}
+
+	pb_unreferenced(region, ph, 0);
+	pb_link(ph, pb, ph->offset, region);
+
+	return OK;
+}
+
+static int mappedfile_sanitycheck(struct phys_region *pr, char *file, int line)
+{
+	MYASSERT(usedpages_add(pr->ph->phys, VM_PAGE_SIZE) == OK);
+	return OK;
+}
+
+static int mappedfile_writable(struct phys_region *pr)
+{
+	assert(pr->ph->refcount > 0);
+	return pr->ph->phys != MAP_NONE && !pr->ph->cached &&
+		pr->ph->refcount == 1;
+}
+
+static int mappedfile_resize(struct vmproc *vmp, struct vir_region *vr,
+	vir_bytes l)
+{
+	/* Growing, for brk() after a data segment, adds zeroed memory.
+	 * Shrinking not implemented; silently ignored.
+	 */
+	if(l <= vr->length)
+		return OK;
+
+	assert(!(l % VM_PAGE_SIZE));
+
+	USE(vr, vr->length = l;);
+
+	return OK;
+}
+
+static void mappedfile_lowshrink(struct vir_region *vr, vir_bytes len)
+{
+	/* The region now starts further into the file. */
+	vr->param.file.pos += len;
+	if(vr->param.file.filelen > len)
+		vr->param.file.filelen -= len;
+	else	vr->param.file.filelen = 0;
+}
+
+static int mappedfile_copy(struct vir_region *vr, struct vir_region *newvr)
+{
+	newvr->param.file = vr->param.file;
+	newvr->param.file.file->refcount++;
+
+	return OK;
+}
+
+static void mappedfile_delete(struct vir_region *region)
+{
+	file_put(region->param.file.file);
+}
+
+static u32_t mappedfile_regionid(struct vir_region *region)
+{
+	return region->id;
+}
+
+static int mappedfile_refcount(struct vir_region *vr)
+{
+	return 1;
+}
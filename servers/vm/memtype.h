@@ -15,6 +15,7 @@ typedef struct mem_type {
 	int (*ev_pagefault)(struct vmproc *vmp, struct vir_region *region,
 	        struct phys_region *ph, int write);
 	int (*ev_resize)(struct vmproc *vmp, struct vir_region *vr, vir_bytes len);
+	void (*ev_lowshrink)(struct vir_region *vr, vir_bytes len);
 	int (*writable)(struct phys_region *pr);
 	int (*ev_sanitycheck)(struct phys_region *pr, char *file, int line);
         int (*ev_copy)(struct vir_region *vr, struct vir_region *newvr);
@@ -31,6 +31,7 @@
 #include "proto.h"
 #include "util.h"
 #include "region.h"
+#include "vfs.h"
 
 /*===========================================================================*
  *				do_mmap			     		     *
@@ -110,7 +111,15 @@ int do_mmap(message *m)
 			return ENOMEM;
 		}
 	} else {
-		return ENOSYS;
+		/* A file: ask VFS which one first. File mappings are
+		 * always private; changes are only seen by the process
+		 * making them.
+		 */
+		if((m->VMM_FLAGS & MAP_THIRDPARTY) || m->VMM_LEN <= 0 ||
+			(m->VMM_OFFSET % VM_PAGE_SIZE) || m->VMM_OFFSET < 0)
+			return EINVAL;
+
+		return vfs_fdlookup(m);
 	}
 
 	/* Return mapping, as seen from process. */
@@ -121,6 +130,82 @@ int do_mmap(message *m)
 	return OK;
 }
 
+/*===========================================================================*
+ *				map_file_region		     		     *
+ *===========================================================================*/
+struct vir_region *map_file_region(struct vmproc *vmp, vir_bytes minv,
+	vir_bytes maxv, vir_bytes len, u32_t vrflags, struct vm_file *file,
+	u32_t pos, vir_bytes filelen)
+{
+/* Map 'len' bytes of 'file', starting at 'pos'. Only 'filelen' bytes come
+ * from the file; the rest of the region is zeroed. On success the region
+ * takes over the caller's reference to the file.
+ */
+	struct vir_region *vr;
+
+	if(len % VM_PAGE_SIZE)
+		len += VM_PAGE_SIZE - (len % VM_PAGE_SIZE);
+
+	if(!(vr = map_page_region(vmp, minv, maxv, len, vrflags, 0,
+		&mem_type_mappedfile)))
+		return NULL;
+
+	vr->param.file.file = file;
+	vr->param.file.pos = pos;
+	vr->param.file.filelen = filelen;
+
+	return vr;
+}
+
+/*===========================================================================*
+ *				mmap_file_reply		     		     *
+ *===========================================================================*/
+void mmap_file_reply(message *m, struct vm_file *file, int r)
+{
+/* VFS has told what file the mmap() call in 'm' is for, or why it can't be
+ * mapped. Finish the call, and reply to the caller.
+ */
+	struct vmproc *vmp;
+	struct vir_region *vr = NULL;
+	u32_t vrflags = 0;
+	int n;
+
+	if(vm_isokendpt(m->m_source, &n) != OK) {
+		/* Caller is gone. */
+		if(file) file_put(file);
+		return;
+	}
+	vmp = &vmproc[n];
+
+	if(m->VMM_PROT & PROT_WRITE)
+		vrflags |= VR_WRITABLE;
+
+	if(r == OK && (m->VMM_ADDR || (m->VMM_FLAGS & MAP_FIXED))) {
+		/* An address is given, first try at that address. */
+		vr = map_file_region(vmp, m->VMM_ADDR, 0, m->VMM_LEN, vrflags,
+			file, m->VMM_OFFSET, m->VMM_LEN);
+		if(!vr && (m->VMM_FLAGS & MAP_FIXED))
+			r = ENOMEM;
+	}
+	if(r == OK && !vr) {
+		/* No address given or address already in use. */
+		vr = map_file_region(vmp, 0, VM_DATATOP, m->VMM_LEN, vrflags,
+			file, m->VMM_OFFSET, m->VMM_LEN);
+		if(!vr)
+			r = ENOMEM;
+	}
+
+	if(r == OK) {
+		m->VMM_RETADDR = vr->vaddr;
+	} else if(file) {
+		file_put(file);
+	}
+
+	m->m_type = r;
+	if((r=send(vmp->vm_endpoint, m)) != OK)
+		panic("mmap_file_reply: send failed: %d", r);
+}
+
 /*===========================================================================*
  *				map_perm_check		     		     *
  *===========================================================================*/
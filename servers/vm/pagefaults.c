@@ -45,6 +45,33 @@ char *pf_errstr(u32_t err)
 	return buf;
 }
 
+/*===========================================================================*
+ *				pagefault_retry	     		     	     *
+ *===========================================================================*/
+static void pagefault_retry(message *m, int result)
+{
+/* The page a pagefault was waiting for is in, or couldn't be read. */
+	endpoint_t ep = m->m_source;
+	int p, s;
+
+	/* The process may have been killed in the meantime. */
+	if(vm_isokendpt(ep, &p) != OK)
+		return;
+
+	if(result == OK) {
+		do_pagefaults(m);
+		pt_clearmapcache();
+		return;
+	}
+
+	printf("VM: pagefault: SIGSEGV %d page not read from file: %d\n",
+		ep, result);
+	if((s=sys_kill(ep, SIGSEGV)) != OK)
+		panic("sys_kill failed: %d", s);
+	if((s=sys_vmctl(ep, VMCTL_CLEAR_PAGEFAULT, 0 /*unused*/)) != OK)
+		panic("pagefault_retry: sys_vmctl failed: %d", ep);
+}
+
 /*===========================================================================*
  *				do_pagefaults	     		     *
  *===========================================================================*/
@@ -54,7 +81,7 @@ void do_pagefaults(message *m)
 	u32_t addr = m->VPF_ADDR;
 	u32_t err = m->VPF_FLAGS;
 	struct vmproc *vmp;
-	int s;
+	int r, s;
 
 	struct vir_region *region;
 	vir_bytes offset;
@@ -99,7 +126,16 @@ void do_pagefaults(message *m)
 	offset = addr - region->vaddr;
 
 	/* Access is allowed; handle it. */
-	if((map_pf(vmp, region, offset, wr)) != OK) {
+	if((r = map_pf(vmp, region, offset, wr)) == SUSPEND) {
+		/* The page has to be read from a file first. The process
+		 * stays stopped until it is in, and then faults again.
+		 */
+		if(vfs_wait(pagefault_retry, m) == OK)
+			return;
+		r = ENOMEM;
+	}
+
+	if(r != OK) {
 		printf("VM: pagefault: SIGSEGV %d pagefault not handled\n", ep);
 		if((s=sys_kill(vmp->vm_endpoint, SIGSEGV)) != OK)
 			panic("sys_kill failed: %d", s);
@@ -113,6 +149,42 @@ void do_pagefaults(message *m)
 		panic("do_pagefaults: sys_vmctl failed: %d", ep);
 }
 
+/*===========================================================================*
+ *				   memreq_retry	     			     *
+ *===========================================================================*/
+static void memreq_retry(message *m, int result)
+{
+/* Handle a kernel memory request, again if it was waiting for a page from
+ * a file, and answer it if it doesn't have to wait (any more).
+ */
+	endpoint_t requestor = (endpoint_t) m->SVMCTL_MRG_REQUESTOR;
+	int p, s, r = result;
+
+	/* The target may have died while this was waiting. */
+	if(r == OK && vm_isokendpt(m->SVMCTL_MRG_TARGET, &p) != OK)
+		r = ESRCH;
+
+	if(r == OK) {
+		r = handle_memory(&vmproc[p], (vir_bytes) m->SVMCTL_MRG_ADDR,
+			(vir_bytes) m->SVMCTL_MRG_LENGTH, m->SVMCTL_MRG_FLAG);
+
+		/* A page has to be read from a file first. Wait for it,
+		 * unless reading it might need the requestor itself.
+		 */
+		if(r == SUSPEND) {
+			if(vfs_may_wait(requestor) &&
+				vfs_wait(memreq_retry, m) == OK)
+				return;
+			r = EFAULT;
+		}
+	}
+
+	/* After a wait, the requestor may be gone too. */
+	if((s=sys_vmctl(requestor, VMCTL_MEMREQ_REPLY, r)) != OK)
+		printf("VM: memory request reply to %d failed: %d\n",
+			requestor, s);
+}
+
 /*===========================================================================*
  *				   do_memory	     			     *
  *===========================================================================*/
@@ -122,28 +194,27 @@ void do_memory(void)
 	vir_bytes mem, mem_s;
 	vir_bytes len;
 	int wrflag;
+	message m;
 
 	while(1) {
-		int p, r = OK;
-		struct vmproc *vmp;
+		int r;
 
 		r = sys_vmctl_get_memreq(&who, &mem, &len, &wrflag, &who_s,
 			&mem_s, &requestor);
 
 		switch(r) {
 		case VMPTYPE_CHECK:
-			if(vm_isokendpt(who, &p) != OK)
-				panic("do_memory: bad endpoint: %d", who);
-			vmp = &vmproc[p];
-
-			r = handle_memory(vmp, mem, len, wrflag);
+			memset(&m, 0, sizeof(m));
+			m.SVMCTL_MRG_TARGET = who;
+			m.SVMCTL_MRG_ADDR = mem;
+			m.SVMCTL_MRG_LENGTH = len;
+			m.SVMCTL_MRG_FLAG = wrflag;
+			m.SVMCTL_MRG_REQUESTOR = (void *) requestor;
+			memreq_retry(&m, OK);
 			break;
 		default:
 			return;
 		}
-
-		if(sys_vmctl(requestor, VMCTL_MEMREQ_REPLY, r) != OK)
-			panic("do_memory: sys_vmctl failed: %d", r);
 	}
 }
 
@@ -45,6 +45,7 @@ USE(newpb,
 	newpb->phys = phys;
 	newpb->refcount = 0;
 	newpb->firstregion = NULL;
+	newpb->cached = NULL;
 	);
 
 	return newpb;
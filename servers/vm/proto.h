@@ -5,6 +5,8 @@ struct stat;
 struct memory;
 struct vir_region;
 struct phys_region;
+struct phys_block;
+struct vm_file;
 
 #include <minix/ipc.h>
 #include <minix/endpoint.h>
@@ -21,6 +23,11 @@ struct phys_region;
 void mem_sanitycheck(char *file, int line);
 phys_clicks alloc_mem(phys_clicks clicks, u32_t flags);
 void memstats(int *nodes, int *pages, int *largest);
+void memstats_blocks(unsigned long *blocks, int orders);
+void zero_pool_refill(void);
+phys_bytes mem_free_pages(void);
+void zero_pool_stats(unsigned long *pages, unsigned long *hits, unsigned long
+	*misses);
 void printmemstats(void);
 void usedpages_reset(void);
 int usedpages_add_f(phys_bytes phys, phys_bytes len, char *file, int
@@ -36,6 +43,8 @@ void get_mem_chunks(struct memory *mem_chunks);
 int vm_isokendpt(endpoint_t ep, int *proc);
 int get_stack_ptr(int proc_nr, vir_bytes *sp);
 int do_info(message *);
+int do_watch_mem(message *m);
+void mem_watch_check(void);
 int swap_proc_slot(struct vmproc *src_vmp, struct vmproc *dst_vmp);
 int swap_proc_dyn_data(struct vmproc *src_vmp, struct vmproc *dst_vmp);
 
@@ -67,6 +76,10 @@ int do_unmap_phys(message *msg);
 int do_remap(message *m);
 int do_get_phys(message *m);
 int do_get_refcount(message *m);
+struct vir_region *map_file_region(struct vmproc *vmp, vir_bytes minv,
+	vir_bytes maxv, vir_bytes len, u32_t vrflags, struct vm_file *file,
+	u32_t pos, vir_bytes filelen);
+void mmap_file_reply(message *m, struct vm_file *file, int r);
 
 /* pagefaults.c */
 void do_pagefaults(message *m);
@@ -91,6 +104,11 @@ void pt_clearmapcache(void);
 int pt_writemap(struct vmproc * vmp, pt_t *pt, vir_bytes v, phys_bytes
 	physaddr, size_t bytes, u32_t flags, u32_t writemapflags);
 int pt_checkrange(pt_t *pt, vir_bytes v, size_t bytes, int write);
+void pt_writeprotect(struct vmproc *vmp, pt_t *pt, vir_bytes v, size_t
+	bytes);
+int pt_bigpage_ok(void);
+int pt_bigmap(struct vmproc *vmp, pt_t *pt, vir_bytes v, phys_bytes
+	physaddr, u32_t flags);
 int pt_bind(pt_t *pt, struct vmproc *who);
 void *vm_allocpage(phys_bytes *p, int cat);
 void *vm_allocpages(phys_bytes *p, int cat, int pages);
@@ -203,3 +221,17 @@ void phys_setphys(struct vir_region *vr, phys_bytes startaddr);
 
 /* mem_shared.c */
 void shared_setsource(struct vir_region *vr, endpoint_t ep, struct vir_region *src);
+
+/* vfs.c */
+int do_vfs_reply(message *m);
+int do_vfs_mmap(message *m);
+int do_vfs_handlemem(message *m);
+int do_vfs_forget(message *m);
+int vfs_fdlookup(message *m);
+int vfs_pagein(struct vm_file *file, u32_t pos);
+int vfs_may_wait(endpoint_t who);
+int vfs_wait(void (*func)(message *m, int result), message *m);
+struct vm_file *file_get(endpoint_t fs_e, endpoint_t drv_e, ino_t ino);
+void file_put(struct vm_file *file);
+struct phys_block *cache_lookup(struct vm_file *file, u32_t pos);
+void cache_remove(struct phys_block *pb);
@@ -41,6 +41,12 @@ static phys_bytes freeyieldednode(yielded_t *node, int freemem);
 static struct vir_region *map_copy_region(struct vmproc *vmp, struct
 	vir_region *vr);
 
+static int map_copy_regions(struct vmproc *dst, struct vmproc *src,
+	struct vir_region *start_src_vr);
+
+static void map_promote(struct vmproc *vmp, struct vir_region *region,
+	vir_bytes offset);
+
 #if SANITYCHECKS
 static void lrucheck(void);
 #endif
@@ -274,7 +280,11 @@ void map_sanitycheck(char *file, int line)
 		}
 		MYASSERT(pr->ph->refcount == pr->ph->seencount);
 		MYASSERT(!(pr->offset % VM_PAGE_SIZE)););
-	ALLREGIONS(,MYASSERT(map_sanitycheck_pt(vmp, vr, pr) == OK));
+	/* Pages that fork left out of the page table are only checked once
+	 * they have been faulted in.
+	 */
+	ALLREGIONS(,MYASSERT(!pr->written ||
+		map_sanitycheck_pt(vmp, vr, pr) == OK));
 }
 
 #define LRUCHECK lrucheck()
@@ -419,12 +429,18 @@ static vir_bytes region_find_slot_range(struct vmproc *vmp,
 	if(minv + length > maxv)
 		return SLOT_FAIL;
 
+/* A region of a big page or more is aligned to one if it fits that way,
+ * so that map_promote() can map it with big pages.
+ */
 #define FREEVRANGE_TRY(rangestart, rangeend) {		\
 	vir_bytes frstart = (rangestart), frend = (rangeend);	\
 	frstart = MAX(frstart, minv);				\
 	frend   = MIN(frend, maxv);				\
 	if(frend > frstart && (frend - frstart) >= length) {	\
 		startv = frend-length;				\
+		if(length >= ARCH_BIG_PAGE_SIZE && startv - frstart >=	\
+		  startv % ARCH_BIG_PAGE_SIZE)			\
+			startv -= startv % ARCH_BIG_PAGE_SIZE;	\
 		foundflag = 1;					\
 	} }
 
@@ -958,6 +974,69 @@ struct phys_region *ph;
 }
 
 
+/* Pages of a big page. */
+#define BIG_PAGES	(ARCH_BIG_PAGE_SIZE / VM_PAGE_SIZE)
+
+/*===========================================================================*
+ *				map_promote				     *
+ *===========================================================================*/
+static void map_promote(struct vmproc *vmp, struct vir_region *region,
+	vir_bytes offset)
+{
+/* A page of anonymous memory has just been mapped in. If that makes all the
+ * memory of the big page around it present, private and writable, and it is
+ * in one aligned big page of physical memory already, map it with a single
+ * page directory entry; that saves the process TLB entries and a page table.
+ * The pages are never moved to make them fit: a driver may be doing DMA to
+ * them. Anything that maps a page of it differently afterwards, such as
+ * fork, copy-on-write or unmapping part of it, splits the big page up again.
+ * The phys_blocks stay a page each throughout.
+ */
+	struct phys_region *pr;
+	vir_bytes bigoff;
+	phys_bytes base = 0;
+	int i, p;
+
+	if(!pt_bigpage_ok() || region->memtype != &mem_type_anon ||
+	  vmp->vm_endpoint == VM_PROC_NR || region->remaps > 0 ||
+	  !(region->flags & VR_WRITABLE) ||
+	  (region->flags & (VR_PHYS64K | VR_LOWER16MB | VR_LOWER1MB |
+	  VR_CONTIG | VR_SHARED | VR_DIRECT)))
+		return;
+
+	/* The big page has to lie within the region. */
+	bigoff = region->vaddr + offset;
+	bigoff -= bigoff % ARCH_BIG_PAGE_SIZE;
+	if(bigoff < region->vaddr)
+		return;
+	bigoff -= region->vaddr;
+	if(bigoff + ARCH_BIG_PAGE_SIZE > region->length)
+		return;
+
+	/* Every page of it must be there, used by this process alone, and in
+	 * its place in physical memory. Look at the last and the first page
+	 * first: while a region fills up from either end, one of them is
+	 * missing.
+	 */
+	for(i = 0; i < BIG_PAGES; i++) {
+		p = (i == 0) ? BIG_PAGES - 1 : i - 1;
+		pr = physblock_get(region, bigoff + p * VM_PAGE_SIZE);
+		if(!pr || pr->ph->phys == MAP_NONE || pr->ph->refcount != 1)
+			return;
+		if(i == 0)
+			base = pr->ph->phys - p * VM_PAGE_SIZE;
+		else if(pr->ph->phys != base + p * VM_PAGE_SIZE)
+			return;
+	}
+
+	if(base % ARCH_BIG_PAGE_SIZE)
+		return;
+
+	if(pt_bigmap(vmp, &vmp->vm_pt, region->vaddr + bigoff, base,
+	  PTF_PRESENT | PTF_USER | PTF_WRITE) != OK)
+		panic("map_promote: pt_bigmap failed");
+}
+
 /*===========================================================================*
  *				map_pf			     *
  *===========================================================================*/
@@ -1012,7 +1091,13 @@ int write;
 
 		if((r = region->memtype->ev_pagefault(vmp,
 			region, ph, write)) == SUSPEND) {
-			panic("map_pf: memtype->ev_pagefault returned SUSPEND\n");
+			/* The page has to come from a file first. Don't
+			 * leave an empty block behind while it does.
+			 */
+			if(ph->ph->phys == MAP_NONE) {
+				pb_unreferenced(region, ph, 1);
+				SLABFREE(ph);
+			}
 			return SUSPEND;
 		}
 
@@ -1034,6 +1119,9 @@ int write;
 		return r;
 	}
 
+	/* That may have made a big page worth of memory present. */
+	map_promote(vmp, region, offset);
+
 	SANITYCHECK(SCL_FUNCTIONS);
 
 #if SANITYCHECKS
@@ -1211,6 +1299,48 @@ int map_writept(struct vmproc *vmp)
 	return OK;
 }
 
+/*=========================================================================*
+ *				map_writept_lazy			*
+ *=========================================================================*/
+static int map_writept_lazy(struct vmproc *vmp, int child)
+{
+/* Write the page tables of a process that has just forked or been forked.
+ * The pages of private anonymous and file-mapped regions are now all shared
+ * copy-on-write, so the parent only loses write access to them, in one walk
+ * per region, and the child gets no entries for them at all; it faults them
+ * in as it touches them, which for a fork followed by exec is hardly ever.
+ */
+	struct vir_region *vr;
+	struct phys_region *ph;
+	int r;
+	region_iter v_iter;
+	region_start_iter_least(&vmp->vm_regions_avl, &v_iter);
+
+	while((vr = region_get_iter(&v_iter))) {
+		vir_bytes p;
+		if((vr->memtype == &mem_type_anon ||
+			vr->memtype == &mem_type_mappedfile) &&
+			vr->remaps == 0) {
+			if(!child)
+				pt_writeprotect(vmp, &vmp->vm_pt, vr->vaddr,
+					vr->length);
+			region_incr_iter(&v_iter);
+			continue;
+		}
+		for(p = 0; p < vr->length; p += VM_PAGE_SIZE) {
+			if(!(ph = physblock_get(vr, p))) continue;
+
+			if((r=map_ph_writept(vmp, vr, ph)) != OK) {
+				printf("VM: map_writept_lazy: failed\n");
+				return r;
+			}
+		}
+		region_incr_iter(&v_iter);
+	}
+
+	return OK;
+}
+
 /*========================================================================*
  *			       map_proc_copy			     	  *
  *========================================================================*/
@@ -1218,10 +1348,21 @@ int map_proc_copy(dst, src)
 struct vmproc *dst;
 struct vmproc *src;
 {
-/* Copy all the memory regions from the src process to the dst process. */
+/* Copy all the memory regions from the src process to the dst process,
+ * for fork.
+ */
+	int r;
+
 	region_init(&dst->vm_regions_avl);
 
-	return map_proc_copy_from(dst, src, NULL);
+	if((r = map_copy_regions(dst, src, NULL)) != OK)
+		return r;
+
+	map_writept_lazy(src, 0);
+	map_writept_lazy(dst, 1);
+
+	SANITYCHECK(SCL_FUNCTIONS);
+	return OK;
 }
 
 /*========================================================================*
@@ -1231,6 +1372,27 @@ int map_proc_copy_from(dst, src, start_src_vr)
 struct vmproc *dst;
 struct vmproc *src;
 struct vir_region *start_src_vr;
+{
+/* Copy the memory regions from the src process to the dst process, from
+ * start_src_vr on, and write both page tables in full.
+ */
+	int r;
+
+	if((r = map_copy_regions(dst, src, start_src_vr)) != OK)
+		return r;
+
+	map_writept(src);
+	map_writept(dst);
+
+	SANITYCHECK(SCL_FUNCTIONS);
+	return OK;
+}
+
+/*========================================================================*
+ *			     map_copy_regions			     	  *
+ *========================================================================*/
+static int map_copy_regions(struct vmproc *dst, struct vmproc *src,
+	struct vir_region *start_src_vr)
 {
 	struct vir_region *vr;
 	region_iter v_iter;
@@ -1276,10 +1438,6 @@ struct vir_region *start_src_vr;
 		region_incr_iter(&v_iter);
 	}
 
-	map_writept(src);
-	map_writept(dst);
-
-	SANITYCHECK(SCL_FUNCTIONS);
 	return OK;
 }
 
@@ -1364,6 +1522,9 @@ int map_unmap_region(struct vmproc *vmp, struct vir_region *r,
 
 		region_remove(&vmp->vm_regions_avl, r->vaddr);
 
+		if(r->memtype->ev_lowshrink)
+			r->memtype->ev_lowshrink(r, len);
+
 		USE(r,
 		r->vaddr += len;
 		r->length -= len;);
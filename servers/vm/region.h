@@ -25,13 +25,16 @@ struct phys_block {
 	u32_t			seencount;
 #endif
 	phys_bytes		phys;	/* physical memory */
-	u8_t			refcount;	/* Refcount of these pages */
+	u16_t			refcount;	/* Refcount of these pages */
 
 	/* what kind of memory is it? */
 	mem_type_t		*memtype;
 
 	/* first in list of phys_regions that reference this block */
 	struct phys_region	*firstregion;	
+
+	/* page cache entry if this block holds file data, or NULL */
+	struct cached_page	*cached;
 };
 
 typedef struct vir_region {
@@ -51,6 +54,11 @@ typedef struct vir_region {
 			vir_bytes vaddr;
 			int id;
 		} shared;
+		struct {
+			struct vm_file *file;	/* file backing the region */
+			u32_t pos;		/* file position of vaddr */
+			vir_bytes filelen;	/* bytes read from the file */
+		} file;
 	} param;
 
 	/* AVL fields */
@@ -88,11 +88,29 @@ int vm_isokendpt(endpoint_t endpoint, int *proc)
 }
 
 
+/*===========================================================================*
+ *                              info_retry                                   *
+ *===========================================================================*/
+static void info_retry(message *m, int result)
+{
+/* A VM_INFO call had to wait for a page from a file. Try it again. */
+	int r = result;
+
+	if(r == OK && (r = do_info(m)) == SUSPEND)
+		return;
+
+	m->m_type = r;
+	if((r = send(m->m_source, m)) != OK)
+		printf("VM: couldn't send info reply to %d: %d\n",
+			m->m_source, r);
+}
+
 /*===========================================================================*
  *                              do_info                                      *
  *===========================================================================*/
 int do_info(message *m)
 {
+	message orig = *m;
 	struct vm_stats_info vsi;
 	struct vm_usage_info vui;
 	static struct vm_region_info vri[MAX_VRI_COUNT];
@@ -113,6 +131,9 @@ int do_info(message *m)
 		memstats(&dummy, &free_pages, &largest_contig);
 		vsi.vsi_free = free_pages;
 		vsi.vsi_largest = largest_contig;
+		memstats_blocks(vsi.vsi_blocks, VSI_ORDERS);
+		zero_pool_stats(&vsi.vsi_zeroed, &vsi.vsi_zero_hits,
+			&vsi.vsi_zero_misses);
 
 		get_stats_info(&vsi);
 
@@ -164,6 +185,11 @@ int do_info(message *m)
 	 * involvement of VM, so we are safe until we're done.
 	 */
 	r = handle_memory(vmp, ptr, size, 1 /*wrflag*/);
+	if (r == SUSPEND) {
+		/* The memory is mapped from a file and not read in yet. */
+		if (vfs_wait(info_retry, &orig) != OK) return ENOMEM;
+		return SUSPEND;
+	}
 	if (r != OK) return r;
 
 	/* Now that we know the copy out will succeed, perform the actual copy
@@ -173,6 +199,55 @@ int do_info(message *m)
 		(vir_bytes) vmp->vm_endpoint, ptr, size);
 }
 
+/*===========================================================================*
+ *				do_watch_mem				     *
+ *===========================================================================*/
+int do_watch_mem(message *m)
+{
+/* Start or stop telling the caller about changes in free memory. */
+	int p;
+
+	if (vm_isokendpt(m->m_source, &p) != OK)
+		return EINVAL;
+
+	if (m->VM_WM_ON)
+		vmproc[p].vm_flags |= VMF_WATCHMEM;
+	else
+		vmproc[p].vm_flags &= ~VMF_WATCHMEM;
+
+	return OK;
+}
+
+/*===========================================================================*
+ *				mem_watch_check				     *
+ *===========================================================================*/
+void mem_watch_check(void)
+{
+/* Notify the processes watching memory, such as file systems sizing their
+ * caches, once free memory has moved by a step since they were last told.
+ * They ask for the details with vm_info_stats().
+ */
+	static phys_bytes last_told;
+	phys_bytes free, step;
+	struct vmproc *vmp;
+	int r;
+
+	step = MAX(total_pages / MEM_WATCH_STEPS, 1);
+	free = mem_free_pages();
+	if (free < last_told + step && free + step > last_told)
+		return;
+	last_told = free;
+
+	for (vmp = vmproc; vmp < &vmproc[VMP_EXECTMP]; vmp++) {
+		if ((vmp->vm_flags & (VMF_INUSE | VMF_WATCHMEM)) !=
+			(VMF_INUSE | VMF_WATCHMEM))
+			continue;
+		if ((r = notify(vmp->vm_endpoint)) != OK)
+			printf("VM: notify of %d failed: %d\n",
+				vmp->vm_endpoint, r);
+	}
+}
+
 /*===========================================================================*
  *				swap_proc_slot	     			     *
  *===========================================================================*/
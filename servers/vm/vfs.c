@@ -0,0 +1,634 @@
+
+#define _SYSTEM 1
+
+/* This file handles the communication with VFS about memory mapped files,
+ * and keeps the cache of file pages that processes have mapped.
+ *
+ * VM must never block on VFS, as VFS needs VM to copy to and from user
+ * processes. Requests to VFS are therefore sent asynchronously, one at a
+ * time, and VFS answers each with a VM_VFS_REPLY call. Giving back a file
+ * goes through the same queue, as VFS may have to wait for its file server
+ * to do so, and requests behind it wait with it. A VM call that
+ * needs a file page that isn't there yet starts a request for it, and
+ * registers itself with vfs_wait() to be retried when the page is in.
+ *
+ * The entry points into this file are:
+ *   do_vfs_reply:	VFS answers the request VM sent it
+ *   do_vfs_mmap:	VFS maps part of an executable into a process
+ *   do_vfs_handlemem:	VFS needs user memory to be present
+ *   do_vfs_forget:	VFS says a file changed; forget its cached pages
+ *   vfs_fdlookup:	ask VFS which file an mmap() file descriptor is
+ *   vfs_pagein:	ask VFS to read a page of a file
+ *   vfs_wait:		retry a call when the page it needs is in
+ *   vfs_may_wait:	whether a copy by some process may wait for that
+ *   file_get:		get a reference to a mapped file
+ *   file_put:		drop a reference to a mapped file
+ *   cache_lookup:	look up a file page in the page cache
+ *   cache_remove:	remove a page from the page cache
+ */
+
+#include <minix/callnr.h>
+#include <minix/com.h>
+#include <minix/config.h>
+#include <minix/const.h>
+#include <minix/endpoint.h>
+#include <minix/minlib.h>
+#include <minix/type.h>
+#include <minix/ipc.h>
+#include <minix/sysutil.h>
+#include <minix/syslib.h>
+#include <minix/bitmap.h>
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "glo.h"
+#include "proto.h"
+#include "util.h"
+#include "region.h"
+#include "vfs.h"
+
+#define CACHE_HASH	1024	/* number of page cache hash chains */
+#define cache_hashfunc(file, pos) \
+	((((u32_t) (file) >> 4) ^ ((pos) / VM_PAGE_SIZE)) % CACHE_HASH)
+
+/* A VM call waiting for a request to VFS. */
+struct vfs_waiter {
+	vfs_callback_t	func;		/* function to retry the call */
+	message		msg;		/* message of the call */
+	struct vfs_waiter *next;	/* next waiter on the same request */
+};
+
+/* A request to VFS. */
+struct vfs_request {
+	int		type;		/* VFS_VM_PAGEIN, _FDLOOKUP or _PUT */
+	int		stale;		/* file changed while reading it */
+	struct vm_file	*file;		/* PAGEIN: file to read from */
+	u32_t		pos;		/* PAGEIN: position to read */
+	endpoint_t	fs_e;		/* PUT: file server of the file */
+	endpoint_t	drv_e;		/* PUT: driver of that file server */
+	ino_t		ino;		/* PUT: inode number of the file */
+	message		msg;		/* FDLOOKUP: the mmap() call */
+	struct vfs_waiter *waiters;	/* calls waiting for this request */
+	struct vfs_request *next;	/* next in queue */
+};
+
+static struct cached_page *cache_hash[CACHE_HASH];
+static struct vm_file *files;		/* all mapped files */
+static struct vfs_request *inflight;	/* request VFS is working on */
+static struct vfs_request *queue_head, *queue_tail;	/* yet to be sent */
+static struct vfs_request *lastreq;	/* request a SUSPEND is about */
+static char *bounce;			/* page VFS reads file data into */
+static phys_bytes bounce_phys;
+
+static void vfs_next(void);
+static void vfs_put(endpoint_t fs_e, endpoint_t drv_e, ino_t ino);
+
+/*===========================================================================*
+ *				vfs_send				     *
+ *===========================================================================*/
+static void vfs_send(message *m)
+{
+	int r;
+
+	if((r=asynsend3(VFS_PROC_NR, m, AMF_NOREPLY)) != OK)
+		panic("VM: asynsend to VFS failed: %d", r);
+}
+
+/*===========================================================================*
+ *				vfs_enqueue				     *
+ *===========================================================================*/
+static void vfs_enqueue(struct vfs_request *req)
+{
+	req->next = NULL;
+	if(queue_tail) queue_tail->next = req;
+	else queue_head = req;
+	queue_tail = req;
+
+	if(!inflight)
+		vfs_next();
+}
+
+/*===========================================================================*
+ *				vfs_next				     *
+ *===========================================================================*/
+static void vfs_next(void)
+{
+/* Send the next queued request to VFS. */
+	struct vfs_request *req;
+	message m;
+
+	assert(!inflight);
+
+	if(!(req = queue_head))
+		return;
+	if(!(queue_head = req->next))
+		queue_tail = NULL;
+	inflight = req;
+
+	memset(&m, 0, sizeof(m));
+	m.m_type = req->type;
+
+	switch(req->type) {
+	case VFS_VM_FDLOOKUP:
+		m.VMV_ENDPT = req->msg.m_source;
+		m.VMV_FD = req->msg.VMM_FD;
+		break;
+	case VFS_VM_PAGEIN:
+		/* VFS only reads the part of the page that is in the file. */
+		memset(bounce, 0, VM_PAGE_SIZE);
+		m.VMV_FS_E = req->file->fs_e;
+		m.VMV_INO = req->file->ino;
+		m.VMV_POS = req->pos;
+		m.VMV_ADDR = (vir_bytes) bounce;
+		m.VMV_LEN = VM_PAGE_SIZE;
+		break;
+	case VFS_VM_PUT:
+		m.VMV_FS_E = req->fs_e;
+		m.VMV_INO = req->ino;
+		break;
+	default:
+		panic("vfs_next: bad request type %d", req->type);
+	}
+
+	vfs_send(&m);
+}
+
+/*===========================================================================*
+ *				vfs_fdlookup				     *
+ *===========================================================================*/
+int vfs_fdlookup(message *m)
+{
+/* An mmap() of a file descriptor. Ask VFS what file it refers to; the
+ * mmap() call is finished by mmap_file_reply() when VFS answers.
+ */
+	struct vfs_request *req;
+
+	if(!(req = malloc(sizeof(*req))))
+		return ENOMEM;
+	memset(req, 0, sizeof(*req));
+	req->type = VFS_VM_FDLOOKUP;
+	req->msg = *m;
+
+	vfs_enqueue(req);
+
+	return SUSPEND;
+}
+
+/*===========================================================================*
+ *				vfs_pagein				     *
+ *===========================================================================*/
+int vfs_pagein(struct vm_file *file, u32_t pos)
+{
+/* A page of 'file' that isn't in the page cache is needed. Ask VFS to read
+ * it, unless that has been asked already. The caller is expected to pass
+ * the resulting SUSPEND back up to the VM call, which can then vfs_wait()
+ * for the page.
+ */
+	struct vfs_request *req;
+
+	assert(!(pos % VM_PAGE_SIZE));
+
+	if(!bounce && !(bounce = vm_allocpage(&bounce_phys, VMP_SLAB)))
+		return ENOMEM;
+
+	for(req = inflight ? inflight : queue_head; req;
+		req = (req == inflight) ? queue_head : req->next) {
+		if(req->type == VFS_VM_PAGEIN && req->file == file &&
+			req->pos == pos)
+			break;
+	}
+
+	if(!req) {
+		if(!(req = malloc(sizeof(*req))))
+			return ENOMEM;
+		memset(req, 0, sizeof(*req));
+		req->type = VFS_VM_PAGEIN;
+		req->file = file;
+		req->pos = pos;
+		file->refcount++;
+		vfs_enqueue(req);
+	}
+
+	lastreq = req;
+
+	return SUSPEND;
+}
+
+/*===========================================================================*
+ *				vfs_put					     *
+ *===========================================================================*/
+static void vfs_put(endpoint_t fs_e, endpoint_t drv_e, ino_t ino)
+{
+/* Give VFS back a reference to a file. Dropping the last one has VFS wait
+ * for the file server, so the request is queued like the others, and
+ * vfs_may_wait() can tell who the requests behind it depend on.
+ */
+	struct vfs_request *req;
+
+	if(!(req = malloc(sizeof(*req))))
+		panic("VM: no memory to give a file back to VFS");
+	memset(req, 0, sizeof(*req));
+	req->type = VFS_VM_PUT;
+	req->fs_e = fs_e;
+	req->drv_e = drv_e;
+	req->ino = ino;
+
+	vfs_enqueue(req);
+}
+
+/*===========================================================================*
+ *				vfs_may_wait				     *
+ *===========================================================================*/
+int vfs_may_wait(endpoint_t who)
+{
+/* A copy by 'who' needs the page that was just asked for. If finishing the
+ * request for it, or one before it, might need 'who' itself, it can't
+ * wait for it and the copy has to fail instead. VFS retries its own copies
+ * and FS requests after making the memory present.
+ */
+	struct vfs_request *req;
+
+	assert(lastreq);
+
+	if(who == VFS_PROC_NR) {
+		lastreq = NULL;
+		return FALSE;
+	}
+
+	for(req = inflight ? inflight : queue_head; req;
+		req = (req == inflight) ? queue_head : req->next) {
+		if((req->type == VFS_VM_PAGEIN && (who == req->file->fs_e ||
+			who == req->file->drv_e)) ||
+			(req->type == VFS_VM_PUT && (who == req->fs_e ||
+			who == req->drv_e))) {
+			lastreq = NULL;
+			return FALSE;
+		}
+		if(req == lastreq)
+			break;
+	}
+
+	return TRUE;
+}
+
+/*===========================================================================*
+ *				vfs_wait				     *
+ *===========================================================================*/
+int vfs_wait(vfs_callback_t func, message *m)
+{
+/* Call 'func' with a copy of 'm' when the request that caused the last
+ * SUSPEND is done.
+ */
+	struct vfs_waiter *w, **wp;
+
+	assert(lastreq);
+
+	if(!(w = malloc(sizeof(*w)))) {
+		lastreq = NULL;
+		return ENOMEM;
+	}
+	w->func = func;
+	w->msg = *m;
+	w->next = NULL;
+
+	for(wp = &lastreq->waiters; *wp; wp = &(*wp)->next)
+		;
+	*wp = w;
+
+	lastreq = NULL;
+
+	return OK;
+}
+
+/*===========================================================================*
+ *				file_get				     *
+ *===========================================================================*/
+struct vm_file *file_get(endpoint_t fs_e, endpoint_t drv_e, ino_t ino)
+{
+/* VFS has given VM a reference to a file. Only one reference per file is
+ * kept; any others are given back right away.
+ */
+	struct vm_file *file;
+
+	for(file = files; file; file = file->next) {
+		if(file->fs_e == fs_e && file->ino == ino)
+			break;
+	}
+
+	if(file || !SLABALLOC(file)) {
+		vfs_put(fs_e, drv_e, ino);
+
+		if(file) file->refcount++;
+		return file;
+	}
+
+	file->fs_e = fs_e;
+	file->drv_e = drv_e;
+	file->ino = ino;
+	file->refcount = 1;
+	file->next = files;
+	files = file;
+
+	return file;
+}
+
+/*===========================================================================*
+ *				file_put				     *
+ *===========================================================================*/
+void file_put(struct vm_file *file)
+{
+	struct vm_file **fp;
+
+	assert(file->refcount > 0);
+	if(--file->refcount > 0)
+		return;
+
+	for(fp = &files; *fp != file; fp = &(*fp)->next)
+		assert(*fp);
+	*fp = file->next;
+
+	vfs_put(file->fs_e, file->drv_e, file->ino);
+
+	SLABFREE(file);
+}
+
+/*===========================================================================*
+ *				cache_lookup				     *
+ *===========================================================================*/
+struct phys_block *cache_lookup(struct vm_file *file, u32_t pos)
+{
+	struct cached_page *cp;
+
+	for(cp = cache_hash[cache_hashfunc(file, pos)]; cp; cp = cp->hashnext)
+		if(cp->file == file && cp->pos == pos)
+			return cp->pb;
+
+	return NULL;
+}
+
+/*===========================================================================*
+ *				cache_insert				     *
+ *===========================================================================*/
+static int cache_insert(struct vm_file *file, u32_t pos, struct phys_block *pb)
+{
+	struct cached_page *cp;
+	int h = cache_hashfunc(file, pos);
+
+	assert(!pb->cached);
+	assert(!cache_lookup(file, pos));
+
+	if(!SLABALLOC(cp))
+		return ENOMEM;
+
+	cp->file = file;
+	cp->pos = pos;
+	cp->pb = pb;
+	cp->hashnext = cache_hash[h];
+	cache_hash[h] = cp;
+	pb->cached = cp;
+
+	return OK;
+}
+
+/*===========================================================================*
+ *				cache_remove				     *
+ *===========================================================================*/
+void cache_remove(struct phys_block *pb)
+{
+/* The page in 'pb' no longer holds file data that others may map. */
+	struct cached_page *cp = pb->cached, **cpp;
+
+	assert(cp);
+	assert(cp->pb == pb);
+
+	for(cpp = &cache_hash[cache_hashfunc(cp->file, cp->pos)];
+		*cpp != cp; cpp = &(*cpp)->hashnext)
+		assert(*cpp);
+	*cpp = cp->hashnext;
+
+	pb->cached = NULL;
+	SLABFREE(cp);
+}
+
+/*===========================================================================*
+ *				pagein_done				     *
+ *===========================================================================*/
+static struct phys_block *pagein_done(struct vfs_request *req, int r)
+{
+/* VFS has read a page into the bounce page. Put it in the page cache. */
+	phys_clicks cl;
+	phys_bytes page;
+	struct phys_block *pb;
+
+	if(r < 0)
+		return NULL;
+
+	if((cl = alloc_mem(1, 0)) == NO_MEM)
+		return NULL;
+	page = CLICK2ABS(cl);
+
+	if(sys_abscopy(bounce_phys, page, VM_PAGE_SIZE) != OK)
+		panic("pagein_done: abscopy failed");
+
+	if(!(pb = pb_new(page))) {
+		free_mem(cl, 1);
+		return NULL;
+	}
+
+	if(cache_insert(req->file, req->pos, pb) != OK) {
+		pb_free(pb);
+		return NULL;
+	}
+
+	return pb;
+}
+
+/*===========================================================================*
+ *				do_vfs_reply				     *
+ *===========================================================================*/
+int do_vfs_reply(message *m)
+{
+/* VFS answers the request in flight. Only VFS may do this; it doesn't
+ * expect a reply, so never send it one.
+ */
+	struct vfs_request *req;
+	struct vfs_waiter *w;
+	struct phys_block *pb;
+	struct vm_file *file;
+	int r = m->VMV_RESULT;
+
+	if(m->m_source != VFS_PROC_NR)
+		return EPERM;
+
+	if(!(req = inflight)) {
+		printf("VM: unexpected reply from VFS\n");
+		return SUSPEND;
+	}
+
+	if(req->type == VFS_VM_PAGEIN && req->stale) {
+		/* What VFS read may be older than the change; read again. */
+		inflight = NULL;
+		req->stale = 0;
+		req->next = queue_head;
+		queue_head = req;
+		if(!queue_tail) queue_tail = req;
+		vfs_next();
+		return SUSPEND;
+	}
+
+	inflight = NULL;
+
+	if(req->type == VFS_VM_FDLOOKUP) {
+		file = NULL;
+		if(r == OK && !(file = file_get(m->VMV_FS_E, m->VMV_DRV_E,
+			m->VMV_INO)))
+			r = ENOMEM;
+		mmap_file_reply(&req->msg, file, r);
+	} else if(req->type == VFS_VM_PAGEIN) {
+		if(!(pb = pagein_done(req, r)) && r >= 0)
+			r = ENOMEM;
+		if(r > 0)
+			r = OK;
+
+		/* Retry what was waiting for the page. With the page in the
+		 * cache, these find it there.
+		 */
+		while((w = req->waiters)) {
+			req->waiters = w->next;
+			w->func(&w->msg, r);
+			free(w);
+		}
+
+		/* Nobody mapped it after all. */
+		if(pb && pb->refcount == 0) {
+			cache_remove(pb);
+			pb_free(pb);
+		}
+
+		file_put(req->file);
+	}
+
+	free(req);
+
+	if(!inflight)
+		vfs_next();
+
+	return SUSPEND;
+}
+
+/*===========================================================================*
+ *				do_vfs_mmap				     *
+ *===========================================================================*/
+int do_vfs_mmap(message *m)
+{
+/* VFS maps part of an executable file into a process, and gives VM a
+ * reference to the file for it.
+ */
+	struct vm_file *file;
+	struct vmproc *vmp;
+	int n;
+
+	if(m->m_source != VFS_PROC_NR)
+		return EPERM;
+
+	if(!(file = file_get(m->VMV_FS_E, m->VMV_DRV_E, m->VMV_INO)))
+		return ENOMEM;
+
+	if(vm_isokendpt(m->VMV_ENDPT, &n) != OK) {
+		file_put(file);
+		return ESRCH;
+	}
+	vmp = &vmproc[n];
+
+	if(!map_file_region(vmp, (vir_bytes) m->VMV_ADDR, 0,
+		(vir_bytes) m->VMV_LEN, VR_WRITABLE, file,
+		(u32_t) m->VMV_POS, (vir_bytes) m->VMV_LEN)) {
+		file_put(file);
+		return ENOMEM;
+	}
+
+	return OK;
+}
+
+/*===========================================================================*
+ *				handlemem_reply				     *
+ *===========================================================================*/
+static void handlemem_reply(message *m, int r)
+{
+/* Tell VFS the memory it asked for is there, or why not. */
+	endpoint_t ep = m->VMV_ENDPT;
+	int n;
+
+	if(r == OK && vm_isokendpt(ep, &n) != OK)
+		r = ESRCH;
+
+	if(r == OK) {
+		r = handle_memory(&vmproc[n], (vir_bytes) m->VMV_ADDR,
+			(vir_bytes) m->VMV_LEN, m->VMV_WRITE != 0);
+
+		if(r == SUSPEND && (r = vfs_wait(handlemem_reply, m)) == OK)
+			return;
+	}
+
+	m->m_type = VFS_VM_REPLY;
+	m->VMV_RESULT = r;
+	vfs_send(m);
+}
+
+/*===========================================================================*
+ *				do_vfs_handlemem			     *
+ *===========================================================================*/
+int do_vfs_handlemem(message *m)
+{
+/* VFS found that a copy to or from a process failed, and wants the memory
+ * involved to be made present so it can try again. This may need pages
+ * from files, which VFS itself has to read. The answer is therefore sent
+ * asynchronously, when the memory is there.
+ */
+	if(m->m_source != VFS_PROC_NR)
+		return EPERM;
+
+	handlemem_reply(m, OK);
+
+	return SUSPEND;
+}
+
+/*===========================================================================*
+ *				do_vfs_forget				     *
+ *===========================================================================*/
+int do_vfs_forget(message *m)
+{
+/* A file was written or truncated. Processes that map it keep the pages
+ * they have, but new mappings must not get the old data from the cache.
+ */
+	struct vm_file *file;
+	struct cached_page *cp, *next;
+	int h;
+
+	if(m->m_source != VFS_PROC_NR)
+		return EPERM;
+
+	for(file = files; file; file = file->next)
+		if(file->fs_e == m->VMV_FS_E && file->ino == m->VMV_INO)
+			break;
+
+	if(!file)
+		return SUSPEND;
+
+	for(h = 0; h < CACHE_HASH; h++) {
+		for(cp = cache_hash[h]; cp; cp = next) {
+			next = cp->hashnext;
+			if(cp->file == file)
+				cache_remove(cp->pb);
+		}
+	}
+
+	if(inflight && inflight->type == VFS_VM_PAGEIN &&
+		inflight->file == file)
+		inflight->stale = 1;
+
+	return SUSPEND;
+}
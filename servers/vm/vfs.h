@@ -0,0 +1,34 @@
+
+#ifndef _VFS_H
+#define _VFS_H 1
+
+#include <minix/ipc.h>
+
+#include "region.h"
+
+/* A file that VM maps into processes. VFS holds a reference to the file
+ * on behalf of VM for as long as this structure exists.
+ */
+struct vm_file {
+	endpoint_t	fs_e;		/* file system the file lives on */
+	endpoint_t	drv_e;		/* driver of that file system, or NONE */
+	ino_t		ino;		/* inode number on that file system */
+	int		refcount;	/* regions and requests using it */
+	struct vm_file	*next;		/* next in list of all files */
+};
+
+/* A page of file data in the page cache. Pages are cached only while
+ * some process has them mapped; the phys_block goes away, and takes this
+ * entry with it, when its last reference does.
+ */
+struct cached_page {
+	struct vm_file	*file;		/* file the page belongs to */
+	u32_t		pos;		/* file position, page aligned */
+	struct phys_block *pb;		/* the page itself */
+	struct cached_page *hashnext;	/* next in hash chain */
+};
+
+/* Called when a request to VFS that a VM call was waiting for is done. */
+typedef void (*vfs_callback_t)(message *m, int result);
+
+#endif
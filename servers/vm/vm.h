@@ -34,6 +34,11 @@
 #define VERBOSE		0
 #define LU_DEBUG	0
 
+/* Processes watching memory are told when free memory has changed by this
+ * fraction of all memory.
+ */
+#define MEM_WATCH_STEPS	16
+
 /* Minimum stack region size - 64MB. */
 #define MINSTACKREGION	(64*1024*1024)
 
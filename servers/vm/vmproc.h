@@ -11,8 +11,6 @@
 
 struct vmproc;
 
-typedef void (*callback_t)(struct vmproc *who, message *m);
-
 struct vmproc {
 	int		vm_flags;
 	endpoint_t	vm_endpoint;
@@ -25,20 +23,8 @@ struct vmproc {
 
 	bitchunk_t vm_call_mask[VM_CALL_MASK_SIZE];
 
-	/* State for requests pending to be done to vfs on behalf of
-	 * this process.
-	 */
-	callback_t vm_callback;	  /* function to call on vfs reply */
-	int vm_callback_type; /* expected message type */
-
 	int vm_slot;		/* process table slot */
 	int vm_yielded;		/* yielded regions */
-
-	union {
-		struct {
-			cp_grant_id_t gid;
-		} open;	/* VM_VFS_OPEN */
-	} vm_state;		/* Callback state. */
 #if VMSTATS
 	int vm_bytecopies;
 #endif
@@ -48,5 +34,6 @@ struct vmproc {
 #define VMF_INUSE	0x001	/* slot contains a process */
 #define VMF_EXITING	0x002	/* PM is cleaning up this process */
 #define VMF_WATCHEXIT	0x008	/* Store in queryexit table */
+#define VMF_WATCHMEM	0x010	/* Notify of changes in free memory */
 
 #endif
@@ -125,6 +125,8 @@
 #define F_SETLK            6	/* set record locking information */
 #define F_SETLKW           7	/* set record locking info; wait if blocked */
 #define F_FREESP           8	/* free a section of a regular file */
+#define F_GETPIPE_SZ       9	/* get the capacity of a pipe */
+#define F_SETPIPE_SZ      10	/* set the capacity of a pipe */
 
 /* File descriptor flags used for fcntl().  POSIX Table 6-2. */
 #define FD_CLOEXEC         1	/* close on exec flag for third arg of fcntl */
@@ -0,0 +1,102 @@
+/* Test 66 - setting the capacity of a pipe with fcntl(). */
+
+#include <sys/types.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_ERROR 3
+
+#include "common.c"
+
+static void test66a(void);
+static void test66b(void);
+static void test66c(void);
+
+int main(int argc, char *argv[])
+{
+  start(66);
+
+  test66a();
+  test66b();
+  test66c();
+
+  quit();
+  return(-1);	/* Impossible */
+}
+
+static void test66a(void)
+{
+/* Set the size of a pipe and read it back from either end. */
+  int fd[2], size;
+
+  subtest = 1;
+
+  if (pipe(fd) != 0) e(1);
+  if ((size = fcntl(fd[0], F_GETPIPE_SZ)) < PIPE_BUF) e(2);
+  if (fcntl(fd[1], F_GETPIPE_SZ) != size) e(3);
+
+  if (fcntl(fd[1], F_SETPIPE_SZ, 128 * 1024) != 128 * 1024) e(4);
+  if (fcntl(fd[0], F_GETPIPE_SZ) != 128 * 1024) e(5);
+  if (fcntl(fd[1], F_GETPIPE_SZ) != 128 * 1024) e(6);
+
+  /* Sizes are rounded up to whole PIPE_BUF units. */
+  if (fcntl(fd[0], F_SETPIPE_SZ, PIPE_BUF + 1) != 2 * PIPE_BUF) e(7);
+  if (fcntl(fd[1], F_GETPIPE_SZ) != 2 * PIPE_BUF) e(8);
+
+  if (close(fd[0]) != 0) e(9);
+  if (close(fd[1]) != 0) e(10);
+}
+
+static void test66b(void)
+{
+/* A pipe holds as much as its size, and cannot shrink below its contents. */
+  char buf[PIPE_BUF];
+  int fd[2], i;
+
+  subtest = 2;
+
+  memset(buf, 'x', sizeof(buf));
+  if (pipe(fd) != 0) e(1);
+  if (fcntl(fd[1], F_SETFL, O_NONBLOCK) != 0) e(2);
+  if (fcntl(fd[1], F_SETPIPE_SZ, 4 * PIPE_BUF) != 4 * PIPE_BUF) e(3);
+
+  for (i = 0; i < 4; i++)
+	if (write(fd[1], buf, sizeof(buf)) != sizeof(buf)) e(4);
+  if (write(fd[1], buf, sizeof(buf)) != -1 || errno != EAGAIN) e(5);
+
+  if (fcntl(fd[1], F_SETPIPE_SZ, PIPE_BUF) != -1 || errno != EBUSY) e(6);
+  if (fcntl(fd[0], F_GETPIPE_SZ) != 4 * PIPE_BUF) e(7);
+
+  /* Growing the pipe makes room. */
+  if (fcntl(fd[1], F_SETPIPE_SZ, 5 * PIPE_BUF) != 5 * PIPE_BUF) e(8);
+  if (write(fd[1], buf, sizeof(buf)) != sizeof(buf)) e(9);
+
+  for (i = 0; i < 5; i++)
+	if (read(fd[0], buf, sizeof(buf)) != sizeof(buf)) e(10);
+
+  if (close(fd[0]) != 0) e(11);
+  if (close(fd[1]) != 0) e(12);
+}
+
+static void test66c(void)
+{
+/* Bad sizes and files that are not pipes are refused. */
+  int fd[2], fd2;
+
+  subtest = 3;
+
+  if (pipe(fd) != 0) e(1);
+  if (fcntl(fd[0], F_SETPIPE_SZ, 0) != -1 || errno != EINVAL) e(2);
+  if (fcntl(fd[0], F_SETPIPE_SZ, -1) != -1 || errno != EINVAL) e(3);
+  if (close(fd[0]) != 0) e(4);
+  if (close(fd[1]) != 0) e(5);
+
+  if ((fd2 = open("file", O_RDWR | O_CREAT, 0644)) < 0) e(6);
+  if (fcntl(fd2, F_SETPIPE_SZ, PIPE_BUF) != -1 || errno != EINVAL) e(7);
+  if (fcntl(fd2, F_GETPIPE_SZ) != -1 || errno != EINVAL) e(8);
+  if (close(fd2) != 0) e(9);
+}